@@ -41,6 +41,7 @@
 // // workGroupOffset -> by default 0, if you only downsample a rectancle within the source texture use SpdSetup function to calculate correct offset
 // ...
 // // Dispatch the shader such that each thread group works on a 64x64 sub-tile of the source image
+// // (SPD_TILE_SIZE x SPD_TILE_SIZE if you define SPD_TILE_SIZE 128, see TILE SIZE below)
 // // for Cube Textures or Texture2DArray, use the z dimension
 // vkCmdDispatch(cmdBuf,(widthInPixels+63)>>6,(heightInPixels+63)>>6, slices);
 
@@ -71,6 +72,8 @@
 // uint32_t dispatchZ = m_CubeTexture.GetArraySize(); // slices - for 2D Texture this is 1, for cube texture 6
 // vkCmdDispatch(cmd_buf, dispatchX, dispatchY, dispatchZ);
 
+// // or build a SpdPlan once and reuse it for every dispatch, see the SpdPlan section below
+
 //------------------------------------------------------------------------------------------------------------------------------
 // INTEGRATION SUMMARY FOR GPU
 // ===========================
@@ -88,6 +91,7 @@
 // // approximate conversion to linear (load function): x*x
 // // approximate conversion from linear (store function): sqrt()
 // // or use more accurate functions from ffx_a.h: AFromSrgbF1(value) and AToSrgbF1(value)
+// // or #define SPD_SRGB, SPD then applies the exact conversions to your load and store functions (see SRGB below)
 // // Recommendation: use UNORM format instead of SRGB for UAV access, and SRGB for SRV access
 // // look in the sample app to see how it's done
 
@@ -164,6 +168,7 @@
 // shared AF1 spdIntermediateG[16][16];
 // shared AF1 spdIntermediateB[16][16];
 // shared AF1 spdIntermediateA[16][16];
+// // with SPD_ONE_CHANNEL (see ONE CHANNEL below) only this one is needed, the LDS functions take and return AF1
 // // or for Packed version:
 // shared AH2 spdIntermediateRG[16][16];
 // shared AH2 spdIntermediateBA[16][16];
@@ -184,6 +189,7 @@
 // // there is to/from linear conversions when using a sampler and render target approach
 // // conversion to linear (load function): x*x
 // // conversion from linear (store function): sqrt()
+// // or #define SPD_SRGB for the exact conversions
 
 // AU1 slice parameter is for Cube textures and texture2DArray
 // if downsampling Texture2D you can ignore this parameter, otherwise use it to access correct slice
@@ -203,7 +209,7 @@
 // }
 
 // // SpdLoad() takes a 32-bit signed integer 2D coordinate and loads color.
-// // Loads the 5th mip level, each value is computed by a different thread group
+// // Loads the 5th mip level (6th with SPD_TILE_SIZE 128), each value is computed by a different thread group
 // // last thread group will access all its elements and compute the subsequent mips
 // // reminder: if non-power-of-2 textures, add border controls if you do not want to read zeros past the border
 // GLSL: AF4 SpdLoad(ASU2 p, AU1 slice){return imageLoad(imgDst[5],p);}
@@ -225,6 +231,27 @@
 // void SpdIncreaseAtomicCounter(AU1 slice){InterlockedAdd(spdGlobalAtomic[0].counter, 1, spdCounter);}
 // AU1 SpdGetAtomicCounter(){return spdCounter;}
 // void SpdResetAtomicCounter(AU1 slice){spdGlobalAtomic[0].counter[slice] = 0;}
+// // #define SPD_ALPHA_COVERAGE to preserve the alpha test coverage in every mip,
+// // this needs SpdAlphaCutoff(), a histogram and up to 1280 held back values in LDS, a coverage counter per slice, the
+// // tiles of the dispatch and an alpha load and store for mips 3-5 (see ALPHA COVERAGE below)
+// // #define SPD_NORMAL_MAP for two channel normal maps, this needs a roughness store and load (see NORMAL MAP below)
+// // #define SPD_MOMENTS to downsample depth into VSM / EVSM moments (see MOMENTS below)
+// // #define SPD_DEPTH_AWARE to downsample color and depth together without halos, this needs depth loads and a depth
+// // store (see DEPTH AWARE below)
+// // #define SPD_MULTI_TARGET to downsample color, depth and velocity in one dispatch, all values are a SpdTargets struct
+// // (see MULTI TARGET below)
+// // #define SPD_TILE_HASH to skip the tiles whose source didn't change since the last dispatch, this needs the raw source
+// // bits, a hash buffer with two uints per tile and a few uints of LDS (see TILE HASH below)
+// // #define SPD_BLOOM and call SpdDownsampleBloom() for a 13-tap bloom downsample chain in one dispatch (see BLOOM below)
+// // #define SPD_GAUSSIAN and call SpdDownsampleGaussian() for Gaussian and Laplacian pyramids (see GAUSSIAN PYRAMID below)
+// // #define SPD_ONE_CHANNEL for single channel images, all values are AF1 instead of AF4 (see ONE CHANNEL below)
+// // #define SPD_UINT for integer data, all values are AU4 instead of AF4 (see UINT VALUES below)
+// // #define SPD_MAJORITY for the most frequent of the four values, e.g. for material ID maps (see MAJORITY below)
+// // #define SPD_OCCUPANCY_OR or SPD_OCCUPANCY_AND for bitmask hierarchies, optionally SPD_OCCUPANCY_8X4 (see OCCUPANCY below)
+// // #define SPD_MAX_HEIGHT and call SpdDownsampleMaxHeight() for conservative max mips of heightfields (see MAX HEIGHT below)
+// // #define SPD_HISTOGRAM and call SpdLuminanceHistogram() for auto-exposure metering (see LUMINANCE HISTOGRAM below)
+// // #define SPD_SUMMED_AREA_TABLE and call SpdSummedAreaTable() for summed area tables (see SUMMED AREA TABLE below)
+// // #define SPD_UPSAMPLE and call SpdUpsample() for the up chain of bloom or SSAO in one dispatch (see UPSAMPLE below)
 
 // // Define the LDS load and store functions
 // // GLSL:
@@ -235,8 +262,13 @@
 // void SpdStoreIntermediate(AU1 x, AU1 y, AF4 value){spdIntermediate[x][y] = value;}
 
 // // Define your reduction function: takes as input the four 2x2 values and returns 1 output value
+// v0..v3 are the top left, top right, bottom left and bottom right value of the quad. This order is guaranteed on every
+// path, the source loads, the mip 6 loads, LDS and wave reductions, and for SpdReduce4H() as well. Up to version 2.0 the
+// source and mip 6 loads passed top left, bottom left, top right, bottom right, so order dependent reductions and the
+// float rounding of the average can give slightly different results than with that version.
 // Example below: computes the average value
 // AF4 SpdReduce4(AF4 v0, AF4 v1, AF4 v2, AF4 v3){return (v0+v1+v2+v3)*0.25;}
+// or #define SPD_KARIS_AVERAGE for a luminance weighted average of HDR data (see KARIS AVERAGE below)
 
 // // PACKED VERSION
 // Load from source image
@@ -255,7 +287,7 @@
 // }
 
 // // SpdLoadH() takes a 32-bit signed integer 2D coordinate and loads color.
-// // Loads the 5th mip level, each value is computed by a different thread group
+// // Loads the 5th mip level (6th with SPD_TILE_SIZE 128), each value is computed by a different thread group
 // // last thread group will access all its elements and compute the subsequent mips
 // GLSL: AH4 SpdLoadH(ASU2 p, AU1 slice){return AH4(imageLoad(imgDst[5],p));}
 // HLSL: AH4 SpdLoadH(ASU2 tex, AU1 slice){return AH4(imgDst[5][tex]);}
@@ -283,6 +315,7 @@
 // // Define your reduction function: takes as input the four 2x2 values and returns 1 output value
 // Example below: computes the average value
 // AH4 SpdReduce4H(AH4 v0, AH4 v1, AH4 v2, AH4 v3){return (v0+v1+v2+v3)*AH1(0.25);}
+// or #define SPD_KARIS_AVERAGE, the packed version also keeps the weighted sum in fp16 range
 
 // //
 
@@ -320,6 +353,126 @@
 //
 //------------------------------------------------------------------------------------------------------------------------------
 
+//==============================================================================================================================
+//                                                     TILE SIZE
+//==============================================================================================================================
+// Each thread group works on a SPD_TILE_SIZE x SPD_TILE_SIZE sub-tile of the source image.
+// 64 (default) or 128. With 128x128 tiles each thread group additionally computes one more mip before the LDS based
+// reduction, so 4x less thread groups hit the global atomic counter. In this case SpdLoad() has to load mip 6 instead of 5.
+// Must match the tile size passed to SpdCreatePlan() / used by SpdSetup() on the CPU side.
+#ifndef SPD_TILE_SIZE
+#define SPD_TILE_SIZE 64
+#endif
+#if SPD_TILE_SIZE == 128
+#define SPD_TILE_MIP_OFFSET 1
+#else
+#define SPD_TILE_MIP_OFFSET 0
+#endif
+// SpdUpsample() always works on 64x64 texels of a mip per thread group (see UPSAMPLE)
+#define SPD_UPSAMPLE_TILE_SIZE 64
+
+//==============================================================================================================================
+//                                                     MOMENTS
+//==============================================================================================================================
+// #define SPD_MOMENTS to build the moments pyramid of a variance shadow map straight from the depth buffer, in the same
+// dispatch: SpdLoadSourceImage() returns depth in .x, SPD turns it into the moments (d, d^2, 0, 0) and averages them.
+// SpdStore() receives the moments, write .xy for a two channel target.
+// #define SPD_MOMENTS_EVSM as well for exponential variance shadow maps: depth is warped to d' = 2d - 1 and the moments are
+// (e^(c+ d'), e^(2 c+ d'), -e^(-c- d'), e^(-2 c- d')) for a four channel target, c+ and c- are the exponents below.
+// The packed version clamps both exponents to 5.54, so e^(2c) still fits into fp16.
+// SpdLoad() returns the stored moments of mip 5, SpdReduce4() has to stay an average.
+// With SPD_LINEAR_SAMPLER the sampler averages depth before the moments are taken, so mip 0 misses the variance of each quad.
+// The CPU engine has the formats RGBA32FVsm and RGBA32FEvsm for the same.
+#ifndef SPD_EVSM_POSITIVE_EXPONENT
+#define SPD_EVSM_POSITIVE_EXPONENT 40.0
+#endif
+#ifndef SPD_EVSM_NEGATIVE_EXPONENT
+#define SPD_EVSM_NEGATIVE_EXPONENT 5.0
+#endif
+
+//==============================================================================================================================
+//                                                     ONE CHANNEL
+//==============================================================================================================================
+// #define SPD_ONE_CHANNEL for single channel images like grayscale camera frames, depth or masks. Every value of the non-packed
+// version is an AF1 instead of an AF4: SpdLoadSourceImage(), SpdLoad(), SpdStore(), SpdReduce4() and the LDS functions take
+// and return AF1, so the LDS only holds spdIntermediateR and the quad shuffles move one register instead of four.
+// 8 and 16-bit unorm data is exact in fp32, there is no packed version (A_HALF is ignored for SPD, SpdDownsampleH() is not
+// defined). SRGB, KARIS_AVERAGE, ALPHA_COVERAGE, NORMAL_MAP, MOMENTS, BLOOM and GAUSSIAN need more than one channel.
+// The CPU engine has the formats R8Unorm and R16Unorm for the same.
+//
+// GLSL: layout(set=0,binding=0,r8) uniform image2D imgSrc;
+// AF1 SpdLoadSourceImage(ASU2 p, AU1 slice){return imageLoad(imgSrc, p).x;}
+// void SpdStore(ASU2 p, AF1 value, AU1 mip, AU1 slice){imageStore(imgDst[mip], p, AF4(value));}
+// AF1 SpdLoadIntermediate(AU1 x, AU1 y){return spdIntermediateR[x][y];}
+// void SpdStoreIntermediate(AU1 x, AU1 y, AF1 value){spdIntermediateR[x][y] = value;}
+// AF1 SpdReduce4(AF1 v0, AF1 v1, AF1 v2, AF1 v3){return (v0+v1+v2+v3)*0.25;}
+// HLSL: [[vk::binding(0)]] Texture2D<float> imgSrc :register(u0);
+// AF1 SpdLoadSourceImage(ASU2 tex, AU1 slice){return imgSrc[tex];}
+#ifdef SPD_ONE_CHANNEL
+#if defined(SPD_SRGB) || defined(SPD_KARIS_AVERAGE) || defined(SPD_ALPHA_COVERAGE) || defined(SPD_NORMAL_MAP)
+#error SPD_ONE_CHANNEL excludes SPD_SRGB, SPD_KARIS_AVERAGE, SPD_ALPHA_COVERAGE and SPD_NORMAL_MAP
+#endif
+#if defined(SPD_MOMENTS) || defined(SPD_BLOOM) || defined(SPD_GAUSSIAN) || defined(SPD_PACKED_ONLY)
+#error SPD_ONE_CHANNEL excludes SPD_MOMENTS, SPD_BLOOM, SPD_GAUSSIAN and SPD_PACKED_ONLY
+#endif
+#endif // #ifdef SPD_ONE_CHANNEL
+
+//==============================================================================================================================
+//                                                     UINT VALUES
+//==============================================================================================================================
+// #define SPD_UINT for integer data like material IDs, segmentation masks or other labels that can't be averaged. Every value
+// of the non-packed version is an AU4 instead of an AF4 (AU1 with SPD_ONE_CHANNEL): the load, store, reduce and LDS
+// functions take and return uints, so the LDS holds integers as well. Usually combined with SPD_MAJORITY (see MAJORITY below),
+// SpdReduce4() can be any other integer reduction too. There is no packed version.
+// Only the plain load path: no SPD_LINEAR_SAMPLER, and none of the modes that work on colors.
+// The CPU engine has the formats R8UintMajority and R32UintMajority for the same.
+//
+// GLSL: layout(set=0,binding=0,r32ui) uniform uimage2D imgSrc;
+// AU1 SpdLoadSourceImage(ASU2 p, AU1 slice){return imageLoad(imgSrc, p).x;}
+// shared AU1 spdIntermediateR[16][16]; // HLSL: groupshared
+// AU1 SpdLoadIntermediate(AU1 x, AU1 y){return spdIntermediateR[x][y];}
+// void SpdStoreIntermediate(AU1 x, AU1 y, AU1 value){spdIntermediateR[x][y] = value;}
+// HLSL: [[vk::binding(0)]] Texture2D<uint> imgSrc :register(u0);
+#ifdef SPD_UINT
+#if defined(SPD_SRGB) || defined(SPD_KARIS_AVERAGE) || defined(SPD_ALPHA_COVERAGE) || defined(SPD_NORMAL_MAP)
+#error SPD_UINT excludes SPD_SRGB, SPD_KARIS_AVERAGE, SPD_ALPHA_COVERAGE and SPD_NORMAL_MAP
+#endif
+#if defined(SPD_MOMENTS) || defined(SPD_BLOOM) || defined(SPD_GAUSSIAN) || defined(SPD_PACKED_ONLY)
+#error SPD_UINT excludes SPD_MOMENTS, SPD_BLOOM, SPD_GAUSSIAN and SPD_PACKED_ONLY
+#endif
+#ifdef SPD_LINEAR_SAMPLER
+#error SPD_UINT excludes SPD_LINEAR_SAMPLER
+#endif
+#endif // #ifdef SPD_UINT
+#if defined(SPD_MAJORITY) && !defined(SPD_UINT)
+#error SPD_MAJORITY needs SPD_UINT
+#endif
+#if (defined(SPD_OCCUPANCY_OR) || defined(SPD_OCCUPANCY_AND)) && !defined(SPD_UINT)
+#error SPD_OCCUPANCY_OR and SPD_OCCUPANCY_AND need SPD_UINT
+#endif
+#if defined(SPD_OCCUPANCY_OR) && (defined(SPD_OCCUPANCY_AND) || defined(SPD_MAJORITY))
+#error SPD_OCCUPANCY_OR excludes SPD_OCCUPANCY_AND and SPD_MAJORITY
+#endif
+#if defined(SPD_OCCUPANCY_AND) && defined(SPD_MAJORITY)
+#error SPD_OCCUPANCY_AND excludes SPD_MAJORITY
+#endif
+#if defined(SPD_OCCUPANCY_8X4) && !defined(SPD_OCCUPANCY_OR) && !defined(SPD_OCCUPANCY_AND)
+#error SPD_OCCUPANCY_8X4 needs SPD_OCCUPANCY_OR or SPD_OCCUPANCY_AND
+#endif
+
+// value type of the non-packed version
+#if defined(SPD_UINT) && defined(SPD_ONE_CHANNEL)
+#define SpdValue AU1
+#elif defined(SPD_UINT)
+#define SpdValue AU4
+#elif defined(SPD_ONE_CHANNEL)
+#define SpdValue AF1
+#elif defined(SPD_MULTI_TARGET)
+#define SpdValue SpdTargets
+#else
+#define SpdValue AF4
+#endif
+
 //==============================================================================================================================
 //                                                     SPD Setup
 //==============================================================================================================================
@@ -331,11 +484,11 @@ outAU2 numWorkGroupsAndMips, // GPU side: pass in as constant
 inAU4 rectInfo, // left, top, width, height
 ASU1 mips // optional: if -1, calculate based on rect width and height
 ){
-    workGroupOffset[0] = rectInfo[0] / 64; // rectInfo[0] = left
-    workGroupOffset[1] = rectInfo[1] / 64; // rectInfo[1] = top
+    workGroupOffset[0] = rectInfo[0] / SPD_TILE_SIZE; // rectInfo[0] = left
+    workGroupOffset[1] = rectInfo[1] / SPD_TILE_SIZE; // rectInfo[1] = top
 
-    AU1 endIndexX = (rectInfo[0] + rectInfo[2] - 1) / 64; // rectInfo[0] = left, rectInfo[2] = width
-    AU1 endIndexY = (rectInfo[1] + rectInfo[3] - 1) / 64; // rectInfo[1] = top, rectInfo[3] = height
+    AU1 endIndexX = (rectInfo[0] + rectInfo[2] - 1) / SPD_TILE_SIZE; // rectInfo[0] = left, rectInfo[2] = width
+    AU1 endIndexY = (rectInfo[1] + rectInfo[3] - 1) / SPD_TILE_SIZE; // rectInfo[1] = top, rectInfo[3] = height
 
     dispatchThreadGroupCountXY[0] = endIndexX + 1 - workGroupOffset[0];
     dispatchThreadGroupCountXY[1] = endIndexY + 1 - workGroupOffset[1];
@@ -358,6 +511,147 @@ A_STATIC void SpdSetup(
 ) {
     SpdSetup(dispatchThreadGroupCountXY, workGroupOffset, numWorkGroupsAndMips, rectInfo, -1);
 }
+
+//==============================================================================================================================
+//                                                     SPD Plan
+//==============================================================================================================================
+// Typed, reusable alternative to SpdSetup. Build it once (at compile time if the sizes are known) and keep it around,
+// recording a dispatch then only reads the cached values.
+// static constexpr SpdPlan plan = SpdCreatePlan(4096, 4096, 1);
+// or at init time:
+// m_plan = SpdCreatePlan(m_Texture.GetWidth(), m_Texture.GetHeight(), m_Texture.GetArraySize());
+// // optionally restrict the update to some rectangles, each rectangle is dispatched separately
+// m_plan = SpdCreatePlan(width, height, slices, SpdPlanRect{left, top, rectWidth, rectHeight});
+// m_plan = SpdPlanAddRect(m_plan, SpdPlanRect{left2, top2, rectWidth2, rectHeight2});
+// ...
+// for (AU1 i = 0; i < m_plan.rectCount; i++)
+// {
+//    const SpdPlanDispatch &dispatch = m_plan.dispatches[i];
+//    data.mips = m_plan.mips;
+//    data.numWorkGroupsPerSlice = dispatch.numWorkGroups;
+//    data.workGroupOffset[0] = dispatch.workGroupOffset[0];
+//    data.workGroupOffset[1] = dispatch.workGroupOffset[1];
+//    vkCmdDispatch(cmd_buf, dispatch.dispatchThreadGroupCountXY[0], dispatch.dispatchThreadGroupCountXY[1], m_plan.slices);
+// }
+#define SPD_PLAN_MAX_MIPS 12
+#define SPD_PLAN_MAX_RECTS 4
+
+struct SpdPlanRect
+{
+    AU1 left;
+    AU1 top;
+    AU1 width;
+    AU1 height;
+};
+
+struct SpdPlanDispatch
+{
+    SpdPlanRect rect;
+    AU1 dispatchThreadGroupCountXY[2]; // CPU side: dispatch thread group count xy
+    AU1 workGroupOffset[2]; // GPU side: pass in as constant
+    AU1 numWorkGroups; // GPU side: pass in as constant, thread groups per slice
+};
+
+struct SpdPlan
+{
+    AU1 width;
+    AU1 height;
+    AU1 slices;
+    AU1 mips;
+    AU1 format; // not used by the GPU path, SpdCpuFormat for the CPU engine
+    AU1 tileSize; // GPU: must match SPD_TILE_SIZE, CPU: 32, 64 or 128
+    AU1 rectCount;
+    SpdPlanDispatch dispatches[SPD_PLAN_MAX_RECTS];
+    AU1 mipExtents[SPD_PLAN_MAX_MIPS][2]; // width and height of each generated mip, mip 0 is half the source size
+    AU1 counterBufferSize; // in bytes, one 32-bit global atomic counter per slice
+};
+
+A_STATIC constexpr AU1 SpdPlanMaxMips(AU1 width, AU1 height)
+{
+    // floor(log2(max(width, height))), clamped to 12
+    AU1 resolution = width > height ? width : height;
+    AU1 mips = 0;
+    while ((resolution >>= 1) != 0 && mips < SPD_PLAN_MAX_MIPS)
+        mips++;
+    return mips;
+}
+
+A_STATIC constexpr SpdPlanDispatch SpdPlanComputeDispatch(SpdPlanRect rect, AU1 tileSize)
+{
+    SpdPlanDispatch dispatch = {};
+    dispatch.rect = rect;
+    dispatch.workGroupOffset[0] = rect.left / tileSize;
+    dispatch.workGroupOffset[1] = rect.top / tileSize;
+
+    AU1 endIndexX = (rect.left + rect.width - 1) / tileSize;
+    AU1 endIndexY = (rect.top + rect.height - 1) / tileSize;
+
+    dispatch.dispatchThreadGroupCountXY[0] = endIndexX + 1 - dispatch.workGroupOffset[0];
+    dispatch.dispatchThreadGroupCountXY[1] = endIndexY + 1 - dispatch.workGroupOffset[1];
+    dispatch.numWorkGroups = dispatch.dispatchThreadGroupCountXY[0] * dispatch.dispatchThreadGroupCountXY[1];
+    return dispatch;
+}
+
+A_STATIC constexpr SpdPlan SpdCreatePlan(
+    AU1 width, // source texture width
+    AU1 height, // source texture height
+    AU1 slices, // 1 for Texture2D, 6 for cube textures
+    SpdPlanRect rect, // left, top, width, height of the region to update
+    ASU1 mips = -1, // optional: if -1, calculate based on the texture width and height
+    AU1 format = 0, // optional: SpdCpuFormat if the plan is used by the CPU engine
+    AU1 tileSize = SPD_TILE_SIZE // optional: source tile size per thread group
+) {
+    SpdPlan plan = {};
+    plan.width = width;
+    plan.height = height;
+    plan.slices = slices;
+    plan.mips = (mips >= 0 && AU1(mips) < SpdPlanMaxMips(width, height)) ? AU1(mips) : SpdPlanMaxMips(width, height);
+    plan.format = format;
+    plan.tileSize = tileSize;
+    plan.rectCount = 1;
+    plan.dispatches[0] = SpdPlanComputeDispatch(rect, tileSize);
+    for (AU1 i = 0; i < plan.mips; i++)
+    {
+        plan.mipExtents[i][0] = (width >> (i + 1)) > 0 ? (width >> (i + 1)) : 1;
+        plan.mipExtents[i][1] = (height >> (i + 1)) > 0 ? (height >> (i + 1)) : 1;
+    }
+    plan.counterBufferSize = slices * AU1(sizeof(AU1));
+    return plan;
+}
+
+A_STATIC constexpr SpdPlan SpdCreatePlan(AU1 width, AU1 height, AU1 slices, ASU1 mips = -1, AU1 format = 0,
+    AU1 tileSize = SPD_TILE_SIZE)
+{
+    return SpdCreatePlan(width, height, slices, SpdPlanRect{ 0, 0, width, height }, mips, format, tileSize);
+}
+
+// Adds another rectangle to update. If the plan is full, the last rectangle is grown to cover the new one.
+A_STATIC constexpr SpdPlan SpdPlanAddRect(SpdPlan plan, SpdPlanRect rect)
+{
+    if (plan.rectCount < SPD_PLAN_MAX_RECTS)
+    {
+        plan.dispatches[plan.rectCount++] = SpdPlanComputeDispatch(rect, plan.tileSize);
+        return plan;
+    }
+    SpdPlanRect last = plan.dispatches[SPD_PLAN_MAX_RECTS - 1].rect;
+    AU1 left = last.left < rect.left ? last.left : rect.left;
+    AU1 top = last.top < rect.top ? last.top : rect.top;
+    AU1 right = (last.left + last.width) > (rect.left + rect.width) ? (last.left + last.width) : (rect.left + rect.width);
+    AU1 bottom = (last.top + last.height) > (rect.top + rect.height) ? (last.top + last.height) : (rect.top + rect.height);
+    plan.dispatches[SPD_PLAN_MAX_RECTS - 1] = SpdPlanComputeDispatch(SpdPlanRect{ left, top, right - left, bottom - top },
+        plan.tileSize);
+    return plan;
+}
+
+// Thread groups per slice of SpdUpsample() for the mips of the plan (see UPSAMPLE), 0 if there is nothing to upsample
+A_STATIC constexpr AU1 SpdPlanUpsampleWorkGroups(const SpdPlan &plan)
+{
+    AU1 workGroups = 0;
+    for (AU1 i = 0; i + 1 < plan.mips; i++)
+        workGroups += ((plan.mipExtents[i][0] + SPD_UPSAMPLE_TILE_SIZE - 1) / SPD_UPSAMPLE_TILE_SIZE) *
+            ((plan.mipExtents[i][1] + SPD_UPSAMPLE_TILE_SIZE - 1) / SPD_UPSAMPLE_TILE_SIZE);
+    return workGroups;
+}
 #endif // #ifdef A_CPU
 //==============================================================================================================================
 //                                                     NON-PACKED VERSION
@@ -371,8 +665,398 @@ A_STATIC void SpdSetup(
   AF4 SpdLoadIntermediate(AU1 x, AU1 y){return AF4(0.0,0.0,0.0,0.0);}
   void SpdStoreIntermediate(AU1 x, AU1 y, AF4 value){}
   AF4 SpdReduce4(AF4 v0, AF4 v1, AF4 v2, AF4 v3){return AF4(0.0,0.0,0.0,0.0);}
+#ifdef SPD_NORMAL_MAP
+  void SpdStoreRoughness(ASU2 p, AF1 variance, AU1 mip, AU1 slice){}
+  AF1 SpdLoadRoughness(ASU2 p, AU1 slice){return AF1(0.0);}
+#endif
 #endif // #ifdef SPD_PACKED_ONLY
 
+// Depth to moments, see MOMENTS above
+#ifdef SPD_MOMENTS
+#if defined(SPD_SRGB) || defined(SPD_NORMAL_MAP)
+#error SPD_MOMENTS excludes SPD_SRGB and SPD_NORMAL_MAP
+#endif
+AF4 SpdDepthToMoments(AF1 d)
+{
+#ifdef SPD_MOMENTS_EVSM
+    d = d * AF1_(2.0) - AF1_(1.0);
+    AF1 positive = exp(AF1_(SPD_EVSM_POSITIVE_EXPONENT) * d);
+    AF1 negative = -exp(-AF1_(SPD_EVSM_NEGATIVE_EXPONENT) * d);
+    return AF4(positive, positive * positive, negative, negative * negative);
+#else
+    return AF4(d, d * d, AF1_(0.0), AF1_(0.0));
+#endif
+}
+#endif // #ifdef SPD_MOMENTS
+
+//==============================================================================================================================
+//                                                     NORMAL MAP
+//==============================================================================================================================
+// #define SPD_NORMAL_MAP to downsample two channel (BC5 style) tangent space normal maps. SpdLoadSourceImage() returns the
+// encoded normal in .xy, z is reconstructed. Normals are averaged in 3D, SpdStore() receives the renormalized normal encoded
+// to [0, 1] in .xyz (write .xy for a two channel target).
+// Averaging unit normals shortens them. The lost length goes to a separate roughness output: SPD calls SpdStoreRoughness()
+// for every mip with the Toksvig variance (1 - |n|) / |n| of the average, e.g. add it to the squared GGX roughness.
+// Each mip averages the source normals, not the renormalized ones of the mip above: the last workgroup rebuilds the length
+// of mip 5 from its variance, so SpdLoadRoughness() has to return the variance stored for mip 5.
+// With SPD_LINEAR_SAMPLER the sampler averages the encoded normals of mip 0, which then has no variance.
+//
+// // Define the roughness store and load functions
+// GLSL:
+// void SpdStoreRoughness(ASU2 p, AF1 variance, AU1 mip, AU1 slice){imageStore(imgRoughness[mip], p, AF4(variance));}
+// AF1 SpdLoadRoughness(ASU2 p, AU1 slice){return imageLoad(imgRoughness[5], p).x;}
+// HLSL:
+// void SpdStoreRoughness(ASU2 p, AF1 variance, AU1 mip, AU1 slice){imgRoughness[mip][p] = variance;}
+// AF1 SpdLoadRoughness(ASU2 p, AU1 slice){return imgRoughness[5][p];}
+// // PACKED version: SpdStoreRoughnessH(ASU2 p, AH1 variance, AU1 mip, AU1 slice) and AH1 SpdLoadRoughnessH(ASU2 p, AU1 slice)
+#ifdef SPD_NORMAL_MAP
+#ifdef SPD_SRGB
+#error SPD_NORMAL_MAP and SPD_SRGB are exclusive
+#endif
+
+// Encoded two channel normal to 3D, scaled to the length its variance stands for
+AF4 SpdDecodeNormal(AF2 encoded, AF1 variance)
+{
+    AF2 xy = encoded * AF1_(2.0) - AF1_(1.0);
+    AF1 z = sqrt(ASatF1(AF1_(1.0) - dot(xy, xy)));
+    return AF4(AF3(xy, z) * ARcpF1(AF1_(1.0) + variance), AF1_(0.0));
+}
+
+// Averaged normal to the encoded renormalized normal in .xyz and its variance in .w
+AF4 SpdEncodeNormal(AF3 n)
+{
+    AF1 len = max(length(n), AF1_(1.0 / 65536.0));
+    return AF4(n * (AF1_(0.5) / len) + AF1_(0.5), (AF1_(1.0) - len) / len);
+}
+#endif // #ifdef SPD_NORMAL_MAP
+
+//==============================================================================================================================
+//                                                     DEPTH AWARE
+//==============================================================================================================================
+// #define SPD_DEPTH_AWARE to downsample color and depth together for half resolution effects like SSR or volumetrics, so
+// averaging across depth edges doesn't leave halos. SPD loads depth with SpdLoadSourceDepth() next to the color and carries
+// it in .w of every value: of each 2x2 quad the nearest depth (the minimum, with SPD_DEPTH_AWARE_MAX the maximum for
+// reversed Z) is kept, and the colors of the samples whose depth is within SpdDepthTolerance() * depth of it are averaged.
+// The nearest sample is always part of the average, so a tolerance of 0 picks the color of the nearest sample.
+// SpdStore() receives the color with alpha 1, SpdStoreDepth() the depth of the same texel, SpdLoad() and SpdLoadDepth()
+// return color and depth of mip 5. Linear view depth makes the relative tolerance the same at every distance.
+// Each mip only sees the four values of the mip above. Only single texel source loads, and no packed version as fp16 is too
+// coarse for depth (SpdDownsampleH() is not defined).
+// SpdReduce4() still has to be defined, it is just not called.
+// The CPU engine has the format RGBA32FDepthAware for the same, with depth stored in alpha.
+//
+// // Define the tolerance and the depth load and store functions
+// AF1 SpdDepthTolerance(){return 0.05;}
+// GLSL:
+// AF1 SpdLoadSourceDepth(ASU2 p, AU1 slice){return imageLoad(imgSrcDepth, p).x;}
+// AF1 SpdLoadDepth(ASU2 p, AU1 slice){return imageLoad(imgDstDepth[5], p).x;}
+// void SpdStoreDepth(ASU2 p, AF1 depth, AU1 mip, AU1 slice){imageStore(imgDstDepth[mip], p, AF4(depth));}
+// HLSL:
+// AF1 SpdLoadSourceDepth(ASU2 p, AU1 slice){return imgSrcDepth[p];}
+// AF1 SpdLoadDepth(ASU2 p, AU1 slice){return imgDstDepth[5][p];}
+// void SpdStoreDepth(ASU2 p, AF1 depth, AU1 mip, AU1 slice){imgDstDepth[mip][p] = depth;}
+#ifdef SPD_DEPTH_AWARE
+#if defined(SPD_ONE_CHANNEL) || defined(SPD_UINT) || defined(SPD_LINEAR_SAMPLER) || defined(SPD_PACKED_ONLY)
+#error SPD_DEPTH_AWARE excludes SPD_ONE_CHANNEL, SPD_UINT, SPD_LINEAR_SAMPLER and SPD_PACKED_ONLY
+#endif
+#if defined(SPD_KARIS_AVERAGE) || defined(SPD_ALPHA_COVERAGE) || defined(SPD_NORMAL_MAP) || defined(SPD_MOMENTS)
+#error SPD_DEPTH_AWARE excludes SPD_KARIS_AVERAGE, SPD_ALPHA_COVERAGE, SPD_NORMAL_MAP and SPD_MOMENTS
+#endif
+#if defined(SPD_BLOOM) || defined(SPD_GAUSSIAN) || defined(SPD_MAX_HEIGHT)
+#error SPD_DEPTH_AWARE excludes SPD_BLOOM, SPD_GAUSSIAN and SPD_MAX_HEIGHT
+#endif
+
+AF1 SpdDepthAwareWeightF1(AF1 depth, AF1 nearest, AF1 tolerance)
+{
+    return abs(depth - nearest) <= tolerance ? AF1_(1.0) : AF1_(0.0);
+}
+
+AF4 SpdReduce4DepthAware(AF4 v0, AF4 v1, AF4 v2, AF4 v3)
+{
+#ifdef SPD_DEPTH_AWARE_MAX
+    AF1 nearest = max(max(v0.w, v1.w), max(v2.w, v3.w));
+#else
+    AF1 nearest = min(min(v0.w, v1.w), min(v2.w, v3.w));
+#endif
+    AF1 tolerance = SpdDepthTolerance() * abs(nearest);
+    AF1 w0 = SpdDepthAwareWeightF1(v0.w, nearest, tolerance);
+    AF1 w1 = SpdDepthAwareWeightF1(v1.w, nearest, tolerance);
+    AF1 w2 = SpdDepthAwareWeightF1(v2.w, nearest, tolerance);
+    AF1 w3 = SpdDepthAwareWeightF1(v3.w, nearest, tolerance);
+    AF3 color = v0.xyz * w0 + v1.xyz * w1 + v2.xyz * w2 + v3.xyz * w3;
+    return AF4(color * ARcpF1(w0 + w1 + w2 + w3), nearest);
+}
+#endif // #ifdef SPD_DEPTH_AWARE
+
+//==============================================================================================================================
+//                                                     MULTI TARGET
+//==============================================================================================================================
+// #define SPD_MULTI_TARGET to downsample HDR color, depth and motion vectors of a frame in one dispatch instead of three. Every
+// value of the non-packed version is a SpdTargets struct that holds all three, so the index math, the tile scheduling,
+// the single atomic counter per slice and the tail of the last workgroup are shared. Each member has its own reduction:
+// color is averaged, depth keeps the minimum in .x and the maximum in .y for min and max Hi-Z chains, velocity keeps the
+// longest of the four motion vectors (ties go to the first of v0..v3).
+// SpdLoadSourceImage() returns depth in both .x and .y, SpdStore() writes each member to its own mip chain, SpdLoad()
+// returns the stored mip 5 values. The LDS functions take and return SpdTargets. SpdReduce4() is not needed.
+// The struct has to be defined before the callbacks, as below. Only the non-packed version and single texel source loads.
+// The CPU engine has SpdDownsampleCpuMultiTarget() for the same, with the formats RGBA32F, RG32FMinMax and RG32FMaxLength.
+//
+// struct SpdTargets { AF4 color; AF2 depth; AF2 velocity; };
+// shared SpdTargets spdIntermediate[16][16]; // HLSL: groupshared
+// GLSL:
+// SpdTargets SpdLoadSourceImage(ASU2 p, AU1 slice){SpdTargets t; t.color = imageLoad(imgSrc, p);
+//    t.depth = imageLoad(imgSrcDepth, p).xx; t.velocity = imageLoad(imgSrcVelocity, p).xy; return t;}
+// void SpdStore(ASU2 p, SpdTargets value, AU1 mip, AU1 slice){imageStore(imgDst[mip], p, value.color);
+//    imageStore(imgDstDepth[mip], p, AF4(value.depth, 0.0, 0.0));
+//    imageStore(imgDstVelocity[mip], p, AF4(value.velocity, 0.0, 0.0));}
+// HLSL:
+// SpdTargets SpdLoadSourceImage(ASU2 p, AU1 slice){SpdTargets t; t.color = imgSrc[p];
+//    t.depth = imgSrcDepth[p].xx; t.velocity = imgSrcVelocity[p].xy; return t;}
+// void SpdStore(ASU2 p, SpdTargets value, AU1 mip, AU1 slice){imgDst[mip][p] = value.color;
+//    imgDstDepth[mip][p] = value.depth; imgDstVelocity[mip][p] = value.velocity;}
+#ifdef SPD_MULTI_TARGET
+#if defined(SPD_ONE_CHANNEL) || defined(SPD_UINT) || defined(SPD_LINEAR_SAMPLER) || defined(SPD_PACKED_ONLY)
+#error SPD_MULTI_TARGET excludes SPD_ONE_CHANNEL, SPD_UINT, SPD_LINEAR_SAMPLER and SPD_PACKED_ONLY
+#endif
+#if defined(SPD_SRGB) || defined(SPD_KARIS_AVERAGE) || defined(SPD_ALPHA_COVERAGE) || defined(SPD_NORMAL_MAP)
+#error SPD_MULTI_TARGET excludes SPD_SRGB, SPD_KARIS_AVERAGE, SPD_ALPHA_COVERAGE and SPD_NORMAL_MAP
+#endif
+#if defined(SPD_MOMENTS) || defined(SPD_DEPTH_AWARE) || defined(SPD_BLOOM) || defined(SPD_GAUSSIAN)
+#error SPD_MULTI_TARGET excludes SPD_MOMENTS, SPD_DEPTH_AWARE, SPD_BLOOM and SPD_GAUSSIAN
+#endif
+#if defined(SPD_MAX_HEIGHT) || defined(SPD_HISTOGRAM) || defined(SPD_SUMMED_AREA_TABLE) || defined(SPD_UPSAMPLE)
+#error SPD_MULTI_TARGET excludes SPD_MAX_HEIGHT, SPD_HISTOGRAM, SPD_SUMMED_AREA_TABLE and SPD_UPSAMPLE
+#endif
+
+SpdTargets SpdReduce4MultiTarget(SpdTargets v0, SpdTargets v1, SpdTargets v2, SpdTargets v3)
+{
+    SpdTargets r;
+    r.color = (v0.color + v1.color + v2.color + v3.color) * AF1_(0.25);
+    r.depth = AF2(min(min(v0.depth.x, v1.depth.x), min(v2.depth.x, v3.depth.x)),
+        max(max(v0.depth.y, v1.depth.y), max(v2.depth.y, v3.depth.y)));
+    r.velocity = v0.velocity;
+    AF1 longest = dot(v0.velocity, v0.velocity);
+    AF1 length1 = dot(v1.velocity, v1.velocity);
+    if (length1 > longest)
+    {
+        r.velocity = v1.velocity;
+        longest = length1;
+    }
+    AF1 length2 = dot(v2.velocity, v2.velocity);
+    if (length2 > longest)
+    {
+        r.velocity = v2.velocity;
+        longest = length2;
+    }
+    if (dot(v3.velocity, v3.velocity) > longest)
+        r.velocity = v3.velocity;
+    return r;
+}
+#endif // #ifdef SPD_MULTI_TARGET
+
+//==============================================================================================================================
+//                                                     SRGB
+//==============================================================================================================================
+// #define SPD_SRGB to downsample sRGB encoded data in linear space with the exact sRGB curve: values returned by
+// SpdLoadSourceImage() and SpdLoad() are converted to linear, values passed to SpdStore() are converted back to sRGB.
+// Alpha stays linear. Meant for UNORM views of sRGB textures, as UAVs can't be typed sRGB.
+// With SPD_LINEAR_SAMPLER the source is not converted, bind it through an sRGB SRV so the sampler filters in linear space.
+AF1 SpdSrgbToLinearF1(AF1 c)
+{
+    return c <= AF1_(0.04045) ? c * AF1_(1.0 / 12.92) : pow((c + AF1_(0.055)) * AF1_(1.0 / 1.055), AF1_(2.4));
+}
+
+AF1 SpdLinearToSrgbF1(AF1 c)
+{
+    return c <= AF1_(0.0031308) ? c * AF1_(12.92) : AF1_(1.055) * pow(c, AF1_(1.0 / 2.4)) - AF1_(0.055);
+}
+
+SpdValue SpdLoadSourceImageSrgb(ASU2 p, AU1 slice)
+{
+    SpdValue v = SpdLoadSourceImage(p, slice);
+#if defined(SPD_SRGB) && !defined(SPD_LINEAR_SAMPLER)
+    v = AF4(SpdSrgbToLinearF1(v.x), SpdSrgbToLinearF1(v.y), SpdSrgbToLinearF1(v.z), v.w);
+#endif
+#ifdef SPD_NORMAL_MAP
+    v = SpdDecodeNormal(v.xy, AF1_(0.0));
+#endif
+#ifdef SPD_MOMENTS
+    v = SpdDepthToMoments(v.x);
+#endif
+#ifdef SPD_DEPTH_AWARE
+    v.w = SpdLoadSourceDepth(p, slice);
+#endif
+    return v;
+}
+
+SpdValue SpdLoadSrgb(ASU2 p, AU1 slice)
+{
+    SpdValue v = SpdLoad(p, slice);
+#ifdef SPD_SRGB
+    v = AF4(SpdSrgbToLinearF1(v.x), SpdSrgbToLinearF1(v.y), SpdSrgbToLinearF1(v.z), v.w);
+#endif
+#ifdef SPD_NORMAL_MAP
+    v = SpdDecodeNormal(v.xy, SpdLoadRoughness(p, slice));
+#endif
+#ifdef SPD_DEPTH_AWARE
+    v.w = SpdLoadDepth(p, slice);
+#endif
+    return v;
+}
+
+void SpdStoreSrgb(ASU2 p, SpdValue value, AU1 mip, AU1 slice)
+{
+#ifdef SPD_SRGB
+    value = AF4(SpdLinearToSrgbF1(value.x), SpdLinearToSrgbF1(value.y), SpdLinearToSrgbF1(value.z), value.w);
+#endif
+#ifdef SPD_NORMAL_MAP
+    value = SpdEncodeNormal(value.xyz);
+    SpdStoreRoughness(p, value.w, mip, slice);
+    value.w = AF1_(1.0);
+#endif
+#ifdef SPD_DEPTH_AWARE
+    SpdStoreDepth(p, value.w, mip, slice);
+    value.w = AF1_(1.0);
+#endif
+    SpdStore(p, value, mip, slice);
+}
+
+//==============================================================================================================================
+//                                                     MAJORITY
+//==============================================================================================================================
+// #define SPD_MAJORITY (with SPD_UINT) to replace SpdReduce4() with a majority vote: the result is the value that occurs most
+// often among the four. Ties go to the lowest value, so the result doesn't depend on the order of the four values and the
+// wave operation and LDS paths agree. Each channel of an AU4 is voted on separately, keep an ID in a single channel.
+// Each mip votes on the four values of the mip above, not on all source texels below it.
+// SpdReduce4() still has to be defined, it is just not called.
+AU1 SpdMajorityU1(AU1 v0, AU1 v1, AU1 v2, AU1 v3)
+{
+    AU1 e01 = v0 == v1 ? 1u : 0u;
+    AU1 e02 = v0 == v2 ? 1u : 0u;
+    AU1 e03 = v0 == v3 ? 1u : 0u;
+    AU1 e12 = v1 == v2 ? 1u : 0u;
+    AU1 e13 = v1 == v3 ? 1u : 0u;
+    AU1 e23 = v2 == v3 ? 1u : 0u;
+    // how many of the others equal each value
+    AU1 c0 = e01 + e02 + e03;
+    AU1 c1 = e01 + e12 + e13;
+    AU1 c2 = e02 + e12 + e23;
+    AU1 c3 = e03 + e13 + e23;
+    AU1 count = max(max(c0, c1), max(c2, c3));
+    AU1 m0 = c0 == count ? v0 : 0xffffffffu;
+    AU1 m1 = c1 == count ? v1 : 0xffffffffu;
+    AU1 m2 = c2 == count ? v2 : 0xffffffffu;
+    AU1 m3 = c3 == count ? v3 : 0xffffffffu;
+    return min(min(m0, m1), min(m2, m3));
+}
+
+AU4 SpdMajorityU4(AU4 v0, AU4 v1, AU4 v2, AU4 v3)
+{
+    return AU4(
+        SpdMajorityU1(v0.x, v1.x, v2.x, v3.x),
+        SpdMajorityU1(v0.y, v1.y, v2.y, v3.y),
+        SpdMajorityU1(v0.z, v1.z, v2.z, v3.z),
+        SpdMajorityU1(v0.w, v1.w, v2.w, v3.w));
+}
+
+//==============================================================================================================================
+//                                                     OCCUPANCY
+//==============================================================================================================================
+// #define SPD_OCCUPANCY_OR (with SPD_UINT) for "any set" or SPD_OCCUPANCY_AND for "all set" hierarchies over bitmasks, e.g.
+// light culling masks or sparse voxel occupancy. Without SPD_OCCUPANCY_8X4 every bit is its own layer: each bit of a mip
+// is the OR (AND) of the same bit of the four values above it, so one uint holds 32 masks.
+// #define SPD_OCCUPANCY_8X4 if every uint is a block of 8x4 cells instead, bit y * 8 + x is cell (x, y). Then every mip
+// halves the cells: the four values of a quad are 16x8 cells, each 2x2 of them is combined into one cell of the result, so
+// a mip texel still covers 8x4 cells and mip n has the resolution of a per-cell mip n.
+// Texels that are duplicated at the borders don't change the result. Cells outside of the image inside of a border block
+// have to be 0 for OR and set for AND.
+// With AU4 values each channel is handled on its own. SpdReduce4() still has to be defined, it is just not called.
+// The CPU engine has the formats R32UintOr, R32UintAnd, R32UintOr8x4 and R32UintAnd8x4 for the same.
+AU1 SpdOccupancyCombineU1(AU1 a, AU1 b)
+{
+#ifdef SPD_OCCUPANCY_AND
+    return a & b;
+#else
+    return a | b;
+#endif
+}
+
+// 8x4 cells to 4x2: bits 0-3 are the upper row, bits 4-7 the lower row
+AU1 SpdOccupancyHalveU1(AU1 v)
+{
+    // combine the columns into the even bits, then the rows into bytes 0 and 2
+    AU1 h = SpdOccupancyCombineU1(v, v >> 1u) & 0x55555555u;
+    h = SpdOccupancyCombineU1(h, h >> 8u) & 0x00550055u;
+    // move the even bits together
+    h = (h | (h >> 1u)) & 0x00330033u;
+    h = (h | (h >> 2u)) & 0x000f000fu;
+    return (h | (h >> 12u)) & 0xffu;
+}
+
+AU1 SpdOccupancyU1(AU1 v0, AU1 v1, AU1 v2, AU1 v3)
+{
+#ifdef SPD_OCCUPANCY_8X4
+    AU1 h0 = SpdOccupancyHalveU1(v0);
+    AU1 h1 = SpdOccupancyHalveU1(v1);
+    AU1 h2 = SpdOccupancyHalveU1(v2);
+    AU1 h3 = SpdOccupancyHalveU1(v3);
+    // rows 0 and 1 from the upper values, rows 2 and 3 from the lower ones, the left value fills the low nibble of each row
+    AU1 upper = (h0 & 0x0fu) | ((h1 & 0x0fu) << 4u) | ((h0 & 0xf0u) << 4u) | ((h1 & 0xf0u) << 8u);
+    AU1 lower = (h2 & 0x0fu) | ((h3 & 0x0fu) << 4u) | ((h2 & 0xf0u) << 4u) | ((h3 & 0xf0u) << 8u);
+    return upper | (lower << 16u);
+#else
+    return SpdOccupancyCombineU1(SpdOccupancyCombineU1(v0, v1), SpdOccupancyCombineU1(v2, v3));
+#endif
+}
+
+AU4 SpdOccupancyU4(AU4 v0, AU4 v1, AU4 v2, AU4 v3)
+{
+    return AU4(
+        SpdOccupancyU1(v0.x, v1.x, v2.x, v3.x),
+        SpdOccupancyU1(v0.y, v1.y, v2.y, v3.y),
+        SpdOccupancyU1(v0.z, v1.z, v2.z, v3.z),
+        SpdOccupancyU1(v0.w, v1.w, v2.w, v3.w));
+}
+
+//==============================================================================================================================
+//                                                     KARIS AVERAGE
+//==============================================================================================================================
+// #define SPD_KARIS_AVERAGE to replace SpdReduce4() with a luminance weighted average: each of the four values is weighted
+// by 1/(1+luma), so a single very bright texel can't dominate the average and flicker through all mips of a bloom chain.
+// Luma uses the Rec. 709 weights, alpha is weighted like the color channels.
+// SpdReduce4() still has to be defined, it is just not called.
+AF1 SpdKarisWeightF1(AF4 v)
+{
+    return ARcpF1(AF1_(1.0) + max(dot(v.xyz, AF3(0.2126, 0.7152, 0.0722)), AF1_(0.0)));
+}
+
+SpdValue SpdReduce4Karis(SpdValue v0, SpdValue v1, SpdValue v2, SpdValue v3)
+{
+#ifdef SPD_KARIS_AVERAGE
+    AF1 w0 = SpdKarisWeightF1(v0);
+    AF1 w1 = SpdKarisWeightF1(v1);
+    AF1 w2 = SpdKarisWeightF1(v2);
+    AF1 w3 = SpdKarisWeightF1(v3);
+    return (v0 * w0 + v1 * w1 + v2 * w2 + v3 * w3) * ARcpF1(w0 + w1 + w2 + w3);
+#elif defined(SPD_MAJORITY) && defined(SPD_ONE_CHANNEL)
+    return SpdMajorityU1(v0, v1, v2, v3);
+#elif defined(SPD_MAJORITY)
+    return SpdMajorityU4(v0, v1, v2, v3);
+#elif defined(SPD_MAX_HEIGHT)
+    return max(max(v0, v1), max(v2, v3));
+#elif (defined(SPD_OCCUPANCY_OR) || defined(SPD_OCCUPANCY_AND)) && defined(SPD_ONE_CHANNEL)
+    return SpdOccupancyU1(v0, v1, v2, v3);
+#elif defined(SPD_OCCUPANCY_OR) || defined(SPD_OCCUPANCY_AND)
+    return SpdOccupancyU4(v0, v1, v2, v3);
+#elif defined(SPD_DEPTH_AWARE)
+    return SpdReduce4DepthAware(v0, v1, v2, v3);
+#elif defined(SPD_MULTI_TARGET)
+    return SpdReduce4MultiTarget(v0, v1, v2, v3);
+#else
+    return SpdReduce4(v0, v1, v2, v3);
+#endif
+}
+
 //_____________________________________________________________/\_______________________________________________________________
 #if defined(A_GLSL) && !defined(SPD_NO_WAVE_OPERATIONS)
 #extension GL_KHR_shader_subgroup_quad:require
@@ -399,130 +1083,663 @@ bool SpdExitWorkgroup(AU1 numWorkGroups, AU1 localInvocationIndex, AU1 slice)
     return (SpdGetAtomicCounter() != (numWorkGroups - 1));
 }
 
-////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
-////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+//==============================================================================================================================
+//                                                     ALPHA COVERAGE
+//==============================================================================================================================
+// #define SPD_ALPHA_COVERAGE to keep the alpha test coverage of every mip at the coverage of the source, so alpha tested
+// geometry like foliage doesn't thin out with distance. Coverage is the fraction of texels with alpha >= SpdAlphaCutoff().
+// The source coverage of a tile is counted while loading it. The values of each mip are held back in LDS until all threads
+// of the workgroup computed them, a 16 + 16 bin alpha histogram in LDS gives the threshold that lets the number of texels
+// closest to the coverage pass, and the values are stored with their alpha scaled to move the threshold onto the cutoff.
+// The LDS intermediates stay unscaled.
+// Mips 0-2 are scaled to the coverage of their tile, as the other tiles are not done yet. So neighbouring tiles get
+// different scales in those mips, which shows as seams at the tile borders where the coverage changes a lot between
+// tiles. Mips 3-5 have 4x4, 2x2 and 1x1 texels per tile, too few to match the coverage of the tile (a single texel is
+// either covered or not), so the tiles store them unscaled. The tile coverage is also added to a per slice global
+// counter, the last workgroup computes the remaining mips from the unscaled mip 5 and scales mips 3-5 of all tiles of the
+// dispatch and the remaining mips with one scale for the whole slice. For mips 3-5 it reads back the 21 alpha values each
+// tile stored up to three times (two histogram passes and the scaled store), and it runs whenever there are 4 or more mips.
+// The histogram has 256 bins, so with float mips the threshold is found to 1/256. #define SPD_ALPHA_COVERAGE_UNORM8 when
+// the mips are stored to UNORM8 UAVs: the histogram then counts the 255 levels the store rounds to, the held back alpha
+// is rounded to its level before it is scaled and the threshold level is stored as the first level at or above the
+// cutoff, while the level below it ends up under the cutoff.
+// Only 64x64 tiles are supported. With SPD_LINEAR_SAMPLER the coverage is counted on the filtered source samples.
+// Texels past the edge of the texture are expected to load as 0, they count as not covered.
+//
+// // Define the cutoff, LDS and global coverage functions
+// AF1 SpdAlphaCutoff(){return alphaCutoff;}
+// shared AU1 spdCoverage[18]; // HLSL: groupshared
+// void SpdStoreCoverageLds(AU1 i, AU1 value){spdCoverage[i] = value;}
+// AU1 SpdLoadCoverageLds(AU1 i){return spdCoverage[i];}
+// // the held back values of up to two mips
+// shared AF4 spdCoverageValues[SPD_COVERAGE_LDS_VALUES]; // HLSL: groupshared
+// void SpdStoreCoverageValueLds(AU1 i, AF4 value){spdCoverageValues[i] = value;}
+// AF4 SpdLoadCoverageValueLds(AU1 i){return spdCoverageValues[i];}
+// GLSL: void SpdAddCoverageLds(AU1 i, AU1 value){atomicAdd(spdCoverage[i], value);}
+// HLSL: void SpdAddCoverageLds(AU1 i, AU1 value){InterlockedAdd(spdCoverage[i], value);}
+// // the tiles of the dispatch, workGroupOffset and dispatchThreadGroupCountXY of SpdSetup() (add it to the constants)
+// AU4 SpdAlphaCoverageTiles(){return AU4(spdConstants.workGroupOffset, spdConstants.dispatchThreadGroupCountXY);}
+// // alpha of mips 3-5 written by the other workgroups, the imgDst bindings have to be coherent (see above)
+// GLSL:
+// AF1 SpdLoadCoverageAlpha(ASU2 p, AU1 mip, AU1 slice){return imageLoad(imgDst[mip], p).a;}
+// void SpdStoreCoverageAlpha(ASU2 p, AF1 alpha, AU1 mip, AU1 slice){
+//     imageStore(imgDst[mip], p, vec4(imageLoad(imgDst[mip], p).rgb, alpha));}
+// HLSL:
+// AF1 SpdLoadCoverageAlpha(ASU2 p, AU1 mip, AU1 slice){return imgDst[mip][p].a;}
+// void SpdStoreCoverageAlpha(ASU2 p, AF1 alpha, AU1 mip, AU1 slice){imgDst[mip][p] = AF4(imgDst[mip][p].rgb, alpha);}
+// // one coverage counter per slice next to the atomic counters, MUST be initialized to 0 as well, SPD resets it after each run
+// GLSL:
+// void SpdAddGlobalCoverage(AU1 value, AU1 slice){atomicAdd(spdGlobalAtomic.coverage[slice], value);}
+// AU1 SpdGetGlobalCoverage(AU1 slice){return spdGlobalAtomic.coverage[slice];}
+// void SpdResetGlobalCoverage(AU1 slice){spdGlobalAtomic.coverage[slice] = 0;}
+// HLSL:
+// void SpdAddGlobalCoverage(AU1 value, AU1 slice){InterlockedAdd(spdGlobalAtomic[0].coverage[slice], value);}
+// AU1 SpdGetGlobalCoverage(AU1 slice){return spdGlobalAtomic[0].coverage[slice];}
+// void SpdResetGlobalCoverage(AU1 slice){spdGlobalAtomic[0].coverage[slice] = 0;}
+#ifdef SPD_ALPHA_COVERAGE
+#if SPD_TILE_SIZE != 64
+#error SPD_ALPHA_COVERAGE only supports SPD_TILE_SIZE 64
+#endif
 
-// User defined: AF4 SpdReduce4(AF4 v0, AF4 v1, AF4 v2, AF4 v3);
+#ifdef SPD_LINEAR_SAMPLER
+#define SPD_COVERAGE_TILE_TEXELS 1024
+#else
+#define SPD_COVERAGE_TILE_TEXELS 4096
+#endif
 
-AF4 SpdReduceQuad(AF4 v)
-{
-    #if defined(A_GLSL) && !defined(SPD_NO_WAVE_OPERATIONS)
-    AF4 v0 = v;
-    AF4 v1 = subgroupQuadSwapHorizontal(v);
-    AF4 v2 = subgroupQuadSwapVertical(v);
-    AF4 v3 = subgroupQuadSwapDiagonal(v);
-    return SpdReduce4(v0, v1, v2, v3);
-    #elif defined(A_HLSL) && !defined(SPD_NO_WAVE_OPERATIONS)
-    // requires SM6.0
-    AU1 quad = WaveGetLaneIndex() &  (~0x3);
-    AF4 v0 = v;
-    AF4 v1 = WaveReadLaneAt(v, quad | 1);
-    AF4 v2 = WaveReadLaneAt(v, quad | 2);
-    AF4 v3 = WaveReadLaneAt(v, quad | 3);
-    return SpdReduce4(v0, v1, v2, v3);
-    /*
-    // if SM6.0 is not available, you can use the AMD shader intrinsics
-    // the AMD shader intrinsics are available in AMD GPU Services (AGS) library:
-    // https://gpuopen.com/amd-gpu-services-ags-library/
-    // works for DX11
-    AF4 v0 = v;
-    AF4 v1;
-    v1.x = AmdExtD3DShaderIntrinsics_SwizzleF(v.x, AmdExtD3DShaderIntrinsicsSwizzle_SwapX1);
-    v1.y = AmdExtD3DShaderIntrinsics_SwizzleF(v.y, AmdExtD3DShaderIntrinsicsSwizzle_SwapX1);
-    v1.z = AmdExtD3DShaderIntrinsics_SwizzleF(v.z, AmdExtD3DShaderIntrinsicsSwizzle_SwapX1);
-    v1.w = AmdExtD3DShaderIntrinsics_SwizzleF(v.w, AmdExtD3DShaderIntrinsicsSwizzle_SwapX1);
-    AF4 v2;
-    v2.x = AmdExtD3DShaderIntrinsics_SwizzleF(v.x, AmdExtD3DShaderIntrinsicsSwizzle_SwapX2);
-    v2.y = AmdExtD3DShaderIntrinsics_SwizzleF(v.y, AmdExtD3DShaderIntrinsicsSwizzle_SwapX2);
-    v2.z = AmdExtD3DShaderIntrinsics_SwizzleF(v.z, AmdExtD3DShaderIntrinsicsSwizzle_SwapX2);
-    v2.w = AmdExtD3DShaderIntrinsics_SwizzleF(v.w, AmdExtD3DShaderIntrinsicsSwizzle_SwapX2);
-    AF4 v3;
-    v3.x = AmdExtD3DShaderIntrinsics_SwizzleF(v.x, AmdExtD3DShaderIntrinsicsSwizzle_ReverseX4);
-    v3.y = AmdExtD3DShaderIntrinsics_SwizzleF(v.y, AmdExtD3DShaderIntrinsicsSwizzle_ReverseX4);
-    v3.z = AmdExtD3DShaderIntrinsics_SwizzleF(v.z, AmdExtD3DShaderIntrinsicsSwizzle_ReverseX4);
-    v3.w = AmdExtD3DShaderIntrinsics_SwizzleF(v.w, AmdExtD3DShaderIntrinsicsSwizzle_ReverseX4);
-    return SpdReduce4(v0, v1, v2, v3);
-    */
-    #endif
-    return v;
-}
+// mip 0 and 1 of the tile (mip 6 and 7 in the last workgroup) are held back together: 32x32 + 16x16 values
+#define SPD_COVERAGE_LDS_VALUES 1280
+
+// first tile mip that is scaled by the last workgroup, 4x4 texels per tile
+#define SPD_COVERAGE_SLICE_MIP 3
+
+// thread private
+#ifdef A_HLSL
+#define SPD_PRIVATE static
+#else
+#define SPD_PRIVATE
+#endif
+SPD_PRIVATE AU1 spdCoverageCount;   // source values at or above the cutoff loaded by this thread
+SPD_PRIVATE AF1 spdCoverageRatio;   // coverage the mips are scaled to, of the tile or of the slice
+SPD_PRIVATE AU1 spdCoverageTexels;  // mip 5 texels the coverage is for, 1 or numWorkGroups in the last workgroup
+SPD_PRIVATE AU2 spdCoverageTile;    // workGroupID of the tile, 0 in the last workgroup
 
-AF4 SpdReduceIntermediate(AU2 i0, AU2 i1, AU2 i2, AU2 i3)
+// Width of the mip region of the workgroup: 32x32 for mip 0, 1x1 for mip 5, again 32x32 at most for mip 6
+AU1 SpdAlphaCoverageSide(AU1 mip)
 {
-    AF4 v0 = SpdLoadIntermediate(i0.x, i0.y);
-    AF4 v1 = SpdLoadIntermediate(i1.x, i1.y);
-    AF4 v2 = SpdLoadIntermediate(i2.x, i2.y);
-    AF4 v3 = SpdLoadIntermediate(i3.x, i3.y);
-    return SpdReduce4(v0, v1, v2, v3);
+    return 32u >> (mip % 6u);
 }
 
-AF4 SpdReduceLoad4(AU2 i0, AU2 i1, AU2 i2, AU2 i3, AU1 slice)
+// LDS index of the held back value of p, mip 1 and 7 go behind the 32x32 values of mip 0 and 6
+AU1 SpdAlphaCoverageIndex(ASU2 p, AU1 mip)
 {
-    AF4 v0 = SpdLoad(ASU2(i0), slice);
-    AF4 v1 = SpdLoad(ASU2(i1), slice);
-    AF4 v2 = SpdLoad(ASU2(i2), slice);
-    AF4 v3 = SpdLoad(ASU2(i3), slice);
-    return SpdReduce4(v0, v1, v2, v3);
+    AU1 side = SpdAlphaCoverageSide(mip);
+    return ((mip % 6u) == 1u ? 1024u : 0u) + (AU1(p.y) % side) * side + AU1(p.x) % side;
 }
 
-AF4 SpdReduceLoad4(AU2 base, AU1 slice)
+// histogram level of an alpha value: alpha >= level / 256, or the UNORM8 level it is stored as
+AU1 SpdAlphaCoverageLevel(AF1 alpha)
 {
-    return SpdReduceLoad4(
-        AU2(base + AU2(0, 0)),
-        AU2(base + AU2(0, 1)), 
-        AU2(base + AU2(1, 0)), 
-        AU2(base + AU2(1, 1)),
-        slice);
+#ifdef SPD_ALPHA_COVERAGE_UNORM8
+    return AU1(ASatF1(alpha) * AF1_(255.0) + AF1_(0.5));
+#else
+    return min(AU1(ASatF1(alpha) * AF1_(256.0)), 255u);
+#endif
 }
 
-AF4 SpdReduceLoadSourceImage4(AU2 i0, AU2 i1, AU2 i2, AU2 i3, AU1 slice)
+// alpha as it is stored with the scale of the mip
+AF1 SpdAlphaCoverageApply(AF1 alpha, AF1 scale)
 {
-    AF4 v0 = SpdLoadSourceImage(ASU2(i0), slice);
-    AF4 v1 = SpdLoadSourceImage(ASU2(i1), slice);
-    AF4 v2 = SpdLoadSourceImage(ASU2(i2), slice);
-    AF4 v3 = SpdLoadSourceImage(ASU2(i3), slice);
-    return SpdReduce4(v0, v1, v2, v3);
+#ifdef SPD_ALPHA_COVERAGE_UNORM8
+    return ASatF1(AF1(SpdAlphaCoverageLevel(alpha)) * scale * AF1_(1.0 / 255.0));
+#else
+    return ASatF1(alpha * scale);
+#endif
 }
 
-AF4 SpdReduceLoadSourceImage(AU2 base, AU1 slice)
+// Scale that moves the values at the threshold level onto the cutoff and the ones below it under the cutoff
+AF1 SpdAlphaCoverageThresholdScale(AF1 cutoff, AU1 threshold)
 {
-#ifdef SPD_LINEAR_SAMPLER
-    return SpdLoadSourceImage(ASU2(base), slice);
+#ifdef SPD_ALPHA_COVERAGE_UNORM8
+    // first level at or above the cutoff, the threshold level lands half a scale step above its rounding edge,
+    // the level below half a step under it
+    AU1 cutoffLevel = min(AU1(ceil(ASatF1(cutoff) * AF1_(255.0))), 255u);
+    if (cutoffLevel > 1u && AF1(cutoffLevel - 1u) * AF1_(1.0 / 255.0) >= cutoff)
+        cutoffLevel--;
+    return (AF1(max(cutoffLevel, 1u)) - AF1_(0.5)) / (AF1(max(threshold, 1u)) - AF1_(0.5));
 #else
-    return SpdReduceLoadSourceImage4(
-        AU2(base + AU2(0, 0)),
-        AU2(base + AU2(0, 1)), 
-        AU2(base + AU2(1, 0)), 
-        AU2(base + AU2(1, 1)),
-        slice);
+    return cutoff * AF1_(256.0) / AF1(max(threshold, 1u));
 #endif
 }
 
+// Number of the values of mip held back by the workgroup, or with stored of the values of mip all tiles of the dispatch
+// stored
+AU1 SpdAlphaCoverageValues(AU1 mip, bool stored)
+{
+    AU2 size = AU2(1, 1);
+    if (stored)
+        size = SpdAlphaCoverageTiles().zw;
+    size *= SpdAlphaCoverageSide(mip);
+    return size.x * size.y;
+}
+
+// Position of value i in mip
+ASU2 SpdAlphaCoveragePosition(AU1 i, AU1 mip, bool stored)
+{
+    AU1 side = SpdAlphaCoverageSide(mip);
+    if (!stored)
+        return ASU2(spdCoverageTile * side + AU2(i % side, i / side));
+    AU4 tiles = SpdAlphaCoverageTiles();
+    AU1 width = tiles.z * side;
+    return ASU2(tiles.xy * side + AU2(i % width, i / width));
+}
+
+// Alpha of value i, held back in LDS or read back from mip
+AF1 SpdAlphaCoverageAlpha(AU1 i, AU1 mip, AU1 slice, bool stored)
+{
+    if (stored)
+        return SpdLoadCoverageAlpha(SpdAlphaCoveragePosition(i, mip, true), mip, slice);
+    return SpdLoadCoverageValueLds(SpdAlphaCoverageIndex(ASU2(0, 0), mip) + i).w;
+}
+
+// Returns the alpha scale for the values of mip held back by the workgroup, or with stored for the values of mip stored
+// by all tiles of the dispatch, called by all threads
+AF1 SpdAlphaCoverageScale(AU1 mip, AU1 localInvocationIndex, AU1 slice, bool stored)
+{
+    AF1 cutoff = SpdAlphaCutoff();
+    AU1 texels = spdCoverageTexels << (2u * (5u - min(mip, 5u)));
+    if (mip > 5u)
+        texels = (spdCoverageTexels + (1u << (2u * (mip - 5u))) - 1u) >> (2u * (mip - 5u));
+    AU1 target = AU1(spdCoverageRatio * AF1(texels) + AF1_(0.5));
+    AU1 count = SpdAlphaCoverageValues(mip, stored);
+
+    // the previous call might still read the histogram
+    SpdWorkgroupShuffleBarrier();
+    if (localInvocationIndex < 17u)
+        SpdStoreCoverageLds(localInvocationIndex, 0u);
+    SpdWorkgroupShuffleBarrier();
+    for (AU1 i = localInvocationIndex; i < count; i += 256u)
+    {
+        AF1 alpha = SpdAlphaCoverageAlpha(i, mip, slice, stored);
+        SpdAddCoverageLds(SpdAlphaCoverageLevel(alpha) >> 4u, 1u);
+        if (SpdAlphaCoverageApply(alpha, AF1_(1.0)) >= cutoff)
+            SpdAddCoverageLds(16u, 1u);
+    }
+    SpdWorkgroupShuffleBarrier();
+    if (SpdLoadCoverageLds(16u) == target)
+        return AF1_(1.0);
+    if (target == 0u)
+        return SpdAlphaCoverageThresholdScale(cutoff, 256u);
+
+    // coarse bin the threshold is in: the highest one with at least target values at or above it
+    AU1 above = 0u;
+    AU1 bin = 0u;
+    for (AU1 b = 16u; b > 0u; b--)
+    {
+        AU1 count = above + SpdLoadCoverageLds(b - 1u);
+        if (count >= target)
+        {
+            bin = b - 1u;
+            break;
+        }
+        above = count;
+    }
+
+    // fine bins within it
+    SpdWorkgroupShuffleBarrier();
+    if (localInvocationIndex < 16u)
+        SpdStoreCoverageLds(localInvocationIndex, 0u);
+    SpdWorkgroupShuffleBarrier();
+    for (AU1 i = localInvocationIndex; i < count; i += 256u)
+    {
+        AU1 level = SpdAlphaCoverageLevel(SpdAlphaCoverageAlpha(i, mip, slice, stored));
+        if ((level >> 4u) == bin)
+            SpdAddCoverageLds(level & 15u, 1u);
+    }
+    SpdWorkgroupShuffleBarrier();
+    AU1 threshold = bin * 16u;
+    for (AU1 f = 16u; f > 0u; f--)
+    {
+        AU1 count = above + SpdLoadCoverageLds(f - 1u);
+        if (count >= target)
+        {
+            // or the level above it, if fewer values than target passing is closer to target
+            threshold = bin * 16u + f - (count - target > target - above ? 0u : 1u);
+            break;
+        }
+        above = count;
+    }
+    return SpdAlphaCoverageThresholdScale(cutoff, threshold);
+}
+#endif // #ifdef SPD_ALPHA_COVERAGE
+
+void SpdAlphaCoverageBegin(AU2 workGroupID)
+{
+#ifdef SPD_ALPHA_COVERAGE
+    spdCoverageCount = 0u;
+    spdCoverageTile = workGroupID;
+#endif
+}
+
+// Counts a value loaded from the source
+void SpdAlphaCoverageCount(SpdValue v)
+{
+#ifdef SPD_ALPHA_COVERAGE
+    spdCoverageCount += v.w >= SpdAlphaCutoff() ? 1u : 0u;
+#endif
+}
+
+// Sums the coverage of the tile and adds it to the slice, called by all threads once the tile is loaded
+void SpdAlphaCoverageTile(AU1 localInvocationIndex, AU1 mips, AU1 slice)
+{
+#ifdef SPD_ALPHA_COVERAGE
+    if (localInvocationIndex == 0u)
+        SpdStoreCoverageLds(17u, 0u);
+    SpdWorkgroupShuffleBarrier();
+    SpdAddCoverageLds(17u, spdCoverageCount);
+    SpdWorkgroupShuffleBarrier();
+    AU1 covered = SpdLoadCoverageLds(17u);
+    // only the last workgroup resets the counter
+    if (localInvocationIndex == 0u && mips > SPD_COVERAGE_SLICE_MIP)
+        SpdAddGlobalCoverage(covered, slice);
+    spdCoverageRatio = AF1(covered) / AF1_(SPD_COVERAGE_TILE_TEXELS);
+    spdCoverageTexels = 1u;
+#endif
+}
+
+// Switches to the coverage of the whole slice, called by all threads of the last workgroup
+void SpdAlphaCoverageSlice(AU1 localInvocationIndex, AU1 numWorkGroups, AU1 slice)
+{
+#ifdef SPD_ALPHA_COVERAGE
+    if (localInvocationIndex == 0u)
+    {
+        SpdStoreCoverageLds(17u, SpdGetGlobalCoverage(slice));
+        SpdResetGlobalCoverage(slice);
+    }
+    SpdWorkgroupShuffleBarrier();
+    spdCoverageRatio = AF1(SpdLoadCoverageLds(17u)) / (AF1(numWorkGroups) * AF1_(SPD_COVERAGE_TILE_TEXELS));
+    spdCoverageTexels = numWorkGroups;
+    spdCoverageTile = AU2(0, 0);
+#endif
+}
+
+void SpdStoreAlphaCoverage(ASU2 p, SpdValue value, AU1 mip, AU1 slice)
+{
+#ifdef SPD_ALPHA_COVERAGE
+    // stored by SpdAlphaCoverageFlush() once the scale of the mip is known
+    SpdStoreCoverageValueLds(SpdAlphaCoverageIndex(p, mip), value);
+#else
+    SpdStoreSrgb(p, value, mip, slice);
+#endif
+}
+
+// Stores the held back values of mip with scaled alpha, called by all threads. Mips 3-5 of a tile are stored unscaled,
+// SpdAlphaCoverageSliceMips() scales them.
+void SpdAlphaCoverageFlush(AU1 mip, AU1 localInvocationIndex, AU1 slice)
+{
+#ifdef SPD_ALPHA_COVERAGE
+    AF1 scale = AF1_(1.0);
+    if (mip < SPD_COVERAGE_SLICE_MIP || mip > 5u)
+        scale = SpdAlphaCoverageScale(mip, localInvocationIndex, slice, false);
+    AU1 first = SpdAlphaCoverageIndex(ASU2(0, 0), mip);
+    for (AU1 i = localInvocationIndex; i < SpdAlphaCoverageValues(mip, false); i += 256u)
+    {
+        AF4 v = SpdLoadCoverageValueLds(first + i);
+        SpdStoreSrgb(SpdAlphaCoveragePosition(i, mip, false), AF4(v.xyz, SpdAlphaCoverageApply(v.w, scale)), mip, slice);
+    }
+#endif
+}
+
+// Scales mips 3-5 of all tiles of the dispatch to the coverage of the slice, called by all threads of the last workgroup
+// after the remaining mips were computed
+void SpdAlphaCoverageSliceMips(AU1 mips, AU1 localInvocationIndex, AU1 slice)
+{
+#ifdef SPD_ALPHA_COVERAGE
+    for (AU1 mip = SPD_COVERAGE_SLICE_MIP; mip < min(mips, 6u); mip++)
+    {
+        AF1 scale = SpdAlphaCoverageScale(mip, localInvocationIndex, slice, true);
+        if (scale == AF1_(1.0))
+            continue;
+        for (AU1 i = localInvocationIndex; i < SpdAlphaCoverageValues(mip, true); i += 256u)
+        {
+            ASU2 p = SpdAlphaCoveragePosition(i, mip, true);
+            SpdStoreCoverageAlpha(p, SpdAlphaCoverageApply(SpdLoadCoverageAlpha(p, mip, slice), scale), mip, slice);
+        }
+    }
+#endif
+}
+
+// Workgroups are done after the tile if mips is at most this, with SPD_ALPHA_COVERAGE the last workgroup also scales the
+// small tile mips
+AU1 SpdLastWorkgroupMip()
+{
+#ifdef SPD_ALPHA_COVERAGE
+    return SPD_COVERAGE_SLICE_MIP;
+#else
+    return 6 + SPD_TILE_MIP_OFFSET;
+#endif
+}
+
+//==============================================================================================================================
+//                                                     TILE HASH
+//==============================================================================================================================
+// #define SPD_TILE_HASH to skip the tiles whose source didn't change since the last dispatch, for mostly static textures like
+// streamed UI or light probes. Before loading its tile every workgroup hashes the raw bits of the source texels: each
+// texel gets a 2x32 bit hash of its bits and position in the tile, the texel hashes are summed with a wave reduction and
+// in LDS, so the order of the threads doesn't matter. The sum is compared to the hash the previous dispatch stored for the
+// tile. Unchanged tiles skip the tile mips (0-5 with 64x64 tiles) and only increase the atomic counter. The last
+// workgroup computes the remaining mips from mip 5 as usual, which still holds the texels of the skipped tiles.
+// The hash buffer has to be cleared to 0 whenever the mips don't match the source, e.g. after creating the texture or when
+// the number of mips changes, a computed hash is never 0. A changed tile whose 64 bit hash stays the same is not updated.
+// Each texel is loaded twice for changed tiles, the hash pays off once most tiles are static.
+// With SPD_LINEAR_SAMPLER SpdLoadSourceBits() still loads single texels, it can read the texture bound for the sampler.
+// SpdDownsampleCpuTileHash() in ffx_spd_cpu.h is the CPU version, with a SIMD hash over the bytes of each tile row.
+//
+// // Define the source bits, the hash buffer and the LDS functions
+// GLSL:
+// AU4 SpdLoadSourceBits(ASU2 p, AU1 slice){return floatBitsToUint(imageLoad(imgSrc, p));}
+// AU2 SpdLoadTileHash(AU2 tile, AU1 slice){return imageLoad(imgTileHash, ivec2(tile)).xy;}
+// void SpdStoreTileHash(AU2 tile, AU2 hash, AU1 slice){imageStore(imgTileHash, ivec2(tile), uvec4(hash, 0, 0));}
+// shared AU1 spdTileHash[3];
+// void SpdAddTileHashLds(AU1 i, AU1 value){atomicAdd(spdTileHash[i], value);}
+// HLSL:
+// AU4 SpdLoadSourceBits(ASU2 p, AU1 slice){return asuint(imgSrc[p]);}
+// AU2 SpdLoadTileHash(AU2 tile, AU1 slice){return imgTileHash[tile];}
+// void SpdStoreTileHash(AU2 tile, AU2 hash, AU1 slice){imgTileHash[tile] = hash;}
+// groupshared AU1 spdTileHash[3];
+// void SpdAddTileHashLds(AU1 i, AU1 value){InterlockedAdd(spdTileHash[i], value);}
+// // both
+// void SpdStoreTileHashLds(AU1 i, AU1 value){spdTileHash[i] = value;}
+// AU1 SpdLoadTileHashLds(AU1 i){return spdTileHash[i];}
+#ifdef SPD_TILE_HASH
+#if defined(SPD_ALPHA_COVERAGE) || defined(SPD_BLOOM) || defined(SPD_GAUSSIAN) || defined(SPD_MAX_HEIGHT)
+#error SPD_TILE_HASH excludes SPD_ALPHA_COVERAGE, SPD_BLOOM, SPD_GAUSSIAN and SPD_MAX_HEIGHT
+#endif
+#if defined(SPD_HISTOGRAM) || defined(SPD_SUMMED_AREA_TABLE) || defined(SPD_UPSAMPLE)
+#error SPD_TILE_HASH excludes SPD_HISTOGRAM, SPD_SUMMED_AREA_TABLE and SPD_UPSAMPLE
+#endif
+
+#if defined(A_GLSL) && !defined(SPD_NO_WAVE_OPERATIONS)
+#extension GL_KHR_shader_subgroup_arithmetic:require
+#endif
+
+// lowbias32 integer hash
+AU1 SpdTileHashMix(AU1 h)
+{
+    h ^= h >> 16u;
+    h *= 0x7feb352du;
+    h ^= h >> 15u;
+    h *= 0x846ca68bu;
+    h ^= h >> 16u;
+    return h;
+}
+
+// Hash of the texel at index i of the tile, two independent chains over the channels in opposite order
+AU2 SpdTileHashTexel(AU4 bits, AU1 i)
+{
+    AU1 a = SpdTileHashMix(i ^ 0x9e3779b9u);
+    AU1 b = SpdTileHashMix(i ^ 0x85ebca6bu);
+    a = SpdTileHashMix(a ^ bits.x);
+    b = SpdTileHashMix(b ^ bits.w);
+    a = SpdTileHashMix(a ^ bits.y);
+    b = SpdTileHashMix(b ^ bits.z);
+    a = SpdTileHashMix(a ^ bits.z);
+    b = SpdTileHashMix(b ^ bits.y);
+    a = SpdTileHashMix(a ^ bits.w);
+    b = SpdTileHashMix(b ^ bits.x);
+    return AU2(a, b);
+}
+#endif // #ifdef SPD_TILE_HASH
+
+// Returns true if the source tile of the workgroup is the same as in the last dispatch, called by all threads before the
+// tile is loaded. Stores the new hash of changed tiles.
+bool SpdTileUnchanged(AU2 workGroupID, AU1 localInvocationIndex, AU1 slice)
+{
+#ifdef SPD_TILE_HASH
+    if (localInvocationIndex == 0u)
+    {
+        SpdStoreTileHashLds(0u, 0u);
+        SpdStoreTileHashLds(1u, 0u);
+    }
+    SpdWorkgroupShuffleBarrier();
+    AU2 hash = AU2(0u, 0u);
+    for (AU1 i = localInvocationIndex; i < AU1(SPD_TILE_SIZE * SPD_TILE_SIZE); i += 256u)
+    {
+        ASU2 p = ASU2(workGroupID * AU2(SPD_TILE_SIZE, SPD_TILE_SIZE) + AU2(i % SPD_TILE_SIZE, i / SPD_TILE_SIZE));
+        hash += SpdTileHashTexel(SpdLoadSourceBits(p, slice), i);
+    }
+#if defined(SPD_NO_WAVE_OPERATIONS)
+    SpdAddTileHashLds(0u, hash.x);
+    SpdAddTileHashLds(1u, hash.y);
+#elif defined(A_GLSL)
+    hash = subgroupAdd(hash);
+    if (subgroupElect())
+    {
+        SpdAddTileHashLds(0u, hash.x);
+        SpdAddTileHashLds(1u, hash.y);
+    }
+#elif defined(A_HLSL)
+    hash = WaveActiveSum(hash);
+    if (WaveIsFirstLane())
+    {
+        SpdAddTileHashLds(0u, hash.x);
+        SpdAddTileHashLds(1u, hash.y);
+    }
+#endif
+    SpdWorkgroupShuffleBarrier();
+    if (localInvocationIndex == 0u)
+    {
+        hash = AU2(max(SpdLoadTileHashLds(0u), 1u), SpdLoadTileHashLds(1u));
+        AU2 previous = SpdLoadTileHash(workGroupID, slice);
+        bool unchanged = previous.x == hash.x && previous.y == hash.y;
+        if (!unchanged)
+            SpdStoreTileHash(workGroupID, hash, slice);
+        SpdStoreTileHashLds(2u, unchanged ? 1u : 0u);
+    }
+    SpdWorkgroupShuffleBarrier();
+    return SpdLoadTileHashLds(2u) != 0u;
+#else
+    return false;
+#endif
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+// User defined: AF4 SpdReduce4(AF4 v0, AF4 v1, AF4 v2, AF4 v3); AF1 with SPD_ONE_CHANNEL
+
+#if defined(SPD_MULTI_TARGET) && !defined(SPD_NO_WAVE_OPERATIONS)
+// SpdTargets of lane 1, 2 or 3 of the quad (the horizontal, vertical and diagonal neighbour), member by member
+SpdTargets SpdMultiTargetQuadRead(SpdTargets v, AU1 lane)
+{
+    SpdTargets r = v;
+#ifdef A_GLSL
+    if (lane == 1u)
+    {
+        r.color = subgroupQuadSwapHorizontal(v.color);
+        r.depth = subgroupQuadSwapHorizontal(v.depth);
+        r.velocity = subgroupQuadSwapHorizontal(v.velocity);
+    }
+    else if (lane == 2u)
+    {
+        r.color = subgroupQuadSwapVertical(v.color);
+        r.depth = subgroupQuadSwapVertical(v.depth);
+        r.velocity = subgroupQuadSwapVertical(v.velocity);
+    }
+    else
+    {
+        r.color = subgroupQuadSwapDiagonal(v.color);
+        r.depth = subgroupQuadSwapDiagonal(v.depth);
+        r.velocity = subgroupQuadSwapDiagonal(v.velocity);
+    }
+#endif
+#ifdef A_HLSL
+    AU1 quad = WaveGetLaneIndex() &  (~0x3);
+    r.color = WaveReadLaneAt(v.color, quad | lane);
+    r.depth = WaveReadLaneAt(v.depth, quad | lane);
+    r.velocity = WaveReadLaneAt(v.velocity, quad | lane);
+#endif
+    return r;
+}
+#endif
+
+SpdValue SpdReduceQuad(SpdValue v)
+{
+    #if defined(SPD_MULTI_TARGET) && !defined(SPD_NO_WAVE_OPERATIONS)
+    return SpdReduce4Karis(v, SpdMultiTargetQuadRead(v, 1u), SpdMultiTargetQuadRead(v, 2u), SpdMultiTargetQuadRead(v, 3u));
+    #elif defined(A_GLSL) && !defined(SPD_NO_WAVE_OPERATIONS)
+    SpdValue v0 = v;
+    SpdValue v1 = subgroupQuadSwapHorizontal(v);
+    SpdValue v2 = subgroupQuadSwapVertical(v);
+    SpdValue v3 = subgroupQuadSwapDiagonal(v);
+    return SpdReduce4Karis(v0, v1, v2, v3);
+    #elif defined(A_HLSL) && !defined(SPD_NO_WAVE_OPERATIONS)
+    // requires SM6.0
+    AU1 quad = WaveGetLaneIndex() &  (~0x3);
+    SpdValue v0 = v;
+    SpdValue v1 = WaveReadLaneAt(v, quad | 1);
+    SpdValue v2 = WaveReadLaneAt(v, quad | 2);
+    SpdValue v3 = WaveReadLaneAt(v, quad | 3);
+    return SpdReduce4Karis(v0, v1, v2, v3);
+    /*
+    // if SM6.0 is not available, you can use the AMD shader intrinsics
+    // the AMD shader intrinsics are available in AMD GPU Services (AGS) library:
+    // https://gpuopen.com/amd-gpu-services-ags-library/
+    // works for DX11
+    AF4 v0 = v;
+    AF4 v1;
+    v1.x = AmdExtD3DShaderIntrinsics_SwizzleF(v.x, AmdExtD3DShaderIntrinsicsSwizzle_SwapX1);
+    v1.y = AmdExtD3DShaderIntrinsics_SwizzleF(v.y, AmdExtD3DShaderIntrinsicsSwizzle_SwapX1);
+    v1.z = AmdExtD3DShaderIntrinsics_SwizzleF(v.z, AmdExtD3DShaderIntrinsicsSwizzle_SwapX1);
+    v1.w = AmdExtD3DShaderIntrinsics_SwizzleF(v.w, AmdExtD3DShaderIntrinsicsSwizzle_SwapX1);
+    AF4 v2;
+    v2.x = AmdExtD3DShaderIntrinsics_SwizzleF(v.x, AmdExtD3DShaderIntrinsicsSwizzle_SwapX2);
+    v2.y = AmdExtD3DShaderIntrinsics_SwizzleF(v.y, AmdExtD3DShaderIntrinsicsSwizzle_SwapX2);
+    v2.z = AmdExtD3DShaderIntrinsics_SwizzleF(v.z, AmdExtD3DShaderIntrinsicsSwizzle_SwapX2);
+    v2.w = AmdExtD3DShaderIntrinsics_SwizzleF(v.w, AmdExtD3DShaderIntrinsicsSwizzle_SwapX2);
+    AF4 v3;
+    v3.x = AmdExtD3DShaderIntrinsics_SwizzleF(v.x, AmdExtD3DShaderIntrinsicsSwizzle_ReverseX4);
+    v3.y = AmdExtD3DShaderIntrinsics_SwizzleF(v.y, AmdExtD3DShaderIntrinsicsSwizzle_ReverseX4);
+    v3.z = AmdExtD3DShaderIntrinsics_SwizzleF(v.z, AmdExtD3DShaderIntrinsicsSwizzle_ReverseX4);
+    v3.w = AmdExtD3DShaderIntrinsics_SwizzleF(v.w, AmdExtD3DShaderIntrinsicsSwizzle_ReverseX4);
+    return SpdReduce4Karis(v0, v1, v2, v3);
+    */
+    #endif
+    return v;
+}
+
+SpdValue SpdReduceIntermediate(AU2 i0, AU2 i1, AU2 i2, AU2 i3)
+{
+    SpdValue v0 = SpdLoadIntermediate(i0.x, i0.y);
+    SpdValue v1 = SpdLoadIntermediate(i1.x, i1.y);
+    SpdValue v2 = SpdLoadIntermediate(i2.x, i2.y);
+    SpdValue v3 = SpdLoadIntermediate(i3.x, i3.y);
+    return SpdReduce4Karis(v0, v1, v2, v3);
+}
+
+SpdValue SpdReduceLoad4(AU2 i0, AU2 i1, AU2 i2, AU2 i3, AU1 slice)
+{
+    SpdValue v0 = SpdLoadSrgb(ASU2(i0), slice);
+    SpdValue v1 = SpdLoadSrgb(ASU2(i1), slice);
+    SpdValue v2 = SpdLoadSrgb(ASU2(i2), slice);
+    SpdValue v3 = SpdLoadSrgb(ASU2(i3), slice);
+    return SpdReduce4Karis(v0, v1, v2, v3);
+}
+
+// loads and reduces the quad at base, in the order of SpdReduce4(): top left, top right, bottom left, bottom right
+SpdValue SpdReduceLoad4(AU2 base, AU1 slice)
+{
+    return SpdReduceLoad4(
+        AU2(base + AU2(0, 0)),
+        AU2(base + AU2(1, 0)),
+        AU2(base + AU2(0, 1)),
+        AU2(base + AU2(1, 1)),
+        slice);
+}
+
+SpdValue SpdReduceLoadSourceImage4(AU2 i0, AU2 i1, AU2 i2, AU2 i3, AU1 slice)
+{
+    SpdValue v0 = SpdLoadSourceImageSrgb(ASU2(i0), slice);
+    SpdValue v1 = SpdLoadSourceImageSrgb(ASU2(i1), slice);
+    SpdValue v2 = SpdLoadSourceImageSrgb(ASU2(i2), slice);
+    SpdValue v3 = SpdLoadSourceImageSrgb(ASU2(i3), slice);
+    SpdAlphaCoverageCount(v0);
+    SpdAlphaCoverageCount(v1);
+    SpdAlphaCoverageCount(v2);
+    SpdAlphaCoverageCount(v3);
+    return SpdReduce4Karis(v0, v1, v2, v3);
+}
+
+SpdValue SpdReduceLoadSourceImage(AU2 base, AU1 slice)
+{
+#ifdef SPD_LINEAR_SAMPLER
+    SpdValue v = SpdLoadSourceImageSrgb(ASU2(base), slice);
+    SpdAlphaCoverageCount(v);
+    return v;
+#else
+    return SpdReduceLoadSourceImage4(
+        AU2(base + AU2(0, 0)),
+        AU2(base + AU2(1, 0)),
+        AU2(base + AU2(0, 1)),
+        AU2(base + AU2(1, 1)),
+        slice);
+#endif
+}
+
+// Returns the reduced 2x2 quad at base of the first level that is kept in registers.
+// With 128x128 tiles base is in mip 0 coordinates: the four mip 0 texels are computed from the source and stored here.
+SpdValue SpdReduceLoadSourceImageTile(AU2 base, AU1 slice)
+{
+#if SPD_TILE_SIZE == 128
+    SpdValue v0 = SpdReduceLoadSourceImage(AU2(base + AU2(0, 0)) * 2, slice);
+    SpdValue v1 = SpdReduceLoadSourceImage(AU2(base + AU2(1, 0)) * 2, slice);
+    SpdValue v2 = SpdReduceLoadSourceImage(AU2(base + AU2(0, 1)) * 2, slice);
+    SpdValue v3 = SpdReduceLoadSourceImage(AU2(base + AU2(1, 1)) * 2, slice);
+    SpdStoreAlphaCoverage(ASU2(base + AU2(0, 0)), v0, 0, slice);
+    SpdStoreAlphaCoverage(ASU2(base + AU2(1, 0)), v1, 0, slice);
+    SpdStoreAlphaCoverage(ASU2(base + AU2(0, 1)), v2, 0, slice);
+    SpdStoreAlphaCoverage(ASU2(base + AU2(1, 1)), v3, 0, slice);
+    return SpdReduce4Karis(v0, v1, v2, v3);
+#else
+    return SpdReduceLoadSourceImage(base, slice);
+#endif
+}
+
+void SpdStoreTile(ASU2 pix, SpdValue value, AU1 mips, AU1 slice)
+{
+#if SPD_TILE_SIZE == 128
+    // mip 0 is already stored by SpdReduceLoadSourceImageTile
+    if (mips <= 1)
+        return;
+#endif
+    SpdStoreAlphaCoverage(pix, value, SPD_TILE_MIP_OFFSET, slice);
+}
+
 void SpdDownsampleMips_0_1_Intrinsics(AU1 x, AU1 y, AU2 workGroupID, AU1 localInvocationIndex, AU1 mip, AU1 slice)
 {
-    AF4 v[4];
+    SpdValue v[4];
 
     ASU2 tex = ASU2(workGroupID.xy * 64) + ASU2(x * 2, y * 2);
     ASU2 pix = ASU2(workGroupID.xy * 32) + ASU2(x, y);
-    v[0] = SpdReduceLoadSourceImage(tex, slice);
-    SpdStore(pix, v[0], 0, slice);
+    v[0] = SpdReduceLoadSourceImageTile(tex, slice);
+    SpdStoreTile(pix, v[0], mip, slice);
 
     tex = ASU2(workGroupID.xy * 64) + ASU2(x * 2 + 32, y * 2);
     pix = ASU2(workGroupID.xy * 32) + ASU2(x + 16, y);
-    v[1] = SpdReduceLoadSourceImage(tex, slice);
-    SpdStore(pix, v[1], 0, slice);
+    v[1] = SpdReduceLoadSourceImageTile(tex, slice);
+    SpdStoreTile(pix, v[1], mip, slice);
     
     tex = ASU2(workGroupID.xy * 64) + ASU2(x * 2, y * 2 + 32);
     pix = ASU2(workGroupID.xy * 32) + ASU2(x, y + 16);
-    v[2] = SpdReduceLoadSourceImage(tex, slice);
-    SpdStore(pix, v[2], 0, slice);
+    v[2] = SpdReduceLoadSourceImageTile(tex, slice);
+    SpdStoreTile(pix, v[2], mip, slice);
     
     tex = ASU2(workGroupID.xy * 64) + ASU2(x * 2 + 32, y * 2 + 32);
     pix = ASU2(workGroupID.xy * 32) + ASU2(x + 16, y + 16);
-    v[3] = SpdReduceLoadSourceImage(tex, slice);
-    SpdStore(pix, v[3], 0, slice);
+    v[3] = SpdReduceLoadSourceImageTile(tex, slice);
+    SpdStoreTile(pix, v[3], mip, slice);
 
-    if (mip <= 1)
+    if (mip <= 1 + SPD_TILE_MIP_OFFSET)
         return;
 
     v[0] = SpdReduceQuad(v[0]);
@@ -532,23 +1749,23 @@ void SpdDownsampleMips_0_1_Intrinsics(AU1 x, AU1 y, AU2 workGroupID, AU1 localIn
 
     if ((localInvocationIndex % 4) == 0)
     {
-        SpdStore(ASU2(workGroupID.xy * 16) + 
-            ASU2(x/2, y/2), v[0], 1, slice);
+        SpdStoreAlphaCoverage(ASU2(workGroupID.xy * 16) + 
+            ASU2(x/2, y/2), v[0], 1 + SPD_TILE_MIP_OFFSET, slice);
         SpdStoreIntermediate(
             x/2, y/2, v[0]);
 
-        SpdStore(ASU2(workGroupID.xy * 16) + 
-            ASU2(x/2 + 8, y/2), v[1], 1, slice);
+        SpdStoreAlphaCoverage(ASU2(workGroupID.xy * 16) + 
+            ASU2(x/2 + 8, y/2), v[1], 1 + SPD_TILE_MIP_OFFSET, slice);
         SpdStoreIntermediate(
             x/2 + 8, y/2, v[1]);
 
-        SpdStore(ASU2(workGroupID.xy * 16) + 
-            ASU2(x/2, y/2 + 8), v[2], 1, slice);
+        SpdStoreAlphaCoverage(ASU2(workGroupID.xy * 16) + 
+            ASU2(x/2, y/2 + 8), v[2], 1 + SPD_TILE_MIP_OFFSET, slice);
         SpdStoreIntermediate(
             x/2, y/2 + 8, v[2]);
 
-        SpdStore(ASU2(workGroupID.xy * 16) + 
-            ASU2(x/2 + 8, y/2 + 8), v[3], 1, slice);
+        SpdStoreAlphaCoverage(ASU2(workGroupID.xy * 16) + 
+            ASU2(x/2 + 8, y/2 + 8), v[3], 1 + SPD_TILE_MIP_OFFSET, slice);
         SpdStoreIntermediate(
             x/2 + 8, y/2 + 8, v[3]);
     }
@@ -556,29 +1773,29 @@ void SpdDownsampleMips_0_1_Intrinsics(AU1 x, AU1 y, AU2 workGroupID, AU1 localIn
 
 void SpdDownsampleMips_0_1_LDS(AU1 x, AU1 y, AU2 workGroupID, AU1 localInvocationIndex, AU1 mip, AU1 slice) 
 {
-    AF4 v[4];
+    SpdValue v[4];
 
     ASU2 tex = ASU2(workGroupID.xy * 64) + ASU2(x * 2, y * 2);
     ASU2 pix = ASU2(workGroupID.xy * 32) + ASU2(x, y);
-    v[0] = SpdReduceLoadSourceImage(tex, slice);
-    SpdStore(pix, v[0], 0, slice);
+    v[0] = SpdReduceLoadSourceImageTile(tex, slice);
+    SpdStoreTile(pix, v[0], mip, slice);
 
     tex = ASU2(workGroupID.xy * 64) + ASU2(x * 2 + 32, y * 2);
     pix = ASU2(workGroupID.xy * 32) + ASU2(x + 16, y);
-    v[1] = SpdReduceLoadSourceImage(tex, slice);
-    SpdStore(pix, v[1], 0, slice);
+    v[1] = SpdReduceLoadSourceImageTile(tex, slice);
+    SpdStoreTile(pix, v[1], mip, slice);
     
     tex = ASU2(workGroupID.xy * 64) + ASU2(x * 2, y * 2 + 32);
     pix = ASU2(workGroupID.xy * 32) + ASU2(x, y + 16);
-    v[2] = SpdReduceLoadSourceImage(tex, slice);
-    SpdStore(pix, v[2], 0, slice);
+    v[2] = SpdReduceLoadSourceImageTile(tex, slice);
+    SpdStoreTile(pix, v[2], mip, slice);
     
     tex = ASU2(workGroupID.xy * 64) + ASU2(x * 2 + 32, y * 2 + 32);
     pix = ASU2(workGroupID.xy * 32) + ASU2(x + 16, y + 16);
-    v[3] = SpdReduceLoadSourceImage(tex, slice);
-    SpdStore(pix, v[3], 0, slice);
+    v[3] = SpdReduceLoadSourceImageTile(tex, slice);
+    SpdStoreTile(pix, v[3], mip, slice);
 
-    if (mip <= 1)
+    if (mip <= 1 + SPD_TILE_MIP_OFFSET)
         return;
 
     for (int i = 0; i < 4; i++)
@@ -593,7 +1810,7 @@ void SpdDownsampleMips_0_1_LDS(AU1 x, AU1 y, AU2 workGroupID, AU1 localInvocatio
                 AU2(x * 2 + 0, y * 2 + 1),
                 AU2(x * 2 + 1, y * 2 + 1)
             );
-            SpdStore(ASU2(workGroupID.xy * 16) + ASU2(x + (i % 2) * 8, y + (i / 2) * 8), v[i], 1, slice);
+            SpdStoreAlphaCoverage(ASU2(workGroupID.xy * 16) + ASU2(x + (i % 2) * 8, y + (i / 2) * 8), v[i], 1 + SPD_TILE_MIP_OFFSET, slice);
         }
         SpdWorkgroupShuffleBarrier();
     }
@@ -622,13 +1839,13 @@ void SpdDownsampleMip_2(AU1 x, AU1 y, AU2 workGroupID, AU1 localInvocationIndex,
 #ifdef SPD_NO_WAVE_OPERATIONS
     if (localInvocationIndex < 64)
     {
-        AF4 v = SpdReduceIntermediate(
+        SpdValue v = SpdReduceIntermediate(
             AU2(x * 2 + 0, y * 2 + 0),
             AU2(x * 2 + 1, y * 2 + 0),
             AU2(x * 2 + 0, y * 2 + 1),
             AU2(x * 2 + 1, y * 2 + 1)
         );
-        SpdStore(ASU2(workGroupID.xy * 8) + ASU2(x, y), v, mip, slice);
+        SpdStoreAlphaCoverage(ASU2(workGroupID.xy * 8) + ASU2(x, y), v, mip, slice);
         // store to LDS, try to reduce bank conflicts
         // x 0 x 0 x 0 x 0 x 0 x 0 x 0 x 0
         // 0 0 0 0 0 0 0 0 0 0 0 0 0 0 0 0
@@ -640,12 +1857,12 @@ void SpdDownsampleMip_2(AU1 x, AU1 y, AU2 workGroupID, AU1 localInvocationIndex,
         SpdStoreIntermediate(x * 2 + y % 2, y * 2, v);
     }
 #else
-    AF4 v = SpdLoadIntermediate(x, y);
+    SpdValue v = SpdLoadIntermediate(x, y);
     v = SpdReduceQuad(v);
     // quad index 0 stores result
     if (localInvocationIndex % 4 == 0)
     {
-        SpdStore(ASU2(workGroupID.xy * 8) + ASU2(x/2, y/2), v, mip, slice);
+        SpdStoreAlphaCoverage(ASU2(workGroupID.xy * 8) + ASU2(x/2, y/2), v, mip, slice);
         SpdStoreIntermediate(x + (y/2) % 2, y, v);
     }
 #endif
@@ -660,13 +1877,13 @@ void SpdDownsampleMip_3(AU1 x, AU1 y, AU2 workGroupID, AU1 localInvocationIndex,
         // 0 0 0 0
         // 0 x 0 x
         // 0 0 0 0
-        AF4 v = SpdReduceIntermediate(
+        SpdValue v = SpdReduceIntermediate(
             AU2(x * 4 + 0 + 0, y * 4 + 0),
             AU2(x * 4 + 2 + 0, y * 4 + 0),
             AU2(x * 4 + 0 + 1, y * 4 + 2),
             AU2(x * 4 + 2 + 1, y * 4 + 2)
         );
-        SpdStore(ASU2(workGroupID.xy * 4) + ASU2(x, y), v, mip, slice);
+        SpdStoreAlphaCoverage(ASU2(workGroupID.xy * 4) + ASU2(x, y), v, mip, slice);
         // store to LDS
         // x 0 0 0 x 0 0 0 x 0 0 0 x 0 0 0
         // 0 0 0 0 0 0 0 0 0 0 0 0 0 0 0 0
@@ -683,12 +1900,12 @@ void SpdDownsampleMip_3(AU1 x, AU1 y, AU2 workGroupID, AU1 localInvocationIndex,
 #else
     if (localInvocationIndex < 64)
     {
-        AF4 v = SpdLoadIntermediate(x * 2 + y % 2,y * 2);
+        SpdValue v = SpdLoadIntermediate(x * 2 + y % 2,y * 2);
         v = SpdReduceQuad(v);
         // quad index 0 stores result
         if (localInvocationIndex % 4 == 0)
         {   
-            SpdStore(ASU2(workGroupID.xy * 4) + ASU2(x/2, y/2), v, mip, slice);
+            SpdStoreAlphaCoverage(ASU2(workGroupID.xy * 4) + ASU2(x/2, y/2), v, mip, slice);
             SpdStoreIntermediate(x * 2 + y/2, y * 2, v);
         }
     }
@@ -703,13 +1920,13 @@ void SpdDownsampleMip_4(AU1 x, AU1 y, AU2 workGroupID, AU1 localInvocationIndex,
         // x 0 0 0 x 0 0 0
         // ...
         // 0 x 0 0 0 x 0 0
-        AF4 v = SpdReduceIntermediate(
+        SpdValue v = SpdReduceIntermediate(
             AU2(x * 8 + 0 + 0 + y * 2, y * 8 + 0),
             AU2(x * 8 + 4 + 0 + y * 2, y * 8 + 0),
             AU2(x * 8 + 0 + 1 + y * 2, y * 8 + 4),
             AU2(x * 8 + 4 + 1 + y * 2, y * 8 + 4)
         );
-        SpdStore(ASU2(workGroupID.xy * 2) + ASU2(x, y), v, mip, slice);
+        SpdStoreAlphaCoverage(ASU2(workGroupID.xy * 2) + ASU2(x, y), v, mip, slice);
         // store to LDS
         // x x x x 0 ...
         // 0 ...
@@ -718,132 +1935,1080 @@ void SpdDownsampleMip_4(AU1 x, AU1 y, AU2 workGroupID, AU1 localInvocationIndex,
 #else
     if (localInvocationIndex < 16)
     {
-        AF4 v = SpdLoadIntermediate(x * 4 + y,y * 4);
+        SpdValue v = SpdLoadIntermediate(x * 4 + y,y * 4);
         v = SpdReduceQuad(v);
         // quad index 0 stores result
         if (localInvocationIndex % 4 == 0)
         {   
-            SpdStore(ASU2(workGroupID.xy * 2) + ASU2(x/2, y/2), v, mip, slice);
+            SpdStoreAlphaCoverage(ASU2(workGroupID.xy * 2) + ASU2(x/2, y/2), v, mip, slice);
             SpdStoreIntermediate(x / 2 + y, 0, v);
         }
     }
 #endif
 }
 
-void SpdDownsampleMip_5(AU2 workGroupID, AU1 localInvocationIndex, AU1 mip, AU1 slice)
+void SpdDownsampleMip_5(AU2 workGroupID, AU1 localInvocationIndex, AU1 mip, AU1 slice)
+{
+#ifdef SPD_NO_WAVE_OPERATIONS
+    if (localInvocationIndex < 1)
+    {
+        // x x x x 0 ...
+        // 0 ...
+        SpdValue v = SpdReduceIntermediate(
+            AU2(0, 0),
+            AU2(1, 0),
+            AU2(2, 0),
+            AU2(3, 0)
+        );
+        SpdStoreAlphaCoverage(ASU2(workGroupID.xy), v, mip, slice);
+    }
+#else
+    if (localInvocationIndex < 4)
+    {
+        SpdValue v = SpdLoadIntermediate(localInvocationIndex,0);
+        v = SpdReduceQuad(v);
+        // quad index 0 stores result
+        if (localInvocationIndex % 4 == 0)
+        {   
+            SpdStoreAlphaCoverage(ASU2(workGroupID.xy), v, mip, slice);
+        }
+    }
+#endif
+}
+
+void SpdDownsampleMips_6_7(AU1 x, AU1 y, AU1 mips, AU1 slice)
+{
+    ASU2 tex = ASU2(x * 4 + 0, y * 4 + 0);
+    ASU2 pix = ASU2(x * 2 + 0, y * 2 + 0);
+    SpdValue v0 = SpdReduceLoad4(tex, slice);
+    SpdStoreAlphaCoverage(pix, v0, 6, slice);
+
+    tex = ASU2(x * 4 + 2, y * 4 + 0);
+    pix = ASU2(x * 2 + 1, y * 2 + 0);
+    SpdValue v1 = SpdReduceLoad4(tex, slice);
+    SpdStoreAlphaCoverage(pix, v1, 6, slice);
+
+    tex = ASU2(x * 4 + 0, y * 4 + 2);
+    pix = ASU2(x * 2 + 0, y * 2 + 1);
+    SpdValue v2 = SpdReduceLoad4(tex, slice);
+    SpdStoreAlphaCoverage(pix, v2, 6, slice);
+
+    tex = ASU2(x * 4 + 2, y * 4 + 2);
+    pix = ASU2(x * 2 + 1, y * 2 + 1);
+    SpdValue v3 = SpdReduceLoad4(tex, slice);
+    SpdStoreAlphaCoverage(pix, v3, 6, slice);
+
+    if (mips <= 7) return;
+    // no barrier needed, working on values only from the same thread
+
+    SpdValue v = SpdReduce4Karis(v0, v1, v2, v3);
+    SpdStoreAlphaCoverage(ASU2(x, y), v, 7, slice);
+    SpdStoreIntermediate(x, y, v);
+}
+
+// With 128x128 tiles the single remaining workgroup starts from at most 32x32 texels of mip 6.
+void SpdDownsampleMip_7(AU1 x, AU1 y, AU1 mips, AU1 slice)
+{
+    SpdValue v = SpdReduceLoad4(AU2(x * 2, y * 2), slice);
+    SpdStoreAlphaCoverage(ASU2(x, y), v, 7, slice);
+    SpdStoreIntermediate(x, y, v);
+}
+
+void SpdDownsampleNextFour(AU1 x, AU1 y, AU2 workGroupID, AU1 localInvocationIndex, AU1 baseMip, AU1 mips, AU1 slice)
+{
+    if (mips <= baseMip) return;
+    SpdWorkgroupShuffleBarrier();
+    SpdDownsampleMip_2(x, y, workGroupID, localInvocationIndex, baseMip, slice);
+    SpdAlphaCoverageFlush(baseMip, localInvocationIndex, slice);
+
+    if (mips <= baseMip + 1) return;
+    SpdWorkgroupShuffleBarrier();
+    SpdDownsampleMip_3(x, y, workGroupID, localInvocationIndex, baseMip + 1, slice);
+    SpdAlphaCoverageFlush(baseMip + 1, localInvocationIndex, slice);
+
+    if (mips <= baseMip + 2) return;
+    SpdWorkgroupShuffleBarrier();
+    SpdDownsampleMip_4(x, y, workGroupID, localInvocationIndex, baseMip + 2, slice);
+    SpdAlphaCoverageFlush(baseMip + 2, localInvocationIndex, slice);
+
+    if (mips <= baseMip + 3) return;
+    SpdWorkgroupShuffleBarrier();
+    SpdDownsampleMip_5(workGroupID, localInvocationIndex, baseMip + 3, slice);
+    SpdAlphaCoverageFlush(baseMip + 3, localInvocationIndex, slice);
+}
+
+void SpdDownsample(
+    AU2 workGroupID,
+    AU1 localInvocationIndex,
+    AU1 mips,
+    AU1 numWorkGroups,
+    AU1 slice
+) {
+    AU2 sub_xy = ARmpRed8x8(localInvocationIndex % 64);
+    AU1 x = sub_xy.x + 8 * ((localInvocationIndex >> 6) % 2);
+    AU1 y = sub_xy.y + 8 * ((localInvocationIndex >> 7));
+    SpdAlphaCoverageBegin(workGroupID);
+    // unchanged tiles keep their mips from the last dispatch
+    if (!SpdTileUnchanged(workGroupID, localInvocationIndex, slice))
+    {
+        SpdDownsampleMips_0_1(x, y, workGroupID, localInvocationIndex, mips, slice);
+        SpdAlphaCoverageTile(localInvocationIndex, mips, slice);
+        SpdAlphaCoverageFlush(SPD_TILE_MIP_OFFSET, localInvocationIndex, slice);
+        if (mips > 1 + SPD_TILE_MIP_OFFSET)
+            SpdAlphaCoverageFlush(1 + SPD_TILE_MIP_OFFSET, localInvocationIndex, slice);
+
+        SpdDownsampleNextFour(x, y, workGroupID, localInvocationIndex, 2 + SPD_TILE_MIP_OFFSET, mips, slice);
+    }
+
+    if (mips <= SpdLastWorkgroupMip()) return;
+
+    if (SpdExitWorkgroup(numWorkGroups, localInvocationIndex, slice)) return;
+
+    SpdResetAtomicCounter(slice);
+    SpdAlphaCoverageSlice(localInvocationIndex, numWorkGroups, slice);
+
+    // After mip 6 there is only a single workgroup left that downsamples the remaining up to 64x64 texels.
+    if (mips > 6 + SPD_TILE_MIP_OFFSET)
+    {
+#if SPD_TILE_SIZE == 128
+        SpdDownsampleMip_7(x, y, mips, slice);
+#else
+        SpdDownsampleMips_6_7(x, y, mips, slice);
+        SpdAlphaCoverageFlush(6, localInvocationIndex, slice);
+        if (mips > 7)
+            SpdAlphaCoverageFlush(7, localInvocationIndex, slice);
+#endif
+
+        SpdDownsampleNextFour(x, y, AU2(0,0), localInvocationIndex, 8, mips, slice);
+    }
+    SpdAlphaCoverageSliceMips(mips, localInvocationIndex, slice);
+}
+
+void SpdDownsample(
+    AU2 workGroupID,
+    AU1 localInvocationIndex,
+    AU1 mips,
+    AU1 numWorkGroups,
+    AU1 slice,
+    AU2 workGroupOffset
+) {
+    SpdDownsample(workGroupID + workGroupOffset, localInvocationIndex, mips, numWorkGroups, slice);
+}
+
+//==============================================================================================================================
+//                                                     BLOOM
+//==============================================================================================================================
+// #define SPD_BLOOM and call SpdDownsampleBloom() instead of SpdDownsample() to build a bloom chain with the 13-tap downsample
+// filter of Call of Duty: Advanced Warfare in one dispatch. Each texel of a mip averages five 4x4 boxes of the level above:
+// the box under it with weight 0.5 and the four boxes one texel further out diagonally with 0.125 each, read as thirteen
+// 2x2 boxes. Loads past the edge are clamped. With SPD_KARIS_AVERAGE the five boxes of mip 0 are weighted by 1/(1+luma).
+//
+// The filter reads 6x6 texels, so every tile mip needs a 2 texel apron of the level above from the neighbouring tiles.
+// Mip 0 gets it from the source. The other mips get it from the mips the neighbours stored: every workgroup that stored a
+// tile mip counts itself in for the 9 tiles around it, and whichever workgroup completes the count of a tile computes the
+// next mip of that tile right away, through the same 36x36 LDS window. Nobody waits, but a workgroup can end up computing
+// mips of other tiles. The last workgroup to store a mip 5 tile computes the remaining mips, same as SpdDownsample().
+// The result matches a separate dispatch per mip up to float rounding.
+// Only 64x64 tiles, whole textures, single texel source loads and the non-packed version. SRGB, NORMAL_MAP, MOMENTS and
+// ALPHA_COVERAGE don't apply, SpdLoadSourceImage() and SpdStore() are called directly.
+//
+// // all mips are read back, so every imgDst binding has to be coherent (see above)
+// GLSL: AF4 SpdLoadBloom(ASU2 p, AU1 mip, AU1 slice){return imageLoad(imgDst[mip], p);}
+// HLSL: AF4 SpdLoadBloom(ASU2 p, AU1 mip, AU1 slice){return imgDst[mip][p];}
+// // Define the LDS functions: the window of the level above and the task stack
+// shared AF4 spdBloomWindow[36][36]; // HLSL: groupshared
+// shared AU1 spdBloomTasks[SPD_BLOOM_MAX_TASKS]; // HLSL: groupshared
+// AF4 SpdLoadBloomWindow(AU1 x, AU1 y){return spdBloomWindow[x][y];}
+// void SpdStoreBloomWindow(AU1 x, AU1 y, AF4 value){spdBloomWindow[x][y] = value;}
+// AU1 SpdLoadBloomTask(AU1 i){return spdBloomTasks[i];}
+// void SpdStoreBloomTask(AU1 i, AU1 task){spdBloomTasks[i] = task;}
+// // 5 counters per workgroup and slice, MUST be initialized to 0, SPD resets them after each run.
+// // The atomic counter functions of SpdDownsample() are needed as well.
+// GLSL:
+// layout(std430, set=0, binding=4) coherent buffer SpdBloomCounters {uint counter[];} spdBloomCounters;
+// AU1 SpdBloomIncreaseCounter(AU1 index, AU1 slice){return atomicAdd(spdBloomCounters.counter[slice * bloomCounters + index], 1);}
+// void SpdBloomResetCounter(AU1 index, AU1 slice){spdBloomCounters.counter[slice * bloomCounters + index] = 0;}
+// HLSL:
+// [[vk::binding(4)]] globallycoherent RWStructuredBuffer<uint> spdBloomCounters :register(u3);
+// AU1 SpdBloomIncreaseCounter(AU1 index, AU1 slice){AU1 v; InterlockedAdd(spdBloomCounters[slice * bloomCounters + index], 1, v); return v;}
+// void SpdBloomResetCounter(AU1 index, AU1 slice){spdBloomCounters[slice * bloomCounters + index] = 0;}
+// // bloomCounters = 5 * numWorkGroups (6 * numWorkGroups with SPD_LAPLACIAN).
+// // Dispatch like SpdDownsample(), pass the workgroup count and the source size:
+// SpdDownsampleBloom(AU2(WorkGroupId.xy), AU1(LocalThreadIndex), AU1(mips), AU2(dispatchThreadGroupCountXY), AU2(sourceSize), AU1(WorkGroupId.z));
+
+//==============================================================================================================================
+//                                                     GAUSSIAN PYRAMID
+//==============================================================================================================================
+// #define SPD_GAUSSIAN instead of SPD_BLOOM and call SpdDownsampleGaussian() for a Gaussian pyramid: each mip is the level above
+// filtered with the separable 5-tap binomial [1 4 6 4 1] / 16 and decimated. Same tile scheme and callbacks as BLOOM.
+// Add #define SPD_LAPLACIAN to also get the Laplacian band-pass levels in the same dispatch, through
+// void SpdStoreLaplacian(ASU2 p, AF4 value, AU1 level, AU1 slice);
+// Level 0 is the source resolution, level n the resolution of mip n - 1: the level minus the next mip expanded with the
+// same kernel. The last mip is the residual, adding up the expanded mips and the levels gives back the source.
+// A band needs the next mip of the neighbouring tiles as well, so it is computed together with the mip after that, from the
+// same LDS window, and each tile gets one extra mip of work for the last band.
+#if defined(SPD_BLOOM) || defined(SPD_GAUSSIAN)
+#if defined(SPD_BLOOM) && defined(SPD_GAUSSIAN)
+#error SPD_BLOOM and SPD_GAUSSIAN are exclusive
+#endif
+#if SPD_TILE_SIZE != 64
+#error SPD_BLOOM and SPD_GAUSSIAN only support SPD_TILE_SIZE 64
+#endif
+#ifdef SPD_LINEAR_SAMPLER
+#error SPD_BLOOM and SPD_GAUSSIAN load single source texels, SPD_LINEAR_SAMPLER is not supported
+#endif
+
+// 9 pending tile mips per level of mips 1-6 at most
+#define SPD_BLOOM_MAX_TASKS 54
+#define SPD_BLOOM_NO_TASK 0xffffffffu
+
+// Makes the mip stores of the workgroup visible to the other workgroups, before they are counted in
+void SpdBloomMemoryBarrier()
+{
+#ifdef A_GLSL
+    memoryBarrier();
+    barrier();
+#endif
+#ifdef A_HLSL
+    DeviceMemoryBarrierWithGroupSync();
+#endif
+}
+
+ASU2 SpdBloomMipSize(AU2 sourceSize, AU1 mip)
+{
+    return ASU2(max(sourceSize >> (mip + 1u), AU2(1, 1)));
+}
+
+AF4 SpdBloomBox(AU2 p)
+{
+    return (SpdLoadBloomWindow(p.x, p.y) + SpdLoadBloomWindow(p.x + 1u, p.y) +
+        SpdLoadBloomWindow(p.x, p.y + 1u) + SpdLoadBloomWindow(p.x + 1u, p.y + 1u)) * AF1_(0.25);
+}
+
+// Filters the 6x6 window texels starting at p
+AF4 SpdBloomFilter(AU2 p, bool karis)
+{
+    AF4 a = SpdBloomBox(p + AU2(0, 0));
+    AF4 b = SpdBloomBox(p + AU2(2, 0));
+    AF4 c = SpdBloomBox(p + AU2(4, 0));
+    AF4 d = SpdBloomBox(p + AU2(1, 1));
+    AF4 e = SpdBloomBox(p + AU2(3, 1));
+    AF4 f = SpdBloomBox(p + AU2(0, 2));
+    AF4 g = SpdBloomBox(p + AU2(2, 2));
+    AF4 h = SpdBloomBox(p + AU2(4, 2));
+    AF4 i = SpdBloomBox(p + AU2(1, 3));
+    AF4 j = SpdBloomBox(p + AU2(3, 3));
+    AF4 k = SpdBloomBox(p + AU2(0, 4));
+    AF4 l = SpdBloomBox(p + AU2(2, 4));
+    AF4 m = SpdBloomBox(p + AU2(4, 4));
+    AF4 center = (d + e + i + j) * AF1_(0.25);
+    AF4 topLeft = (a + b + f + g) * AF1_(0.25);
+    AF4 topRight = (b + c + g + h) * AF1_(0.25);
+    AF4 bottomLeft = (f + g + k + l) * AF1_(0.25);
+    AF4 bottomRight = (g + h + l + m) * AF1_(0.25);
+#ifdef SPD_KARIS_AVERAGE
+    if (karis)
+    {
+        AF1 w0 = AF1_(0.5) * SpdKarisWeightF1(center);
+        AF1 w1 = AF1_(0.125) * SpdKarisWeightF1(topLeft);
+        AF1 w2 = AF1_(0.125) * SpdKarisWeightF1(topRight);
+        AF1 w3 = AF1_(0.125) * SpdKarisWeightF1(bottomLeft);
+        AF1 w4 = AF1_(0.125) * SpdKarisWeightF1(bottomRight);
+        return (center * w0 + topLeft * w1 + topRight * w2 + bottomLeft * w3 + bottomRight * w4) *
+            ARcpF1(w0 + w1 + w2 + w3 + w4);
+    }
+#endif
+    return center * AF1_(0.5) + (topLeft + topRight + bottomLeft + bottomRight) * AF1_(0.125);
+}
+
+AF4 SpdGaussianRow(AU2 p)
+{
+    return (SpdLoadBloomWindow(p.x, p.y) + SpdLoadBloomWindow(p.x + 4u, p.y) +
+        (SpdLoadBloomWindow(p.x + 1u, p.y) + SpdLoadBloomWindow(p.x + 3u, p.y)) * AF1_(4.0) +
+        SpdLoadBloomWindow(p.x + 2u, p.y) * AF1_(6.0)) * AF1_(1.0 / 16.0);
+}
+
+// Filters the 5x5 window texels starting at p
+AF4 SpdGaussianFilter(AU2 p)
+{
+    return (SpdGaussianRow(p) + SpdGaussianRow(p + AU2(0, 4)) +
+        (SpdGaussianRow(p + AU2(0, 1)) + SpdGaussianRow(p + AU2(0, 3))) * AF1_(4.0) +
+        SpdGaussianRow(p + AU2(0, 2)) * AF1_(6.0)) * AF1_(1.0 / 16.0);
+}
+
+// Window texels expanded to texel q of the level above the window, q = 0 is the level above window texel 2
+AF4 SpdGaussianExpand(AU2 q)
+{
+    // even texels sit on a window texel: 1 6 1 / 8, odd ones between two: 1 1 / 2
+    AU2 w = (q >> 1u) + AU2(1, 1);
+    AF3 wx = (q.x & 1u) == 0u ? AF3(0.125, 0.75, 0.125) : AF3(0.0, 0.5, 0.5);
+    AF3 wy = (q.y & 1u) == 0u ? AF3(0.125, 0.75, 0.125) : AF3(0.0, 0.5, 0.5);
+    AF4 v = AF4(0.0, 0.0, 0.0, 0.0);
+    for (AU1 y = 0u; y < 3u; y++)
+        for (AU1 x = 0u; x < 3u; x++)
+            v += SpdLoadBloomWindow(w.x + x, w.y + y) * (wx[x] * wy[y]);
+    return v;
+}
+
+// Loads a window of size x size texels of the level above mip at origin plus a 2 texel apron, computes the texels of mip
+// under it if mip < mips, and with SPD_LAPLACIAN and band the Laplacian level of the level above that. Called by all threads.
+void SpdBloomBlock(AU2 origin, AU1 size, AU1 mip, AU1 mips, bool band, AU2 sourceSize, AU1 localInvocationIndex,
+    AU1 slice)
+{
+    ASU2 inSize = mip == 0u ? ASU2(sourceSize) : SpdBloomMipSize(sourceSize, mip - 1u);
+    if (ASU1(origin.x) >= inSize.x || ASU1(origin.y) >= inSize.y)
+        return;
+    ASU2 base = ASU2(origin) - ASU2(2, 2);
+    AU1 window = size + 4u;
+    for (AU1 t = localInvocationIndex; t < window * window; t += 256u)
+    {
+        AU2 w = AU2(t % window, t / window);
+        ASU2 p = clamp(base + ASU2(w), ASU2(0, 0), inSize - ASU2(1, 1));
+        SpdStoreBloomWindow(w.x, w.y, mip == 0u ? SpdLoadSourceImage(p, slice) : SpdLoadBloom(p, mip - 1u, slice));
+    }
+    SpdWorkgroupShuffleBarrier();
+
+    ASU2 outSize = SpdBloomMipSize(sourceSize, mip);
+    AU1 outBlock = size / 2u;
+    if (mip < mips && localInvocationIndex < outBlock * outBlock)
+    {
+        AU2 o = AU2(localInvocationIndex % outBlock, localInvocationIndex / outBlock);
+        ASU2 pix = ASU2(origin / 2u + o);
+        if (pix.x < outSize.x && pix.y < outSize.y)
+        {
+#ifdef SPD_GAUSSIAN
+            SpdStore(pix, SpdGaussianFilter(o * 2u), mip, slice);
+#else
+            SpdStore(pix, SpdBloomFilter(o * 2u, mip == 0u), mip, slice);
+#endif
+        }
+    }
+
+#ifdef SPD_LAPLACIAN
+    if (band && mip > 0u)
+    {
+        ASU2 bandSize = mip == 1u ? ASU2(sourceSize) : SpdBloomMipSize(sourceSize, mip - 2u);
+        AU1 bandBlock = size * 2u;
+        for (AU1 t = localInvocationIndex; t < bandBlock * bandBlock; t += 256u)
+        {
+            AU2 q = AU2(t % bandBlock, t / bandBlock);
+            ASU2 pix = ASU2(origin * 2u + q);
+            if (pix.x < bandSize.x && pix.y < bandSize.y)
+            {
+                AF4 v = mip == 1u ? SpdLoadSourceImage(pix, slice) : SpdLoadBloom(pix, mip - 2u, slice);
+                SpdStoreLaplacian(pix, v - SpdGaussianExpand(q), mip - 1u, slice);
+            }
+        }
+    }
+#endif
+    SpdWorkgroupShuffleBarrier();
+}
+
+// Tiles within one tile of tile, including itself
+AU1 SpdBloomNeighbours(AU2 tile, AU2 numWorkGroupsXY)
+{
+    AU1 x = 1u + (tile.x > 0u ? 1u : 0u) + (tile.x + 1u < numWorkGroupsXY.x ? 1u : 0u);
+    AU1 y = 1u + (tile.y > 0u ? 1u : 0u) + (tile.y + 1u < numWorkGroupsXY.y ? 1u : 0u);
+    return x * y;
+}
+
+// Number of mips a tile goes through, the Laplacian needs one more for the last band
+AU1 SpdBloomTileMips(AU1 mips)
+{
+#ifdef SPD_LAPLACIAN
+    return min(mips, 6u) + 1u;
+#else
+    return min(mips, 6u);
+#endif
+}
+
+// Counts the stored tile mip in for the tiles around it and pushes the tiles that are complete now onto the task stack.
+// Returns true if the workgroup has to compute the remaining mips. Called by all threads.
+bool SpdBloomFinishTile(AU2 tile, AU1 mip, AU1 mips, AU2 numWorkGroupsXY, AU1 localInvocationIndex, AU1 slice,
+    inout AU1 tasks)
+{
+    SpdBloomMemoryBarrier();
+    AU1 numWorkGroups = numWorkGroupsXY.x * numWorkGroupsXY.y;
+    if (mip + 1u < SpdBloomTileMips(mips))
+    {
+        if (localInvocationIndex < 9u)
+        {
+            ASU2 n = ASU2(tile) + ASU2(localInvocationIndex % 3u, localInvocationIndex / 3u) - ASU2(1, 1);
+            AU1 task = SPD_BLOOM_NO_TASK;
+            if (n.x >= 0 && n.y >= 0 && n.x < ASU1(numWorkGroupsXY.x) && n.y < ASU1(numWorkGroupsXY.y))
+            {
+                // counters of mip 1 come first, the task of a tile mip is its counter index + numWorkGroups
+                AU1 index = mip * numWorkGroups + AU1(n.y) * numWorkGroupsXY.x + AU1(n.x);
+                if (SpdBloomIncreaseCounter(index, slice) + 1u == SpdBloomNeighbours(AU2(n), numWorkGroupsXY))
+                {
+                    SpdBloomResetCounter(index, slice);
+                    task = index + numWorkGroups;
+                }
+            }
+            SpdStoreBloomTask(tasks + localInvocationIndex, task);
+        }
+        tasks += 9u;
+        SpdWorkgroupShuffleBarrier();
+        return false;
+    }
+    if (mips <= 6u)
+        return false;
+    return !SpdExitWorkgroup(numWorkGroups, localInvocationIndex, slice);
+}
+
+void SpdDownsampleBloom(
+    AU2 workGroupID,
+    AU1 localInvocationIndex,
+    AU1 mips,
+    AU2 numWorkGroupsXY,
+    AU2 sourceSize,
+    AU1 slice
+) {
+    // mip 0 of the own tile, from 32x32 source texels per block
+    for (AU1 b = 0u; b < 4u; b++)
+        SpdBloomBlock(workGroupID * 64u + AU2(b % 2u, b / 2u) * 32u, 32u, 0u, mips, false, sourceSize,
+            localInvocationIndex, slice);
+
+    AU1 numWorkGroups = numWorkGroupsXY.x * numWorkGroupsXY.y;
+    AU1 tasks = 0u;
+    bool last = SpdBloomFinishTile(workGroupID, 0u, mips, numWorkGroupsXY, localInvocationIndex, slice, tasks);
+    while (tasks > 0u)
+    {
+        tasks--;
+        AU1 task = SpdLoadBloomTask(tasks);
+        if (task == SPD_BLOOM_NO_TASK)
+            continue;
+        AU1 mip = task / numWorkGroups;
+        AU1 index = task % numWorkGroups;
+        AU2 tile = AU2(index % numWorkGroupsXY.x, index / numWorkGroupsXY.x);
+        AU1 size = 64u >> mip;
+        SpdBloomBlock(tile * size, size, mip, mips, true, sourceSize, localInvocationIndex, slice);
+        if (SpdBloomFinishTile(tile, mip, mips, numWorkGroupsXY, localInvocationIndex, slice, tasks))
+            last = true;
+    }
+    if (!last)
+        return;
+
+    SpdResetAtomicCounter(slice);
+    // at most 64x64 texels of mip 5 are left, the band of mip 5 is done by the tiles
+#ifdef SPD_LAPLACIAN
+    AU1 lastMip = mips;
+#else
+    AU1 lastMip = mips - 1u;
+#endif
+    for (AU1 mip = 6u; mip <= lastMip; mip++)
+    {
+        ASU2 size = SpdBloomMipSize(sourceSize, mip - 1u);
+        for (AU1 y = 0u; y < AU1(size.y); y += 32u)
+            for (AU1 x = 0u; x < AU1(size.x); x += 32u)
+                SpdBloomBlock(AU2(x, y), 32u, mip, mips, mip > 6u, sourceSize, localInvocationIndex, slice);
+        SpdBloomMemoryBarrier();
+    }
+}
+
+#ifdef SPD_GAUSSIAN
+void SpdDownsampleGaussian(
+    AU2 workGroupID,
+    AU1 localInvocationIndex,
+    AU1 mips,
+    AU2 numWorkGroupsXY,
+    AU2 sourceSize,
+    AU1 slice
+) {
+    SpdDownsampleBloom(workGroupID, localInvocationIndex, mips, numWorkGroupsXY, sourceSize, slice);
+}
+#endif
+#endif // #if defined(SPD_BLOOM) || defined(SPD_GAUSSIAN)
+
+//==============================================================================================================================
+//                                                     MAX HEIGHT
+//==============================================================================================================================
+// #define SPD_MAX_HEIGHT and call SpdDownsampleMaxHeight() instead of SpdDownsample() for the max mips of a heightfield, as
+// used by cone step mapping, parallax occlusion mapping or terrain ray marching: every texel is the maximum of the heights
+// below it. Usually combined with SPD_ONE_CHANNEL. SpdReduce4() still has to be defined, it is just not called.
+// Non-power-of-two sizes are handled conservatively. The mip of an odd sized level drops its last column or row, so the
+// last column and row of every mip after that are recomputed from the level above up to its edge: every height is below
+// a texel of every mip. The tiles compute the mips as usual, the last workgroup then recomputes the borders mip by mip.
+// The other texels never read a border texel of the level above, so they don't have to wait for it.
+// Loads past the edge of the source and of mip 5 have to return the edge texel or a value that is not higher than any
+// height, e.g. 0. Only the non-packed version, single texel source loads and the plain max reduction.
+// The CPU engine has the format R16UnormMaxHeight for the same, optionally packed into one buffer without padding.
+//
+// // the borders of all mips are read back, so every imgDst binding has to be coherent (see above)
+// GLSL: AF1 SpdLoadMaxHeight(ASU2 p, AU1 mip, AU1 slice){return imageLoad(imgDst[mip], p).x;}
+// HLSL: AF1 SpdLoadMaxHeight(ASU2 p, AU1 mip, AU1 slice){return imgDst[mip][p];}
+// // Dispatch like SpdDownsample(), pass the source size as well:
+// SpdDownsampleMaxHeight(AU2(WorkGroupId.xy), AU1(LocalThreadIndex), AU1(mips), AU1(numWorkGroups), AU2(sourceSize), AU1(WorkGroupId.z));
+#ifdef SPD_MAX_HEIGHT
+#if defined(SPD_KARIS_AVERAGE) || defined(SPD_MAJORITY) || defined(SPD_OCCUPANCY_OR) || defined(SPD_OCCUPANCY_AND)
+#error SPD_MAX_HEIGHT excludes SPD_KARIS_AVERAGE, SPD_MAJORITY, SPD_OCCUPANCY_OR and SPD_OCCUPANCY_AND
+#endif
+#if defined(SPD_SRGB) || defined(SPD_ALPHA_COVERAGE) || defined(SPD_NORMAL_MAP) || defined(SPD_MOMENTS)
+#error SPD_MAX_HEIGHT excludes SPD_SRGB, SPD_ALPHA_COVERAGE, SPD_NORMAL_MAP and SPD_MOMENTS
+#endif
+#if defined(SPD_BLOOM) || defined(SPD_GAUSSIAN) || defined(SPD_LINEAR_SAMPLER) || defined(SPD_PACKED_ONLY)
+#error SPD_MAX_HEIGHT excludes SPD_BLOOM, SPD_GAUSSIAN, SPD_LINEAR_SAMPLER and SPD_PACKED_ONLY
+#endif
+
+// Makes the mip stores of the workgroup visible to the other workgroups
+void SpdMaxHeightMemoryBarrier()
+{
+#ifdef A_GLSL
+    memoryBarrier();
+    barrier();
+#endif
+#ifdef A_HLSL
+    DeviceMemoryBarrierWithGroupSync();
+#endif
+}
+
+AU2 SpdMaxHeightMipSize(AU2 sourceSize, AU1 mip)
+{
+    return max(sourceSize >> (mip + 1u), AU2(1, 1));
+}
+
+// Maximum of the texels of the level above mip from 2 * p to 2 * p + 1, for the last column and row up to its edge
+SpdValue SpdMaxHeightFold(AU2 p, AU1 mip, AU2 sourceSize, AU1 slice)
+{
+    AU2 inSize = mip == 0u ? sourceSize : SpdMaxHeightMipSize(sourceSize, mip - 1u);
+    AU2 outSize = SpdMaxHeightMipSize(sourceSize, mip);
+    AU2 p0 = min(p * 2u, inSize - AU2(1, 1));
+    AU2 p1 = min(p * 2u + AU2(1, 1), inSize - AU2(1, 1));
+    if (p.x == outSize.x - 1u)
+        p1.x = inSize.x - 1u;
+    if (p.y == outSize.y - 1u)
+        p1.y = inSize.y - 1u;
+    // at most 3x3 texels
+    SpdValue v = mip == 0u ? SpdLoadSourceImage(ASU2(p0), slice) : SpdLoadMaxHeight(ASU2(p0), mip - 1u, slice);
+    for (AU1 y = p0.y; y <= p1.y; y++)
+    {
+        for (AU1 x = p0.x; x <= p1.x; x++)
+        {
+            ASU2 t = ASU2(x, y);
+            v = max(v, mip == 0u ? SpdLoadSourceImage(t, slice) : SpdLoadMaxHeight(t, mip - 1u, slice));
+        }
+    }
+    return v;
+}
+
+// Recomputes the last column and row of every mip from the first one whose level above has an odd size, called by all
+// threads of the last workgroup
+void SpdMaxHeightBorders(AU1 mips, AU2 sourceSize, AU1 localInvocationIndex, AU1 slice)
+{
+    bool foldX = false;
+    bool foldY = false;
+    for (AU1 mip = 0u; mip < mips; mip++)
+    {
+        AU2 inSize = mip == 0u ? sourceSize : SpdMaxHeightMipSize(sourceSize, mip - 1u);
+        AU2 outSize = SpdMaxHeightMipSize(sourceSize, mip);
+        foldX = foldX || inSize.x > outSize.x * 2u;
+        foldY = foldY || inSize.y > outSize.y * 2u;
+        // the last column, then the rest of the last row
+        AU1 columnTexels = foldX ? outSize.y : 0u;
+        AU1 rowTexels = foldY ? outSize.x - (foldX ? 1u : 0u) : 0u;
+        for (AU1 i = localInvocationIndex; i < columnTexels + rowTexels; i += 256u)
+        {
+            AU2 p = i < columnTexels ? AU2(outSize.x - 1u, i) : AU2(i - columnTexels, outSize.y - 1u);
+            SpdStore(ASU2(p), SpdMaxHeightFold(p, mip, sourceSize, slice), mip, slice);
+        }
+        SpdMaxHeightMemoryBarrier();
+    }
+}
+
+void SpdDownsampleMaxHeight(
+    AU2 workGroupID,
+    AU1 localInvocationIndex,
+    AU1 mips,
+    AU1 numWorkGroups,
+    AU2 sourceSize,
+    AU1 slice
+) {
+    AU2 sub_xy = ARmpRed8x8(localInvocationIndex % 64);
+    AU1 x = sub_xy.x + 8 * ((localInvocationIndex >> 6) % 2);
+    AU1 y = sub_xy.y + 8 * ((localInvocationIndex >> 7));
+    SpdDownsampleMips_0_1(x, y, workGroupID, localInvocationIndex, mips, slice);
+    SpdDownsampleNextFour(x, y, workGroupID, localInvocationIndex, 2 + SPD_TILE_MIP_OFFSET, mips, slice);
+
+    // every workgroup counts in, even without remaining mips the last one has to do the borders
+    SpdMaxHeightMemoryBarrier();
+    if (SpdExitWorkgroup(numWorkGroups, localInvocationIndex, slice)) return;
+
+    SpdResetAtomicCounter(slice);
+    if (mips > 6 + SPD_TILE_MIP_OFFSET)
+    {
+#if SPD_TILE_SIZE == 128
+        SpdDownsampleMip_7(x, y, mips, slice);
+#else
+        SpdDownsampleMips_6_7(x, y, mips, slice);
+#endif
+        SpdDownsampleNextFour(x, y, AU2(0,0), localInvocationIndex, 8, mips, slice);
+    }
+    SpdMaxHeightMemoryBarrier();
+    SpdMaxHeightBorders(mips, sourceSize, localInvocationIndex, slice);
+}
+#endif // #ifdef SPD_MAX_HEIGHT
+
+//==============================================================================================================================
+//                                                   LUMINANCE HISTOGRAM
+//==============================================================================================================================
+// #define SPD_HISTOGRAM and call SpdLuminanceHistogram() for the log2 luminance histogram of the source and the average
+// luminance auto-exposure meters on, in one dispatch with the same workgroups and atomic counter as SpdDownsample().
+// Each workgroup bins the texels of its tile in LDS and writes the tile histogram to a scratch buffer, the last workgroup
+// sums the tile histograms, stores the merged histogram and computes the average.
+// SPD_HISTOGRAM_BINS is 64 or 256 (default). Bin 0 holds the texels below the metering range, which are not metered, the
+// other bins split the range evenly in log2 space, texels above it go to the last bin. The average luminance is the
+// weighted mean of the bin centers between the low and high percentile of the metered texels, so that a few very dark or
+// very bright texels don't move the exposure. Luminance is Rec. 709 of RGB, or the value itself with SPD_ONE_CHANNEL.
+// Only the non-packed version and single texel source loads, the mip functions still have to be defined, they are just
+// not called.
+// The CPU engine has SpdCpuLuminanceHistogram() for the same.
+//
+// // x, y: min and max log2 luminance of the metering range, z, w: low and high percentile, e.g. (-10, 6, 0.5, 0.95)
+// AF4 SpdHistogramParams(){return histogramParams;}
+// // one uint per bin in LDS
+// shared AU1 spdHistogram[SPD_HISTOGRAM_BINS]; // HLSL: groupshared
+// void SpdStoreHistogramLds(AU1 bin, AU1 value){spdHistogram[bin] = value;}
+// AU1 SpdLoadHistogramLds(AU1 bin){return spdHistogram[bin];}
+// GLSL: void SpdAddHistogramLds(AU1 bin, AU1 value){atomicAdd(spdHistogram[bin], value);}
+// HLSL: void SpdAddHistogramLds(AU1 bin, AU1 value){InterlockedAdd(spdHistogram[bin], value);}
+// // scratch buffer of slices * numWorkGroups * SPD_HISTOGRAM_BINS uints, coherent like the atomic counter
+// GLSL: void SpdStoreTileHistogram(AU1 index, AU1 count){spdTileHistograms.counts[index] = count;}
+// GLSL: AU1 SpdLoadTileHistogram(AU1 index){return spdTileHistograms.counts[index];}
+// HLSL: void SpdStoreTileHistogram(AU1 index, AU1 count){spdTileHistograms[index] = count;}
+// HLSL: AU1 SpdLoadTileHistogram(AU1 index){return spdTileHistograms[index];}
+// // results of the slice, called by the last workgroup. The exposure is up to you, it usually adapts over time, e.g.
+// // exposure[slice] = lerp(exposure[slice], 0.18 / averageLuminance, 1.0 - exp(-deltaTime * adaptationSpeed));
+// void SpdStoreHistogram(AU1 bin, AU1 count, AU1 slice){histogram[slice * SPD_HISTOGRAM_BINS + bin] = count;}
+// void SpdStoreExposure(AF1 averageLuminance, AU1 slice){...}
+// // Dispatch like SpdDownsample() for the whole texture, the number of workgroups follows from the source size:
+// SpdLuminanceHistogram(AU2(WorkGroupId.xy), AU1(LocalThreadIndex), AU2(sourceSize), AU1(WorkGroupId.z));
+#ifdef SPD_HISTOGRAM
+#ifndef SPD_HISTOGRAM_BINS
+#define SPD_HISTOGRAM_BINS 256
+#endif
+#if SPD_HISTOGRAM_BINS != 64 && SPD_HISTOGRAM_BINS != 256
+#error SPD_HISTOGRAM_BINS has to be 64 or 256
+#endif
+#if defined(SPD_UINT) || defined(SPD_LINEAR_SAMPLER) || defined(SPD_PACKED_ONLY)
+#error SPD_HISTOGRAM excludes SPD_UINT, SPD_LINEAR_SAMPLER and SPD_PACKED_ONLY
+#endif
+
+// Makes the tile histogram of the workgroup visible to the last workgroup
+void SpdHistogramMemoryBarrier()
+{
+#ifdef A_GLSL
+    memoryBarrier();
+    barrier();
+#endif
+#ifdef A_HLSL
+    DeviceMemoryBarrierWithGroupSync();
+#endif
+}
+
+AF1 SpdHistogramLuminance(SpdValue v)
 {
-#ifdef SPD_NO_WAVE_OPERATIONS
-    if (localInvocationIndex < 1)
-    {
-        // x x x x 0 ...
-        // 0 ...
-        AF4 v = SpdReduceIntermediate(
-            AU2(0, 0),
-            AU2(1, 0),
-            AU2(2, 0),
-            AU2(3, 0)
-        );
-        SpdStore(ASU2(workGroupID.xy), v, mip, slice);
-    }
+#ifdef SPD_ONE_CHANNEL
+    return v;
 #else
-    if (localInvocationIndex < 4)
-    {
-        AF4 v = SpdLoadIntermediate(localInvocationIndex,0);
-        v = SpdReduceQuad(v);
-        // quad index 0 stores result
-        if (localInvocationIndex % 4 == 0)
-        {   
-            SpdStore(ASU2(workGroupID.xy), v, mip, slice);
-        }
-    }
+    return dot(v.rgb, AF3(0.2126, 0.7152, 0.0722));
 #endif
 }
 
-void SpdDownsampleMips_6_7(AU1 x, AU1 y, AU1 mips, AU1 slice)
+// params.xy is the metering range in log2 luminance
+AU1 SpdHistogramBin(AF1 luminance, AF4 params)
 {
-    ASU2 tex = ASU2(x * 4 + 0, y * 4 + 0);
-    ASU2 pix = ASU2(x * 2 + 0, y * 2 + 0);
-    AF4 v0 = SpdReduceLoad4(tex, slice);
-    SpdStore(pix, v0, 6, slice);
+    if (!(luminance >= exp2(params.x)))
+        return 0u;
+    AF1 t = min((log2(luminance) - params.x) / (params.y - params.x), AF1_(1.0));
+    return 1u + min(AU1(t * AF1_(SPD_HISTOGRAM_BINS - 1)), AU1(SPD_HISTOGRAM_BINS - 2));
+}
 
-    tex = ASU2(x * 4 + 2, y * 4 + 0);
-    pix = ASU2(x * 2 + 1, y * 2 + 0);
-    AF4 v1 = SpdReduceLoad4(tex, slice);
-    SpdStore(pix, v1, 6, slice);
+// Average luminance of the merged histogram in LDS, between the percentiles params.zw of the metered texels
+AF1 SpdHistogramAverage(AF4 params)
+{
+    AF1 metered = AF1_(0.0);
+    for (AU1 bin = 1u; bin < AU1(SPD_HISTOGRAM_BINS); bin++)
+        metered += AF1(SpdLoadHistogramLds(bin));
+    AF1 low = metered * params.z;
+    AF1 high = metered * params.w;
+    AF1 below = AF1_(0.0);
+    AF1 sum = AF1_(0.0);
+    AF1 weight = AF1_(0.0);
+    for (AU1 bin = 1u; bin < AU1(SPD_HISTOGRAM_BINS); bin++)
+    {
+        AF1 count = AF1(SpdLoadHistogramLds(bin));
+        // part of the bin between the percentiles
+        AF1 inside = min(below + count, high) - max(below, low);
+        if (inside > AF1_(0.0))
+        {
+            AF1 center = (AF1(bin) - AF1_(0.5)) / AF1_(SPD_HISTOGRAM_BINS - 1);
+            sum += inside * (params.x + center * (params.y - params.x));
+            weight += inside;
+        }
+        below += count;
+    }
+    return exp2(weight > AF1_(0.0) ? sum / weight : params.x);
+}
 
-    tex = ASU2(x * 4 + 0, y * 4 + 2);
-    pix = ASU2(x * 2 + 0, y * 2 + 1);
-    AF4 v2 = SpdReduceLoad4(tex, slice);
-    SpdStore(pix, v2, 6, slice);
+void SpdLuminanceHistogram(
+    AU2 workGroupID,
+    AU1 localInvocationIndex,
+    AU2 sourceSize,
+    AU1 slice
+) {
+    AF4 params = SpdHistogramParams();
+    if (localInvocationIndex < AU1(SPD_HISTOGRAM_BINS))
+        SpdStoreHistogramLds(localInvocationIndex, 0u);
+    SpdWorkgroupShuffleBarrier();
 
-    tex = ASU2(x * 4 + 2, y * 4 + 2);
-    pix = ASU2(x * 2 + 1, y * 2 + 1);
-    AF4 v3 = SpdReduceLoad4(tex, slice);
-    SpdStore(pix, v3, 6, slice);
+    // a row of the tile per 64 or 128 threads, coalesced
+    AU2 numWorkGroupsXY = (sourceSize + AU2(SPD_TILE_SIZE - 1, SPD_TILE_SIZE - 1)) / AU2(SPD_TILE_SIZE, SPD_TILE_SIZE);
+    AU2 origin = workGroupID * AU2(SPD_TILE_SIZE, SPD_TILE_SIZE);
+    for (AU1 i = localInvocationIndex; i < AU1(SPD_TILE_SIZE * SPD_TILE_SIZE); i += 256u)
+    {
+        AU2 p = origin + AU2(i % AU1(SPD_TILE_SIZE), i / AU1(SPD_TILE_SIZE));
+        if (p.x < sourceSize.x && p.y < sourceSize.y)
+            SpdAddHistogramLds(SpdHistogramBin(SpdHistogramLuminance(SpdLoadSourceImage(ASU2(p), slice)), params), 1u);
+    }
+    SpdWorkgroupShuffleBarrier();
 
-    if (mips <= 7) return;
-    // no barrier needed, working on values only from the same thread
+    AU1 numWorkGroups = numWorkGroupsXY.x * numWorkGroupsXY.y;
+    AU1 sliceBase = slice * numWorkGroups * AU1(SPD_HISTOGRAM_BINS);
+    AU1 tile = workGroupID.y * numWorkGroupsXY.x + workGroupID.x;
+    if (localInvocationIndex < AU1(SPD_HISTOGRAM_BINS))
+        SpdStoreTileHistogram(sliceBase + tile * AU1(SPD_HISTOGRAM_BINS) + localInvocationIndex,
+            SpdLoadHistogramLds(localInvocationIndex));
+    SpdHistogramMemoryBarrier();
+    if (SpdExitWorkgroup(numWorkGroups, localInvocationIndex, slice)) return;
 
-    AF4 v = SpdReduce4(v0, v1, v2, v3);
-    SpdStore(ASU2(x, y), v, 7, slice);
-    SpdStoreIntermediate(x, y, v);
+    SpdResetAtomicCounter(slice);
+    // one bin per thread, summed over all tiles of the slice
+    if (localInvocationIndex < AU1(SPD_HISTOGRAM_BINS))
+    {
+        AU1 count = 0u;
+        for (AU1 t = 0u; t < numWorkGroups; t++)
+            count += SpdLoadTileHistogram(sliceBase + t * AU1(SPD_HISTOGRAM_BINS) + localInvocationIndex);
+        SpdStoreHistogramLds(localInvocationIndex, count);
+        SpdStoreHistogram(localInvocationIndex, count, slice);
+    }
+    SpdWorkgroupShuffleBarrier();
+    if (localInvocationIndex == 0u)
+        SpdStoreExposure(SpdHistogramAverage(params), slice);
 }
+#endif // #ifdef SPD_HISTOGRAM
 
-void SpdDownsampleNextFour(AU1 x, AU1 y, AU2 workGroupID, AU1 localInvocationIndex, AU1 baseMip, AU1 mips, AU1 slice)
-{
-    if (mips <= baseMip) return;
-    SpdWorkgroupShuffleBarrier();
-    SpdDownsampleMip_2(x, y, workGroupID, localInvocationIndex, baseMip, slice);
+//==============================================================================================================================
+//                                                   SUMMED AREA TABLE
+//==============================================================================================================================
+// #define SPD_SUMMED_AREA_TABLE and call SpdSummedAreaTable() for the summed area table of the source in one dispatch
+// instead of a horizontal and a vertical prefix sum pass, e.g. for box filtered glossy reflections.
+// Each workgroup takes the next 64x64 tile from the atomic counter, row major, and computes the prefix sums local to the
+// tile in LDS, one channel at a time. It then looks back to the tile to its left and the one above, waits until both
+// published their results and adds their carries, S = L + (top + (left - corner)): top is the last row of the tile above,
+// left the last column of the tile to the left and corner the texel they share. Then it publishes its own results with a
+// flag per tile. As tiles are handed out in order, the tiles a workgroup waits for are running already. The last tile
+// depends on all others, it resets the counter and the flags.
+// Loads past the edge of the source have to return 0. Only the non-packed version, single texel source loads and 64x64
+// tiles, sums are in float: subtract the average first for large images that need small differences.
+// The CPU engine has SpdCpuSummedAreaTable() for the same, and SpdCpuBenchmarkSummedAreaTable() against two passes.
+//
+// // the table, the workgroups read the results of the neighbouring tiles, so it has to be coherent like the mips
+// GLSL: layout(set=0,binding=4,rgba32f) uniform coherent image2D imgSat;
+// HLSL: [[vk::binding(4)]] globallycoherent RWTexture2D<float4> imgSat :register(u4);
+// GLSL: void SpdStoreSat(ASU2 p, AF4 value, AU1 slice){imageStore(imgSat, p, value);}
+// GLSL: AF4 SpdLoadSat(ASU2 p, AU1 slice){return imageLoad(imgSat, p);}
+// HLSL: void SpdStoreSat(ASU2 p, AF4 value, AU1 slice){imgSat[p] = value;}
+// HLSL: AF4 SpdLoadSat(ASU2 p, AU1 slice){return imgSat[p];}
+// // one flag per tile and slice next to the atomic counters, MUST be initialized to 0 as well, SPD resets them after
+// // each run, the waiting workgroups spin on them, so they have to be coherent (GLSL: and volatile)
+// GLSL: void SpdStoreSatFlag(AU1 i, AU1 value){spdGlobalAtomic.satFlags[i] = value;}
+// GLSL: AU1 SpdLoadSatFlag(AU1 i){return spdGlobalAtomic.satFlags[i];}
+// HLSL: void SpdStoreSatFlag(AU1 i, AU1 value){spdGlobalAtomic[0].satFlags[i] = value;}
+// HLSL: AU1 SpdLoadSatFlag(AU1 i){return spdGlobalAtomic[0].satFlags[i];}
+// // one channel of the tile in LDS
+// shared AF1 spdSat[64][64]; // HLSL: groupshared
+// void SpdStoreSatLds(AU1 x, AU1 y, AF1 value){spdSat[x][y] = value;}
+// AF1 SpdLoadSatLds(AU1 x, AU1 y){return spdSat[x][y];}
+// // Dispatch numWorkGroups workgroups per slice like SpdDownsample(), the workgroup ID is not read:
+// SpdSummedAreaTable(AU1(LocalThreadIndex), AU2(sourceSize), AU1(WorkGroupId.z));
+#ifdef SPD_SUMMED_AREA_TABLE
+#if SPD_TILE_SIZE != 64
+#error SPD_SUMMED_AREA_TABLE only supports SPD_TILE_SIZE 64
+#endif
+#if defined(SPD_UINT) || defined(SPD_LINEAR_SAMPLER) || defined(SPD_PACKED_ONLY)
+#error SPD_SUMMED_AREA_TABLE excludes SPD_UINT, SPD_LINEAR_SAMPLER and SPD_PACKED_ONLY
+#endif
 
-    if (mips <= baseMip + 1) return;
-    SpdWorkgroupShuffleBarrier();
-    SpdDownsampleMip_3(x, y, workGroupID, localInvocationIndex, baseMip + 1, slice);
+#ifdef SPD_ONE_CHANNEL
+#define SPD_SAT_CHANNELS 1u
+#define SPD_SAT_ZERO AF1_(0.0)
+#else
+#define SPD_SAT_CHANNELS 4u
+#define SPD_SAT_ZERO AF4_(0.0)
+#endif
 
-    if (mips <= baseMip + 2) return;
-    SpdWorkgroupShuffleBarrier();
-    SpdDownsampleMip_4(x, y, workGroupID, localInvocationIndex, baseMip + 2, slice);
+// Makes the results of the workgroup visible to the other workgroups
+void SpdSatMemoryBarrier()
+{
+#ifdef A_GLSL
+    memoryBarrier();
+    barrier();
+#endif
+#ifdef A_HLSL
+    DeviceMemoryBarrierWithGroupSync();
+#endif
+}
 
-    if (mips <= baseMip + 3) return;
-    SpdWorkgroupShuffleBarrier();
-    SpdDownsampleMip_5(workGroupID, localInvocationIndex, baseMip + 3, slice);
+AF1 SpdSatChannel(SpdValue v, AU1 c)
+{
+#ifdef SPD_ONE_CHANNEL
+    return v;
+#else
+    return v[c];
+#endif
 }
 
-void SpdDownsample(
-    AU2 workGroupID,
+SpdValue SpdSatSetChannel(SpdValue v, AU1 c, AF1 value)
+{
+#ifdef SPD_ONE_CHANNEL
+    return value;
+#else
+    v[c] = value;
+    return v;
+#endif
+}
+
+void SpdSummedAreaTable(
     AU1 localInvocationIndex,
-    AU1 mips,
-    AU1 numWorkGroups,
+    AU2 sourceSize,
     AU1 slice
 ) {
-    AU2 sub_xy = ARmpRed8x8(localInvocationIndex % 64);
-    AU1 x = sub_xy.x + 8 * ((localInvocationIndex >> 6) % 2);
-    AU1 y = sub_xy.y + 8 * ((localInvocationIndex >> 7));
-    SpdDownsampleMips_0_1(x, y, workGroupID, localInvocationIndex, mips, slice);
+    AU2 numWorkGroupsXY = (sourceSize + AU2(63, 63)) / AU2(64, 64);
+    AU1 numWorkGroups = numWorkGroupsXY.x * numWorkGroupsXY.y;
+    if (localInvocationIndex == 0u)
+        SpdIncreaseAtomicCounter(slice);
+    SpdWorkgroupShuffleBarrier();
+    AU1 tile = SpdGetAtomicCounter();
+    AU2 tileXY = AU2(tile % numWorkGroupsXY.x, tile / numWorkGroupsXY.x);
+    AU2 origin = tileXY * AU2(64, 64);
+
+    // rows: 16 texels of row r from column 16 * s, columns: 16 texels of column x from row 16 * q
+    AU1 r = localInvocationIndex >> 2u;
+    AU1 s = localInvocationIndex & 3u;
+    AU1 x = localInvocationIndex & 63u;
+    AU1 q = localInvocationIndex >> 6u;
+    SpdValue source[16];
+    SpdValue result[16];
+    for (AU1 i = 0u; i < 16u; i++)
+    {
+        source[i] = SpdLoadSourceImage(ASU2(origin + AU2(16u * s + i, r)), slice);
+        result[i] = SPD_SAT_ZERO;
+    }
 
-    SpdDownsampleNextFour(x, y, workGroupID, localInvocationIndex, 2, mips, slice);
+    for (AU1 c = 0u; c < SPD_SAT_CHANNELS; c++)
+    {
+        // prefix sums of the rows: own 16 texels, then the sums of the texels left of them
+        AF1 row[16];
+        AF1 sum = AF1_(0.0);
+        for (AU1 i = 0u; i < 16u; i++)
+        {
+            sum += SpdSatChannel(source[i], c);
+            row[i] = sum;
+        }
+        SpdStoreSatLds(16u * s + 15u, r, sum);
+        SpdWorkgroupShuffleBarrier();
+        AF1 carry = AF1_(0.0);
+        for (AU1 j = 0u; j < s; j++)
+            carry += SpdLoadSatLds(16u * j + 15u, r);
+        SpdWorkgroupShuffleBarrier();
+        for (AU1 i = 0u; i < 16u; i++)
+            SpdStoreSatLds(16u * s + i, r, row[i] + carry);
+        SpdWorkgroupShuffleBarrier();
 
-    if (mips <= 6) return;
+        // prefix sums of the columns, same
+        sum = AF1_(0.0);
+        for (AU1 i = 0u; i < 16u; i++)
+        {
+            sum += SpdLoadSatLds(x, 16u * q + i);
+            row[i] = sum;
+        }
+        SpdWorkgroupShuffleBarrier();
+        SpdStoreSatLds(x, 16u * q + 15u, sum);
+        SpdWorkgroupShuffleBarrier();
+        carry = AF1_(0.0);
+        for (AU1 j = 0u; j < q; j++)
+            carry += SpdLoadSatLds(x, 16u * j + 15u);
+        for (AU1 i = 0u; i < 16u; i++)
+            result[i] = SpdSatSetChannel(result[i], c, row[i] + carry);
+        // the next channel overwrites the LDS
+        SpdWorkgroupShuffleBarrier();
+    }
 
-    if (SpdExitWorkgroup(numWorkGroups, localInvocationIndex, slice)) return;
+    // look back to the tiles to the left and above
+    AU1 flagBase = slice * numWorkGroups;
+    if (localInvocationIndex == 0u)
+    {
+        if (tileXY.x > 0u)
+            while (SpdLoadSatFlag(flagBase + tile - 1u) == 0u) {}
+        if (tileXY.y > 0u)
+            while (SpdLoadSatFlag(flagBase + tile - numWorkGroupsXY.x) == 0u) {}
+    }
+    SpdSatMemoryBarrier();
+    SpdValue zero = SPD_SAT_ZERO;
+    AU2 p = origin + AU2(x, 16u * q);
+    SpdValue top = (tileXY.y > 0u && p.x < sourceSize.x) ? SpdLoadSat(ASU2(p.x, origin.y - 1u), slice) : zero;
+    SpdValue corner = (tileXY.x > 0u && tileXY.y > 0u) ? SpdLoadSat(ASU2(origin - AU2(1, 1)), slice) : zero;
+    for (AU1 i = 0u; i < 16u; i++)
+    {
+        if (p.x < sourceSize.x && p.y + i < sourceSize.y)
+        {
+            SpdValue left = tileXY.x > 0u ? SpdLoadSat(ASU2(origin.x - 1u, p.y + i), slice) : zero;
+            SpdStoreSat(ASU2(p.x, p.y + i), result[i] + (top + (left - corner)), slice);
+        }
+    }
 
-    SpdResetAtomicCounter(slice);
+    // publish, nobody waits for the last tile, it waited for all others
+    SpdSatMemoryBarrier();
+    if (localInvocationIndex == 0u && tile != numWorkGroups - 1u)
+        SpdStoreSatFlag(flagBase + tile, 1u);
+    if (tile == numWorkGroups - 1u)
+    {
+        if (localInvocationIndex == 0u)
+            SpdResetAtomicCounter(slice);
+        for (AU1 i = localInvocationIndex; i < numWorkGroups; i += 256u)
+            SpdStoreSatFlag(flagBase + i, 0u);
+    }
+}
+#endif // #ifdef SPD_SUMMED_AREA_TABLE
 
-    // After mip 6 there is only a single workgroup left that downsamples the remaining up to 64x64 texels.
-    SpdDownsampleMips_6_7(x, y, mips, slice);
+//==============================================================================================================================
+//                                                        UPSAMPLE
+//==============================================================================================================================
+// #define SPD_UPSAMPLE and call SpdUpsample() for the up chain that goes with the mips, as used by bloom and multi resolution
+// SSAO: mip mips - 1 is upsampled and combined with mip mips - 2, the result is upsampled and combined with mip mips - 3
+// and so on down to mip 0, in one dispatch instead of one per mip.
+// Each thread group works on 64x64 texels of one mip. The thread groups take their work from the atomic counter, from the
+// coarsest mip to mip 0, and wait until all thread groups of the next coarser mip are done, which each mip counts in a
+// counter of its own. So the next finer mip starts as soon as the coarser one is finished, and as work is handed out in
+// order, the thread groups a thread group waits for are running already. The last thread group of mip 0 resets the
+// counters.
+// Upsampling is bilinear, each texel reads the 2x2 texels of the coarser mip around its center with the weights 9, 3, 3, 1.
+// Loads are clamped to the edge of the mip, the texels past the edge of a mip are not stored. Only the non-packed version.
+// SpdPlanUpsampleWorkGroups() returns the number of thread groups per slice. The CPU engine has SpdUpsampleCpuReference().
+//
+// // loads of mip from the down chain, and of the result of the coarser mip, mips - 1 is read with both. Both can read the
+// // same texture: the result of a mip replaces the mip in place. Then the up chain needs coherent mips like SpdLoad().
+// GLSL: AF4 SpdLoadUpsampleFine(ASU2 p, AU1 mip, AU1 slice){return imageLoad(imgDst[mip + 1], p);}
+// GLSL: AF4 SpdLoadUpsampleCoarse(ASU2 p, AU1 mip, AU1 slice){return imageLoad(imgDst[mip + 1], p);}
+// HLSL: AF4 SpdLoadUpsampleFine(ASU2 p, AU1 mip, AU1 slice){return imgDst[mip + 1][p];}
+// HLSL: AF4 SpdLoadUpsampleCoarse(ASU2 p, AU1 mip, AU1 slice){return imgDst[mip + 1][p];}
+// // combines the mip with the upsampled coarser one, e.g. additive bloom or a lerp by a blend factor per mip
+// AF4 SpdUpsampleCombine(AF4 fine, AF4 coarse, AU1 mip){return fine + coarse;}
+// void SpdStoreUpsample(ASU2 p, AF4 value, AU1 mip, AU1 slice){imageStore(imgDst[mip + 1], p, value);}
+// // one counter per mip and slice next to the atomic counters, MUST be initialized to 0 as well, SPD resets them after
+// // each run. The increase returns the previous value, the waiting thread groups spin on the load, so it has to be coherent.
+// GLSL: AU1 SpdIncreaseUpsampleCounter(AU1 mip, AU1 slice){return atomicAdd(spdGlobalAtomic.upsample[slice][mip], 1);}
+// GLSL: AU1 SpdLoadUpsampleCounter(AU1 mip, AU1 slice){return spdGlobalAtomic.upsample[slice][mip];}
+// GLSL: void SpdResetUpsampleCounter(AU1 mip, AU1 slice){spdGlobalAtomic.upsample[slice][mip] = 0;}
+// HLSL: AU1 SpdIncreaseUpsampleCounter(AU1 mip, AU1 slice){
+//    AU1 previous; InterlockedAdd(spdGlobalAtomic[0].upsample[slice][mip], 1, previous); return previous;}
+// HLSL: AU1 SpdLoadUpsampleCounter(AU1 mip, AU1 slice){return spdGlobalAtomic[0].upsample[slice][mip];}
+// HLSL: void SpdResetUpsampleCounter(AU1 mip, AU1 slice){spdGlobalAtomic[0].upsample[slice][mip] = 0;}
+// // Dispatch SpdPlanUpsampleWorkGroups(plan) thread groups per slice, the workgroup ID is not read, mips as for
+// // SpdDownsample() and the source size of the down chain:
+// SpdUpsample(AU1(LocalThreadIndex), AU1(mips), AU2(sourceSize), AU1(WorkGroupId.z));
+#ifdef SPD_UPSAMPLE
+#if defined(SPD_UINT) || defined(SPD_PACKED_ONLY)
+#error SPD_UPSAMPLE excludes SPD_UINT and SPD_PACKED_ONLY
+#endif
 
-    SpdDownsampleNextFour(x, y, AU2(0,0), localInvocationIndex, 8, mips, slice);
+// Makes the stores of the thread group visible to the other thread groups
+void SpdUpsampleMemoryBarrier()
+{
+#ifdef A_GLSL
+    memoryBarrier();
+    barrier();
+#endif
+#ifdef A_HLSL
+    DeviceMemoryBarrierWithGroupSync();
+#endif
 }
 
-void SpdDownsample(
-    AU2 workGroupID,
+AU2 SpdUpsampleMipSize(AU2 sourceSize, AU1 mip)
+{
+    return max(sourceSize >> (mip + 1u), AU2(1, 1));
+}
+
+AU1 SpdUpsampleTiles(AU2 sourceSize, AU1 mip)
+{
+    AU2 tiles = (SpdUpsampleMipSize(sourceSize, mip) + AU2(SPD_UPSAMPLE_TILE_SIZE - 1, SPD_UPSAMPLE_TILE_SIZE - 1)) /
+        AU2(SPD_UPSAMPLE_TILE_SIZE, SPD_UPSAMPLE_TILE_SIZE);
+    return tiles.x * tiles.y;
+}
+
+// Bilinear sample of the coarser mip for texel p of mip
+SpdValue SpdUpsampleCoarse(AU2 p, AU1 mip, AU2 coarseSize, AU1 slice)
+{
+    // the texel before the center and its weight, 1/4 for even and 3/4 for odd coordinates
+    ASU2 a = ASU2((p + AU2(1, 1)) >> 1u) - ASU2(1, 1);
+    AF2 w = AF2((p & AU2(1, 1)) * 2u + AU2(1, 1)) * AF1_(0.25);
+    ASU2 b = min(a + ASU2(1, 1), ASU2(coarseSize) - ASU2(1, 1));
+    a = max(a, ASU2(0, 0));
+    SpdValue top = SpdLoadUpsampleCoarse(ASU2(a.x, a.y), mip + 1u, slice) * w.x +
+        SpdLoadUpsampleCoarse(ASU2(b.x, a.y), mip + 1u, slice) * (AF1_(1.0) - w.x);
+    SpdValue bottom = SpdLoadUpsampleCoarse(ASU2(a.x, b.y), mip + 1u, slice) * w.x +
+        SpdLoadUpsampleCoarse(ASU2(b.x, b.y), mip + 1u, slice) * (AF1_(1.0) - w.x);
+    return top * w.y + bottom * (AF1_(1.0) - w.y);
+}
+
+void SpdUpsample(
     AU1 localInvocationIndex,
     AU1 mips,
-    AU1 numWorkGroups,
-    AU1 slice,
-    AU2 workGroupOffset
+    AU2 sourceSize,
+    AU1 slice
 ) {
-    SpdDownsample(workGroupID + workGroupOffset, localInvocationIndex, mips, numWorkGroups, slice);
+    if (mips < 2u) return;
+    if (localInvocationIndex == 0u)
+        SpdIncreaseAtomicCounter(slice);
+    SpdWorkgroupShuffleBarrier();
+
+    // mip and tile of the work, coarsest mip first
+    AU1 tile = SpdGetAtomicCounter();
+    AU1 mip = mips - 2u;
+    for (; mip > 0u && tile >= SpdUpsampleTiles(sourceSize, mip); mip--)
+        tile -= SpdUpsampleTiles(sourceSize, mip);
+
+    // wait for the coarser mip, unless it is the one the chain starts with
+    if (localInvocationIndex == 0u && mip + 2u < mips)
+        while (SpdLoadUpsampleCounter(mip + 1u, slice) < SpdUpsampleTiles(sourceSize, mip + 1u)) {}
+    SpdUpsampleMemoryBarrier();
+
+    AU2 size = SpdUpsampleMipSize(sourceSize, mip);
+    AU2 coarseSize = SpdUpsampleMipSize(sourceSize, mip + 1u);
+    AU1 tilesX = (size.x + AU1(SPD_UPSAMPLE_TILE_SIZE - 1)) / AU1(SPD_UPSAMPLE_TILE_SIZE);
+    AU2 origin = AU2(tile % tilesX, tile / tilesX) * AU2(SPD_UPSAMPLE_TILE_SIZE, SPD_UPSAMPLE_TILE_SIZE);
+    for (AU1 i = localInvocationIndex; i < AU1(SPD_UPSAMPLE_TILE_SIZE * SPD_UPSAMPLE_TILE_SIZE); i += 256u)
+    {
+        AU2 p = origin + AU2(i % AU1(SPD_UPSAMPLE_TILE_SIZE), i / AU1(SPD_UPSAMPLE_TILE_SIZE));
+        if (p.x < size.x && p.y < size.y)
+        {
+            SpdValue fine = SpdLoadUpsampleFine(ASU2(p), mip, slice);
+            SpdStoreUpsample(ASU2(p), SpdUpsampleCombine(fine, SpdUpsampleCoarse(p, mip, coarseSize, slice), mip), mip,
+                slice);
+        }
+    }
+
+    // count in, the last thread group of mip 0 is the last one of the chain
+    SpdUpsampleMemoryBarrier();
+    if (localInvocationIndex == 0u &&
+        SpdIncreaseUpsampleCounter(mip, slice) == SpdUpsampleTiles(sourceSize, mip) - 1u && mip == 0u)
+    {
+        for (AU1 m = 0u; m + 1u < mips; m++)
+            SpdResetUpsampleCounter(m, slice);
+        SpdResetAtomicCounter(slice);
+    }
 }
+#endif // #ifdef SPD_UPSAMPLE
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -852,12 +3017,147 @@ void SpdDownsample(
 //                                                       PACKED VERSION
 //==============================================================================================================================
 
-#ifdef A_HALF
+#if defined(A_HALF) && !defined(SPD_ONE_CHANNEL) && !defined(SPD_UINT) && !defined(SPD_DEPTH_AWARE) && !defined(SPD_MULTI_TARGET)
 
 #ifdef A_GLSL
 #extension GL_EXT_shader_subgroup_extended_types_float16:require
 #endif
 
+// sRGB conversions of the loads and stores, see SRGB above
+AH1 SpdSrgbToLinearH1(AH1 c)
+{
+    return c <= AH1_(0.04045) ? c * AH1_(1.0 / 12.92) : pow((c + AH1_(0.055)) * AH1_(1.0 / 1.055), AH1_(2.4));
+}
+
+AH1 SpdLinearToSrgbH1(AH1 c)
+{
+    return c <= AH1_(0.0031308) ? c * AH1_(12.92) : AH1_(1.055) * pow(c, AH1_(1.0 / 2.4)) - AH1_(0.055);
+}
+
+// Depth to moments, see MOMENTS above
+#ifdef SPD_MOMENTS
+AH4 SpdDepthToMomentsH(AH1 d)
+{
+#ifdef SPD_MOMENTS_EVSM
+    d = d * AH1_(2.0) - AH1_(1.0);
+    AH1 positive = exp(AH1_(min(SPD_EVSM_POSITIVE_EXPONENT, 5.54)) * d);
+    AH1 negative = -exp(-AH1_(min(SPD_EVSM_NEGATIVE_EXPONENT, 5.54)) * d);
+    return AH4(positive, positive * positive, negative, negative * negative);
+#else
+    return AH4(d, d * d, AH1_(0.0), AH1_(0.0));
+#endif
+}
+#endif // #ifdef SPD_MOMENTS
+
+// Normal map decoding and encoding, see NORMAL MAP above
+#ifdef SPD_NORMAL_MAP
+AH4 SpdDecodeNormalH(AH2 encoded, AH1 variance)
+{
+    AH2 xy = encoded * AH1_(2.0) - AH1_(1.0);
+    AH1 z = sqrt(ASatH1(AH1_(1.0) - dot(xy, xy)));
+    return AH4(AH3(xy, z) * ARcpH1(AH1_(1.0) + variance), AH1_(0.0));
+}
+
+AH4 SpdEncodeNormalH(AH3 n)
+{
+    // smallest normal fp16 value, so the variance stays finite
+    AH1 len = max(length(n), AH1_(1.0 / 16384.0));
+    return AH4(n * (AH1_(0.5) / len) + AH1_(0.5), (AH1_(1.0) - len) / len);
+}
+#endif // #ifdef SPD_NORMAL_MAP
+
+AH4 SpdLoadSourceImageSrgbH(ASU2 p, AU1 slice)
+{
+    AH4 v = SpdLoadSourceImageH(p, slice);
+#if defined(SPD_SRGB) && !defined(SPD_LINEAR_SAMPLER)
+    v = AH4(SpdSrgbToLinearH1(v.x), SpdSrgbToLinearH1(v.y), SpdSrgbToLinearH1(v.z), v.w);
+#endif
+#ifdef SPD_NORMAL_MAP
+    v = SpdDecodeNormalH(v.xy, AH1_(0.0));
+#endif
+#ifdef SPD_MOMENTS
+    v = SpdDepthToMomentsH(v.x);
+#endif
+    return v;
+}
+
+AH4 SpdLoadSrgbH(ASU2 p, AU1 slice)
+{
+    AH4 v = SpdLoadH(p, slice);
+#ifdef SPD_SRGB
+    v = AH4(SpdSrgbToLinearH1(v.x), SpdSrgbToLinearH1(v.y), SpdSrgbToLinearH1(v.z), v.w);
+#endif
+#ifdef SPD_NORMAL_MAP
+    v = SpdDecodeNormalH(v.xy, SpdLoadRoughnessH(p, slice));
+#endif
+    return v;
+}
+
+void SpdStoreSrgbH(ASU2 p, AH4 value, AU1 mip, AU1 slice)
+{
+#ifdef SPD_SRGB
+    value = AH4(SpdLinearToSrgbH1(value.x), SpdLinearToSrgbH1(value.y), SpdLinearToSrgbH1(value.z), value.w);
+#endif
+#ifdef SPD_NORMAL_MAP
+    value = SpdEncodeNormalH(value.xyz);
+    SpdStoreRoughnessH(p, value.w, mip, slice);
+    value.w = AH1_(1.0);
+#endif
+    SpdStoreH(p, value, mip, slice);
+}
+
+// Karis average, see KARIS AVERAGE above
+// luma is clamped so that the weight stays a normal fp16 value (>= 2^-14) and can't flush to zero,
+// the weighted values are then bounded as well, unlike the plain sum of four fp16 values which overflows above 16k
+AH1 SpdKarisWeightH1(AH4 v)
+{
+    AH1 luma = min(max(dot(v.xyz, AH3(0.2126, 0.7152, 0.0722)), AH1_(0.0)), AH1_(16383.0));
+    return ARcpH1(AH1_(1.0) + luma);
+}
+
+AH4 SpdReduce4KarisH(AH4 v0, AH4 v1, AH4 v2, AH4 v3)
+{
+#ifdef SPD_KARIS_AVERAGE
+    AH1 w0 = SpdKarisWeightH1(v0);
+    AH1 w1 = SpdKarisWeightH1(v1);
+    AH1 w2 = SpdKarisWeightH1(v2);
+    AH1 w3 = SpdKarisWeightH1(v3);
+    return (v0 * w0 + v1 * w1 + v2 * w2 + v3 * w3) * ARcpH1(w0 + w1 + w2 + w3);
+#else
+    return SpdReduce4H(v0, v1, v2, v3);
+#endif
+}
+
+// Alpha coverage, see ALPHA COVERAGE above
+void SpdAlphaCoverageCountH(AH4 v)
+{
+    SpdAlphaCoverageCount(AF4(v));
+}
+
+void SpdStoreAlphaCoverageH(ASU2 p, AH4 value, AU1 mip, AU1 slice)
+{
+#ifdef SPD_ALPHA_COVERAGE
+    SpdStoreAlphaCoverage(p, AF4(value), mip, slice);
+#else
+    SpdStoreSrgbH(p, value, mip, slice);
+#endif
+}
+
+void SpdAlphaCoverageFlushH(AU1 mip, AU1 localInvocationIndex, AU1 slice)
+{
+#ifdef SPD_ALPHA_COVERAGE
+    AF1 scale = AF1_(1.0);
+    if (mip < SPD_COVERAGE_SLICE_MIP || mip > 5u)
+        scale = SpdAlphaCoverageScale(mip, localInvocationIndex, slice, false);
+    AU1 first = SpdAlphaCoverageIndex(ASU2(0, 0), mip);
+    for (AU1 i = localInvocationIndex; i < SpdAlphaCoverageValues(mip, false); i += 256u)
+    {
+        AF4 v = SpdLoadCoverageValueLds(first + i);
+        SpdStoreSrgbH(SpdAlphaCoveragePosition(i, mip, false), AH4(v.xyz, SpdAlphaCoverageApply(v.w, scale)), mip, slice);
+    }
+#endif
+}
+
 AH4 SpdReduceQuadH(AH4 v)
 {
     #if defined(A_GLSL) && !defined(SPD_NO_WAVE_OPERATIONS)
@@ -865,7 +3165,7 @@ AH4 SpdReduceQuadH(AH4 v)
     AH4 v1 = subgroupQuadSwapHorizontal(v);
     AH4 v2 = subgroupQuadSwapVertical(v);
     AH4 v3 = subgroupQuadSwapDiagonal(v);
-    return SpdReduce4H(v0, v1, v2, v3);
+    return SpdReduce4KarisH(v0, v1, v2, v3);
     #elif defined(A_HLSL) && !defined(SPD_NO_WAVE_OPERATIONS)
     // requires SM6.0
     AU1 quad = WaveGetLaneIndex() &  (~0x3);
@@ -873,7 +3173,7 @@ AH4 SpdReduceQuadH(AH4 v)
     AH4 v1 = WaveReadLaneAt(v, quad | 1);
     AH4 v2 = WaveReadLaneAt(v, quad | 2);
     AH4 v3 = WaveReadLaneAt(v, quad | 3);
-    return SpdReduce4H(v0, v1, v2, v3);
+    return SpdReduce4KarisH(v0, v1, v2, v3);
     /*
     // if SM6.0 is not available, you can use the AMD shader intrinsics
     // the AMD shader intrinsics are available in AMD GPU Services (AGS) library:
@@ -895,7 +3195,7 @@ AH4 SpdReduceQuadH(AH4 v)
     v3.y = AmdExtD3DShaderIntrinsics_SwizzleF(v.y, AmdExtD3DShaderIntrinsicsSwizzle_ReverseX4);
     v3.z = AmdExtD3DShaderIntrinsics_SwizzleF(v.z, AmdExtD3DShaderIntrinsicsSwizzle_ReverseX4);
     v3.w = AmdExtD3DShaderIntrinsics_SwizzleF(v.w, AmdExtD3DShaderIntrinsicsSwizzle_ReverseX4);
-    return SpdReduce4H(v0, v1, v2, v3);
+    return SpdReduce4KarisH(v0, v1, v2, v3);
     */
     #endif
     return AH4(0.0, 0.0, 0.0, 0.0);
@@ -908,76 +3208,108 @@ AH4 SpdReduceIntermediateH(AU2 i0, AU2 i1, AU2 i2, AU2 i3)
     AH4 v1 = SpdLoadIntermediateH(i1.x, i1.y);
     AH4 v2 = SpdLoadIntermediateH(i2.x, i2.y);
     AH4 v3 = SpdLoadIntermediateH(i3.x, i3.y);
-    return SpdReduce4H(v0, v1, v2, v3);
+    return SpdReduce4KarisH(v0, v1, v2, v3);
 }
 
 AH4 SpdReduceLoad4H(AU2 i0, AU2 i1, AU2 i2, AU2 i3, AU1 slice)
 {
-    AH4 v0 = SpdLoadH(ASU2(i0), slice);
-    AH4 v1 = SpdLoadH(ASU2(i1), slice);
-    AH4 v2 = SpdLoadH(ASU2(i2), slice);
-    AH4 v3 = SpdLoadH(ASU2(i3), slice);
-    return SpdReduce4H(v0, v1, v2, v3);
+    AH4 v0 = SpdLoadSrgbH(ASU2(i0), slice);
+    AH4 v1 = SpdLoadSrgbH(ASU2(i1), slice);
+    AH4 v2 = SpdLoadSrgbH(ASU2(i2), slice);
+    AH4 v3 = SpdLoadSrgbH(ASU2(i3), slice);
+    return SpdReduce4KarisH(v0, v1, v2, v3);
 }
 
 AH4 SpdReduceLoad4H(AU2 base, AU1 slice)
 {
     return SpdReduceLoad4H(
         AU2(base + AU2(0, 0)),
-        AU2(base + AU2(0, 1)), 
-        AU2(base + AU2(1, 0)), 
+        AU2(base + AU2(1, 0)),
+        AU2(base + AU2(0, 1)),
         AU2(base + AU2(1, 1)),
         slice);
 }
 
 AH4 SpdReduceLoadSourceImage4H(AU2 i0, AU2 i1, AU2 i2, AU2 i3, AU1 slice)
 {
-    AH4 v0 = SpdLoadSourceImageH(ASU2(i0), slice);
-    AH4 v1 = SpdLoadSourceImageH(ASU2(i1), slice);
-    AH4 v2 = SpdLoadSourceImageH(ASU2(i2), slice);
-    AH4 v3 = SpdLoadSourceImageH(ASU2(i3), slice);
-    return SpdReduce4H(v0, v1, v2, v3);
+    AH4 v0 = SpdLoadSourceImageSrgbH(ASU2(i0), slice);
+    AH4 v1 = SpdLoadSourceImageSrgbH(ASU2(i1), slice);
+    AH4 v2 = SpdLoadSourceImageSrgbH(ASU2(i2), slice);
+    AH4 v3 = SpdLoadSourceImageSrgbH(ASU2(i3), slice);
+    SpdAlphaCoverageCountH(v0);
+    SpdAlphaCoverageCountH(v1);
+    SpdAlphaCoverageCountH(v2);
+    SpdAlphaCoverageCountH(v3);
+    return SpdReduce4KarisH(v0, v1, v2, v3);
 }
 
 AH4 SpdReduceLoadSourceImageH(AU2 base, AU1 slice)
 {
 #ifdef SPD_LINEAR_SAMPLER
-    return SpdLoadSourceImageH(ASU2(base), slice);
+    AH4 v = SpdLoadSourceImageSrgbH(ASU2(base), slice);
+    SpdAlphaCoverageCountH(v);
+    return v;
 #else
     return SpdReduceLoadSourceImage4H(
         AU2(base + AU2(0, 0)),
-        AU2(base + AU2(0, 1)), 
-        AU2(base + AU2(1, 0)), 
+        AU2(base + AU2(1, 0)),
+        AU2(base + AU2(0, 1)),
         AU2(base + AU2(1, 1)),
         slice);
 #endif
 }
 
+AH4 SpdReduceLoadSourceImageTileH(AU2 base, AU1 slice)
+{
+#if SPD_TILE_SIZE == 128
+    AH4 v0 = SpdReduceLoadSourceImageH(AU2(base + AU2(0, 0)) * 2, slice);
+    AH4 v1 = SpdReduceLoadSourceImageH(AU2(base + AU2(1, 0)) * 2, slice);
+    AH4 v2 = SpdReduceLoadSourceImageH(AU2(base + AU2(0, 1)) * 2, slice);
+    AH4 v3 = SpdReduceLoadSourceImageH(AU2(base + AU2(1, 1)) * 2, slice);
+    SpdStoreAlphaCoverageH(ASU2(base + AU2(0, 0)), v0, 0, slice);
+    SpdStoreAlphaCoverageH(ASU2(base + AU2(1, 0)), v1, 0, slice);
+    SpdStoreAlphaCoverageH(ASU2(base + AU2(0, 1)), v2, 0, slice);
+    SpdStoreAlphaCoverageH(ASU2(base + AU2(1, 1)), v3, 0, slice);
+    return SpdReduce4KarisH(v0, v1, v2, v3);
+#else
+    return SpdReduceLoadSourceImageH(base, slice);
+#endif
+}
+
+void SpdStoreTileH(ASU2 pix, AH4 value, AU1 mips, AU1 slice)
+{
+#if SPD_TILE_SIZE == 128
+    if (mips <= 1)
+        return;
+#endif
+    SpdStoreAlphaCoverageH(pix, value, SPD_TILE_MIP_OFFSET, slice);
+}
+
 void SpdDownsampleMips_0_1_IntrinsicsH(AU1 x, AU1 y, AU2 workGroupID, AU1 localInvocationIndex, AU1 mips, AU1 slice)
 {
     AH4 v[4];
 
     ASU2 tex = ASU2(workGroupID.xy * 64) + ASU2(x * 2, y * 2);
     ASU2 pix = ASU2(workGroupID.xy * 32) + ASU2(x, y);
-    v[0] = SpdReduceLoadSourceImageH(tex, slice);
-    SpdStoreH(pix, v[0], 0, slice);
+    v[0] = SpdReduceLoadSourceImageTileH(tex, slice);
+    SpdStoreTileH(pix, v[0], mips, slice);
 
     tex = ASU2(workGroupID.xy * 64) + ASU2(x * 2 + 32, y * 2);
     pix = ASU2(workGroupID.xy * 32) + ASU2(x + 16, y);
-    v[1] = SpdReduceLoadSourceImageH(tex, slice);
-    SpdStoreH(pix, v[1], 0, slice);
+    v[1] = SpdReduceLoadSourceImageTileH(tex, slice);
+    SpdStoreTileH(pix, v[1], mips, slice);
 
     tex = ASU2(workGroupID.xy * 64) + ASU2(x * 2, y * 2 + 32);
     pix = ASU2(workGroupID.xy * 32) + ASU2(x, y + 16);
-    v[2] = SpdReduceLoadSourceImageH(tex, slice);
-    SpdStoreH(pix, v[2], 0, slice);
+    v[2] = SpdReduceLoadSourceImageTileH(tex, slice);
+    SpdStoreTileH(pix, v[2], mips, slice);
 
     tex = ASU2(workGroupID.xy * 64) + ASU2(x * 2 + 32, y * 2 + 32);
     pix = ASU2(workGroupID.xy * 32) + ASU2(x + 16, y + 16);
-    v[3] = SpdReduceLoadSourceImageH(tex, slice);
-    SpdStoreH(pix, v[3], 0, slice);
+    v[3] = SpdReduceLoadSourceImageTileH(tex, slice);
+    SpdStoreTileH(pix, v[3], mips, slice);
 
-    if (mips <= 1)
+    if (mips <= 1 + SPD_TILE_MIP_OFFSET)
         return;
 
     v[0] = SpdReduceQuadH(v[0]);
@@ -987,16 +3319,16 @@ void SpdDownsampleMips_0_1_IntrinsicsH(AU1 x, AU1 y, AU2 workGroupID, AU1 localI
 
     if ((localInvocationIndex % 4) == 0)
     {
-        SpdStoreH(ASU2(workGroupID.xy * 16) + ASU2(x/2, y/2), v[0], 1, slice);
+        SpdStoreAlphaCoverageH(ASU2(workGroupID.xy * 16) + ASU2(x/2, y/2), v[0], 1 + SPD_TILE_MIP_OFFSET, slice);
         SpdStoreIntermediateH(x/2, y/2, v[0]);
 
-        SpdStoreH(ASU2(workGroupID.xy * 16) + ASU2(x/2 + 8, y/2), v[1], 1, slice);
+        SpdStoreAlphaCoverageH(ASU2(workGroupID.xy * 16) + ASU2(x/2 + 8, y/2), v[1], 1 + SPD_TILE_MIP_OFFSET, slice);
         SpdStoreIntermediateH(x/2 + 8, y/2, v[1]);
 
-        SpdStoreH(ASU2(workGroupID.xy * 16) + ASU2(x/2, y/2 + 8), v[2], 1, slice);
+        SpdStoreAlphaCoverageH(ASU2(workGroupID.xy * 16) + ASU2(x/2, y/2 + 8), v[2], 1 + SPD_TILE_MIP_OFFSET, slice);
         SpdStoreIntermediateH(x/2, y/2 + 8, v[2]);
 
-        SpdStoreH(ASU2(workGroupID.xy * 16) + ASU2(x/2 + 8, y/2 + 8), v[3], 1, slice);
+        SpdStoreAlphaCoverageH(ASU2(workGroupID.xy * 16) + ASU2(x/2 + 8, y/2 + 8), v[3], 1 + SPD_TILE_MIP_OFFSET, slice);
         SpdStoreIntermediateH(x/2 + 8, y/2 + 8, v[3]);
     }
 }
@@ -1007,25 +3339,25 @@ void SpdDownsampleMips_0_1_LDSH(AU1 x, AU1 y, AU2 workGroupID, AU1 localInvocati
 
     ASU2 tex = ASU2(workGroupID.xy * 64) + ASU2(x * 2, y * 2);
     ASU2 pix = ASU2(workGroupID.xy * 32) + ASU2(x, y);
-    v[0] = SpdReduceLoadSourceImageH(tex, slice);
-    SpdStoreH(pix, v[0], 0, slice);
+    v[0] = SpdReduceLoadSourceImageTileH(tex, slice);
+    SpdStoreTileH(pix, v[0], mips, slice);
 
     tex = ASU2(workGroupID.xy * 64) + ASU2(x * 2 + 32, y * 2);
     pix = ASU2(workGroupID.xy * 32) + ASU2(x + 16, y);
-    v[1] = SpdReduceLoadSourceImageH(tex, slice);
-    SpdStoreH(pix, v[1], 0, slice);
+    v[1] = SpdReduceLoadSourceImageTileH(tex, slice);
+    SpdStoreTileH(pix, v[1], mips, slice);
 
     tex = ASU2(workGroupID.xy * 64) + ASU2(x * 2, y * 2 + 32);
     pix = ASU2(workGroupID.xy * 32) + ASU2(x, y + 16);
-    v[2] = SpdReduceLoadSourceImageH(tex, slice);
-    SpdStoreH(pix, v[2], 0, slice);
+    v[2] = SpdReduceLoadSourceImageTileH(tex, slice);
+    SpdStoreTileH(pix, v[2], mips, slice);
 
     tex = ASU2(workGroupID.xy * 64) + ASU2(x * 2 + 32, y * 2 + 32);
     pix = ASU2(workGroupID.xy * 32) + ASU2(x + 16, y + 16);
-    v[3] = SpdReduceLoadSourceImageH(tex, slice);
-    SpdStoreH(pix, v[3], 0, slice);
+    v[3] = SpdReduceLoadSourceImageTileH(tex, slice);
+    SpdStoreTileH(pix, v[3], mips, slice);
 
-    if (mips <= 1)
+    if (mips <= 1 + SPD_TILE_MIP_OFFSET)
         return;
 
     for (int i = 0; i < 4; i++)
@@ -1040,7 +3372,7 @@ void SpdDownsampleMips_0_1_LDSH(AU1 x, AU1 y, AU2 workGroupID, AU1 localInvocati
                 AU2(x * 2 + 0, y * 2 + 1),
                 AU2(x * 2 + 1, y * 2 + 1)
             );
-            SpdStoreH(ASU2(workGroupID.xy * 16) + ASU2(x + (i % 2) * 8, y + (i / 2) * 8), v[i], 1, slice);
+            SpdStoreAlphaCoverageH(ASU2(workGroupID.xy * 16) + ASU2(x + (i % 2) * 8, y + (i / 2) * 8), v[i], 1 + SPD_TILE_MIP_OFFSET, slice);
         }
         SpdWorkgroupShuffleBarrier();
     }
@@ -1075,7 +3407,7 @@ void SpdDownsampleMip_2H(AU1 x, AU1 y, AU2 workGroupID, AU1 localInvocationIndex
             AU2(x * 2 + 0, y * 2 + 1),
             AU2(x * 2 + 1, y * 2 + 1)
         );
-        SpdStoreH(ASU2(workGroupID.xy * 8) + ASU2(x, y), v, mip, slice);
+        SpdStoreAlphaCoverageH(ASU2(workGroupID.xy * 8) + ASU2(x, y), v, mip, slice);
         // store to LDS, try to reduce bank conflicts
         // x 0 x 0 x 0 x 0 x 0 x 0 x 0 x 0
         // 0 0 0 0 0 0 0 0 0 0 0 0 0 0 0 0
@@ -1092,7 +3424,7 @@ void SpdDownsampleMip_2H(AU1 x, AU1 y, AU2 workGroupID, AU1 localInvocationIndex
     // quad index 0 stores result
     if (localInvocationIndex % 4 == 0)
     {   
-        SpdStoreH(ASU2(workGroupID.xy * 8) + ASU2(x/2, y/2), v, mip, slice);
+        SpdStoreAlphaCoverageH(ASU2(workGroupID.xy * 8) + ASU2(x/2, y/2), v, mip, slice);
         SpdStoreIntermediateH(x + (y/2) % 2, y, v);
     }
 #endif
@@ -1113,7 +3445,7 @@ void SpdDownsampleMip_3H(AU1 x, AU1 y, AU2 workGroupID, AU1 localInvocationIndex
             AU2(x * 4 + 0 + 1, y * 4 + 2),
             AU2(x * 4 + 2 + 1, y * 4 + 2)
         );
-        SpdStoreH(ASU2(workGroupID.xy * 4) + ASU2(x, y), v, mip, slice);
+        SpdStoreAlphaCoverageH(ASU2(workGroupID.xy * 4) + ASU2(x, y), v, mip, slice);
         // store to LDS
         // x 0 0 0 x 0 0 0 x 0 0 0 x 0 0 0
         // 0 0 0 0 0 0 0 0 0 0 0 0 0 0 0 0
@@ -1135,7 +3467,7 @@ void SpdDownsampleMip_3H(AU1 x, AU1 y, AU2 workGroupID, AU1 localInvocationIndex
         // quad index 0 stores result
         if (localInvocationIndex % 4 == 0)
         {   
-            SpdStoreH(ASU2(workGroupID.xy * 4) + ASU2(x/2, y/2), v, mip, slice);
+            SpdStoreAlphaCoverageH(ASU2(workGroupID.xy * 4) + ASU2(x/2, y/2), v, mip, slice);
             SpdStoreIntermediateH(x * 2 + y/2, y * 2, v);
         }
     }
@@ -1156,7 +3488,7 @@ void SpdDownsampleMip_4H(AU1 x, AU1 y, AU2 workGroupID, AU1 localInvocationIndex
             AU2(x * 8 + 0 + 1 + y * 2, y * 8 + 4),
             AU2(x * 8 + 4 + 1 + y * 2, y * 8 + 4)
         );
-        SpdStoreH(ASU2(workGroupID.xy * 2) + ASU2(x, y), v, mip, slice);
+        SpdStoreAlphaCoverageH(ASU2(workGroupID.xy * 2) + ASU2(x, y), v, mip, slice);
         // store to LDS
         // x x x x 0 ...
         // 0 ...
@@ -1170,7 +3502,7 @@ void SpdDownsampleMip_4H(AU1 x, AU1 y, AU2 workGroupID, AU1 localInvocationIndex
         // quad index 0 stores result
         if (localInvocationIndex % 4 == 0)
         {   
-            SpdStoreH(ASU2(workGroupID.xy * 2) + ASU2(x/2, y/2), v, mip, slice);
+            SpdStoreAlphaCoverageH(ASU2(workGroupID.xy * 2) + ASU2(x/2, y/2), v, mip, slice);
             SpdStoreIntermediateH(x / 2 + y, 0, v);
         }
     }
@@ -1190,7 +3522,7 @@ void SpdDownsampleMip_5H(AU2 workGroupID, AU1 localInvocationIndex, AU1 mip, AU1
             AU2(2, 0),
             AU2(3, 0)
         );
-        SpdStoreH(ASU2(workGroupID.xy), v, mip, slice);
+        SpdStoreAlphaCoverageH(ASU2(workGroupID.xy), v, mip, slice);
     }
 #else
     if (localInvocationIndex < 4)
@@ -1200,7 +3532,7 @@ void SpdDownsampleMip_5H(AU2 workGroupID, AU1 localInvocationIndex, AU1 mip, AU1
         // quad index 0 stores result
         if (localInvocationIndex % 4 == 0)
         {   
-            SpdStoreH(ASU2(workGroupID.xy), v, mip, slice);
+            SpdStoreAlphaCoverageH(ASU2(workGroupID.xy), v, mip, slice);
         }
     }
 #endif
@@ -1211,28 +3543,35 @@ void SpdDownsampleMips_6_7H(AU1 x, AU1 y, AU1 mips, AU1 slice)
     ASU2 tex = ASU2(x * 4 + 0, y * 4 + 0);
     ASU2 pix = ASU2(x * 2 + 0, y * 2 + 0);
     AH4 v0 = SpdReduceLoad4H(tex, slice);
-    SpdStoreH(pix, v0, 6, slice);
+    SpdStoreAlphaCoverageH(pix, v0, 6, slice);
 
     tex = ASU2(x * 4 + 2, y * 4 + 0);
     pix = ASU2(x * 2 + 1, y * 2 + 0);
     AH4 v1 = SpdReduceLoad4H(tex, slice);
-    SpdStoreH(pix, v1, 6, slice);
+    SpdStoreAlphaCoverageH(pix, v1, 6, slice);
 
     tex = ASU2(x * 4 + 0, y * 4 + 2);
     pix = ASU2(x * 2 + 0, y * 2 + 1);
     AH4 v2 = SpdReduceLoad4H(tex, slice);
-    SpdStoreH(pix, v2, 6, slice);
+    SpdStoreAlphaCoverageH(pix, v2, 6, slice);
 
     tex = ASU2(x * 4 + 2, y * 4 + 2);
     pix = ASU2(x * 2 + 1, y * 2 + 1);
     AH4 v3 = SpdReduceLoad4H(tex, slice);
-    SpdStoreH(pix, v3, 6, slice);
+    SpdStoreAlphaCoverageH(pix, v3, 6, slice);
 
     if (mips < 8) return;
     // no barrier needed, working on values only from the same thread
 
-    AH4 v = SpdReduce4H(v0, v1, v2, v3);
-    SpdStoreH(ASU2(x, y), v, 7, slice);
+    AH4 v = SpdReduce4KarisH(v0, v1, v2, v3);
+    SpdStoreAlphaCoverageH(ASU2(x, y), v, 7, slice);
+    SpdStoreIntermediateH(x, y, v);
+}
+
+void SpdDownsampleMip_7H(AU1 x, AU1 y, AU1 mips, AU1 slice)
+{
+    AH4 v = SpdReduceLoad4H(AU2(x * 2, y * 2), slice);
+    SpdStoreAlphaCoverageH(ASU2(x, y), v, 7, slice);
     SpdStoreIntermediateH(x, y, v);
 }
 
@@ -1241,18 +3580,22 @@ void SpdDownsampleNextFourH(AU1 x, AU1 y, AU2 workGroupID, AU1 localInvocationIn
     if (mips <= baseMip) return;
     SpdWorkgroupShuffleBarrier();
     SpdDownsampleMip_2H(x, y, workGroupID, localInvocationIndex, baseMip, slice);
+    SpdAlphaCoverageFlushH(baseMip, localInvocationIndex, slice);
 
     if (mips <= baseMip + 1) return;
     SpdWorkgroupShuffleBarrier();
     SpdDownsampleMip_3H(x, y, workGroupID, localInvocationIndex, baseMip + 1, slice);
+    SpdAlphaCoverageFlushH(baseMip + 1, localInvocationIndex, slice);
 
     if (mips <= baseMip + 2) return;
     SpdWorkgroupShuffleBarrier();
     SpdDownsampleMip_4H(x, y, workGroupID, localInvocationIndex, baseMip + 2, slice);
+    SpdAlphaCoverageFlushH(baseMip + 2, localInvocationIndex, slice);
 
     if (mips <= baseMip + 3) return;
     SpdWorkgroupShuffleBarrier();
     SpdDownsampleMip_5H(workGroupID, localInvocationIndex, baseMip + 3, slice);
+    SpdAlphaCoverageFlushH(baseMip + 3, localInvocationIndex, slice);
 }
 
 void SpdDownsampleH(
@@ -1266,20 +3609,41 @@ void SpdDownsampleH(
     AU1 x = sub_xy.x + 8 * ((localInvocationIndex >> 6) % 2);
     AU1 y = sub_xy.y + 8 * ((localInvocationIndex >> 7));
 
-    SpdDownsampleMips_0_1H(x, y, workGroupID, localInvocationIndex, mips, slice);
+    SpdAlphaCoverageBegin(workGroupID);
+    // unchanged tiles keep their mips from the last dispatch
+    if (!SpdTileUnchanged(workGroupID, localInvocationIndex, slice))
+    {
+        SpdDownsampleMips_0_1H(x, y, workGroupID, localInvocationIndex, mips, slice);
+        SpdAlphaCoverageTile(localInvocationIndex, mips, slice);
+        SpdAlphaCoverageFlushH(SPD_TILE_MIP_OFFSET, localInvocationIndex, slice);
+        if (mips > 1 + SPD_TILE_MIP_OFFSET)
+            SpdAlphaCoverageFlushH(1 + SPD_TILE_MIP_OFFSET, localInvocationIndex, slice);
 
-    SpdDownsampleNextFourH(x, y, workGroupID, localInvocationIndex, 2, mips, slice);
+        SpdDownsampleNextFourH(x, y, workGroupID, localInvocationIndex, 2 + SPD_TILE_MIP_OFFSET, mips, slice);
+    }
 
-    if (mips < 7) return;
+    if (mips <= SpdLastWorkgroupMip()) return;
 
     if (SpdExitWorkgroup(numWorkGroups, localInvocationIndex, slice)) return;
 
     SpdResetAtomicCounter(slice);
+    SpdAlphaCoverageSlice(localInvocationIndex, numWorkGroups, slice);
 
     // After mip 6 there is only a single workgroup left that downsamples the remaining up to 64x64 texels.
-    SpdDownsampleMips_6_7H(x, y, mips, slice);
+    if (mips > 6 + SPD_TILE_MIP_OFFSET)
+    {
+#if SPD_TILE_SIZE == 128
+        SpdDownsampleMip_7H(x, y, mips, slice);
+#else
+        SpdDownsampleMips_6_7H(x, y, mips, slice);
+        SpdAlphaCoverageFlushH(6, localInvocationIndex, slice);
+        if (mips > 7)
+            SpdAlphaCoverageFlushH(7, localInvocationIndex, slice);
+#endif
 
-    SpdDownsampleNextFourH(x, y, AU2(0,0), localInvocationIndex, 8, mips, slice);
+        SpdDownsampleNextFourH(x, y, AU2(0,0), localInvocationIndex, 8, mips, slice);
+    }
+    SpdAlphaCoverageSliceMips(mips, localInvocationIndex, slice);
 }
 
 void SpdDownsampleH(
@@ -1293,5 +3657,5 @@ void SpdDownsampleH(
     SpdDownsampleH(workGroupID + workGroupOffset, localInvocationIndex, mips, numWorkGroups, slice);
 }
 
-#endif // #ifdef A_HALF
+#endif // #if defined(A_HALF) && !defined(SPD_ONE_CHANNEL) && !defined(SPD_UINT) && !defined(SPD_DEPTH_AWARE) && !defined(SPD_MULTI_TARGET)
 #endif // #ifdef A_GPU
\ No newline at end of file
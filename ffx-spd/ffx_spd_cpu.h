@@ -0,0 +1,5705 @@
+//_____________________________________________________________/\_______________________________________________________________
+//==============================================================================================================================
+//
+//                                     [FFX SPD] Single Pass Downsampler 2.0 - CPU Engine
+//
+//==============================================================================================================================
+// LICENSE
+// =======
+// Copyright (c) 2017-2020 Advanced Micro Devices, Inc. All rights reserved.
+// -------
+// Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation
+// files (the "Software"), to deal in the Software without restriction, including without limitation the rights to use, copy,
+// modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the
+// Software is furnished to do so, subject to the following conditions:
+// -------
+// The above copyright notice and this permission notice shall be included in all copies or substantial portions of the
+// Software.
+// -------
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE
+// WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE AUTHORS OR
+// COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+// ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+//
+//------------------------------------------------------------------------------------------------------------------------------
+// ABOUT
+// =====
+// Host side implementation of SPD for tools, asset cookers and other consumers that want the mip chain in system memory.
+// Follows the same scheme as the shader version: the source is split into 64x64 tiles, each tile is reduced down to a single
+// texel (mips 0-5), and once all tiles of a slice are done the remaining mips are computed from mip 5.
+// The tile size is a runtime parameter of the SpdPlan (32, 64 or 128). Row kernels exist for scalar, SSE4.1, AVX2 and
+// AVX-512 and are picked at runtime, tiles can be spread over worker threads. The fastest combination depends on the
+// machine and is picked once at startup with SpdCpuAutotune(), which caches its result in a small text file.
+//
+// All levels and all slices live in one SpdMipChain arena allocation. Level offsets, pitches and extents are described by a
+// SpdMipChainLayout, which can be computed at compile time if the dimensions are known (SpdMipChainLayoutT<>), or at setup.
+// The downsampler only writes into the arena, there is no allocation on the hot path.
+//
+// Level 0 of the chain is the source image, SPD mip N is stored in level N + 1 (same as the sample, where mip 0 of the texture
+// is the source and SpdStore(mip) writes to imgDst[mip + 1]).
+//------------------------------------------------------------------------------------------------------------------------------
+// INTEGRATION SUMMARY
+// ===================
+// #define A_CPU
+// #include "ffx_a.h"
+// #include "ffx_spd.h"
+// #include "ffx_spd_cpu.h"
+// ...
+// // compile time layout, e.g. for a known 1024x1024 RGBA8 cube map with all 11 levels
+// typedef SpdMipChainLayoutT<1024, 1024, 6, 11, SpdCpuFormat::RGBA8Unorm> CubeLayout;
+// static_assert(CubeLayout::value.levels[10].width == 1, "");
+// // or at setup
+// SpdMipChainLayout layout = SpdComputeMipChainLayout(width, height, slices, SPD_CPU_ALL_LEVELS, SpdCpuFormat::RGBA32F);
+//
+// SpdMipChain chain;
+// chain.Init(layout, SPD_MIP_CHAIN_FLAG_HUGE_PAGES); // one allocation for everything
+// // write the source image into chain.Level(0, slice), rows are chain.RowPitch(0) bytes apart
+// SpdDownsampleCpu(chain, layout.levelCount - 1);
+// // or with a SpdPlan built once, e.g. to only update a sub-rectangle of an atlas
+// SpdPlan plan = SpdCreatePlan(width, height, slices, SpdPlanRect{left, top, rectWidth, rectHeight}, -1, AU1(format));
+// SpdDownsampleCpu(chain, plan);
+// // or tuned for this machine, benchmarked on the first run and read from the cache file afterwards
+// SpdCpuConfig config = SpdCpuAutotune(SpdCpuFormat::RGBA8Unorm, "spd_cpu.cache");
+// SpdPlan plan = SpdCreatePlan(width, height, slices, -1, AU1(format), config.tileSize);
+// SpdDownsampleCpu(chain, plan, config);
+// // alpha tested textures: keep the coverage of alpha >= 0.5 the same in every mip
+// SpdDownsampleCpuAlphaCoverage(chain, plan, config, 0.5f);
+// AF1 coverage[SPD_CPU_MAX_LEVELS]; // should stay close to coverage[0] down to the levels with only a few texels
+// SpdCpuAlphaCoveragePerLevel(chain, slice, 0.5f, coverage);
+// for (AU1 level = 0; level < chain.LevelCount(); level++) printf("level %u coverage %.3f\n", level, coverage[level]);
+// // two channel normal maps: layout with SpdCpuFormat::RGBA8UnormNormal, RG of level 0 is the normal map and A is 0,
+// // every level receives the renormalized normal in RG and its Toksvig variance (roughness) in A
+// // shadow maps: SpdCpuFormat::RGBA32FVsm or RGBA32FEvsm, depth in R of level 0, the other levels receive the moments
+// // half resolution color for SSR or volumetrics: SpdCpuFormat::RGBA32FDepthAware, color in RGB and depth in A of level 0,
+// // every level receives the nearest depth and the average color of the texels close to it
+// // color, depth and motion vectors of a frame in one job: RGBA32F, RG32FMinMax and RG32FMaxLength chains of the same size
+// SpdMipChain *targets[] = { &color, &depth, &velocity };
+// SpdDownsampleCpuMultiTarget(targets, 3, plan, config);
+// // mostly static textures: only the tiles whose source changed since the last call are downsampled again
+// SpdCpuTileHashes hashes;
+// hashes.Init(width, height, slices, plan.tileSize);
+// SpdDownsampleCpuTileHash(chain, hashes, plan, config, &skippedTiles);
+// // remote viewers: a blurry preview from 1 of 64 source texels first, then the exact mips, see SpdCpuProgressiveTimes
+// SpdDownsampleCpuProgressive(chain, plan, config, SendPreview, &connection, &times);
+// // thumbnails of huge textures: only the blocks of the requested level region and the source texels below are used
+// SpdLazyMipChain lazy;
+// lazy.Init(chain);
+// lazy.Request(3, slice, x0, y0, x1, y1); // a region of level 3, only the blocks of levels 1-3 below it are computed
+// lazy.Invalidate(slice, x0, y0, x1, y1); // after the source region changed
+// // asset cookers: unchanged textures are read back from a directory of memory mapped blobs instead of downsampled again
+// SpdMipChainCache cache;
+// cache.Open("spd_mip_cache", AL1(4) << 30); // up to 4 GB, least recently used blobs are deleted first
+// SpdMipChainView mips; // zero copy, points into the blob on a hit and into the chain on a miss
+// cache.Downsample(chain, plan, config, SpdCpuCacheMode::Downsample, 0.0f, mips);
+// printf("hit rate %.2f\n", SpdCpuCacheHitRate(cache.Stats()));
+// // bloom chains with the 13-tap filter, RGBA32F only, SpdDownsampleCpuBloomReference() computes the same level by level
+// SpdDownsampleCpuBloom(chain, plan, config);
+// // Gaussian pyramid, plus the Laplacian levels in a second chain with the same layout
+// SpdDownsampleCpuGaussian(chain, plan, config, &laplacian);
+// // grayscale camera frames: SpdCpuFormat::R8Unorm or R16Unorm, one byte or word per texel
+// // material ID or segmentation maps: SpdCpuFormat::R32UintMajority or R8UintMajority, each texel gets the most frequent
+// // of the four texels above it
+// // occupancy hierarchies: SpdCpuFormat::R32UintOr or R32UintAnd for 32 independent masks per texel, R32UintOr8x4 or
+// // R32UintAnd8x4 if every texel is a block of 8x4 cells
+// // heightfields for ray marching: SpdCpuFormat::R16UnormMaxHeight, each texel is the maximum of all heights below it,
+// // with alignment 1 the whole pyramid is one packed buffer, level l starts at Layout().levels[l].offset
+// SpdMipChainLayout packed = SpdComputeMipChainLayout(w, h, 1, SPD_CPU_ALL_LEVELS, SpdCpuFormat::R16UnormMaxHeight, 1);
+// // auto-exposure for offline tone mapping: 256 bin log2 luminance histogram of level 0, average luminance and exposure
+// SpdCpuHistogram histogram;
+// SpdCpuLuminanceHistogram(chain, slice, SpdCpuDefaultHistogramSettings(), histogram, config);
+// // summed area tables for box filtered glossy reflections, RGBA32F source and table, the table can be the source
+// SpdCpuSummedAreaTable(chain, table, config);
+// double satMilliseconds[2]; // single pass and the two pass baseline
+// SpdCpuBenchmarkSummedAreaTable(config, 16, satMilliseconds);
+// // bloom up chain: each level gets the bilinear upsampled coarser one added, or combined by a functor of your own
+// SpdUpsampleCpuReference(chain, mips);
+// // time per 4K frame of each ISA
+// double milliseconds[SPD_CPU_ISA_COUNT];
+// SpdCpuIsa isa = SpdCpuBenchmarkIsa(SpdCpuFormat::R8Unorm, 16, milliseconds);
+//------------------------------------------------------------------------------------------------------------------------------
+#ifndef FFX_SPD_CPU_H
+#define FFX_SPD_CPU_H
+
+#ifdef A_CPU
+
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <stdio.h>
+#include <new>
+#include <chrono>
+#include <atomic>
+#include <thread>
+
+#ifdef _WIN32
+    #ifndef WIN32_LEAN_AND_MEAN
+        #define WIN32_LEAN_AND_MEAN
+    #endif
+    #include <windows.h>
+    #include <malloc.h>
+#else
+    #include <sys/mman.h>
+    #include <sys/stat.h>
+    #include <fcntl.h>
+    #include <unistd.h>
+    #include <dirent.h>
+#endif
+
+// SIMD kernels are compiled for every ISA and picked at runtime, no -m flags needed.
+// Define SPD_CPU_NO_SIMD to only build the scalar kernels.
+#if !defined(SPD_CPU_NO_SIMD) && (defined(__x86_64__) || defined(__i386__) || defined(_M_X64) || defined(_M_IX86))
+    #define SPD_CPU_SIMD 1
+    #include <immintrin.h>
+    #ifdef A_GCC
+        #include <cpuid.h>
+        #define SPD_CPU_TARGET(isa) __attribute__((target(isa)))
+    #else
+        #include <intrin.h>
+        #define SPD_CPU_TARGET(isa)
+    #endif
+#endif
+
+//==============================================================================================================================
+//                                                     FORMATS
+//==============================================================================================================================
+// 12 mips maximum, same as the shader version, plus the source level
+#define SPD_CPU_MAX_MIP_LEVELS 12
+#define SPD_CPU_MAX_LEVELS (SPD_CPU_MAX_MIP_LEVELS + 1)
+// pass as level count to get the full chain down to 1x1 (clamped to SPD_CPU_MAX_LEVELS)
+#define SPD_CPU_ALL_LEVELS 0
+
+// Alignment of every row, level and slice within the arena. Matches a cache line and the widest SIMD register (AVX-512).
+#define SPD_CPU_ALIGNMENT 64
+// Supported tile sizes are SPD_CPU_MIN_TILE_SIZE << i for i in [0, SPD_CPU_TILE_SIZE_COUNT): 32, 64, 128
+#define SPD_CPU_MIN_TILE_SIZE 32
+#define SPD_CPU_TILE_SIZE_COUNT 3
+
+enum class SpdCpuFormat : AU1
+{
+    RGBA32F,         // 4x float
+    RGBA8Unorm,      // 4x 8-bit unorm, averaged in float
+    RGBA8UnormFixed, // 4x 8-bit unorm, averaged in 16-bit integers with round half up, within 1 of RGBA8Unorm
+    RGBA8UnormSrgb,  // 4x 8-bit, sRGB encoded RGB and linear alpha, averaged in linear space
+    RGBA32FNormal,   // 4x float, two channel normal map in RG, reconstructed z in B, Toksvig variance in A (see NORMAL MAP)
+    RGBA8UnormNormal,// 4x 8-bit unorm, same as RGBA32FNormal, the variance saturates at 1
+    RGBA32FVsm,      // 4x float, depth in R of level 0, VSM moments (d, d^2, 0, 0) in the other levels (see MOMENTS)
+    RGBA32FEvsm,     // 4x float, depth in R of level 0, EVSM moments in the other levels
+    R8Unorm,         // 1x 8-bit unorm, grayscale, averaged in integers with round half up (see SPD_ONE_CHANNEL)
+    R16Unorm,        // 1x 16-bit unorm, same as R8Unorm
+    R8UintMajority,  // 1x 8-bit uint label, the most frequent of the four, ties go to the lowest (see SPD_MAJORITY)
+    R32UintMajority, // 1x 32-bit uint ID, same as R8UintMajority
+    R32UintOr,       // 1x 32-bit mask, every bit is the OR of the same bit of the four (see SPD_OCCUPANCY_OR)
+    R32UintAnd,      // 1x 32-bit mask, every bit is the AND of the same bit of the four (see SPD_OCCUPANCY_AND)
+    R32UintOr8x4,    // 1x 32-bit block of 8x4 cells, every 2x2 cells are ORed into one (see SPD_OCCUPANCY_8X4)
+    R32UintAnd8x4,   // 1x 32-bit block of 8x4 cells, every 2x2 cells are ANDed into one
+    R16UnormMaxHeight, // 1x 16-bit height, the maximum of the four, odd sizes fold into the border (see SPD_MAX_HEIGHT)
+    RGBA32FDepthAware, // 4x float, color in RGB, depth in A, averages the colors near the minimum depth (see SPD_DEPTH_AWARE)
+    RGBA32FDepthAwareMax, // 4x float, same as RGBA32FDepthAware with the maximum depth as the nearest, for reversed Z
+    RG32FMinMax,     // 2x float, minimum depth in R, maximum depth in G, level 0 holds depth in both (see SPD_MULTI_TARGET)
+    RG32FMaxLength,  // 2x float motion vector, the longest of the four, ties go to the first (see SPD_MULTI_TARGET)
+};
+
+A_STATIC constexpr AU1 SpdCpuFormatTexelSize(SpdCpuFormat format)
+{
+    return (format == SpdCpuFormat::R8Unorm || format == SpdCpuFormat::R8UintMajority) ? 1u :
+        (format == SpdCpuFormat::R16Unorm || format == SpdCpuFormat::R16UnormMaxHeight) ? 2u :
+        (format == SpdCpuFormat::RG32FMinMax || format == SpdCpuFormat::RG32FMaxLength) ? 8u :
+        (format == SpdCpuFormat::RGBA32F || format == SpdCpuFormat::RGBA32FNormal ||
+        format == SpdCpuFormat::RGBA32FVsm || format == SpdCpuFormat::RGBA32FEvsm ||
+        format == SpdCpuFormat::RGBA32FDepthAware || format == SpdCpuFormat::RGBA32FDepthAwareMax) ? 16u : 4u;
+}
+
+A_STATIC constexpr AU1 SpdCpuFormatChannels(SpdCpuFormat format)
+{
+    return (format == SpdCpuFormat::R8Unorm || format == SpdCpuFormat::R16Unorm ||
+        format == SpdCpuFormat::R8UintMajority || format == SpdCpuFormat::R32UintMajority ||
+        format == SpdCpuFormat::R32UintOr || format == SpdCpuFormat::R32UintAnd ||
+        format == SpdCpuFormat::R32UintOr8x4 || format == SpdCpuFormat::R32UintAnd8x4 ||
+        format == SpdCpuFormat::R16UnormMaxHeight) ? 1u :
+        (format == SpdCpuFormat::RG32FMinMax || format == SpdCpuFormat::RG32FMaxLength) ? 2u : 4u;
+}
+
+//==============================================================================================================================
+//                                                     MIP CHAIN LAYOUT
+//==============================================================================================================================
+struct SpdMipLevelLayout
+{
+    AU1 width;    // in texels
+    AU1 height;   // in texels
+    AU1 rowPitch; // in bytes, multiple of the layout alignment
+    AL1 offset;   // in bytes, from the start of the slice
+};
+
+struct SpdMipChainLayout
+{
+    SpdMipLevelLayout levels[SPD_CPU_MAX_LEVELS];
+    AU1 levelCount; // number of levels including the source level 0
+    AU1 slices;
+    AU1 texelSize;
+    SpdCpuFormat format;
+    AL1 slicePitch;   // in bytes, multiple of the layout alignment
+    AL1 size;         // total arena size in bytes
+};
+
+A_STATIC constexpr AL1 SpdCpuAlignUp(AL1 value, AL1 alignment)
+{
+    return (value + alignment - 1) & ~(alignment - 1);
+}
+
+A_STATIC constexpr AU1 SpdCpuMaxLevels(AU1 width, AU1 height)
+{
+    // same as SpdSetup: floor(log2(max(width, height))) mips plus the source level
+    AU1 resolution = width > height ? width : height;
+    AU1 levels = 1;
+    while ((resolution >>= 1) != 0 && levels < SPD_CPU_MAX_LEVELS)
+        levels++;
+    return levels;
+}
+
+// Level extents follow the usual D3D/Vulkan rule: max(1, size >> level)
+// Rows and slices start at multiples of alignment (a power of two), 1 packs all levels without padding, e.g. for a
+// heightfield pyramid that is handed to code which indexes it with offset + y * width + x
+A_STATIC constexpr SpdMipChainLayout SpdComputeMipChainLayout(AU1 width, AU1 height, AU1 slices, AU1 levels,
+    SpdCpuFormat format, AU1 alignment = SPD_CPU_ALIGNMENT)
+{
+    SpdMipChainLayout layout = {};
+    AU1 maxLevels = SpdCpuMaxLevels(width, height);
+    layout.levelCount = (levels == SPD_CPU_ALL_LEVELS || levels > maxLevels) ? maxLevels : levels;
+    layout.slices = slices;
+    layout.texelSize = SpdCpuFormatTexelSize(format);
+    layout.format = format;
+
+    AL1 offset = 0;
+    for (AU1 i = 0; i < layout.levelCount; i++)
+    {
+        SpdMipLevelLayout level = {};
+        level.width = (width >> i) > 0 ? (width >> i) : 1;
+        level.height = (height >> i) > 0 ? (height >> i) : 1;
+        level.rowPitch = AU1(SpdCpuAlignUp(AL1(level.width) * layout.texelSize, alignment));
+        level.offset = offset;
+        layout.levels[i] = level;
+        offset += AL1(level.rowPitch) * level.height;
+    }
+    layout.slicePitch = SpdCpuAlignUp(offset, alignment);
+    layout.size = layout.slicePitch * slices;
+    return layout;
+}
+
+// Compile time version: SpdMipChainLayoutT<4096, 4096, 1, SPD_CPU_ALL_LEVELS, SpdCpuFormat::RGBA32F>::value
+template<AU1 Width, AU1 Height, AU1 Slices, AU1 Levels, SpdCpuFormat Format>
+struct SpdMipChainLayoutT
+{
+    static_assert(Width > 0 && Height > 0 && Slices > 0, "SPD mip chain dimensions must not be zero");
+    static constexpr SpdMipChainLayout value = SpdComputeMipChainLayout(Width, Height, Slices, Levels, Format);
+};
+template<AU1 Width, AU1 Height, AU1 Slices, AU1 Levels, SpdCpuFormat Format>
+constexpr SpdMipChainLayout SpdMipChainLayoutT<Width, Height, Slices, Levels, Format>::value;
+
+//==============================================================================================================================
+//                                                     MIP CHAIN ARENA
+//==============================================================================================================================
+#define SPD_MIP_CHAIN_FLAG_NONE 0u
+// Try to back the arena with huge/large pages, silently falls back to regular pages if the OS refuses.
+// On Windows this needs the SeLockMemoryPrivilege.
+#define SPD_MIP_CHAIN_FLAG_HUGE_PAGES 1u
+
+class SpdMipChain
+{
+public:
+    SpdMipChain() {}
+    ~SpdMipChain() { Release(); }
+
+    SpdMipChain(const SpdMipChain&) = delete;
+    SpdMipChain& operator=(const SpdMipChain&) = delete;
+
+    // returns false if the allocation failed
+    bool Init(const SpdMipChainLayout &layout, AU1 flags = SPD_MIP_CHAIN_FLAG_NONE)
+    {
+        Release();
+        m_layout = layout;
+        if (layout.size == 0)
+            return false;
+
+        if (flags & SPD_MIP_CHAIN_FLAG_HUGE_PAGES)
+            m_pData = AllocHugePages(layout.size);
+        if (m_pData == nullptr)
+        {
+            m_hugePages = false;
+#ifdef _WIN32
+            m_pData = (AB1*)_aligned_malloc(size_t(layout.size), SPD_CPU_ALIGNMENT);
+#else
+            void *pData = nullptr;
+            if (posix_memalign(&pData, SPD_CPU_ALIGNMENT, size_t(layout.size)) == 0)
+                m_pData = (AB1*)pData;
+#endif
+        }
+        return m_pData != nullptr;
+    }
+
+    void Release()
+    {
+        if (m_pData == nullptr)
+            return;
+        if (m_hugePages)
+        {
+#ifdef _WIN32
+            VirtualFree(m_pData, 0, MEM_RELEASE);
+#else
+            munmap(m_pData, size_t(m_mappedSize));
+#endif
+        }
+        else
+        {
+#ifdef _WIN32
+            _aligned_free(m_pData);
+#else
+            free(m_pData);
+#endif
+        }
+        m_pData = nullptr;
+        m_hugePages = false;
+        m_mappedSize = 0;
+    }
+
+    const SpdMipChainLayout &Layout() const { return m_layout; }
+    AU1 LevelCount() const { return m_layout.levelCount; }
+    AU1 SliceCount() const { return m_layout.slices; }
+    AU1 Width(AU1 level) const { return m_layout.levels[level].width; }
+    AU1 Height(AU1 level) const { return m_layout.levels[level].height; }
+    AU1 RowPitch(AU1 level) const { return m_layout.levels[level].rowPitch; }
+    bool UsesHugePages() const { return m_hugePages; }
+
+    AB1 *Data() { return m_pData; }
+    const AB1 *Data() const { return m_pData; }
+
+    AB1 *Level(AU1 level, AU1 slice)
+    {
+        return m_pData + m_layout.slicePitch * slice + m_layout.levels[level].offset;
+    }
+    const AB1 *Level(AU1 level, AU1 slice) const
+    {
+        return m_pData + m_layout.slicePitch * slice + m_layout.levels[level].offset;
+    }
+    AB1 *Row(AU1 level, AU1 slice, AU1 y)
+    {
+        return Level(level, slice) + AL1(m_layout.levels[level].rowPitch) * y;
+    }
+    const AB1 *Row(AU1 level, AU1 slice, AU1 y) const
+    {
+        return Level(level, slice) + AL1(m_layout.levels[level].rowPitch) * y;
+    }
+
+private:
+    AB1 *AllocHugePages(AL1 size)
+    {
+#ifdef _WIN32
+        SIZE_T largePage = GetLargePageMinimum();
+        if (largePage == 0)
+            return nullptr;
+        AL1 mappedSize = SpdCpuAlignUp(size, largePage);
+        void *pData = VirtualAlloc(NULL, SIZE_T(mappedSize), MEM_RESERVE | MEM_COMMIT | MEM_LARGE_PAGES, PAGE_READWRITE);
+#else
+        // 2MB is the huge page size on x86-64 and the common default on ARM64
+        AL1 mappedSize = SpdCpuAlignUp(size, AL1(2) << 20);
+        void *pData = MAP_FAILED;
+    #ifdef MAP_HUGETLB
+        pData = mmap(NULL, size_t(mappedSize), PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+    #endif
+        if (pData == MAP_FAILED)
+        {
+            // no reserved huge pages, ask for transparent huge pages instead
+            pData = mmap(NULL, size_t(mappedSize), PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+            if (pData == MAP_FAILED)
+                return nullptr;
+    #ifdef MADV_HUGEPAGE
+            madvise(pData, size_t(mappedSize), MADV_HUGEPAGE);
+    #endif
+        }
+#endif
+        if (pData == nullptr)
+            return nullptr;
+        m_hugePages = true;
+        m_mappedSize = mappedSize;
+        return (AB1*)pData;
+    }
+
+    SpdMipChainLayout m_layout = {};
+    AB1 *m_pData = nullptr;
+    AL1 m_mappedSize = 0;
+    bool m_hugePages = false;
+};
+
+//==============================================================================================================================
+//                                                     ROW KERNELS
+//==============================================================================================================================
+// All ISAs have to round the same way, so multiplies and adds must not be fused into FMAs in any of the kernels.
+// GCC fuses intrinsics as well once FMA is available (AVX-512 implies it).
+#if defined(__clang__)
+    #pragma STDC FP_CONTRACT OFF
+#elif defined(A_GCC)
+    #pragma GCC push_options
+    #pragma GCC optimize("fp-contract=off")
+#endif
+
+// A row kernel computes one output row of a level from the two input rows of the previous level.
+// It writes count texels starting at output column x, input columns are clamped to inWidth - 1 (clamp to edge).
+typedef void (*SpdCpuReduceRowFn)(AB1 *A_RESTRICT dst, const AB1 *A_RESTRICT row0, const AB1 *A_RESTRICT row1,
+    AU1 x, AU1 count, AU1 inWidth);
+
+// User defined reduction on the CPU side: takes as input the four 2x2 values and returns 1 output value, same as SpdReduce4
+A_STATIC void SpdCpuReduce4(outAF4 d, inAF4 v0, inAF4 v1, inAF4 v2, inAF4 v3)
+{
+    d[0] = (v0[0] + v1[0] + v2[0] + v3[0]) * 0.25f;
+    d[1] = (v0[1] + v1[1] + v2[1] + v3[1]) * 0.25f;
+    d[2] = (v0[2] + v1[2] + v2[2] + v3[2]) * 0.25f;
+    d[3] = (v0[3] + v1[3] + v2[3] + v3[3]) * 0.25f;
+}
+
+A_STATIC void SpdCpuReduceRowRGBA32F(AB1 *A_RESTRICT dst, const AB1 *A_RESTRICT row0, const AB1 *A_RESTRICT row1,
+    AU1 x, AU1 count, AU1 inWidth)
+{
+    const AF1 *r0 = (const AF1*)row0;
+    const AF1 *r1 = (const AF1*)row1;
+    AF1 *d = (AF1*)dst + x * 4;
+    for (AU1 i = x; i < x + count; i++, d += 4)
+    {
+        AU1 c0 = AMinU1(i * 2 + 0, inWidth - 1) * 4;
+        AU1 c1 = AMinU1(i * 2 + 1, inWidth - 1) * 4;
+        varAF4(v0) = initAF4(r0[c0 + 0], r0[c0 + 1], r0[c0 + 2], r0[c0 + 3]);
+        varAF4(v1) = initAF4(r0[c1 + 0], r0[c1 + 1], r0[c1 + 2], r0[c1 + 3]);
+        varAF4(v2) = initAF4(r1[c0 + 0], r1[c0 + 1], r1[c0 + 2], r1[c0 + 3]);
+        varAF4(v3) = initAF4(r1[c1 + 0], r1[c1 + 1], r1[c1 + 2], r1[c1 + 3]);
+        SpdCpuReduce4(d, v0, v1, v2, v3);
+    }
+}
+
+A_STATIC AF1 SpdCpuUnpackUnorm8(AB1 v)
+{
+    return AF1(v) * (1.0f / 255.0f);
+}
+
+A_STATIC AB1 SpdCpuPackUnorm8(AF1 v)
+{
+    return AB1(ASatF1(v) * 255.0f + 0.5f);
+}
+
+A_STATIC void SpdCpuReduceRowRGBA8Unorm(AB1 *A_RESTRICT dst, const AB1 *A_RESTRICT row0, const AB1 *A_RESTRICT row1,
+    AU1 x, AU1 count, AU1 inWidth)
+{
+    AB1 *d = dst + x * 4;
+    for (AU1 i = x; i < x + count; i++, d += 4)
+    {
+        AU1 c0 = AMinU1(i * 2 + 0, inWidth - 1) * 4;
+        AU1 c1 = AMinU1(i * 2 + 1, inWidth - 1) * 4;
+        varAF4(v0); varAF4(v1); varAF4(v2); varAF4(v3); varAF4(r);
+        for (AU1 c = 0; c < 4; c++)
+        {
+            v0[c] = SpdCpuUnpackUnorm8(row0[c0 + c]);
+            v1[c] = SpdCpuUnpackUnorm8(row0[c1 + c]);
+            v2[c] = SpdCpuUnpackUnorm8(row1[c0 + c]);
+            v3[c] = SpdCpuUnpackUnorm8(row1[c1 + c]);
+        }
+        SpdCpuReduce4(r, v0, v1, v2, v3);
+        for (AU1 c = 0; c < 4; c++)
+            d[c] = SpdCpuPackUnorm8(r[c]);
+    }
+}
+
+// (a + b + c + d + 2) >> 2 is the exactly rounded average, the float path can only end up 1 lower when its sum lands just
+// below a .5 boundary. No conversions and a quarter of the register width per texel compared to the float path.
+A_STATIC void SpdCpuReduceRowRGBA8UnormFixed(AB1 *A_RESTRICT dst, const AB1 *A_RESTRICT row0, const AB1 *A_RESTRICT row1,
+    AU1 x, AU1 count, AU1 inWidth)
+{
+    AB1 *d = dst + x * 4;
+    for (AU1 i = x; i < x + count; i++, d += 4)
+    {
+        AU1 c0 = AMinU1(i * 2 + 0, inWidth - 1) * 4;
+        AU1 c1 = AMinU1(i * 2 + 1, inWidth - 1) * 4;
+        for (AU1 c = 0; c < 4; c++)
+            d[c] = AB1((AU1(row0[c0 + c]) + row0[c1 + c] + row1[c0 + c] + row1[c1 + c] + 2) >> 2);
+    }
+}
+
+// Single channel kernels for grayscale images, same rounding as RGBA8UnormFixed. A texel is one byte or word, so the SIMD
+// versions reduce 16 (SSE4.1), 32 (AVX2) or 64 (AVX-512) 8-bit texels per instruction, half that for 16-bit.
+A_STATIC void SpdCpuReduceRowR8Unorm(AB1 *A_RESTRICT dst, const AB1 *A_RESTRICT row0, const AB1 *A_RESTRICT row1,
+    AU1 x, AU1 count, AU1 inWidth)
+{
+    for (AU1 i = x; i < x + count; i++)
+    {
+        AU1 c0 = AMinU1(i * 2 + 0, inWidth - 1);
+        AU1 c1 = AMinU1(i * 2 + 1, inWidth - 1);
+        dst[i] = AB1((AU1(row0[c0]) + row0[c1] + row1[c0] + row1[c1] + 2) >> 2);
+    }
+}
+
+A_STATIC void SpdCpuReduceRowR16Unorm(AB1 *A_RESTRICT dst, const AB1 *A_RESTRICT row0, const AB1 *A_RESTRICT row1,
+    AU1 x, AU1 count, AU1 inWidth)
+{
+    const AW1 *r0 = (const AW1*)row0;
+    const AW1 *r1 = (const AW1*)row1;
+    AW1 *d = (AW1*)dst;
+    for (AU1 i = x; i < x + count; i++)
+    {
+        AU1 c0 = AMinU1(i * 2 + 0, inWidth - 1);
+        AU1 c1 = AMinU1(i * 2 + 1, inWidth - 1);
+        d[i] = AW1((AU1(r0[c0]) + r0[c1] + r1[c0] + r1[c1] + 2) >> 2);
+    }
+}
+
+// Majority vote of SPD_MAJORITY: the lowest of the values that occur most often among the four
+A_STATIC AU1 SpdCpuMajority4(AU1 v0, AU1 v1, AU1 v2, AU1 v3)
+{
+    AU1 e01 = v0 == v1;
+    AU1 e02 = v0 == v2;
+    AU1 e03 = v0 == v3;
+    AU1 e12 = v1 == v2;
+    AU1 e13 = v1 == v3;
+    AU1 e23 = v2 == v3;
+    AU1 c0 = e01 + e02 + e03;
+    AU1 c1 = e01 + e12 + e13;
+    AU1 c2 = e02 + e12 + e23;
+    AU1 c3 = e03 + e13 + e23;
+    AU1 count = AMaxU1(AMaxU1(c0, c1), AMaxU1(c2, c3));
+    AU1 m0 = c0 == count ? v0 : 0xffffffffu;
+    AU1 m1 = c1 == count ? v1 : 0xffffffffu;
+    AU1 m2 = c2 == count ? v2 : 0xffffffffu;
+    AU1 m3 = c3 == count ? v3 : 0xffffffffu;
+    return AMinU1(AMinU1(m0, m1), AMinU1(m2, m3));
+}
+
+A_STATIC void SpdCpuReduceRowR8UintMajority(AB1 *A_RESTRICT dst, const AB1 *A_RESTRICT row0, const AB1 *A_RESTRICT row1,
+    AU1 x, AU1 count, AU1 inWidth)
+{
+    for (AU1 i = x; i < x + count; i++)
+    {
+        AU1 c0 = AMinU1(i * 2 + 0, inWidth - 1);
+        AU1 c1 = AMinU1(i * 2 + 1, inWidth - 1);
+        dst[i] = AB1(SpdCpuMajority4(row0[c0], row0[c1], row1[c0], row1[c1]));
+    }
+}
+
+A_STATIC void SpdCpuReduceRowR32UintMajority(AB1 *A_RESTRICT dst, const AB1 *A_RESTRICT row0,
+    const AB1 *A_RESTRICT row1, AU1 x, AU1 count, AU1 inWidth)
+{
+    const AU1 *r0 = (const AU1*)row0;
+    const AU1 *r1 = (const AU1*)row1;
+    AU1 *d = (AU1*)dst;
+    for (AU1 i = x; i < x + count; i++)
+    {
+        AU1 c0 = AMinU1(i * 2 + 0, inWidth - 1);
+        AU1 c1 = AMinU1(i * 2 + 1, inWidth - 1);
+        d[i] = SpdCpuMajority4(r0[c0], r0[c1], r1[c0], r1[c1]);
+    }
+}
+
+// Bitwise OR / AND of SPD_OCCUPANCY_OR / SPD_OCCUPANCY_AND. The two input texels of an output texel are one 64-bit word,
+// left texel in the low half, so every operation works on two texels.
+template<bool UseAnd>
+A_STATIC AL1 SpdCpuCombine64(AL1 a, AL1 b)
+{
+    return UseAnd ? a & b : a | b;
+}
+
+// Halves the 8x4 cell blocks of SPD_OCCUPANCY_8X4 in both halves, then puts the two 4x2 results side by side:
+// bits 0-7 are the upper row of the output block, bits 8-15 the lower row
+template<bool UseAnd>
+A_STATIC AU1 SpdCpuHalveBlocks(AL1 pair)
+{
+    AL1 h = SpdCpuCombine64<UseAnd>(pair, pair >> 1) & 0x5555555555555555ull;
+    h = SpdCpuCombine64<UseAnd>(h, h >> 8) & 0x0055005500550055ull;
+    h = (h | (h >> 1)) & 0x0033003300330033ull;
+    h = (h | (h >> 2)) & 0x000f000f000f000full;
+    // the right block (bytes 4 and 6) goes to the upper nibbles of bytes 0 and 2
+    h |= h >> 28;
+    return AU1((h & 0xffull) | ((h >> 8) & 0xff00ull));
+}
+
+template<bool UseAnd, bool Blocks>
+A_STATIC void SpdCpuReduceRowBitwise(AB1 *A_RESTRICT dst, const AB1 *A_RESTRICT row0, const AB1 *A_RESTRICT row1,
+    AU1 x, AU1 count, AU1 inWidth)
+{
+    const AU1 *r0 = (const AU1*)row0;
+    const AU1 *r1 = (const AU1*)row1;
+    AU1 *d = (AU1*)dst;
+    for (AU1 i = x; i < x + count; i++)
+    {
+        AU1 c0 = AMinU1(i * 2 + 0, inWidth - 1);
+        AU1 c1 = AMinU1(i * 2 + 1, inWidth - 1);
+        AL1 top = AL1(r0[c0]) | (AL1(r0[c1]) << 32);
+        AL1 bottom = AL1(r1[c0]) | (AL1(r1[c1]) << 32);
+        if (Blocks)
+        {
+            d[i] = SpdCpuHalveBlocks<UseAnd>(top) | (SpdCpuHalveBlocks<UseAnd>(bottom) << 16);
+        }
+        else
+        {
+            AL1 v = SpdCpuCombine64<UseAnd>(top, bottom);
+            d[i] = AU1(SpdCpuCombine64<UseAnd>(v, v >> 32));
+        }
+    }
+}
+
+// Row kernels of the four bitwise formats for one ISA suffix
+#define SPD_CPU_BITWISE_KERNELS(isa) \
+    A_STATIC void SpdCpuReduceRowR32UintOr##isa(AB1 *A_RESTRICT dst, const AB1 *A_RESTRICT row0, \
+        const AB1 *A_RESTRICT row1, AU1 x, AU1 count, AU1 inWidth) \
+        { SpdCpuReduceRowBitwise##isa<false, false>(dst, row0, row1, x, count, inWidth); } \
+    A_STATIC void SpdCpuReduceRowR32UintAnd##isa(AB1 *A_RESTRICT dst, const AB1 *A_RESTRICT row0, \
+        const AB1 *A_RESTRICT row1, AU1 x, AU1 count, AU1 inWidth) \
+        { SpdCpuReduceRowBitwise##isa<true, false>(dst, row0, row1, x, count, inWidth); } \
+    A_STATIC void SpdCpuReduceRowR32UintOr8x4##isa(AB1 *A_RESTRICT dst, const AB1 *A_RESTRICT row0, \
+        const AB1 *A_RESTRICT row1, AU1 x, AU1 count, AU1 inWidth) \
+        { SpdCpuReduceRowBitwise##isa<false, true>(dst, row0, row1, x, count, inWidth); } \
+    A_STATIC void SpdCpuReduceRowR32UintAnd8x4##isa(AB1 *A_RESTRICT dst, const AB1 *A_RESTRICT row0, \
+        const AB1 *A_RESTRICT row1, AU1 x, AU1 count, AU1 inWidth) \
+        { SpdCpuReduceRowBitwise##isa<true, true>(dst, row0, row1, x, count, inWidth); }
+
+SPD_CPU_BITWISE_KERNELS()
+
+// Maximum of SPD_MAX_HEIGHT. Only the 2x2 texels above, the texels odd sizes leave over are folded in afterwards by
+// SpdCpuFoldMaxHeightBorders().
+A_STATIC void SpdCpuReduceRowR16UnormMaxHeight(AB1 *A_RESTRICT dst, const AB1 *A_RESTRICT row0,
+    const AB1 *A_RESTRICT row1, AU1 x, AU1 count, AU1 inWidth)
+{
+    const AW1 *r0 = (const AW1*)row0;
+    const AW1 *r1 = (const AW1*)row1;
+    AW1 *d = (AW1*)dst;
+    for (AU1 i = x; i < x + count; i++)
+    {
+        AU1 c0 = AMinU1(i * 2 + 0, inWidth - 1);
+        AU1 c1 = AMinU1(i * 2 + 1, inWidth - 1);
+        d[i] = AW1(AMaxU1(AMaxU1(r0[c0], r0[c1]), AMaxU1(r1[c0], r1[c1])));
+    }
+}
+
+//==============================================================================================================================
+//                                                     SRGB
+//==============================================================================================================================
+// Decoding is a lookup, encoding is a piecewise linear fit of the exact curve: the bucket is picked by the float exponent and
+// the top SPD_CPU_SRGB_ENCODE_BITS mantissa bits, below 2^-12 the curve is linear anyway. The fit is off by less than
+// 0.03 of an 8-bit step, so results only differ from the exactly rounded conversion if that lands right on a .5 boundary.
+#define SPD_CPU_SRGB_ENCODE_BITS 4
+#define SPD_CPU_SRGB_ENCODE_MIN_EXPONENT (127 - 12)
+#define SPD_CPU_SRGB_ENCODE_ENTRIES (12 << SPD_CPU_SRGB_ENCODE_BITS)
+#define SPD_CPU_SRGB_ENCODE_BASE (SPD_CPU_SRGB_ENCODE_MIN_EXPONENT << SPD_CPU_SRGB_ENCODE_BITS)
+#define SPD_CPU_SRGB_ENCODE_SHIFT (23 - SPD_CPU_SRGB_ENCODE_BITS)
+// 2^-12, largest float below 1.0
+#define SPD_CPU_SRGB_LINEAR_LIMIT (1.0f / 4096.0f)
+#define SPD_CPU_SRGB_MAX 0.99999994f
+#define SPD_CPU_SRGB_LINEAR_SCALE (12.92f * 255.0f)
+
+struct SpdCpuSrgbTables
+{
+    AF1 decode[512]; // [0, 256): sRGB byte to linear, [256, 512): byte / 255 for alpha
+    AF1 encodeBias[SPD_CPU_SRGB_ENCODE_ENTRIES]; // linear to sRGB * 255 + 0.5 = bias + scale * linear
+    AF1 encodeScale[SPD_CPU_SRGB_ENCODE_ENTRIES];
+};
+
+A_STATIC double SpdCpuSrgbToLinear(double c)
+{
+    return c <= 0.04045 ? c / 12.92 : pow((c + 0.055) / 1.055, 2.4);
+}
+
+A_STATIC double SpdCpuLinearToSrgb(double c)
+{
+    return c <= 0.0031308 ? c * 12.92 : 1.055 * pow(c, 1.0 / 2.4) - 0.055;
+}
+
+A_STATIC SpdCpuSrgbTables SpdCpuBuildSrgbTables()
+{
+    SpdCpuSrgbTables tables;
+    for (AU1 i = 0; i < 256; i++)
+    {
+        tables.decode[i] = AF1(SpdCpuSrgbToLinear(i / 255.0));
+        tables.decode[256 + i] = SpdCpuUnpackUnorm8(AB1(i));
+    }
+    for (AU1 i = 0; i < SPD_CPU_SRGB_ENCODE_ENTRIES; i++)
+    {
+        AU1 bits0 = (SPD_CPU_SRGB_ENCODE_BASE + i) << SPD_CPU_SRGB_ENCODE_SHIFT;
+        AU1 bits1 = (SPD_CPU_SRGB_ENCODE_BASE + i + 1) << SPD_CPU_SRGB_ENCODE_SHIFT;
+        AF1 x0, x1;
+        memcpy(&x0, &bits0, 4);
+        memcpy(&x1, &bits1, 4);
+        double y0 = SpdCpuLinearToSrgb(x0) * 255.0 + 0.5;
+        double y1 = SpdCpuLinearToSrgb(x1) * 255.0 + 0.5;
+        double scale = (y1 - y0) / (double(x1) - double(x0));
+        tables.encodeScale[i] = AF1(scale);
+        tables.encodeBias[i] = AF1(y0 - scale * x0);
+    }
+    return tables;
+}
+
+A_STATIC const SpdCpuSrgbTables &SpdCpuGetSrgbTables()
+{
+    static const SpdCpuSrgbTables tables = SpdCpuBuildSrgbTables();
+    return tables;
+}
+
+A_STATIC AB1 SpdCpuEncodeSrgb8(const SpdCpuSrgbTables &tables, AF1 v)
+{
+    v = AMinF1(ASatF1(v), SPD_CPU_SRGB_MAX);
+    if (v < SPD_CPU_SRGB_LINEAR_LIMIT)
+        return AB1(v * SPD_CPU_SRGB_LINEAR_SCALE + 0.5f);
+    AU1 i = (AU1_AF1(v) >> SPD_CPU_SRGB_ENCODE_SHIFT) - SPD_CPU_SRGB_ENCODE_BASE;
+    return AB1(tables.encodeBias[i] + tables.encodeScale[i] * v);
+}
+
+A_STATIC void SpdCpuReduceRowRGBA8UnormSrgb(AB1 *A_RESTRICT dst, const AB1 *A_RESTRICT row0, const AB1 *A_RESTRICT row1,
+    AU1 x, AU1 count, AU1 inWidth)
+{
+    const SpdCpuSrgbTables &tables = SpdCpuGetSrgbTables();
+    AB1 *d = dst + x * 4;
+    for (AU1 i = x; i < x + count; i++, d += 4)
+    {
+        AU1 c0 = AMinU1(i * 2 + 0, inWidth - 1) * 4;
+        AU1 c1 = AMinU1(i * 2 + 1, inWidth - 1) * 4;
+        varAF4(v0); varAF4(v1); varAF4(v2); varAF4(v3); varAF4(r);
+        for (AU1 c = 0; c < 4; c++)
+        {
+            AU1 table = c == 3 ? 256 : 0;
+            v0[c] = tables.decode[table + row0[c0 + c]];
+            v1[c] = tables.decode[table + row0[c1 + c]];
+            v2[c] = tables.decode[table + row1[c0 + c]];
+            v3[c] = tables.decode[table + row1[c1 + c]];
+        }
+        SpdCpuReduce4(r, v0, v1, v2, v3);
+        for (AU1 c = 0; c < 3; c++)
+            d[c] = SpdCpuEncodeSrgb8(tables, r[c]);
+        d[3] = SpdCpuPackUnorm8(r[3]);
+    }
+}
+
+//==============================================================================================================================
+//                                                     NORMAL MAP
+//==============================================================================================================================
+// RGBA32FNormal and RGBA8UnormNormal, see NORMAL MAP in ffx_spd.h. RG holds the encoded two channel normal, B is ignored on
+// load and receives the encoded z, A is the Toksvig variance (1 - |n|) / |n|, the roughness output of every level.
+// A of the source level is its variance as well, 0 for a plain normal map.
+// Normals of the level above are scaled back to their unnormalized length 1 / (1 + variance) before they are averaged, so
+// every level is the average of the source normals.
+A_STATIC void SpdCpuDecodeNormal(outAF3 n, AF1 r, AF1 g, AF1 variance)
+{
+    AF1 x = r * 2.0f - 1.0f;
+    AF1 y = g * 2.0f - 1.0f;
+    AF1 z = sqrtf(AMaxF1(1.0f - x * x - y * y, 0.0f));
+    AF1 l = 1.0f / (1.0f + variance);
+    n[0] = x * l;
+    n[1] = y * l;
+    n[2] = z * l;
+}
+
+// Averages four decoded normals, d receives the encoded renormalized normal and its variance
+A_STATIC void SpdCpuEncodeNormal(outAF4 d, inAF3 n0, inAF3 n1, inAF3 n2, inAF3 n3)
+{
+    varAF3(n);
+    for (AU1 c = 0; c < 3; c++)
+        n[c] = (n0[c] + n1[c] + n2[c] + n3[c]) * 0.25f;
+    AF1 len = AMaxF1(sqrtf(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]), 1.0f / 65536.0f);
+    AF1 scale = 0.5f / len;
+    for (AU1 c = 0; c < 3; c++)
+        d[c] = n[c] * scale + 0.5f;
+    d[3] = (1.0f - len) / len;
+}
+
+A_STATIC void SpdCpuReduceRowRGBA32FNormal(AB1 *A_RESTRICT dst, const AB1 *A_RESTRICT row0, const AB1 *A_RESTRICT row1,
+    AU1 x, AU1 count, AU1 inWidth)
+{
+    const AF1 *r0 = (const AF1*)row0;
+    const AF1 *r1 = (const AF1*)row1;
+    AF1 *d = (AF1*)dst + x * 4;
+    for (AU1 i = x; i < x + count; i++, d += 4)
+    {
+        AU1 c0 = AMinU1(i * 2 + 0, inWidth - 1) * 4;
+        AU1 c1 = AMinU1(i * 2 + 1, inWidth - 1) * 4;
+        varAF3(n0); varAF3(n1); varAF3(n2); varAF3(n3);
+        SpdCpuDecodeNormal(n0, r0[c0 + 0], r0[c0 + 1], r0[c0 + 3]);
+        SpdCpuDecodeNormal(n1, r0[c1 + 0], r0[c1 + 1], r0[c1 + 3]);
+        SpdCpuDecodeNormal(n2, r1[c0 + 0], r1[c0 + 1], r1[c0 + 3]);
+        SpdCpuDecodeNormal(n3, r1[c1 + 0], r1[c1 + 1], r1[c1 + 3]);
+        SpdCpuEncodeNormal(d, n0, n1, n2, n3);
+    }
+}
+
+A_STATIC void SpdCpuReduceRowRGBA8UnormNormal(AB1 *A_RESTRICT dst, const AB1 *A_RESTRICT row0,
+    const AB1 *A_RESTRICT row1, AU1 x, AU1 count, AU1 inWidth)
+{
+    AB1 *d = dst + x * 4;
+    for (AU1 i = x; i < x + count; i++, d += 4)
+    {
+        AU1 c0 = AMinU1(i * 2 + 0, inWidth - 1) * 4;
+        AU1 c1 = AMinU1(i * 2 + 1, inWidth - 1) * 4;
+        varAF3(n0); varAF3(n1); varAF3(n2); varAF3(n3); varAF4(r);
+        SpdCpuDecodeNormal(n0, SpdCpuUnpackUnorm8(row0[c0 + 0]), SpdCpuUnpackUnorm8(row0[c0 + 1]),
+            SpdCpuUnpackUnorm8(row0[c0 + 3]));
+        SpdCpuDecodeNormal(n1, SpdCpuUnpackUnorm8(row0[c1 + 0]), SpdCpuUnpackUnorm8(row0[c1 + 1]),
+            SpdCpuUnpackUnorm8(row0[c1 + 3]));
+        SpdCpuDecodeNormal(n2, SpdCpuUnpackUnorm8(row1[c0 + 0]), SpdCpuUnpackUnorm8(row1[c0 + 1]),
+            SpdCpuUnpackUnorm8(row1[c0 + 3]));
+        SpdCpuDecodeNormal(n3, SpdCpuUnpackUnorm8(row1[c1 + 0]), SpdCpuUnpackUnorm8(row1[c1 + 1]),
+            SpdCpuUnpackUnorm8(row1[c1 + 3]));
+        SpdCpuEncodeNormal(r, n0, n1, n2, n3);
+        for (AU1 c = 0; c < 4; c++)
+            d[c] = SpdCpuPackUnorm8(r[c]);
+    }
+}
+
+//==============================================================================================================================
+//                                                     MOMENTS
+//==============================================================================================================================
+// RGBA32FVsm and RGBA32FEvsm, see MOMENTS in ffx_spd.h. Only level 1 reads depth, it has its own source kernels.
+// The levels below average the moments with the RGBA32F kernels.
+A_STATIC void SpdCpuDepthToMoments(outAF4 m, AF1 d, bool evsm)
+{
+    if (!evsm)
+    {
+        m[0] = d;
+        m[1] = d * d;
+        m[2] = 0.0f;
+        m[3] = 0.0f;
+        return;
+    }
+    d = d * 2.0f - 1.0f;
+    AF1 positive = expf(AF1(SPD_EVSM_POSITIVE_EXPONENT) * d);
+    AF1 negative = -expf(-AF1(SPD_EVSM_NEGATIVE_EXPONENT) * d);
+    m[0] = positive;
+    m[1] = positive * positive;
+    m[2] = negative;
+    m[3] = negative * negative;
+}
+
+A_STATIC void SpdCpuReduceRowDepthMoments(AB1 *A_RESTRICT dst, const AB1 *A_RESTRICT row0, const AB1 *A_RESTRICT row1,
+    AU1 x, AU1 count, AU1 inWidth, bool evsm)
+{
+    const AF1 *r0 = (const AF1*)row0;
+    const AF1 *r1 = (const AF1*)row1;
+    AF1 *d = (AF1*)dst + x * 4;
+    for (AU1 i = x; i < x + count; i++, d += 4)
+    {
+        AU1 c0 = AMinU1(i * 2 + 0, inWidth - 1) * 4;
+        AU1 c1 = AMinU1(i * 2 + 1, inWidth - 1) * 4;
+        varAF4(v0); varAF4(v1); varAF4(v2); varAF4(v3);
+        SpdCpuDepthToMoments(v0, r0[c0], evsm);
+        SpdCpuDepthToMoments(v1, r0[c1], evsm);
+        SpdCpuDepthToMoments(v2, r1[c0], evsm);
+        SpdCpuDepthToMoments(v3, r1[c1], evsm);
+        SpdCpuReduce4(d, v0, v1, v2, v3);
+    }
+}
+
+A_STATIC void SpdCpuReduceRowDepthVsm(AB1 *A_RESTRICT dst, const AB1 *A_RESTRICT row0, const AB1 *A_RESTRICT row1,
+    AU1 x, AU1 count, AU1 inWidth)
+{
+    SpdCpuReduceRowDepthMoments(dst, row0, row1, x, count, inWidth, false);
+}
+
+A_STATIC void SpdCpuReduceRowDepthEvsm(AB1 *A_RESTRICT dst, const AB1 *A_RESTRICT row0, const AB1 *A_RESTRICT row1,
+    AU1 x, AU1 count, AU1 inWidth)
+{
+    SpdCpuReduceRowDepthMoments(dst, row0, row1, x, count, inWidth, true);
+}
+
+//==============================================================================================================================
+//                                                     DEPTH AWARE
+//==============================================================================================================================
+// RGBA32FDepthAware and RGBA32FDepthAwareMax, see DEPTH AWARE in ffx_spd.h. A holds depth, every level keeps the nearest
+// depth of the four and the average color of the texels within SPD_CPU_DEPTH_TOLERANCE * depth of it.
+// Weights are 0 or 1, so the SIMD kernels give the same results as the scalar one.
+#ifndef SPD_CPU_DEPTH_TOLERANCE
+#define SPD_CPU_DEPTH_TOLERANCE 0.05f
+#endif
+
+A_STATIC void SpdCpuReduce4DepthAware(outAF4 d, inAF4 v0, inAF4 v1, inAF4 v2, inAF4 v3, bool reversed)
+{
+    AF1 nearest = reversed ? AMaxF1(AMaxF1(v0[3], v1[3]), AMaxF1(v2[3], v3[3])) :
+        AMinF1(AMinF1(v0[3], v1[3]), AMinF1(v2[3], v3[3]));
+    AF1 tolerance = AF1(SPD_CPU_DEPTH_TOLERANCE) * fabsf(nearest);
+    AF1 w0 = fabsf(v0[3] - nearest) <= tolerance ? 1.0f : 0.0f;
+    AF1 w1 = fabsf(v1[3] - nearest) <= tolerance ? 1.0f : 0.0f;
+    AF1 w2 = fabsf(v2[3] - nearest) <= tolerance ? 1.0f : 0.0f;
+    AF1 w3 = fabsf(v3[3] - nearest) <= tolerance ? 1.0f : 0.0f;
+    AF1 scale = 1.0f / (w0 + w1 + w2 + w3);
+    for (AU1 c = 0; c < 3; c++)
+        d[c] = (v0[c] * w0 + v1[c] * w1 + v2[c] * w2 + v3[c] * w3) * scale;
+    d[3] = nearest;
+}
+
+A_STATIC void SpdCpuReduceRowDepthAware(AB1 *A_RESTRICT dst, const AB1 *A_RESTRICT row0, const AB1 *A_RESTRICT row1,
+    AU1 x, AU1 count, AU1 inWidth, bool reversed)
+{
+    const AF1 *r0 = (const AF1*)row0;
+    const AF1 *r1 = (const AF1*)row1;
+    AF1 *d = (AF1*)dst + x * 4;
+    for (AU1 i = x; i < x + count; i++, d += 4)
+    {
+        AU1 c0 = AMinU1(i * 2 + 0, inWidth - 1) * 4;
+        AU1 c1 = AMinU1(i * 2 + 1, inWidth - 1) * 4;
+        varAF4(v0) = initAF4(r0[c0 + 0], r0[c0 + 1], r0[c0 + 2], r0[c0 + 3]);
+        varAF4(v1) = initAF4(r0[c1 + 0], r0[c1 + 1], r0[c1 + 2], r0[c1 + 3]);
+        varAF4(v2) = initAF4(r1[c0 + 0], r1[c0 + 1], r1[c0 + 2], r1[c0 + 3]);
+        varAF4(v3) = initAF4(r1[c1 + 0], r1[c1 + 1], r1[c1 + 2], r1[c1 + 3]);
+        SpdCpuReduce4DepthAware(d, v0, v1, v2, v3, reversed);
+    }
+}
+
+// Row kernels of the two depth aware formats for one ISA suffix
+#define SPD_CPU_DEPTH_AWARE_KERNELS(isa) \
+    A_STATIC void SpdCpuReduceRowRGBA32FDepthAware##isa(AB1 *A_RESTRICT dst, const AB1 *A_RESTRICT row0, \
+        const AB1 *A_RESTRICT row1, AU1 x, AU1 count, AU1 inWidth) \
+        { SpdCpuReduceRowDepthAware##isa(dst, row0, row1, x, count, inWidth, false); } \
+    A_STATIC void SpdCpuReduceRowRGBA32FDepthAwareMax##isa(AB1 *A_RESTRICT dst, const AB1 *A_RESTRICT row0, \
+        const AB1 *A_RESTRICT row1, AU1 x, AU1 count, AU1 inWidth) \
+        { SpdCpuReduceRowDepthAware##isa(dst, row0, row1, x, count, inWidth, true); }
+
+SPD_CPU_DEPTH_AWARE_KERNELS()
+
+//==============================================================================================================================
+//                                                     MULTI TARGET
+//==============================================================================================================================
+// The depth and velocity formats of SPD_MULTI_TARGET, color uses RGBA32F. Level 0 of RG32FMinMax holds the depth in R and G.
+// Of each 2x2 quad v0 v1 | v2 v3 the top and bottom texels are combined first, min(min(v0, v2), min(v1, v3)), so the SIMD
+// kernels that work on the even and odd columns give the same results, even for -0 and +0.
+A_STATIC void SpdCpuReduceRowRG32FMinMax(AB1 *A_RESTRICT dst, const AB1 *A_RESTRICT row0, const AB1 *A_RESTRICT row1,
+    AU1 x, AU1 count, AU1 inWidth)
+{
+    const AF1 *r0 = (const AF1*)row0;
+    const AF1 *r1 = (const AF1*)row1;
+    AF1 *d = (AF1*)dst + x * 2;
+    for (AU1 i = x; i < x + count; i++, d += 2)
+    {
+        AU1 c0 = AMinU1(i * 2 + 0, inWidth - 1) * 2;
+        AU1 c1 = AMinU1(i * 2 + 1, inWidth - 1) * 2;
+        d[0] = AMinF1(AMinF1(r0[c0], r1[c0]), AMinF1(r0[c1], r1[c1]));
+        d[1] = AMaxF1(AMaxF1(r0[c0 + 1], r1[c0 + 1]), AMaxF1(r0[c1 + 1], r1[c1 + 1]));
+    }
+}
+
+// Longest of the four motion vectors in the order v0, v1, v2, v3, a later one has to be strictly longer
+A_STATIC void SpdCpuReduceRowRG32FMaxLength(AB1 *A_RESTRICT dst, const AB1 *A_RESTRICT row0, const AB1 *A_RESTRICT row1,
+    AU1 x, AU1 count, AU1 inWidth)
+{
+    const AF1 *r0 = (const AF1*)row0;
+    const AF1 *r1 = (const AF1*)row1;
+    AF1 *d = (AF1*)dst + x * 2;
+    for (AU1 i = x; i < x + count; i++, d += 2)
+    {
+        AU1 c0 = AMinU1(i * 2 + 0, inWidth - 1) * 2;
+        AU1 c1 = AMinU1(i * 2 + 1, inWidth - 1) * 2;
+        const AF1 *v[4] = { r0 + c0, r0 + c1, r1 + c0, r1 + c1 };
+        const AF1 *longest = v[0];
+        AF1 longestLength = v[0][0] * v[0][0] + v[0][1] * v[0][1];
+        for (AU1 j = 1; j < 4; j++)
+        {
+            AF1 length = v[j][0] * v[j][0] + v[j][1] * v[j][1];
+            if (length > longestLength)
+            {
+                longest = v[j];
+                longestLength = length;
+            }
+        }
+        d[0] = longest[0];
+        d[1] = longest[1];
+    }
+}
+
+//==============================================================================================================================
+//                                                     SIMD ROW KERNELS
+//==============================================================================================================================
+// Same operations in the same order as the scalar kernels, so every ISA produces identical results.
+// The SIMD loop covers the output texels whose input columns are all inside the row, the scalar kernel does the clamped rest.
+#ifdef SPD_CPU_SIMD
+
+SPD_CPU_TARGET("sse4.1")
+A_STATIC void SpdCpuReduceRowRGBA32F_SSE41(AB1 *A_RESTRICT dst, const AB1 *A_RESTRICT row0, const AB1 *A_RESTRICT row1,
+    AU1 x, AU1 count, AU1 inWidth)
+{
+    const AF1 *r0 = (const AF1*)row0;
+    const AF1 *r1 = (const AF1*)row1;
+    AF1 *d = (AF1*)dst;
+    const __m128 quarter = _mm_set1_ps(0.25f);
+    AU1 end = x + count;
+    AU1 simdEnd = AMinU1(end, inWidth / 2);
+    AU1 i = x;
+    for (; i < simdEnd; i++)
+    {
+        __m128 v = _mm_add_ps(_mm_loadu_ps(r0 + i * 8), _mm_loadu_ps(r0 + i * 8 + 4));
+        v = _mm_add_ps(v, _mm_loadu_ps(r1 + i * 8));
+        v = _mm_add_ps(v, _mm_loadu_ps(r1 + i * 8 + 4));
+        _mm_storeu_ps(d + i * 4, _mm_mul_ps(v, quarter));
+    }
+    if (i < end)
+        SpdCpuReduceRowRGBA32F(dst, row0, row1, i, end - i, inWidth);
+}
+
+// 2 output texels per iteration, input texels t0 t1 | t2 t3 are regrouped into t0 t2 | t1 t3
+SPD_CPU_TARGET("avx2")
+A_STATIC void SpdCpuReduceRowRGBA32F_AVX2(AB1 *A_RESTRICT dst, const AB1 *A_RESTRICT row0, const AB1 *A_RESTRICT row1,
+    AU1 x, AU1 count, AU1 inWidth)
+{
+    const AF1 *r0 = (const AF1*)row0;
+    const AF1 *r1 = (const AF1*)row1;
+    AF1 *d = (AF1*)dst;
+    const __m256 quarter = _mm256_set1_ps(0.25f);
+    AU1 end = x + count;
+    AU1 simdEnd = AMinU1(end, inWidth / 2);
+    AU1 i = x;
+    for (; i + 2 <= simdEnd; i += 2)
+    {
+        __m256 a0 = _mm256_loadu_ps(r0 + i * 8);
+        __m256 a1 = _mm256_loadu_ps(r0 + i * 8 + 8);
+        __m256 b0 = _mm256_loadu_ps(r1 + i * 8);
+        __m256 b1 = _mm256_loadu_ps(r1 + i * 8 + 8);
+        __m256 v = _mm256_add_ps(_mm256_permute2f128_ps(a0, a1, 0x20), _mm256_permute2f128_ps(a0, a1, 0x31));
+        v = _mm256_add_ps(v, _mm256_permute2f128_ps(b0, b1, 0x20));
+        v = _mm256_add_ps(v, _mm256_permute2f128_ps(b0, b1, 0x31));
+        _mm256_storeu_ps(d + i * 4, _mm256_mul_ps(v, quarter));
+    }
+    if (i < end)
+        SpdCpuReduceRowRGBA32F(dst, row0, row1, i, end - i, inWidth);
+}
+
+// 4 output texels per iteration, even and odd input texels are split with 128-bit lane shuffles
+SPD_CPU_TARGET("avx512f,avx512bw")
+A_STATIC void SpdCpuReduceRowRGBA32F_AVX512(AB1 *A_RESTRICT dst, const AB1 *A_RESTRICT row0, const AB1 *A_RESTRICT row1,
+    AU1 x, AU1 count, AU1 inWidth)
+{
+    const AF1 *r0 = (const AF1*)row0;
+    const AF1 *r1 = (const AF1*)row1;
+    AF1 *d = (AF1*)dst;
+    const __m512 quarter = _mm512_set1_ps(0.25f);
+    AU1 end = x + count;
+    AU1 simdEnd = AMinU1(end, inWidth / 2);
+    AU1 i = x;
+    for (; i + 4 <= simdEnd; i += 4)
+    {
+        __m512 a0 = _mm512_loadu_ps(r0 + i * 8);
+        __m512 a1 = _mm512_loadu_ps(r0 + i * 8 + 16);
+        __m512 b0 = _mm512_loadu_ps(r1 + i * 8);
+        __m512 b1 = _mm512_loadu_ps(r1 + i * 8 + 16);
+        __m512 v = _mm512_add_ps(_mm512_shuffle_f32x4(a0, a1, 0x88), _mm512_shuffle_f32x4(a0, a1, 0xDD));
+        v = _mm512_add_ps(v, _mm512_shuffle_f32x4(b0, b1, 0x88));
+        v = _mm512_add_ps(v, _mm512_shuffle_f32x4(b0, b1, 0xDD));
+        _mm512_storeu_ps(d + i * 4, _mm512_mul_ps(v, quarter));
+    }
+    if (i < end)
+        SpdCpuReduceRowRGBA32F(dst, row0, row1, i, end - i, inWidth);
+}
+
+SPD_CPU_TARGET("sse4.1")
+A_STATIC __m128 SpdCpuUnpackUnorm8_SSE41(__m128i v)
+{
+    return _mm_mul_ps(_mm_cvtepi32_ps(_mm_cvtepu8_epi32(v)), _mm_set1_ps(1.0f / 255.0f));
+}
+
+SPD_CPU_TARGET("sse4.1")
+A_STATIC void SpdCpuReduceRowRGBA8Unorm_SSE41(AB1 *A_RESTRICT dst, const AB1 *A_RESTRICT row0, const AB1 *A_RESTRICT row1,
+    AU1 x, AU1 count, AU1 inWidth)
+{
+    const __m128 quarter = _mm_set1_ps(0.25f);
+    AU1 end = x + count;
+    AU1 simdEnd = AMinU1(end, inWidth / 2);
+    AU1 i = x;
+    for (; i < simdEnd; i++)
+    {
+        __m128i a = _mm_loadl_epi64((const __m128i*)(row0 + i * 8));
+        __m128i b = _mm_loadl_epi64((const __m128i*)(row1 + i * 8));
+        __m128 v = _mm_add_ps(SpdCpuUnpackUnorm8_SSE41(a), SpdCpuUnpackUnorm8_SSE41(_mm_srli_si128(a, 4)));
+        v = _mm_add_ps(v, SpdCpuUnpackUnorm8_SSE41(b));
+        v = _mm_add_ps(v, SpdCpuUnpackUnorm8_SSE41(_mm_srli_si128(b, 4)));
+        v = _mm_min_ps(_mm_max_ps(_mm_mul_ps(v, quarter), _mm_setzero_ps()), _mm_set1_ps(1.0f));
+        __m128i o = _mm_cvttps_epi32(_mm_add_ps(_mm_mul_ps(v, _mm_set1_ps(255.0f)), _mm_set1_ps(0.5f)));
+        o = _mm_packus_epi16(_mm_packus_epi32(o, o), o);
+        AU1 packed = AU1(_mm_cvtsi128_si32(o));
+        memcpy(dst + i * 4, &packed, 4);
+    }
+    if (i < end)
+        SpdCpuReduceRowRGBA8Unorm(dst, row0, row1, i, end - i, inWidth);
+}
+
+SPD_CPU_TARGET("avx2")
+A_STATIC __m256 SpdCpuUnpackUnorm8_AVX2(__m128i v)
+{
+    return _mm256_mul_ps(_mm256_cvtepi32_ps(_mm256_cvtepu8_epi32(v)), _mm256_set1_ps(1.0f / 255.0f));
+}
+
+SPD_CPU_TARGET("avx2")
+A_STATIC void SpdCpuReduceRowRGBA8Unorm_AVX2(AB1 *A_RESTRICT dst, const AB1 *A_RESTRICT row0, const AB1 *A_RESTRICT row1,
+    AU1 x, AU1 count, AU1 inWidth)
+{
+    const __m256 quarter = _mm256_set1_ps(0.25f);
+    AU1 end = x + count;
+    AU1 simdEnd = AMinU1(end, inWidth / 2);
+    AU1 i = x;
+    for (; i + 2 <= simdEnd; i += 2)
+    {
+        __m128i a = _mm_loadu_si128((const __m128i*)(row0 + i * 8));
+        __m128i b = _mm_loadu_si128((const __m128i*)(row1 + i * 8));
+        __m256 a0 = SpdCpuUnpackUnorm8_AVX2(a);
+        __m256 a1 = SpdCpuUnpackUnorm8_AVX2(_mm_srli_si128(a, 8));
+        __m256 b0 = SpdCpuUnpackUnorm8_AVX2(b);
+        __m256 b1 = SpdCpuUnpackUnorm8_AVX2(_mm_srli_si128(b, 8));
+        __m256 v = _mm256_add_ps(_mm256_permute2f128_ps(a0, a1, 0x20), _mm256_permute2f128_ps(a0, a1, 0x31));
+        v = _mm256_add_ps(v, _mm256_permute2f128_ps(b0, b1, 0x20));
+        v = _mm256_add_ps(v, _mm256_permute2f128_ps(b0, b1, 0x31));
+        v = _mm256_min_ps(_mm256_max_ps(_mm256_mul_ps(v, quarter), _mm256_setzero_ps()), _mm256_set1_ps(1.0f));
+        __m256i o = _mm256_cvttps_epi32(_mm256_add_ps(_mm256_mul_ps(v, _mm256_set1_ps(255.0f)), _mm256_set1_ps(0.5f)));
+        o = _mm256_packus_epi16(_mm256_packus_epi32(o, o), o);
+        AU1 packed[2] = { AU1(_mm_cvtsi128_si32(_mm256_castsi256_si128(o))), AU1(_mm_cvtsi128_si32(_mm256_extracti128_si256(o, 1))) };
+        memcpy(dst + i * 4, packed, 8);
+    }
+    if (i < end)
+        SpdCpuReduceRowRGBA8Unorm(dst, row0, row1, i, end - i, inWidth);
+}
+
+SPD_CPU_TARGET("avx512f,avx512bw")
+A_STATIC __m512 SpdCpuUnpackUnorm8_AVX512(__m128i v)
+{
+    return _mm512_mul_ps(_mm512_cvtepi32_ps(_mm512_cvtepu8_epi32(v)), _mm512_set1_ps(1.0f / 255.0f));
+}
+
+SPD_CPU_TARGET("avx512f,avx512bw")
+A_STATIC void SpdCpuReduceRowRGBA8Unorm_AVX512(AB1 *A_RESTRICT dst, const AB1 *A_RESTRICT row0, const AB1 *A_RESTRICT row1,
+    AU1 x, AU1 count, AU1 inWidth)
+{
+    const __m512 quarter = _mm512_set1_ps(0.25f);
+    AU1 end = x + count;
+    AU1 simdEnd = AMinU1(end, inWidth / 2);
+    AU1 i = x;
+    for (; i + 4 <= simdEnd; i += 4)
+    {
+        __m256i a = _mm256_loadu_si256((const __m256i*)(row0 + i * 8));
+        __m256i b = _mm256_loadu_si256((const __m256i*)(row1 + i * 8));
+        __m512 a0 = SpdCpuUnpackUnorm8_AVX512(_mm256_castsi256_si128(a));
+        __m512 a1 = SpdCpuUnpackUnorm8_AVX512(_mm256_extracti128_si256(a, 1));
+        __m512 b0 = SpdCpuUnpackUnorm8_AVX512(_mm256_castsi256_si128(b));
+        __m512 b1 = SpdCpuUnpackUnorm8_AVX512(_mm256_extracti128_si256(b, 1));
+        __m512 v = _mm512_add_ps(_mm512_shuffle_f32x4(a0, a1, 0x88), _mm512_shuffle_f32x4(a0, a1, 0xDD));
+        v = _mm512_add_ps(v, _mm512_shuffle_f32x4(b0, b1, 0x88));
+        v = _mm512_add_ps(v, _mm512_shuffle_f32x4(b0, b1, 0xDD));
+        v = _mm512_min_ps(_mm512_max_ps(_mm512_mul_ps(v, quarter), _mm512_setzero_ps()), _mm512_set1_ps(1.0f));
+        __m512i o = _mm512_cvttps_epi32(_mm512_add_ps(_mm512_mul_ps(v, _mm512_set1_ps(255.0f)), _mm512_set1_ps(0.5f)));
+        _mm_storeu_si128((__m128i*)(dst + i * 4), _mm512_cvtusepi32_epi8(o));
+    }
+    if (i < end)
+        SpdCpuReduceRowRGBA8Unorm(dst, row0, row1, i, end - i, inWidth);
+}
+
+// Fixed point kernels: bytes are widened to 16-bit words, one texel is then 64 bits. Even and odd input texels are split
+// with 64-bit unpacks, summed and rounded, and narrowed back with a saturating pack.
+SPD_CPU_TARGET("sse4.1")
+A_STATIC __m128i SpdCpuSumTexelPairs_SSE41(__m128i row0, __m128i row1)
+{
+    const __m128i zero = _mm_setzero_si128();
+    __m128i lo = _mm_add_epi16(_mm_unpacklo_epi8(row0, zero), _mm_unpacklo_epi8(row1, zero));
+    __m128i hi = _mm_add_epi16(_mm_unpackhi_epi8(row0, zero), _mm_unpackhi_epi8(row1, zero));
+    return _mm_add_epi16(_mm_unpacklo_epi64(lo, hi), _mm_unpackhi_epi64(lo, hi));
+}
+
+// 4 output texels per iteration
+SPD_CPU_TARGET("sse4.1")
+A_STATIC void SpdCpuReduceRowRGBA8UnormFixed_SSE41(AB1 *A_RESTRICT dst, const AB1 *A_RESTRICT row0,
+    const AB1 *A_RESTRICT row1, AU1 x, AU1 count, AU1 inWidth)
+{
+    const __m128i two = _mm_set1_epi16(2);
+    AU1 end = x + count;
+    AU1 simdEnd = AMinU1(end, inWidth / 2);
+    AU1 i = x;
+    for (; i + 4 <= simdEnd; i += 4)
+    {
+        __m128i a = SpdCpuSumTexelPairs_SSE41(_mm_loadu_si128((const __m128i*)(row0 + i * 8)),
+            _mm_loadu_si128((const __m128i*)(row1 + i * 8)));
+        __m128i b = SpdCpuSumTexelPairs_SSE41(_mm_loadu_si128((const __m128i*)(row0 + i * 8 + 16)),
+            _mm_loadu_si128((const __m128i*)(row1 + i * 8 + 16)));
+        a = _mm_srli_epi16(_mm_add_epi16(a, two), 2);
+        b = _mm_srli_epi16(_mm_add_epi16(b, two), 2);
+        _mm_storeu_si128((__m128i*)(dst + i * 4), _mm_packus_epi16(a, b));
+    }
+    if (i < end)
+        SpdCpuReduceRowRGBA8UnormFixed(dst, row0, row1, i, end - i, inWidth);
+}
+
+SPD_CPU_TARGET("avx2")
+A_STATIC __m256i SpdCpuSumTexelPairs_AVX2(__m256i row0, __m256i row1)
+{
+    const __m256i zero = _mm256_setzero_si256();
+    __m256i lo = _mm256_add_epi16(_mm256_unpacklo_epi8(row0, zero), _mm256_unpacklo_epi8(row1, zero));
+    __m256i hi = _mm256_add_epi16(_mm256_unpackhi_epi8(row0, zero), _mm256_unpackhi_epi8(row1, zero));
+    return _mm256_add_epi16(_mm256_unpacklo_epi64(lo, hi), _mm256_unpackhi_epi64(lo, hi));
+}
+
+// 8 output texels per iteration, the pack interleaves the 128-bit lanes which is undone with one qword permute
+SPD_CPU_TARGET("avx2")
+A_STATIC void SpdCpuReduceRowRGBA8UnormFixed_AVX2(AB1 *A_RESTRICT dst, const AB1 *A_RESTRICT row0,
+    const AB1 *A_RESTRICT row1, AU1 x, AU1 count, AU1 inWidth)
+{
+    const __m256i two = _mm256_set1_epi16(2);
+    AU1 end = x + count;
+    AU1 simdEnd = AMinU1(end, inWidth / 2);
+    AU1 i = x;
+    for (; i + 8 <= simdEnd; i += 8)
+    {
+        __m256i a = SpdCpuSumTexelPairs_AVX2(_mm256_loadu_si256((const __m256i*)(row0 + i * 8)),
+            _mm256_loadu_si256((const __m256i*)(row1 + i * 8)));
+        __m256i b = SpdCpuSumTexelPairs_AVX2(_mm256_loadu_si256((const __m256i*)(row0 + i * 8 + 32)),
+            _mm256_loadu_si256((const __m256i*)(row1 + i * 8 + 32)));
+        a = _mm256_srli_epi16(_mm256_add_epi16(a, two), 2);
+        b = _mm256_srli_epi16(_mm256_add_epi16(b, two), 2);
+        __m256i o = _mm256_permute4x64_epi64(_mm256_packus_epi16(a, b), 0xD8);
+        _mm256_storeu_si256((__m256i*)(dst + i * 4), o);
+    }
+    if (i < end)
+        SpdCpuReduceRowRGBA8UnormFixed(dst, row0, row1, i, end - i, inWidth);
+}
+
+SPD_CPU_TARGET("avx512f,avx512bw")
+A_STATIC __m512i SpdCpuSumTexelPairs_AVX512(__m512i row0, __m512i row1)
+{
+    const __m512i zero = _mm512_setzero_si512();
+    __m512i lo = _mm512_add_epi16(_mm512_unpacklo_epi8(row0, zero), _mm512_unpacklo_epi8(row1, zero));
+    __m512i hi = _mm512_add_epi16(_mm512_unpackhi_epi8(row0, zero), _mm512_unpackhi_epi8(row1, zero));
+    return _mm512_add_epi16(_mm512_unpacklo_epi64(lo, hi), _mm512_unpackhi_epi64(lo, hi));
+}
+
+// 16 output texels per iteration
+SPD_CPU_TARGET("avx512f,avx512bw")
+A_STATIC void SpdCpuReduceRowRGBA8UnormFixed_AVX512(AB1 *A_RESTRICT dst, const AB1 *A_RESTRICT row0,
+    const AB1 *A_RESTRICT row1, AU1 x, AU1 count, AU1 inWidth)
+{
+    const __m512i two = _mm512_set1_epi16(2);
+    const __m512i order = _mm512_set_epi64(7, 5, 3, 1, 6, 4, 2, 0);
+    AU1 end = x + count;
+    AU1 simdEnd = AMinU1(end, inWidth / 2);
+    AU1 i = x;
+    for (; i + 16 <= simdEnd; i += 16)
+    {
+        __m512i a = SpdCpuSumTexelPairs_AVX512(_mm512_loadu_si512(row0 + i * 8), _mm512_loadu_si512(row1 + i * 8));
+        __m512i b = SpdCpuSumTexelPairs_AVX512(_mm512_loadu_si512(row0 + i * 8 + 64),
+            _mm512_loadu_si512(row1 + i * 8 + 64));
+        a = _mm512_srli_epi16(_mm512_add_epi16(a, two), 2);
+        b = _mm512_srli_epi16(_mm512_add_epi16(b, two), 2);
+        _mm512_storeu_si512(dst + i * 4, _mm512_permutexvar_epi64(order, _mm512_packus_epi16(a, b)));
+    }
+    if (i < end)
+        SpdCpuReduceRowRGBA8UnormFixed(dst, row0, row1, i, end - i, inWidth);
+}
+
+// Single channel kernels: neighbouring bytes are summed with a multiply-add against 1 (words are split into their 32-bit
+// halves), both rows are added, rounded and packed back. The pack works per 128-bit lane, a qword permute restores the order.
+// A row of a tile is often narrower than one AVX-512 iteration, so each kernel hands the rest to the next narrower one.
+SPD_CPU_TARGET("sse4.1")
+A_STATIC __m128i SpdCpuSumPairsR8_SSE41(__m128i row0, __m128i row1)
+{
+    const __m128i one = _mm_set1_epi8(1);
+    return _mm_add_epi16(_mm_maddubs_epi16(row0, one), _mm_maddubs_epi16(row1, one));
+}
+
+// 16 output texels per iteration
+SPD_CPU_TARGET("sse4.1")
+A_STATIC void SpdCpuReduceRowR8Unorm_SSE41(AB1 *A_RESTRICT dst, const AB1 *A_RESTRICT row0, const AB1 *A_RESTRICT row1,
+    AU1 x, AU1 count, AU1 inWidth)
+{
+    const __m128i two = _mm_set1_epi16(2);
+    AU1 end = x + count;
+    AU1 simdEnd = AMinU1(end, inWidth / 2);
+    AU1 i = x;
+    for (; i + 16 <= simdEnd; i += 16)
+    {
+        __m128i a = SpdCpuSumPairsR8_SSE41(_mm_loadu_si128((const __m128i*)(row0 + i * 2)),
+            _mm_loadu_si128((const __m128i*)(row1 + i * 2)));
+        __m128i b = SpdCpuSumPairsR8_SSE41(_mm_loadu_si128((const __m128i*)(row0 + i * 2 + 16)),
+            _mm_loadu_si128((const __m128i*)(row1 + i * 2 + 16)));
+        a = _mm_srli_epi16(_mm_add_epi16(a, two), 2);
+        b = _mm_srli_epi16(_mm_add_epi16(b, two), 2);
+        _mm_storeu_si128((__m128i*)(dst + i), _mm_packus_epi16(a, b));
+    }
+    if (i < end)
+        SpdCpuReduceRowR8Unorm(dst, row0, row1, i, end - i, inWidth);
+}
+
+SPD_CPU_TARGET("avx2")
+A_STATIC __m256i SpdCpuSumPairsR8_AVX2(__m256i row0, __m256i row1)
+{
+    const __m256i one = _mm256_set1_epi8(1);
+    return _mm256_add_epi16(_mm256_maddubs_epi16(row0, one), _mm256_maddubs_epi16(row1, one));
+}
+
+// 32 output texels per iteration
+SPD_CPU_TARGET("avx2")
+A_STATIC void SpdCpuReduceRowR8Unorm_AVX2(AB1 *A_RESTRICT dst, const AB1 *A_RESTRICT row0, const AB1 *A_RESTRICT row1,
+    AU1 x, AU1 count, AU1 inWidth)
+{
+    const __m256i two = _mm256_set1_epi16(2);
+    AU1 end = x + count;
+    AU1 simdEnd = AMinU1(end, inWidth / 2);
+    AU1 i = x;
+    for (; i + 32 <= simdEnd; i += 32)
+    {
+        __m256i a = SpdCpuSumPairsR8_AVX2(_mm256_loadu_si256((const __m256i*)(row0 + i * 2)),
+            _mm256_loadu_si256((const __m256i*)(row1 + i * 2)));
+        __m256i b = SpdCpuSumPairsR8_AVX2(_mm256_loadu_si256((const __m256i*)(row0 + i * 2 + 32)),
+            _mm256_loadu_si256((const __m256i*)(row1 + i * 2 + 32)));
+        a = _mm256_srli_epi16(_mm256_add_epi16(a, two), 2);
+        b = _mm256_srli_epi16(_mm256_add_epi16(b, two), 2);
+        _mm256_storeu_si256((__m256i*)(dst + i), _mm256_permute4x64_epi64(_mm256_packus_epi16(a, b), 0xD8));
+    }
+    if (i < end)
+        SpdCpuReduceRowR8Unorm_SSE41(dst, row0, row1, i, end - i, inWidth);
+}
+
+SPD_CPU_TARGET("avx512f,avx512bw")
+A_STATIC __m512i SpdCpuSumPairsR8_AVX512(__m512i row0, __m512i row1)
+{
+    const __m512i one = _mm512_set1_epi8(1);
+    return _mm512_add_epi16(_mm512_maddubs_epi16(row0, one), _mm512_maddubs_epi16(row1, one));
+}
+
+// 64 output texels per iteration
+SPD_CPU_TARGET("avx512f,avx512bw")
+A_STATIC void SpdCpuReduceRowR8Unorm_AVX512(AB1 *A_RESTRICT dst, const AB1 *A_RESTRICT row0, const AB1 *A_RESTRICT row1,
+    AU1 x, AU1 count, AU1 inWidth)
+{
+    const __m512i two = _mm512_set1_epi16(2);
+    const __m512i order = _mm512_set_epi64(7, 5, 3, 1, 6, 4, 2, 0);
+    AU1 end = x + count;
+    AU1 simdEnd = AMinU1(end, inWidth / 2);
+    AU1 i = x;
+    for (; i + 64 <= simdEnd; i += 64)
+    {
+        __m512i a = SpdCpuSumPairsR8_AVX512(_mm512_loadu_si512(row0 + i * 2), _mm512_loadu_si512(row1 + i * 2));
+        __m512i b = SpdCpuSumPairsR8_AVX512(_mm512_loadu_si512(row0 + i * 2 + 64), _mm512_loadu_si512(row1 + i * 2 + 64));
+        a = _mm512_srli_epi16(_mm512_add_epi16(a, two), 2);
+        b = _mm512_srli_epi16(_mm512_add_epi16(b, two), 2);
+        _mm512_storeu_si512(dst + i, _mm512_permutexvar_epi64(order, _mm512_packus_epi16(a, b)));
+    }
+    if (i < end)
+        SpdCpuReduceRowR8Unorm_AVX2(dst, row0, row1, i, end - i, inWidth);
+}
+
+SPD_CPU_TARGET("sse4.1")
+A_STATIC __m128i SpdCpuSumPairsR16_SSE41(__m128i row0, __m128i row1)
+{
+    const __m128i low = _mm_set1_epi32(0xFFFF);
+    __m128i v0 = _mm_add_epi32(_mm_and_si128(row0, low), _mm_srli_epi32(row0, 16));
+    __m128i v1 = _mm_add_epi32(_mm_and_si128(row1, low), _mm_srli_epi32(row1, 16));
+    return _mm_add_epi32(v0, v1);
+}
+
+// 8 output texels per iteration
+SPD_CPU_TARGET("sse4.1")
+A_STATIC void SpdCpuReduceRowR16Unorm_SSE41(AB1 *A_RESTRICT dst, const AB1 *A_RESTRICT row0, const AB1 *A_RESTRICT row1,
+    AU1 x, AU1 count, AU1 inWidth)
+{
+    const __m128i two = _mm_set1_epi32(2);
+    AU1 end = x + count;
+    AU1 simdEnd = AMinU1(end, inWidth / 2);
+    AU1 i = x;
+    for (; i + 8 <= simdEnd; i += 8)
+    {
+        __m128i a = SpdCpuSumPairsR16_SSE41(_mm_loadu_si128((const __m128i*)(row0 + i * 4)),
+            _mm_loadu_si128((const __m128i*)(row1 + i * 4)));
+        __m128i b = SpdCpuSumPairsR16_SSE41(_mm_loadu_si128((const __m128i*)(row0 + i * 4 + 16)),
+            _mm_loadu_si128((const __m128i*)(row1 + i * 4 + 16)));
+        a = _mm_srli_epi32(_mm_add_epi32(a, two), 2);
+        b = _mm_srli_epi32(_mm_add_epi32(b, two), 2);
+        _mm_storeu_si128((__m128i*)(dst + i * 2), _mm_packus_epi32(a, b));
+    }
+    if (i < end)
+        SpdCpuReduceRowR16Unorm(dst, row0, row1, i, end - i, inWidth);
+}
+
+SPD_CPU_TARGET("avx2")
+A_STATIC __m256i SpdCpuSumPairsR16_AVX2(__m256i row0, __m256i row1)
+{
+    const __m256i low = _mm256_set1_epi32(0xFFFF);
+    __m256i v0 = _mm256_add_epi32(_mm256_and_si256(row0, low), _mm256_srli_epi32(row0, 16));
+    __m256i v1 = _mm256_add_epi32(_mm256_and_si256(row1, low), _mm256_srli_epi32(row1, 16));
+    return _mm256_add_epi32(v0, v1);
+}
+
+// 16 output texels per iteration
+SPD_CPU_TARGET("avx2")
+A_STATIC void SpdCpuReduceRowR16Unorm_AVX2(AB1 *A_RESTRICT dst, const AB1 *A_RESTRICT row0, const AB1 *A_RESTRICT row1,
+    AU1 x, AU1 count, AU1 inWidth)
+{
+    const __m256i two = _mm256_set1_epi32(2);
+    AU1 end = x + count;
+    AU1 simdEnd = AMinU1(end, inWidth / 2);
+    AU1 i = x;
+    for (; i + 16 <= simdEnd; i += 16)
+    {
+        __m256i a = SpdCpuSumPairsR16_AVX2(_mm256_loadu_si256((const __m256i*)(row0 + i * 4)),
+            _mm256_loadu_si256((const __m256i*)(row1 + i * 4)));
+        __m256i b = SpdCpuSumPairsR16_AVX2(_mm256_loadu_si256((const __m256i*)(row0 + i * 4 + 32)),
+            _mm256_loadu_si256((const __m256i*)(row1 + i * 4 + 32)));
+        a = _mm256_srli_epi32(_mm256_add_epi32(a, two), 2);
+        b = _mm256_srli_epi32(_mm256_add_epi32(b, two), 2);
+        _mm256_storeu_si256((__m256i*)(dst + i * 2), _mm256_permute4x64_epi64(_mm256_packus_epi32(a, b), 0xD8));
+    }
+    if (i < end)
+        SpdCpuReduceRowR16Unorm_SSE41(dst, row0, row1, i, end - i, inWidth);
+}
+
+SPD_CPU_TARGET("avx512f,avx512bw")
+A_STATIC __m512i SpdCpuSumPairsR16_AVX512(__m512i row0, __m512i row1)
+{
+    const __m512i low = _mm512_set1_epi32(0xFFFF);
+    __m512i v0 = _mm512_add_epi32(_mm512_and_si512(row0, low), _mm512_srli_epi32(row0, 16));
+    __m512i v1 = _mm512_add_epi32(_mm512_and_si512(row1, low), _mm512_srli_epi32(row1, 16));
+    return _mm512_add_epi32(v0, v1);
+}
+
+// 32 output texels per iteration
+SPD_CPU_TARGET("avx512f,avx512bw")
+A_STATIC void SpdCpuReduceRowR16Unorm_AVX512(AB1 *A_RESTRICT dst, const AB1 *A_RESTRICT row0, const AB1 *A_RESTRICT row1,
+    AU1 x, AU1 count, AU1 inWidth)
+{
+    const __m512i two = _mm512_set1_epi32(2);
+    const __m512i order = _mm512_set_epi64(7, 5, 3, 1, 6, 4, 2, 0);
+    AU1 end = x + count;
+    AU1 simdEnd = AMinU1(end, inWidth / 2);
+    AU1 i = x;
+    for (; i + 32 <= simdEnd; i += 32)
+    {
+        __m512i a = SpdCpuSumPairsR16_AVX512(_mm512_loadu_si512(row0 + i * 4), _mm512_loadu_si512(row1 + i * 4));
+        __m512i b = SpdCpuSumPairsR16_AVX512(_mm512_loadu_si512(row0 + i * 4 + 64), _mm512_loadu_si512(row1 + i * 4 + 64));
+        a = _mm512_srli_epi32(_mm512_add_epi32(a, two), 2);
+        b = _mm512_srli_epi32(_mm512_add_epi32(b, two), 2);
+        _mm512_storeu_si512(dst + i * 2, _mm512_permutexvar_epi64(order, _mm512_packus_epi32(a, b)));
+    }
+    if (i < end)
+        SpdCpuReduceRowR16Unorm_AVX2(dst, row0, row1, i, end - i, inWidth);
+}
+
+// Max height kernels: maximum of the two rows, then of the two words of each 32-bit pair, packed like the R16 kernels
+SPD_CPU_TARGET("sse4.1")
+A_STATIC __m128i SpdCpuMaxPairsR16_SSE41(__m128i row0, __m128i row1)
+{
+    __m128i v = _mm_max_epu16(row0, row1);
+    return _mm_max_epi32(_mm_and_si128(v, _mm_set1_epi32(0xFFFF)), _mm_srli_epi32(v, 16));
+}
+
+// 8 output texels per iteration
+SPD_CPU_TARGET("sse4.1")
+A_STATIC void SpdCpuReduceRowR16UnormMaxHeight_SSE41(AB1 *A_RESTRICT dst, const AB1 *A_RESTRICT row0,
+    const AB1 *A_RESTRICT row1, AU1 x, AU1 count, AU1 inWidth)
+{
+    AU1 end = x + count;
+    AU1 simdEnd = AMinU1(end, inWidth / 2);
+    AU1 i = x;
+    for (; i + 8 <= simdEnd; i += 8)
+    {
+        __m128i a = SpdCpuMaxPairsR16_SSE41(_mm_loadu_si128((const __m128i*)(row0 + i * 4)),
+            _mm_loadu_si128((const __m128i*)(row1 + i * 4)));
+        __m128i b = SpdCpuMaxPairsR16_SSE41(_mm_loadu_si128((const __m128i*)(row0 + i * 4 + 16)),
+            _mm_loadu_si128((const __m128i*)(row1 + i * 4 + 16)));
+        _mm_storeu_si128((__m128i*)(dst + i * 2), _mm_packus_epi32(a, b));
+    }
+    if (i < end)
+        SpdCpuReduceRowR16UnormMaxHeight(dst, row0, row1, i, end - i, inWidth);
+}
+
+SPD_CPU_TARGET("avx2")
+A_STATIC __m256i SpdCpuMaxPairsR16_AVX2(__m256i row0, __m256i row1)
+{
+    __m256i v = _mm256_max_epu16(row0, row1);
+    return _mm256_max_epi32(_mm256_and_si256(v, _mm256_set1_epi32(0xFFFF)), _mm256_srli_epi32(v, 16));
+}
+
+// 16 output texels per iteration
+SPD_CPU_TARGET("avx2")
+A_STATIC void SpdCpuReduceRowR16UnormMaxHeight_AVX2(AB1 *A_RESTRICT dst, const AB1 *A_RESTRICT row0,
+    const AB1 *A_RESTRICT row1, AU1 x, AU1 count, AU1 inWidth)
+{
+    AU1 end = x + count;
+    AU1 simdEnd = AMinU1(end, inWidth / 2);
+    AU1 i = x;
+    for (; i + 16 <= simdEnd; i += 16)
+    {
+        __m256i a = SpdCpuMaxPairsR16_AVX2(_mm256_loadu_si256((const __m256i*)(row0 + i * 4)),
+            _mm256_loadu_si256((const __m256i*)(row1 + i * 4)));
+        __m256i b = SpdCpuMaxPairsR16_AVX2(_mm256_loadu_si256((const __m256i*)(row0 + i * 4 + 32)),
+            _mm256_loadu_si256((const __m256i*)(row1 + i * 4 + 32)));
+        _mm256_storeu_si256((__m256i*)(dst + i * 2), _mm256_permute4x64_epi64(_mm256_packus_epi32(a, b), 0xD8));
+    }
+    if (i < end)
+        SpdCpuReduceRowR16UnormMaxHeight_SSE41(dst, row0, row1, i, end - i, inWidth);
+}
+
+SPD_CPU_TARGET("avx512f,avx512bw")
+A_STATIC __m512i SpdCpuMaxPairsR16_AVX512(__m512i row0, __m512i row1)
+{
+    __m512i v = _mm512_max_epu16(row0, row1);
+    return _mm512_max_epi32(_mm512_and_si512(v, _mm512_set1_epi32(0xFFFF)), _mm512_srli_epi32(v, 16));
+}
+
+// 32 output texels per iteration
+SPD_CPU_TARGET("avx512f,avx512bw")
+A_STATIC void SpdCpuReduceRowR16UnormMaxHeight_AVX512(AB1 *A_RESTRICT dst, const AB1 *A_RESTRICT row0,
+    const AB1 *A_RESTRICT row1, AU1 x, AU1 count, AU1 inWidth)
+{
+    const __m512i order = _mm512_set_epi64(7, 5, 3, 1, 6, 4, 2, 0);
+    AU1 end = x + count;
+    AU1 simdEnd = AMinU1(end, inWidth / 2);
+    AU1 i = x;
+    for (; i + 32 <= simdEnd; i += 32)
+    {
+        __m512i a = SpdCpuMaxPairsR16_AVX512(_mm512_loadu_si512(row0 + i * 4), _mm512_loadu_si512(row1 + i * 4));
+        __m512i b = SpdCpuMaxPairsR16_AVX512(_mm512_loadu_si512(row0 + i * 4 + 64), _mm512_loadu_si512(row1 + i * 4 + 64));
+        _mm512_storeu_si512(dst + i * 2, _mm512_permutexvar_epi64(order, _mm512_packus_epi32(a, b)));
+    }
+    if (i < end)
+        SpdCpuReduceRowR16UnormMaxHeight_AVX2(dst, row0, row1, i, end - i, inWidth);
+}
+
+// Majority kernels: the equality masks (-1 for equal) of the six pairs add up to minus the count of each value. Values without
+// the highest count are replaced by all ones, the unsigned minimum of the four is then the lowest of the most frequent.
+// Even and odd input columns are split with a pack (8-bit) or a shuffle (32-bit), same lane fixup as above.
+SPD_CPU_TARGET("sse4.1")
+A_STATIC __m128i SpdCpuMajority8_SSE41(__m128i v0, __m128i v1, __m128i v2, __m128i v3)
+{
+    const __m128i ones = _mm_set1_epi8(-1);
+    __m128i e01 = _mm_cmpeq_epi8(v0, v1);
+    __m128i e02 = _mm_cmpeq_epi8(v0, v2);
+    __m128i e03 = _mm_cmpeq_epi8(v0, v3);
+    __m128i e12 = _mm_cmpeq_epi8(v1, v2);
+    __m128i e13 = _mm_cmpeq_epi8(v1, v3);
+    __m128i e23 = _mm_cmpeq_epi8(v2, v3);
+    __m128i c0 = _mm_add_epi8(_mm_add_epi8(e01, e02), e03);
+    __m128i c1 = _mm_add_epi8(_mm_add_epi8(e01, e12), e13);
+    __m128i c2 = _mm_add_epi8(_mm_add_epi8(e02, e12), e23);
+    __m128i c3 = _mm_add_epi8(_mm_add_epi8(e03, e13), e23);
+    __m128i count = _mm_min_epi8(_mm_min_epi8(c0, c1), _mm_min_epi8(c2, c3));
+    __m128i m0 = _mm_or_si128(v0, _mm_xor_si128(_mm_cmpeq_epi8(c0, count), ones));
+    __m128i m1 = _mm_or_si128(v1, _mm_xor_si128(_mm_cmpeq_epi8(c1, count), ones));
+    __m128i m2 = _mm_or_si128(v2, _mm_xor_si128(_mm_cmpeq_epi8(c2, count), ones));
+    __m128i m3 = _mm_or_si128(v3, _mm_xor_si128(_mm_cmpeq_epi8(c3, count), ones));
+    return _mm_min_epu8(_mm_min_epu8(m0, m1), _mm_min_epu8(m2, m3));
+}
+
+// 16 output texels per iteration
+SPD_CPU_TARGET("sse4.1")
+A_STATIC void SpdCpuReduceRowR8UintMajority_SSE41(AB1 *A_RESTRICT dst, const AB1 *A_RESTRICT row0,
+    const AB1 *A_RESTRICT row1, AU1 x, AU1 count, AU1 inWidth)
+{
+    const __m128i low = _mm_set1_epi16(0xFF);
+    AU1 end = x + count;
+    AU1 simdEnd = AMinU1(end, inWidth / 2);
+    AU1 i = x;
+    for (; i + 16 <= simdEnd; i += 16)
+    {
+        __m128i a0 = _mm_loadu_si128((const __m128i*)(row0 + i * 2));
+        __m128i a1 = _mm_loadu_si128((const __m128i*)(row0 + i * 2 + 16));
+        __m128i b0 = _mm_loadu_si128((const __m128i*)(row1 + i * 2));
+        __m128i b1 = _mm_loadu_si128((const __m128i*)(row1 + i * 2 + 16));
+        __m128i v0 = _mm_packus_epi16(_mm_and_si128(a0, low), _mm_and_si128(a1, low));
+        __m128i v1 = _mm_packus_epi16(_mm_srli_epi16(a0, 8), _mm_srli_epi16(a1, 8));
+        __m128i v2 = _mm_packus_epi16(_mm_and_si128(b0, low), _mm_and_si128(b1, low));
+        __m128i v3 = _mm_packus_epi16(_mm_srli_epi16(b0, 8), _mm_srli_epi16(b1, 8));
+        _mm_storeu_si128((__m128i*)(dst + i), SpdCpuMajority8_SSE41(v0, v1, v2, v3));
+    }
+    if (i < end)
+        SpdCpuReduceRowR8UintMajority(dst, row0, row1, i, end - i, inWidth);
+}
+
+SPD_CPU_TARGET("avx2")
+A_STATIC __m256i SpdCpuMajority8_AVX2(__m256i v0, __m256i v1, __m256i v2, __m256i v3)
+{
+    const __m256i ones = _mm256_set1_epi8(-1);
+    __m256i e01 = _mm256_cmpeq_epi8(v0, v1);
+    __m256i e02 = _mm256_cmpeq_epi8(v0, v2);
+    __m256i e03 = _mm256_cmpeq_epi8(v0, v3);
+    __m256i e12 = _mm256_cmpeq_epi8(v1, v2);
+    __m256i e13 = _mm256_cmpeq_epi8(v1, v3);
+    __m256i e23 = _mm256_cmpeq_epi8(v2, v3);
+    __m256i c0 = _mm256_add_epi8(_mm256_add_epi8(e01, e02), e03);
+    __m256i c1 = _mm256_add_epi8(_mm256_add_epi8(e01, e12), e13);
+    __m256i c2 = _mm256_add_epi8(_mm256_add_epi8(e02, e12), e23);
+    __m256i c3 = _mm256_add_epi8(_mm256_add_epi8(e03, e13), e23);
+    __m256i count = _mm256_min_epi8(_mm256_min_epi8(c0, c1), _mm256_min_epi8(c2, c3));
+    __m256i m0 = _mm256_or_si256(v0, _mm256_xor_si256(_mm256_cmpeq_epi8(c0, count), ones));
+    __m256i m1 = _mm256_or_si256(v1, _mm256_xor_si256(_mm256_cmpeq_epi8(c1, count), ones));
+    __m256i m2 = _mm256_or_si256(v2, _mm256_xor_si256(_mm256_cmpeq_epi8(c2, count), ones));
+    __m256i m3 = _mm256_or_si256(v3, _mm256_xor_si256(_mm256_cmpeq_epi8(c3, count), ones));
+    return _mm256_min_epu8(_mm256_min_epu8(m0, m1), _mm256_min_epu8(m2, m3));
+}
+
+// 32 output texels per iteration
+SPD_CPU_TARGET("avx2")
+A_STATIC void SpdCpuReduceRowR8UintMajority_AVX2(AB1 *A_RESTRICT dst, const AB1 *A_RESTRICT row0,
+    const AB1 *A_RESTRICT row1, AU1 x, AU1 count, AU1 inWidth)
+{
+    const __m256i low = _mm256_set1_epi16(0xFF);
+    AU1 end = x + count;
+    AU1 simdEnd = AMinU1(end, inWidth / 2);
+    AU1 i = x;
+    for (; i + 32 <= simdEnd; i += 32)
+    {
+        __m256i a0 = _mm256_loadu_si256((const __m256i*)(row0 + i * 2));
+        __m256i a1 = _mm256_loadu_si256((const __m256i*)(row0 + i * 2 + 32));
+        __m256i b0 = _mm256_loadu_si256((const __m256i*)(row1 + i * 2));
+        __m256i b1 = _mm256_loadu_si256((const __m256i*)(row1 + i * 2 + 32));
+        __m256i v0 = _mm256_packus_epi16(_mm256_and_si256(a0, low), _mm256_and_si256(a1, low));
+        __m256i v1 = _mm256_packus_epi16(_mm256_srli_epi16(a0, 8), _mm256_srli_epi16(a1, 8));
+        __m256i v2 = _mm256_packus_epi16(_mm256_and_si256(b0, low), _mm256_and_si256(b1, low));
+        __m256i v3 = _mm256_packus_epi16(_mm256_srli_epi16(b0, 8), _mm256_srli_epi16(b1, 8));
+        __m256i o = SpdCpuMajority8_AVX2(v0, v1, v2, v3);
+        _mm256_storeu_si256((__m256i*)(dst + i), _mm256_permute4x64_epi64(o, 0xD8));
+    }
+    if (i < end)
+        SpdCpuReduceRowR8UintMajority_SSE41(dst, row0, row1, i, end - i, inWidth);
+}
+
+// AVX-512 compares return masks, the counts are built from them with masked moves
+SPD_CPU_TARGET("avx512f,avx512bw")
+A_STATIC __m512i SpdCpuMajority8_AVX512(__m512i v0, __m512i v1, __m512i v2, __m512i v3)
+{
+    const __m512i ones = _mm512_set1_epi8(-1);
+    __m512i e01 = _mm512_maskz_mov_epi8(_mm512_cmpeq_epi8_mask(v0, v1), ones);
+    __m512i e02 = _mm512_maskz_mov_epi8(_mm512_cmpeq_epi8_mask(v0, v2), ones);
+    __m512i e03 = _mm512_maskz_mov_epi8(_mm512_cmpeq_epi8_mask(v0, v3), ones);
+    __m512i e12 = _mm512_maskz_mov_epi8(_mm512_cmpeq_epi8_mask(v1, v2), ones);
+    __m512i e13 = _mm512_maskz_mov_epi8(_mm512_cmpeq_epi8_mask(v1, v3), ones);
+    __m512i e23 = _mm512_maskz_mov_epi8(_mm512_cmpeq_epi8_mask(v2, v3), ones);
+    __m512i c0 = _mm512_add_epi8(_mm512_add_epi8(e01, e02), e03);
+    __m512i c1 = _mm512_add_epi8(_mm512_add_epi8(e01, e12), e13);
+    __m512i c2 = _mm512_add_epi8(_mm512_add_epi8(e02, e12), e23);
+    __m512i c3 = _mm512_add_epi8(_mm512_add_epi8(e03, e13), e23);
+    __m512i count = _mm512_min_epi8(_mm512_min_epi8(c0, c1), _mm512_min_epi8(c2, c3));
+    __m512i m0 = _mm512_mask_mov_epi8(ones, _mm512_cmpeq_epi8_mask(c0, count), v0);
+    __m512i m1 = _mm512_mask_mov_epi8(ones, _mm512_cmpeq_epi8_mask(c1, count), v1);
+    __m512i m2 = _mm512_mask_mov_epi8(ones, _mm512_cmpeq_epi8_mask(c2, count), v2);
+    __m512i m3 = _mm512_mask_mov_epi8(ones, _mm512_cmpeq_epi8_mask(c3, count), v3);
+    return _mm512_min_epu8(_mm512_min_epu8(m0, m1), _mm512_min_epu8(m2, m3));
+}
+
+// 64 output texels per iteration
+SPD_CPU_TARGET("avx512f,avx512bw")
+A_STATIC void SpdCpuReduceRowR8UintMajority_AVX512(AB1 *A_RESTRICT dst, const AB1 *A_RESTRICT row0,
+    const AB1 *A_RESTRICT row1, AU1 x, AU1 count, AU1 inWidth)
+{
+    const __m512i low = _mm512_set1_epi16(0xFF);
+    const __m512i order = _mm512_set_epi64(7, 5, 3, 1, 6, 4, 2, 0);
+    AU1 end = x + count;
+    AU1 simdEnd = AMinU1(end, inWidth / 2);
+    AU1 i = x;
+    for (; i + 64 <= simdEnd; i += 64)
+    {
+        __m512i a0 = _mm512_loadu_si512(row0 + i * 2);
+        __m512i a1 = _mm512_loadu_si512(row0 + i * 2 + 64);
+        __m512i b0 = _mm512_loadu_si512(row1 + i * 2);
+        __m512i b1 = _mm512_loadu_si512(row1 + i * 2 + 64);
+        __m512i v0 = _mm512_packus_epi16(_mm512_and_si512(a0, low), _mm512_and_si512(a1, low));
+        __m512i v1 = _mm512_packus_epi16(_mm512_srli_epi16(a0, 8), _mm512_srli_epi16(a1, 8));
+        __m512i v2 = _mm512_packus_epi16(_mm512_and_si512(b0, low), _mm512_and_si512(b1, low));
+        __m512i v3 = _mm512_packus_epi16(_mm512_srli_epi16(b0, 8), _mm512_srli_epi16(b1, 8));
+        __m512i o = SpdCpuMajority8_AVX512(v0, v1, v2, v3);
+        _mm512_storeu_si512(dst + i, _mm512_permutexvar_epi64(order, o));
+    }
+    if (i < end)
+        SpdCpuReduceRowR8UintMajority_AVX2(dst, row0, row1, i, end - i, inWidth);
+}
+
+SPD_CPU_TARGET("sse4.1")
+A_STATIC __m128i SpdCpuMajority32_SSE41(__m128i v0, __m128i v1, __m128i v2, __m128i v3)
+{
+    const __m128i ones = _mm_set1_epi32(-1);
+    __m128i e01 = _mm_cmpeq_epi32(v0, v1);
+    __m128i e02 = _mm_cmpeq_epi32(v0, v2);
+    __m128i e03 = _mm_cmpeq_epi32(v0, v3);
+    __m128i e12 = _mm_cmpeq_epi32(v1, v2);
+    __m128i e13 = _mm_cmpeq_epi32(v1, v3);
+    __m128i e23 = _mm_cmpeq_epi32(v2, v3);
+    __m128i c0 = _mm_add_epi32(_mm_add_epi32(e01, e02), e03);
+    __m128i c1 = _mm_add_epi32(_mm_add_epi32(e01, e12), e13);
+    __m128i c2 = _mm_add_epi32(_mm_add_epi32(e02, e12), e23);
+    __m128i c3 = _mm_add_epi32(_mm_add_epi32(e03, e13), e23);
+    __m128i count = _mm_min_epi32(_mm_min_epi32(c0, c1), _mm_min_epi32(c2, c3));
+    __m128i m0 = _mm_or_si128(v0, _mm_xor_si128(_mm_cmpeq_epi32(c0, count), ones));
+    __m128i m1 = _mm_or_si128(v1, _mm_xor_si128(_mm_cmpeq_epi32(c1, count), ones));
+    __m128i m2 = _mm_or_si128(v2, _mm_xor_si128(_mm_cmpeq_epi32(c2, count), ones));
+    __m128i m3 = _mm_or_si128(v3, _mm_xor_si128(_mm_cmpeq_epi32(c3, count), ones));
+    return _mm_min_epu32(_mm_min_epu32(m0, m1), _mm_min_epu32(m2, m3));
+}
+
+// 4 output texels per iteration
+SPD_CPU_TARGET("sse4.1")
+A_STATIC void SpdCpuReduceRowR32UintMajority_SSE41(AB1 *A_RESTRICT dst, const AB1 *A_RESTRICT row0,
+    const AB1 *A_RESTRICT row1, AU1 x, AU1 count, AU1 inWidth)
+{
+    AU1 end = x + count;
+    AU1 simdEnd = AMinU1(end, inWidth / 2);
+    AU1 i = x;
+    for (; i + 4 <= simdEnd; i += 4)
+    {
+        __m128 a0 = _mm_loadu_ps((const AF1*)(row0 + i * 8));
+        __m128 a1 = _mm_loadu_ps((const AF1*)(row0 + i * 8 + 16));
+        __m128 b0 = _mm_loadu_ps((const AF1*)(row1 + i * 8));
+        __m128 b1 = _mm_loadu_ps((const AF1*)(row1 + i * 8 + 16));
+        __m128i o = SpdCpuMajority32_SSE41(_mm_castps_si128(_mm_shuffle_ps(a0, a1, 0x88)),
+            _mm_castps_si128(_mm_shuffle_ps(a0, a1, 0xDD)), _mm_castps_si128(_mm_shuffle_ps(b0, b1, 0x88)),
+            _mm_castps_si128(_mm_shuffle_ps(b0, b1, 0xDD)));
+        _mm_storeu_si128((__m128i*)(dst + i * 4), o);
+    }
+    if (i < end)
+        SpdCpuReduceRowR32UintMajority(dst, row0, row1, i, end - i, inWidth);
+}
+
+SPD_CPU_TARGET("avx2")
+A_STATIC __m256i SpdCpuMajority32_AVX2(__m256i v0, __m256i v1, __m256i v2, __m256i v3)
+{
+    const __m256i ones = _mm256_set1_epi32(-1);
+    __m256i e01 = _mm256_cmpeq_epi32(v0, v1);
+    __m256i e02 = _mm256_cmpeq_epi32(v0, v2);
+    __m256i e03 = _mm256_cmpeq_epi32(v0, v3);
+    __m256i e12 = _mm256_cmpeq_epi32(v1, v2);
+    __m256i e13 = _mm256_cmpeq_epi32(v1, v3);
+    __m256i e23 = _mm256_cmpeq_epi32(v2, v3);
+    __m256i c0 = _mm256_add_epi32(_mm256_add_epi32(e01, e02), e03);
+    __m256i c1 = _mm256_add_epi32(_mm256_add_epi32(e01, e12), e13);
+    __m256i c2 = _mm256_add_epi32(_mm256_add_epi32(e02, e12), e23);
+    __m256i c3 = _mm256_add_epi32(_mm256_add_epi32(e03, e13), e23);
+    __m256i count = _mm256_min_epi32(_mm256_min_epi32(c0, c1), _mm256_min_epi32(c2, c3));
+    __m256i m0 = _mm256_or_si256(v0, _mm256_xor_si256(_mm256_cmpeq_epi32(c0, count), ones));
+    __m256i m1 = _mm256_or_si256(v1, _mm256_xor_si256(_mm256_cmpeq_epi32(c1, count), ones));
+    __m256i m2 = _mm256_or_si256(v2, _mm256_xor_si256(_mm256_cmpeq_epi32(c2, count), ones));
+    __m256i m3 = _mm256_or_si256(v3, _mm256_xor_si256(_mm256_cmpeq_epi32(c3, count), ones));
+    return _mm256_min_epu32(_mm256_min_epu32(m0, m1), _mm256_min_epu32(m2, m3));
+}
+
+// 8 output texels per iteration
+SPD_CPU_TARGET("avx2")
+A_STATIC void SpdCpuReduceRowR32UintMajority_AVX2(AB1 *A_RESTRICT dst, const AB1 *A_RESTRICT row0,
+    const AB1 *A_RESTRICT row1, AU1 x, AU1 count, AU1 inWidth)
+{
+    AU1 end = x + count;
+    AU1 simdEnd = AMinU1(end, inWidth / 2);
+    AU1 i = x;
+    for (; i + 8 <= simdEnd; i += 8)
+    {
+        __m256 a0 = _mm256_loadu_ps((const AF1*)(row0 + i * 8));
+        __m256 a1 = _mm256_loadu_ps((const AF1*)(row0 + i * 8 + 32));
+        __m256 b0 = _mm256_loadu_ps((const AF1*)(row1 + i * 8));
+        __m256 b1 = _mm256_loadu_ps((const AF1*)(row1 + i * 8 + 32));
+        __m256i o = SpdCpuMajority32_AVX2(_mm256_castps_si256(_mm256_shuffle_ps(a0, a1, 0x88)),
+            _mm256_castps_si256(_mm256_shuffle_ps(a0, a1, 0xDD)), _mm256_castps_si256(_mm256_shuffle_ps(b0, b1, 0x88)),
+            _mm256_castps_si256(_mm256_shuffle_ps(b0, b1, 0xDD)));
+        _mm256_storeu_si256((__m256i*)(dst + i * 4), _mm256_permute4x64_epi64(o, 0xD8));
+    }
+    if (i < end)
+        SpdCpuReduceRowR32UintMajority_SSE41(dst, row0, row1, i, end - i, inWidth);
+}
+
+SPD_CPU_TARGET("avx512f,avx512bw")
+A_STATIC __m512i SpdCpuMajority32_AVX512(__m512i v0, __m512i v1, __m512i v2, __m512i v3)
+{
+    const __m512i ones = _mm512_set1_epi32(-1);
+    __m512i e01 = _mm512_maskz_mov_epi32(_mm512_cmpeq_epi32_mask(v0, v1), ones);
+    __m512i e02 = _mm512_maskz_mov_epi32(_mm512_cmpeq_epi32_mask(v0, v2), ones);
+    __m512i e03 = _mm512_maskz_mov_epi32(_mm512_cmpeq_epi32_mask(v0, v3), ones);
+    __m512i e12 = _mm512_maskz_mov_epi32(_mm512_cmpeq_epi32_mask(v1, v2), ones);
+    __m512i e13 = _mm512_maskz_mov_epi32(_mm512_cmpeq_epi32_mask(v1, v3), ones);
+    __m512i e23 = _mm512_maskz_mov_epi32(_mm512_cmpeq_epi32_mask(v2, v3), ones);
+    __m512i c0 = _mm512_add_epi32(_mm512_add_epi32(e01, e02), e03);
+    __m512i c1 = _mm512_add_epi32(_mm512_add_epi32(e01, e12), e13);
+    __m512i c2 = _mm512_add_epi32(_mm512_add_epi32(e02, e12), e23);
+    __m512i c3 = _mm512_add_epi32(_mm512_add_epi32(e03, e13), e23);
+    __m512i count = _mm512_min_epi32(_mm512_min_epi32(c0, c1), _mm512_min_epi32(c2, c3));
+    __m512i m0 = _mm512_mask_mov_epi32(ones, _mm512_cmpeq_epi32_mask(c0, count), v0);
+    __m512i m1 = _mm512_mask_mov_epi32(ones, _mm512_cmpeq_epi32_mask(c1, count), v1);
+    __m512i m2 = _mm512_mask_mov_epi32(ones, _mm512_cmpeq_epi32_mask(c2, count), v2);
+    __m512i m3 = _mm512_mask_mov_epi32(ones, _mm512_cmpeq_epi32_mask(c3, count), v3);
+    return _mm512_min_epu32(_mm512_min_epu32(m0, m1), _mm512_min_epu32(m2, m3));
+}
+
+// 16 output texels per iteration, the even and odd columns of 32 input texels are gathered with two-source permutes
+SPD_CPU_TARGET("avx512f,avx512bw")
+A_STATIC void SpdCpuReduceRowR32UintMajority_AVX512(AB1 *A_RESTRICT dst, const AB1 *A_RESTRICT row0,
+    const AB1 *A_RESTRICT row1, AU1 x, AU1 count, AU1 inWidth)
+{
+    const __m512i even = _mm512_set_epi32(30, 28, 26, 24, 22, 20, 18, 16, 14, 12, 10, 8, 6, 4, 2, 0);
+    const __m512i odd = _mm512_set_epi32(31, 29, 27, 25, 23, 21, 19, 17, 15, 13, 11, 9, 7, 5, 3, 1);
+    AU1 end = x + count;
+    AU1 simdEnd = AMinU1(end, inWidth / 2);
+    AU1 i = x;
+    for (; i + 16 <= simdEnd; i += 16)
+    {
+        __m512i a0 = _mm512_loadu_si512(row0 + i * 8);
+        __m512i a1 = _mm512_loadu_si512(row0 + i * 8 + 64);
+        __m512i b0 = _mm512_loadu_si512(row1 + i * 8);
+        __m512i b1 = _mm512_loadu_si512(row1 + i * 8 + 64);
+        __m512i o = SpdCpuMajority32_AVX512(_mm512_permutex2var_epi32(a0, even, a1),
+            _mm512_permutex2var_epi32(a0, odd, a1), _mm512_permutex2var_epi32(b0, even, b1),
+            _mm512_permutex2var_epi32(b0, odd, b1));
+        _mm512_storeu_si512(dst + i * 4, o);
+    }
+    if (i < end)
+        SpdCpuReduceRowR32UintMajority_AVX2(dst, row0, row1, i, end - i, inWidth);
+}
+
+// Bitwise kernels: every 64-bit lane holds the two input texels of one output texel like the scalar kernel, the results
+// end up in the low halves of the lanes and are gathered with the same shuffles as the majority kernels
+template<bool UseAnd>
+SPD_CPU_TARGET("sse4.1")
+A_STATIC __m128i SpdCpuCombine_SSE41(__m128i a, __m128i b)
+{
+    return UseAnd ? _mm_and_si128(a, b) : _mm_or_si128(a, b);
+}
+
+template<bool UseAnd, bool Blocks>
+SPD_CPU_TARGET("sse4.1")
+A_STATIC __m128i SpdCpuBitwise64_SSE41(__m128i top, __m128i bottom)
+{
+    if (!Blocks)
+    {
+        __m128i v = SpdCpuCombine_SSE41<UseAnd>(top, bottom);
+        return SpdCpuCombine_SSE41<UseAnd>(v, _mm_srli_epi64(v, 32));
+    }
+    __m128i h[2] = { top, bottom };
+    for (AU1 j = 0; j < 2; j++)
+    {
+        h[j] = _mm_and_si128(SpdCpuCombine_SSE41<UseAnd>(h[j], _mm_srli_epi64(h[j], 1)),
+            _mm_set1_epi64x(0x5555555555555555ll));
+        h[j] = _mm_and_si128(SpdCpuCombine_SSE41<UseAnd>(h[j], _mm_srli_epi64(h[j], 8)),
+            _mm_set1_epi64x(0x0055005500550055ll));
+        h[j] = _mm_and_si128(_mm_or_si128(h[j], _mm_srli_epi64(h[j], 1)), _mm_set1_epi64x(0x0033003300330033ll));
+        h[j] = _mm_and_si128(_mm_or_si128(h[j], _mm_srli_epi64(h[j], 2)), _mm_set1_epi64x(0x000f000f000f000fll));
+        h[j] = _mm_or_si128(h[j], _mm_srli_epi64(h[j], 28));
+        h[j] = _mm_or_si128(_mm_and_si128(h[j], _mm_set1_epi64x(0xff)),
+            _mm_and_si128(_mm_srli_epi64(h[j], 8), _mm_set1_epi64x(0xff00)));
+    }
+    return _mm_or_si128(h[0], _mm_slli_epi64(h[1], 16));
+}
+
+// 4 output texels per iteration
+template<bool UseAnd, bool Blocks>
+SPD_CPU_TARGET("sse4.1")
+A_STATIC void SpdCpuReduceRowBitwise_SSE41(AB1 *A_RESTRICT dst, const AB1 *A_RESTRICT row0,
+    const AB1 *A_RESTRICT row1, AU1 x, AU1 count, AU1 inWidth)
+{
+    AU1 end = x + count;
+    AU1 simdEnd = AMinU1(end, inWidth / 2);
+    AU1 i = x;
+    for (; i + 4 <= simdEnd; i += 4)
+    {
+        __m128i o0 = SpdCpuBitwise64_SSE41<UseAnd, Blocks>(_mm_loadu_si128((const __m128i*)(row0 + i * 8)),
+            _mm_loadu_si128((const __m128i*)(row1 + i * 8)));
+        __m128i o1 = SpdCpuBitwise64_SSE41<UseAnd, Blocks>(_mm_loadu_si128((const __m128i*)(row0 + i * 8 + 16)),
+            _mm_loadu_si128((const __m128i*)(row1 + i * 8 + 16)));
+        __m128 o = _mm_shuffle_ps(_mm_castsi128_ps(o0), _mm_castsi128_ps(o1), 0x88);
+        _mm_storeu_si128((__m128i*)(dst + i * 4), _mm_castps_si128(o));
+    }
+    if (i < end)
+        SpdCpuReduceRowBitwise<UseAnd, Blocks>(dst, row0, row1, i, end - i, inWidth);
+}
+
+template<bool UseAnd>
+SPD_CPU_TARGET("avx2")
+A_STATIC __m256i SpdCpuCombine_AVX2(__m256i a, __m256i b)
+{
+    return UseAnd ? _mm256_and_si256(a, b) : _mm256_or_si256(a, b);
+}
+
+template<bool UseAnd, bool Blocks>
+SPD_CPU_TARGET("avx2")
+A_STATIC __m256i SpdCpuBitwise64_AVX2(__m256i top, __m256i bottom)
+{
+    if (!Blocks)
+    {
+        __m256i v = SpdCpuCombine_AVX2<UseAnd>(top, bottom);
+        return SpdCpuCombine_AVX2<UseAnd>(v, _mm256_srli_epi64(v, 32));
+    }
+    __m256i h[2] = { top, bottom };
+    for (AU1 j = 0; j < 2; j++)
+    {
+        h[j] = _mm256_and_si256(SpdCpuCombine_AVX2<UseAnd>(h[j], _mm256_srli_epi64(h[j], 1)),
+            _mm256_set1_epi64x(0x5555555555555555ll));
+        h[j] = _mm256_and_si256(SpdCpuCombine_AVX2<UseAnd>(h[j], _mm256_srli_epi64(h[j], 8)),
+            _mm256_set1_epi64x(0x0055005500550055ll));
+        h[j] = _mm256_and_si256(_mm256_or_si256(h[j], _mm256_srli_epi64(h[j], 1)),
+            _mm256_set1_epi64x(0x0033003300330033ll));
+        h[j] = _mm256_and_si256(_mm256_or_si256(h[j], _mm256_srli_epi64(h[j], 2)),
+            _mm256_set1_epi64x(0x000f000f000f000fll));
+        h[j] = _mm256_or_si256(h[j], _mm256_srli_epi64(h[j], 28));
+        h[j] = _mm256_or_si256(_mm256_and_si256(h[j], _mm256_set1_epi64x(0xff)),
+            _mm256_and_si256(_mm256_srli_epi64(h[j], 8), _mm256_set1_epi64x(0xff00)));
+    }
+    return _mm256_or_si256(h[0], _mm256_slli_epi64(h[1], 16));
+}
+
+// 8 output texels per iteration
+template<bool UseAnd, bool Blocks>
+SPD_CPU_TARGET("avx2")
+A_STATIC void SpdCpuReduceRowBitwise_AVX2(AB1 *A_RESTRICT dst, const AB1 *A_RESTRICT row0,
+    const AB1 *A_RESTRICT row1, AU1 x, AU1 count, AU1 inWidth)
+{
+    AU1 end = x + count;
+    AU1 simdEnd = AMinU1(end, inWidth / 2);
+    AU1 i = x;
+    for (; i + 8 <= simdEnd; i += 8)
+    {
+        __m256i o0 = SpdCpuBitwise64_AVX2<UseAnd, Blocks>(_mm256_loadu_si256((const __m256i*)(row0 + i * 8)),
+            _mm256_loadu_si256((const __m256i*)(row1 + i * 8)));
+        __m256i o1 = SpdCpuBitwise64_AVX2<UseAnd, Blocks>(_mm256_loadu_si256((const __m256i*)(row0 + i * 8 + 32)),
+            _mm256_loadu_si256((const __m256i*)(row1 + i * 8 + 32)));
+        __m256 o = _mm256_shuffle_ps(_mm256_castsi256_ps(o0), _mm256_castsi256_ps(o1), 0x88);
+        _mm256_storeu_si256((__m256i*)(dst + i * 4), _mm256_permute4x64_epi64(_mm256_castps_si256(o), 0xD8));
+    }
+    if (i < end)
+        SpdCpuReduceRowBitwise_SSE41<UseAnd, Blocks>(dst, row0, row1, i, end - i, inWidth);
+}
+
+template<bool UseAnd>
+SPD_CPU_TARGET("avx512f,avx512bw")
+A_STATIC __m512i SpdCpuCombine_AVX512(__m512i a, __m512i b)
+{
+    return UseAnd ? _mm512_and_si512(a, b) : _mm512_or_si512(a, b);
+}
+
+template<bool UseAnd, bool Blocks>
+SPD_CPU_TARGET("avx512f,avx512bw")
+A_STATIC __m512i SpdCpuBitwise64_AVX512(__m512i top, __m512i bottom)
+{
+    if (!Blocks)
+    {
+        __m512i v = SpdCpuCombine_AVX512<UseAnd>(top, bottom);
+        return SpdCpuCombine_AVX512<UseAnd>(v, _mm512_srli_epi64(v, 32));
+    }
+    __m512i h[2] = { top, bottom };
+    for (AU1 j = 0; j < 2; j++)
+    {
+        h[j] = _mm512_and_si512(SpdCpuCombine_AVX512<UseAnd>(h[j], _mm512_srli_epi64(h[j], 1)),
+            _mm512_set1_epi64(0x5555555555555555ll));
+        h[j] = _mm512_and_si512(SpdCpuCombine_AVX512<UseAnd>(h[j], _mm512_srli_epi64(h[j], 8)),
+            _mm512_set1_epi64(0x0055005500550055ll));
+        h[j] = _mm512_and_si512(_mm512_or_si512(h[j], _mm512_srli_epi64(h[j], 1)),
+            _mm512_set1_epi64(0x0033003300330033ll));
+        h[j] = _mm512_and_si512(_mm512_or_si512(h[j], _mm512_srli_epi64(h[j], 2)),
+            _mm512_set1_epi64(0x000f000f000f000fll));
+        h[j] = _mm512_or_si512(h[j], _mm512_srli_epi64(h[j], 28));
+        h[j] = _mm512_or_si512(_mm512_and_si512(h[j], _mm512_set1_epi64(0xff)),
+            _mm512_and_si512(_mm512_srli_epi64(h[j], 8), _mm512_set1_epi64(0xff00)));
+    }
+    return _mm512_or_si512(h[0], _mm512_slli_epi64(h[1], 16));
+}
+
+// 16 output texels per iteration, the low halves of the lanes are gathered with a two-source permute
+template<bool UseAnd, bool Blocks>
+SPD_CPU_TARGET("avx512f,avx512bw")
+A_STATIC void SpdCpuReduceRowBitwise_AVX512(AB1 *A_RESTRICT dst, const AB1 *A_RESTRICT row0,
+    const AB1 *A_RESTRICT row1, AU1 x, AU1 count, AU1 inWidth)
+{
+    const __m512i even = _mm512_set_epi32(30, 28, 26, 24, 22, 20, 18, 16, 14, 12, 10, 8, 6, 4, 2, 0);
+    AU1 end = x + count;
+    AU1 simdEnd = AMinU1(end, inWidth / 2);
+    AU1 i = x;
+    for (; i + 16 <= simdEnd; i += 16)
+    {
+        __m512i o0 = SpdCpuBitwise64_AVX512<UseAnd, Blocks>(_mm512_loadu_si512(row0 + i * 8),
+            _mm512_loadu_si512(row1 + i * 8));
+        __m512i o1 = SpdCpuBitwise64_AVX512<UseAnd, Blocks>(_mm512_loadu_si512(row0 + i * 8 + 64),
+            _mm512_loadu_si512(row1 + i * 8 + 64));
+        _mm512_storeu_si512(dst + i * 4, _mm512_permutex2var_epi32(o0, even, o1));
+    }
+    if (i < end)
+        SpdCpuReduceRowBitwise_AVX2<UseAnd, Blocks>(dst, row0, row1, i, end - i, inWidth);
+}
+
+SPD_CPU_BITWISE_KERNELS(_SSE41)
+SPD_CPU_BITWISE_KERNELS(_AVX2)
+SPD_CPU_BITWISE_KERNELS(_AVX512)
+
+// sRGB kernels: decode and encode tables are read with gathers, alpha uses the second half of the decode table and the
+// unorm encode. There is no SSE4.1 version, without gathers it is not faster than the scalar kernel.
+SPD_CPU_TARGET("avx2")
+A_STATIC __m256 SpdCpuDecodeSrgb8_AVX2(const SpdCpuSrgbTables &tables, __m128i v)
+{
+    const __m256i alpha = _mm256_setr_epi32(0, 0, 0, 256, 0, 0, 0, 256);
+    return _mm256_i32gather_ps(tables.decode, _mm256_add_epi32(_mm256_cvtepu8_epi32(v), alpha), 4);
+}
+
+SPD_CPU_TARGET("avx2")
+A_STATIC __m256i SpdCpuEncodeSrgb8_AVX2(const SpdCpuSrgbTables &tables, __m256 v)
+{
+    v = _mm256_min_ps(_mm256_max_ps(v, _mm256_setzero_ps()), _mm256_set1_ps(SPD_CPU_SRGB_MAX));
+    __m256i index = _mm256_sub_epi32(_mm256_srli_epi32(_mm256_castps_si256(v), SPD_CPU_SRGB_ENCODE_SHIFT),
+        _mm256_set1_epi32(SPD_CPU_SRGB_ENCODE_BASE));
+    index = _mm256_max_epi32(index, _mm256_setzero_si256());
+    __m256 curve = _mm256_add_ps(_mm256_i32gather_ps(tables.encodeBias, index, 4),
+        _mm256_mul_ps(_mm256_i32gather_ps(tables.encodeScale, index, 4), v));
+    __m256 linear = _mm256_add_ps(_mm256_mul_ps(v, _mm256_set1_ps(SPD_CPU_SRGB_LINEAR_SCALE)), _mm256_set1_ps(0.5f));
+    __m256 r = _mm256_blendv_ps(curve, linear, _mm256_cmp_ps(v, _mm256_set1_ps(SPD_CPU_SRGB_LINEAR_LIMIT), _CMP_LT_OQ));
+    __m256 alpha = _mm256_add_ps(_mm256_mul_ps(v, _mm256_set1_ps(255.0f)), _mm256_set1_ps(0.5f));
+    return _mm256_cvttps_epi32(_mm256_blend_ps(r, alpha, 0x88));
+}
+
+SPD_CPU_TARGET("avx2")
+A_STATIC void SpdCpuReduceRowRGBA8UnormSrgb_AVX2(AB1 *A_RESTRICT dst, const AB1 *A_RESTRICT row0, const AB1 *A_RESTRICT row1,
+    AU1 x, AU1 count, AU1 inWidth)
+{
+    const SpdCpuSrgbTables &tables = SpdCpuGetSrgbTables();
+    const __m256 quarter = _mm256_set1_ps(0.25f);
+    AU1 end = x + count;
+    AU1 simdEnd = AMinU1(end, inWidth / 2);
+    AU1 i = x;
+    for (; i + 2 <= simdEnd; i += 2)
+    {
+        __m128i a = _mm_loadu_si128((const __m128i*)(row0 + i * 8));
+        __m128i b = _mm_loadu_si128((const __m128i*)(row1 + i * 8));
+        __m256 a0 = SpdCpuDecodeSrgb8_AVX2(tables, a);
+        __m256 a1 = SpdCpuDecodeSrgb8_AVX2(tables, _mm_srli_si128(a, 8));
+        __m256 b0 = SpdCpuDecodeSrgb8_AVX2(tables, b);
+        __m256 b1 = SpdCpuDecodeSrgb8_AVX2(tables, _mm_srli_si128(b, 8));
+        __m256 v = _mm256_add_ps(_mm256_permute2f128_ps(a0, a1, 0x20), _mm256_permute2f128_ps(a0, a1, 0x31));
+        v = _mm256_add_ps(v, _mm256_permute2f128_ps(b0, b1, 0x20));
+        v = _mm256_add_ps(v, _mm256_permute2f128_ps(b0, b1, 0x31));
+        __m256i o = SpdCpuEncodeSrgb8_AVX2(tables, _mm256_mul_ps(v, quarter));
+        o = _mm256_packus_epi16(_mm256_packus_epi32(o, o), o);
+        AU1 packed[2] = { AU1(_mm_cvtsi128_si32(_mm256_castsi256_si128(o))),
+            AU1(_mm_cvtsi128_si32(_mm256_extracti128_si256(o, 1))) };
+        memcpy(dst + i * 4, packed, 8);
+    }
+    if (i < end)
+        SpdCpuReduceRowRGBA8UnormSrgb(dst, row0, row1, i, end - i, inWidth);
+}
+
+SPD_CPU_TARGET("avx512f,avx512bw")
+A_STATIC __m512 SpdCpuDecodeSrgb8_AVX512(const SpdCpuSrgbTables &tables, __m128i v)
+{
+    const __m512i alpha = _mm512_setr_epi32(0, 0, 0, 256, 0, 0, 0, 256, 0, 0, 0, 256, 0, 0, 0, 256);
+    return _mm512_i32gather_ps(_mm512_add_epi32(_mm512_cvtepu8_epi32(v), alpha), tables.decode, 4);
+}
+
+SPD_CPU_TARGET("avx512f,avx512bw")
+A_STATIC __m512i SpdCpuEncodeSrgb8_AVX512(const SpdCpuSrgbTables &tables, __m512 v)
+{
+    v = _mm512_min_ps(_mm512_max_ps(v, _mm512_setzero_ps()), _mm512_set1_ps(SPD_CPU_SRGB_MAX));
+    __m512i index = _mm512_sub_epi32(_mm512_srli_epi32(_mm512_castps_si512(v), SPD_CPU_SRGB_ENCODE_SHIFT),
+        _mm512_set1_epi32(SPD_CPU_SRGB_ENCODE_BASE));
+    index = _mm512_max_epi32(index, _mm512_setzero_si512());
+    __m512 curve = _mm512_add_ps(_mm512_i32gather_ps(index, tables.encodeBias, 4),
+        _mm512_mul_ps(_mm512_i32gather_ps(index, tables.encodeScale, 4), v));
+    __m512 linear = _mm512_add_ps(_mm512_mul_ps(v, _mm512_set1_ps(SPD_CPU_SRGB_LINEAR_SCALE)), _mm512_set1_ps(0.5f));
+    __m512 r = _mm512_mask_blend_ps(_mm512_cmp_ps_mask(v, _mm512_set1_ps(SPD_CPU_SRGB_LINEAR_LIMIT), _CMP_LT_OQ),
+        curve, linear);
+    __m512 alpha = _mm512_add_ps(_mm512_mul_ps(v, _mm512_set1_ps(255.0f)), _mm512_set1_ps(0.5f));
+    return _mm512_cvttps_epi32(_mm512_mask_blend_ps(0x8888, r, alpha));
+}
+
+SPD_CPU_TARGET("avx512f,avx512bw")
+A_STATIC void SpdCpuReduceRowRGBA8UnormSrgb_AVX512(AB1 *A_RESTRICT dst, const AB1 *A_RESTRICT row0,
+    const AB1 *A_RESTRICT row1, AU1 x, AU1 count, AU1 inWidth)
+{
+    const SpdCpuSrgbTables &tables = SpdCpuGetSrgbTables();
+    const __m512 quarter = _mm512_set1_ps(0.25f);
+    AU1 end = x + count;
+    AU1 simdEnd = AMinU1(end, inWidth / 2);
+    AU1 i = x;
+    for (; i + 4 <= simdEnd; i += 4)
+    {
+        __m256i a = _mm256_loadu_si256((const __m256i*)(row0 + i * 8));
+        __m256i b = _mm256_loadu_si256((const __m256i*)(row1 + i * 8));
+        __m512 a0 = SpdCpuDecodeSrgb8_AVX512(tables, _mm256_castsi256_si128(a));
+        __m512 a1 = SpdCpuDecodeSrgb8_AVX512(tables, _mm256_extracti128_si256(a, 1));
+        __m512 b0 = SpdCpuDecodeSrgb8_AVX512(tables, _mm256_castsi256_si128(b));
+        __m512 b1 = SpdCpuDecodeSrgb8_AVX512(tables, _mm256_extracti128_si256(b, 1));
+        __m512 v = _mm512_add_ps(_mm512_shuffle_f32x4(a0, a1, 0x88), _mm512_shuffle_f32x4(a0, a1, 0xDD));
+        v = _mm512_add_ps(v, _mm512_shuffle_f32x4(b0, b1, 0x88));
+        v = _mm512_add_ps(v, _mm512_shuffle_f32x4(b0, b1, 0xDD));
+        __m512i o = SpdCpuEncodeSrgb8_AVX512(tables, _mm512_mul_ps(v, quarter));
+        _mm_storeu_si128((__m128i*)(dst + i * 4), _mm512_cvtusepi32_epi8(o));
+    }
+    if (i < end)
+        SpdCpuReduceRowRGBA8UnormSrgb(dst, row0, row1, i, end - i, inWidth);
+}
+
+// Normal map kernels work on 8 (AVX2) or 16 (AVX-512) output texels at once with one channel per register. The channels of
+// the even and odd input texels are gathered, n[0] to n[3] are the four texels of each 2x2 quad in the scalar order.
+// There is no SSE4.1 version, for the same reason as for sRGB.
+SPD_CPU_TARGET("avx2")
+A_STATIC void SpdCpuDecodeNormal_AVX2(__m256 *n, __m256 r, __m256 g, __m256 variance)
+{
+    const __m256 one = _mm256_set1_ps(1.0f);
+    __m256 x = _mm256_sub_ps(_mm256_mul_ps(r, _mm256_set1_ps(2.0f)), one);
+    __m256 y = _mm256_sub_ps(_mm256_mul_ps(g, _mm256_set1_ps(2.0f)), one);
+    __m256 z = _mm256_sub_ps(_mm256_sub_ps(one, _mm256_mul_ps(x, x)), _mm256_mul_ps(y, y));
+    z = _mm256_sqrt_ps(_mm256_max_ps(z, _mm256_setzero_ps()));
+    __m256 l = _mm256_div_ps(one, _mm256_add_ps(one, variance));
+    n[0] = _mm256_mul_ps(x, l);
+    n[1] = _mm256_mul_ps(y, l);
+    n[2] = _mm256_mul_ps(z, l);
+}
+
+SPD_CPU_TARGET("avx2")
+A_STATIC void SpdCpuEncodeNormal_AVX2(__m256 *d, __m256 (*n)[3])
+{
+    __m256 v[3];
+    for (AU1 c = 0; c < 3; c++)
+    {
+        v[c] = _mm256_add_ps(_mm256_add_ps(_mm256_add_ps(n[0][c], n[1][c]), n[2][c]), n[3][c]);
+        v[c] = _mm256_mul_ps(v[c], _mm256_set1_ps(0.25f));
+    }
+    __m256 len = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(v[0], v[0]), _mm256_mul_ps(v[1], v[1])),
+        _mm256_mul_ps(v[2], v[2]));
+    len = _mm256_max_ps(_mm256_sqrt_ps(len), _mm256_set1_ps(1.0f / 65536.0f));
+    __m256 scale = _mm256_div_ps(_mm256_set1_ps(0.5f), len);
+    for (AU1 c = 0; c < 3; c++)
+        d[c] = _mm256_add_ps(_mm256_mul_ps(v[c], scale), _mm256_set1_ps(0.5f));
+    d[3] = _mm256_div_ps(_mm256_sub_ps(_mm256_set1_ps(1.0f), len), len);
+}
+
+SPD_CPU_TARGET("avx2")
+A_STATIC void SpdCpuReduceRowRGBA32FNormal_AVX2(AB1 *A_RESTRICT dst, const AB1 *A_RESTRICT row0,
+    const AB1 *A_RESTRICT row1, AU1 x, AU1 count, AU1 inWidth)
+{
+    const AF1 *rows[2] = { (const AF1*)row0, (const AF1*)row1 };
+    AF1 *d = (AF1*)dst;
+    const __m256i index = _mm256_setr_epi32(0, 8, 16, 24, 32, 40, 48, 56);
+    AU1 end = x + count;
+    AU1 simdEnd = AMinU1(end, inWidth / 2);
+    AU1 i = x;
+    for (; i + 8 <= simdEnd; i += 8)
+    {
+        __m256 n[4][3];
+        for (AU1 j = 0; j < 4; j++)
+        {
+            const AF1 *t = rows[j / 2] + (i * 2 + j % 2) * 4;
+            SpdCpuDecodeNormal_AVX2(n[j], _mm256_i32gather_ps(t, index, 4), _mm256_i32gather_ps(t + 1, index, 4),
+                _mm256_i32gather_ps(t + 3, index, 4));
+        }
+        __m256 o[4];
+        SpdCpuEncodeNormal_AVX2(o, n);
+        // 4x8 transpose back to RGBA texels
+        __m256 t0 = _mm256_unpacklo_ps(o[0], o[1]);
+        __m256 t1 = _mm256_unpackhi_ps(o[0], o[1]);
+        __m256 t2 = _mm256_unpacklo_ps(o[2], o[3]);
+        __m256 t3 = _mm256_unpackhi_ps(o[2], o[3]);
+        __m256 u0 = _mm256_shuffle_ps(t0, t2, 0x44);
+        __m256 u1 = _mm256_shuffle_ps(t0, t2, 0xEE);
+        __m256 u2 = _mm256_shuffle_ps(t1, t3, 0x44);
+        __m256 u3 = _mm256_shuffle_ps(t1, t3, 0xEE);
+        _mm256_storeu_ps(d + i * 4, _mm256_permute2f128_ps(u0, u1, 0x20));
+        _mm256_storeu_ps(d + i * 4 + 8, _mm256_permute2f128_ps(u2, u3, 0x20));
+        _mm256_storeu_ps(d + i * 4 + 16, _mm256_permute2f128_ps(u0, u1, 0x31));
+        _mm256_storeu_ps(d + i * 4 + 24, _mm256_permute2f128_ps(u2, u3, 0x31));
+    }
+    if (i < end)
+        SpdCpuReduceRowRGBA32FNormal(dst, row0, row1, i, end - i, inWidth);
+}
+
+SPD_CPU_TARGET("avx2")
+A_STATIC __m256 SpdCpuUnpackChannel8_AVX2(__m256i v, int shift)
+{
+    v = _mm256_and_si256(_mm256_srli_epi32(v, shift), _mm256_set1_epi32(0xFF));
+    return _mm256_mul_ps(_mm256_cvtepi32_ps(v), _mm256_set1_ps(1.0f / 255.0f));
+}
+
+SPD_CPU_TARGET("avx2")
+A_STATIC __m256i SpdCpuPackChannel8_AVX2(__m256 v, int shift)
+{
+    v = _mm256_min_ps(_mm256_max_ps(v, _mm256_setzero_ps()), _mm256_set1_ps(1.0f));
+    v = _mm256_add_ps(_mm256_mul_ps(v, _mm256_set1_ps(255.0f)), _mm256_set1_ps(0.5f));
+    return _mm256_slli_epi32(_mm256_cvttps_epi32(v), shift);
+}
+
+SPD_CPU_TARGET("avx2")
+A_STATIC void SpdCpuReduceRowRGBA8UnormNormal_AVX2(AB1 *A_RESTRICT dst, const AB1 *A_RESTRICT row0,
+    const AB1 *A_RESTRICT row1, AU1 x, AU1 count, AU1 inWidth)
+{
+    const AB1 *rows[2] = { row0, row1 };
+    const __m256i index = _mm256_setr_epi32(0, 2, 4, 6, 8, 10, 12, 14);
+    AU1 end = x + count;
+    AU1 simdEnd = AMinU1(end, inWidth / 2);
+    AU1 i = x;
+    for (; i + 8 <= simdEnd; i += 8)
+    {
+        __m256 n[4][3];
+        for (AU1 j = 0; j < 4; j++)
+        {
+            __m256i t = _mm256_i32gather_epi32((const int*)(rows[j / 2] + (i * 2 + j % 2) * 4), index, 4);
+            SpdCpuDecodeNormal_AVX2(n[j], SpdCpuUnpackChannel8_AVX2(t, 0), SpdCpuUnpackChannel8_AVX2(t, 8),
+                SpdCpuUnpackChannel8_AVX2(t, 24));
+        }
+        __m256 o[4];
+        SpdCpuEncodeNormal_AVX2(o, n);
+        __m256i texels = _mm256_or_si256(
+            _mm256_or_si256(SpdCpuPackChannel8_AVX2(o[0], 0), SpdCpuPackChannel8_AVX2(o[1], 8)),
+            _mm256_or_si256(SpdCpuPackChannel8_AVX2(o[2], 16), SpdCpuPackChannel8_AVX2(o[3], 24)));
+        _mm256_storeu_si256((__m256i*)(dst + i * 4), texels);
+    }
+    if (i < end)
+        SpdCpuReduceRowRGBA8UnormNormal(dst, row0, row1, i, end - i, inWidth);
+}
+
+SPD_CPU_TARGET("avx512f,avx512bw")
+A_STATIC void SpdCpuDecodeNormal_AVX512(__m512 *n, __m512 r, __m512 g, __m512 variance)
+{
+    const __m512 one = _mm512_set1_ps(1.0f);
+    __m512 x = _mm512_sub_ps(_mm512_mul_ps(r, _mm512_set1_ps(2.0f)), one);
+    __m512 y = _mm512_sub_ps(_mm512_mul_ps(g, _mm512_set1_ps(2.0f)), one);
+    __m512 z = _mm512_sub_ps(_mm512_sub_ps(one, _mm512_mul_ps(x, x)), _mm512_mul_ps(y, y));
+    z = _mm512_sqrt_ps(_mm512_max_ps(z, _mm512_setzero_ps()));
+    __m512 l = _mm512_div_ps(one, _mm512_add_ps(one, variance));
+    n[0] = _mm512_mul_ps(x, l);
+    n[1] = _mm512_mul_ps(y, l);
+    n[2] = _mm512_mul_ps(z, l);
+}
+
+SPD_CPU_TARGET("avx512f,avx512bw")
+A_STATIC void SpdCpuEncodeNormal_AVX512(__m512 *d, __m512 (*n)[3])
+{
+    __m512 v[3];
+    for (AU1 c = 0; c < 3; c++)
+    {
+        v[c] = _mm512_add_ps(_mm512_add_ps(_mm512_add_ps(n[0][c], n[1][c]), n[2][c]), n[3][c]);
+        v[c] = _mm512_mul_ps(v[c], _mm512_set1_ps(0.25f));
+    }
+    __m512 len = _mm512_add_ps(_mm512_add_ps(_mm512_mul_ps(v[0], v[0]), _mm512_mul_ps(v[1], v[1])),
+        _mm512_mul_ps(v[2], v[2]));
+    len = _mm512_max_ps(_mm512_sqrt_ps(len), _mm512_set1_ps(1.0f / 65536.0f));
+    __m512 scale = _mm512_div_ps(_mm512_set1_ps(0.5f), len);
+    for (AU1 c = 0; c < 3; c++)
+        d[c] = _mm512_add_ps(_mm512_mul_ps(v[c], scale), _mm512_set1_ps(0.5f));
+    d[3] = _mm512_div_ps(_mm512_sub_ps(_mm512_set1_ps(1.0f), len), len);
+}
+
+SPD_CPU_TARGET("avx512f,avx512bw")
+A_STATIC void SpdCpuReduceRowRGBA32FNormal_AVX512(AB1 *A_RESTRICT dst, const AB1 *A_RESTRICT row0,
+    const AB1 *A_RESTRICT row1, AU1 x, AU1 count, AU1 inWidth)
+{
+    const AF1 *rows[2] = { (const AF1*)row0, (const AF1*)row1 };
+    AF1 *d = (AF1*)dst;
+    const __m512i index = _mm512_setr_epi32(0, 8, 16, 24, 32, 40, 48, 56, 64, 72, 80, 88, 96, 104, 112, 120);
+    const __m512i outIndex = _mm512_setr_epi32(0, 4, 8, 12, 16, 20, 24, 28, 32, 36, 40, 44, 48, 52, 56, 60);
+    AU1 end = x + count;
+    AU1 simdEnd = AMinU1(end, inWidth / 2);
+    AU1 i = x;
+    for (; i + 16 <= simdEnd; i += 16)
+    {
+        __m512 n[4][3];
+        for (AU1 j = 0; j < 4; j++)
+        {
+            const AF1 *t = rows[j / 2] + (i * 2 + j % 2) * 4;
+            SpdCpuDecodeNormal_AVX512(n[j], _mm512_i32gather_ps(index, t, 4), _mm512_i32gather_ps(index, t + 1, 4),
+                _mm512_i32gather_ps(index, t + 3, 4));
+        }
+        __m512 o[4];
+        SpdCpuEncodeNormal_AVX512(o, n);
+        for (AU1 c = 0; c < 4; c++)
+            _mm512_i32scatter_ps(d + i * 4 + c, outIndex, o[c], 4);
+    }
+    if (i < end)
+        SpdCpuReduceRowRGBA32FNormal(dst, row0, row1, i, end - i, inWidth);
+}
+
+SPD_CPU_TARGET("avx512f,avx512bw")
+A_STATIC __m512 SpdCpuUnpackChannel8_AVX512(__m512i v, unsigned int shift)
+{
+    v = _mm512_and_si512(_mm512_srli_epi32(v, shift), _mm512_set1_epi32(0xFF));
+    return _mm512_mul_ps(_mm512_cvtepi32_ps(v), _mm512_set1_ps(1.0f / 255.0f));
+}
+
+SPD_CPU_TARGET("avx512f,avx512bw")
+A_STATIC __m512i SpdCpuPackChannel8_AVX512(__m512 v, unsigned int shift)
+{
+    v = _mm512_min_ps(_mm512_max_ps(v, _mm512_setzero_ps()), _mm512_set1_ps(1.0f));
+    v = _mm512_add_ps(_mm512_mul_ps(v, _mm512_set1_ps(255.0f)), _mm512_set1_ps(0.5f));
+    return _mm512_slli_epi32(_mm512_cvttps_epi32(v), shift);
+}
+
+SPD_CPU_TARGET("avx512f,avx512bw")
+A_STATIC void SpdCpuReduceRowRGBA8UnormNormal_AVX512(AB1 *A_RESTRICT dst, const AB1 *A_RESTRICT row0,
+    const AB1 *A_RESTRICT row1, AU1 x, AU1 count, AU1 inWidth)
+{
+    const AB1 *rows[2] = { row0, row1 };
+    const __m512i index = _mm512_setr_epi32(0, 2, 4, 6, 8, 10, 12, 14, 16, 18, 20, 22, 24, 26, 28, 30);
+    AU1 end = x + count;
+    AU1 simdEnd = AMinU1(end, inWidth / 2);
+    AU1 i = x;
+    for (; i + 16 <= simdEnd; i += 16)
+    {
+        __m512 n[4][3];
+        for (AU1 j = 0; j < 4; j++)
+        {
+            __m512i t = _mm512_i32gather_epi32(index, (const int*)(rows[j / 2] + (i * 2 + j % 2) * 4), 4);
+            SpdCpuDecodeNormal_AVX512(n[j], SpdCpuUnpackChannel8_AVX512(t, 0), SpdCpuUnpackChannel8_AVX512(t, 8),
+                SpdCpuUnpackChannel8_AVX512(t, 24));
+        }
+        __m512 o[4];
+        SpdCpuEncodeNormal_AVX512(o, n);
+        __m512i texels = _mm512_or_si512(
+            _mm512_or_si512(SpdCpuPackChannel8_AVX512(o[0], 0), SpdCpuPackChannel8_AVX512(o[1], 8)),
+            _mm512_or_si512(SpdCpuPackChannel8_AVX512(o[2], 16), SpdCpuPackChannel8_AVX512(o[3], 24)));
+        _mm512_storeu_si512(dst + i * 4, texels);
+    }
+    if (i < end)
+        SpdCpuReduceRowRGBA8UnormNormal(dst, row0, row1, i, end - i, inWidth);
+}
+
+// Depth aware, same texel grouping as the RGBA32F kernels. The depth of every texel is broadcast to its four lanes.
+SPD_CPU_TARGET("sse4.1")
+A_STATIC __m128 SpdCpuReduce4DepthAware_SSE41(__m128 v0, __m128 v1, __m128 v2, __m128 v3, bool reversed)
+{
+    const __m128 one = _mm_set1_ps(1.0f);
+    const __m128 sign = _mm_set1_ps(-0.0f);
+    __m128 d[4] = { _mm_shuffle_ps(v0, v0, 0xFF), _mm_shuffle_ps(v1, v1, 0xFF), _mm_shuffle_ps(v2, v2, 0xFF),
+        _mm_shuffle_ps(v3, v3, 0xFF) };
+    __m128 nearest = reversed ? _mm_max_ps(_mm_max_ps(d[0], d[1]), _mm_max_ps(d[2], d[3])) :
+        _mm_min_ps(_mm_min_ps(d[0], d[1]), _mm_min_ps(d[2], d[3]));
+    __m128 tolerance = _mm_mul_ps(_mm_set1_ps(SPD_CPU_DEPTH_TOLERANCE), _mm_andnot_ps(sign, nearest));
+    __m128 w[4];
+    for (AU1 j = 0; j < 4; j++)
+        w[j] = _mm_and_ps(_mm_cmple_ps(_mm_andnot_ps(sign, _mm_sub_ps(d[j], nearest)), tolerance), one);
+    __m128 c = _mm_add_ps(_mm_mul_ps(v0, w[0]), _mm_mul_ps(v1, w[1]));
+    c = _mm_add_ps(_mm_add_ps(c, _mm_mul_ps(v2, w[2])), _mm_mul_ps(v3, w[3]));
+    __m128 weight = _mm_add_ps(_mm_add_ps(_mm_add_ps(w[0], w[1]), w[2]), w[3]);
+    c = _mm_mul_ps(c, _mm_div_ps(one, weight));
+    return _mm_blend_ps(c, nearest, 0x8);
+}
+
+SPD_CPU_TARGET("sse4.1")
+A_STATIC void SpdCpuReduceRowDepthAware_SSE41(AB1 *A_RESTRICT dst, const AB1 *A_RESTRICT row0,
+    const AB1 *A_RESTRICT row1, AU1 x, AU1 count, AU1 inWidth, bool reversed)
+{
+    const AF1 *r0 = (const AF1*)row0;
+    const AF1 *r1 = (const AF1*)row1;
+    AF1 *d = (AF1*)dst;
+    AU1 end = x + count;
+    AU1 simdEnd = AMinU1(end, inWidth / 2);
+    AU1 i = x;
+    for (; i < simdEnd; i++)
+    {
+        _mm_storeu_ps(d + i * 4, SpdCpuReduce4DepthAware_SSE41(_mm_loadu_ps(r0 + i * 8), _mm_loadu_ps(r0 + i * 8 + 4),
+            _mm_loadu_ps(r1 + i * 8), _mm_loadu_ps(r1 + i * 8 + 4), reversed));
+    }
+    if (i < end)
+        SpdCpuReduceRowDepthAware(dst, row0, row1, i, end - i, inWidth, reversed);
+}
+
+SPD_CPU_TARGET("avx2")
+A_STATIC __m256 SpdCpuReduce4DepthAware_AVX2(__m256 v0, __m256 v1, __m256 v2, __m256 v3, bool reversed)
+{
+    const __m256 one = _mm256_set1_ps(1.0f);
+    const __m256 sign = _mm256_set1_ps(-0.0f);
+    __m256 d[4] = { _mm256_permute_ps(v0, 0xFF), _mm256_permute_ps(v1, 0xFF), _mm256_permute_ps(v2, 0xFF),
+        _mm256_permute_ps(v3, 0xFF) };
+    __m256 nearest = reversed ? _mm256_max_ps(_mm256_max_ps(d[0], d[1]), _mm256_max_ps(d[2], d[3])) :
+        _mm256_min_ps(_mm256_min_ps(d[0], d[1]), _mm256_min_ps(d[2], d[3]));
+    __m256 tolerance = _mm256_mul_ps(_mm256_set1_ps(SPD_CPU_DEPTH_TOLERANCE), _mm256_andnot_ps(sign, nearest));
+    __m256 w[4];
+    for (AU1 j = 0; j < 4; j++)
+    {
+        __m256 distance = _mm256_andnot_ps(sign, _mm256_sub_ps(d[j], nearest));
+        w[j] = _mm256_and_ps(_mm256_cmp_ps(distance, tolerance, _CMP_LE_OQ), one);
+    }
+    __m256 c = _mm256_add_ps(_mm256_mul_ps(v0, w[0]), _mm256_mul_ps(v1, w[1]));
+    c = _mm256_add_ps(_mm256_add_ps(c, _mm256_mul_ps(v2, w[2])), _mm256_mul_ps(v3, w[3]));
+    __m256 weight = _mm256_add_ps(_mm256_add_ps(_mm256_add_ps(w[0], w[1]), w[2]), w[3]);
+    c = _mm256_mul_ps(c, _mm256_div_ps(one, weight));
+    return _mm256_blend_ps(c, nearest, 0x88);
+}
+
+// 2 output texels per iteration, regrouped like in SpdCpuReduceRowRGBA32F_AVX2()
+SPD_CPU_TARGET("avx2")
+A_STATIC void SpdCpuReduceRowDepthAware_AVX2(AB1 *A_RESTRICT dst, const AB1 *A_RESTRICT row0,
+    const AB1 *A_RESTRICT row1, AU1 x, AU1 count, AU1 inWidth, bool reversed)
+{
+    const AF1 *r0 = (const AF1*)row0;
+    const AF1 *r1 = (const AF1*)row1;
+    AF1 *d = (AF1*)dst;
+    AU1 end = x + count;
+    AU1 simdEnd = AMinU1(end, inWidth / 2);
+    AU1 i = x;
+    for (; i + 2 <= simdEnd; i += 2)
+    {
+        __m256 a0 = _mm256_loadu_ps(r0 + i * 8);
+        __m256 a1 = _mm256_loadu_ps(r0 + i * 8 + 8);
+        __m256 b0 = _mm256_loadu_ps(r1 + i * 8);
+        __m256 b1 = _mm256_loadu_ps(r1 + i * 8 + 8);
+        _mm256_storeu_ps(d + i * 4, SpdCpuReduce4DepthAware_AVX2(
+            _mm256_permute2f128_ps(a0, a1, 0x20), _mm256_permute2f128_ps(a0, a1, 0x31),
+            _mm256_permute2f128_ps(b0, b1, 0x20), _mm256_permute2f128_ps(b0, b1, 0x31), reversed));
+    }
+    if (i < end)
+        SpdCpuReduceRowDepthAware(dst, row0, row1, i, end - i, inWidth, reversed);
+}
+
+SPD_CPU_TARGET("avx512f,avx512bw")
+A_STATIC __m512 SpdCpuReduce4DepthAware_AVX512(__m512 v0, __m512 v1, __m512 v2, __m512 v3, bool reversed)
+{
+    const __m512 one = _mm512_set1_ps(1.0f);
+    __m512 d[4] = { _mm512_permute_ps(v0, 0xFF), _mm512_permute_ps(v1, 0xFF), _mm512_permute_ps(v2, 0xFF),
+        _mm512_permute_ps(v3, 0xFF) };
+    __m512 nearest = reversed ? _mm512_max_ps(_mm512_max_ps(d[0], d[1]), _mm512_max_ps(d[2], d[3])) :
+        _mm512_min_ps(_mm512_min_ps(d[0], d[1]), _mm512_min_ps(d[2], d[3]));
+    __m512 tolerance = _mm512_mul_ps(_mm512_set1_ps(SPD_CPU_DEPTH_TOLERANCE), _mm512_abs_ps(nearest));
+    __m512 w[4];
+    for (AU1 j = 0; j < 4; j++)
+    {
+        __mmask16 near = _mm512_cmp_ps_mask(_mm512_abs_ps(_mm512_sub_ps(d[j], nearest)), tolerance, _CMP_LE_OQ);
+        w[j] = _mm512_maskz_mov_ps(near, one);
+    }
+    __m512 c = _mm512_add_ps(_mm512_mul_ps(v0, w[0]), _mm512_mul_ps(v1, w[1]));
+    c = _mm512_add_ps(_mm512_add_ps(c, _mm512_mul_ps(v2, w[2])), _mm512_mul_ps(v3, w[3]));
+    __m512 weight = _mm512_add_ps(_mm512_add_ps(_mm512_add_ps(w[0], w[1]), w[2]), w[3]);
+    c = _mm512_mul_ps(c, _mm512_div_ps(one, weight));
+    return _mm512_mask_blend_ps(0x8888, c, nearest);
+}
+
+// 4 output texels per iteration, split like in SpdCpuReduceRowRGBA32F_AVX512()
+SPD_CPU_TARGET("avx512f,avx512bw")
+A_STATIC void SpdCpuReduceRowDepthAware_AVX512(AB1 *A_RESTRICT dst, const AB1 *A_RESTRICT row0,
+    const AB1 *A_RESTRICT row1, AU1 x, AU1 count, AU1 inWidth, bool reversed)
+{
+    const AF1 *r0 = (const AF1*)row0;
+    const AF1 *r1 = (const AF1*)row1;
+    AF1 *d = (AF1*)dst;
+    AU1 end = x + count;
+    AU1 simdEnd = AMinU1(end, inWidth / 2);
+    AU1 i = x;
+    for (; i + 4 <= simdEnd; i += 4)
+    {
+        __m512 a0 = _mm512_loadu_ps(r0 + i * 8);
+        __m512 a1 = _mm512_loadu_ps(r0 + i * 8 + 16);
+        __m512 b0 = _mm512_loadu_ps(r1 + i * 8);
+        __m512 b1 = _mm512_loadu_ps(r1 + i * 8 + 16);
+        _mm512_storeu_ps(d + i * 4, SpdCpuReduce4DepthAware_AVX512(
+            _mm512_maskz_shuffle_f32x4(0xFFFF, a0, a1, 0x88), _mm512_maskz_shuffle_f32x4(0xFFFF, a0, a1, 0xDD),
+            _mm512_maskz_shuffle_f32x4(0xFFFF, b0, b1, 0x88), _mm512_maskz_shuffle_f32x4(0xFFFF, b0, b1, 0xDD), reversed));
+    }
+    if (i < end)
+        SpdCpuReduceRowDepthAware(dst, row0, row1, i, end - i, inWidth, reversed);
+}
+
+SPD_CPU_DEPTH_AWARE_KERNELS(_SSE41)
+SPD_CPU_DEPTH_AWARE_KERNELS(_AVX2)
+SPD_CPU_DEPTH_AWARE_KERNELS(_AVX512)
+
+// Multi target, the two float texels of a row are split into the even and odd columns: for n output texels one register
+// holds the n even input texels, the other the n odd ones. AVX2 and AVX-512 split within 128-bit lanes, the outputs are
+// put back in order at the end.
+SPD_CPU_TARGET("sse4.1")
+A_STATIC void SpdCpuSplitRG32F_SSE41(const AF1 *row, __m128 &even, __m128 &odd)
+{
+    __m128 a = _mm_loadu_ps(row);
+    __m128 b = _mm_loadu_ps(row + 4);
+    even = _mm_shuffle_ps(a, b, 0x44);
+    odd = _mm_shuffle_ps(a, b, 0xEE);
+}
+
+SPD_CPU_TARGET("sse4.1")
+A_STATIC __m128 SpdCpuLengthSquared_SSE41(__m128 v)
+{
+    __m128 squared = _mm_mul_ps(v, v);
+    return _mm_add_ps(squared, _mm_shuffle_ps(squared, squared, 0xB1));
+}
+
+// 2 output texels per iteration
+SPD_CPU_TARGET("sse4.1")
+A_STATIC void SpdCpuReduceRowRG32FMinMax_SSE41(AB1 *A_RESTRICT dst, const AB1 *A_RESTRICT row0,
+    const AB1 *A_RESTRICT row1, AU1 x, AU1 count, AU1 inWidth)
+{
+    const AF1 *r0 = (const AF1*)row0;
+    const AF1 *r1 = (const AF1*)row1;
+    AF1 *d = (AF1*)dst;
+    AU1 end = x + count;
+    AU1 simdEnd = AMinU1(end, inWidth / 2);
+    AU1 i = x;
+    for (; i + 2 <= simdEnd; i += 2)
+    {
+        __m128 e0, o0, e1, o1;
+        SpdCpuSplitRG32F_SSE41(r0 + i * 4, e0, o0);
+        SpdCpuSplitRG32F_SSE41(r1 + i * 4, e1, o1);
+        __m128 lo = _mm_min_ps(_mm_min_ps(e0, e1), _mm_min_ps(o0, o1));
+        __m128 hi = _mm_max_ps(_mm_max_ps(e0, e1), _mm_max_ps(o0, o1));
+        _mm_storeu_ps(d + i * 2, _mm_blend_ps(lo, hi, 0xA));
+    }
+    if (i < end)
+        SpdCpuReduceRowRG32FMinMax(dst, row0, row1, i, end - i, inWidth);
+}
+
+SPD_CPU_TARGET("sse4.1")
+A_STATIC void SpdCpuReduceRowRG32FMaxLength_SSE41(AB1 *A_RESTRICT dst, const AB1 *A_RESTRICT row0,
+    const AB1 *A_RESTRICT row1, AU1 x, AU1 count, AU1 inWidth)
+{
+    const AF1 *r0 = (const AF1*)row0;
+    const AF1 *r1 = (const AF1*)row1;
+    AF1 *d = (AF1*)dst;
+    AU1 end = x + count;
+    AU1 simdEnd = AMinU1(end, inWidth / 2);
+    AU1 i = x;
+    for (; i + 2 <= simdEnd; i += 2)
+    {
+        __m128 v[4];
+        SpdCpuSplitRG32F_SSE41(r0 + i * 4, v[0], v[1]);
+        SpdCpuSplitRG32F_SSE41(r1 + i * 4, v[2], v[3]);
+        __m128 longest = v[0];
+        __m128 longestLength = SpdCpuLengthSquared_SSE41(v[0]);
+        for (AU1 j = 1; j < 4; j++)
+        {
+            __m128 length = SpdCpuLengthSquared_SSE41(v[j]);
+            __m128 longer = _mm_cmpgt_ps(length, longestLength);
+            longest = _mm_blendv_ps(longest, v[j], longer);
+            longestLength = _mm_blendv_ps(longestLength, length, longer);
+        }
+        _mm_storeu_ps(d + i * 2, longest);
+    }
+    if (i < end)
+        SpdCpuReduceRowRG32FMaxLength(dst, row0, row1, i, end - i, inWidth);
+}
+
+SPD_CPU_TARGET("avx2")
+A_STATIC void SpdCpuSplitRG32F_AVX2(const AF1 *row, __m256 &even, __m256 &odd)
+{
+    __m256 a = _mm256_loadu_ps(row);
+    __m256 b = _mm256_loadu_ps(row + 8);
+    even = _mm256_shuffle_ps(a, b, 0x44);
+    odd = _mm256_shuffle_ps(a, b, 0xEE);
+}
+
+// Outputs come out as 0 2 | 1 3
+SPD_CPU_TARGET("avx2")
+A_STATIC __m256 SpdCpuOrderRG32F_AVX2(__m256 v)
+{
+    return _mm256_castpd_ps(_mm256_permute4x64_pd(_mm256_castps_pd(v), 0xD8));
+}
+
+SPD_CPU_TARGET("avx2")
+A_STATIC __m256 SpdCpuLengthSquared_AVX2(__m256 v)
+{
+    __m256 squared = _mm256_mul_ps(v, v);
+    return _mm256_add_ps(squared, _mm256_permute_ps(squared, 0xB1));
+}
+
+// 4 output texels per iteration
+SPD_CPU_TARGET("avx2")
+A_STATIC void SpdCpuReduceRowRG32FMinMax_AVX2(AB1 *A_RESTRICT dst, const AB1 *A_RESTRICT row0,
+    const AB1 *A_RESTRICT row1, AU1 x, AU1 count, AU1 inWidth)
+{
+    const AF1 *r0 = (const AF1*)row0;
+    const AF1 *r1 = (const AF1*)row1;
+    AF1 *d = (AF1*)dst;
+    AU1 end = x + count;
+    AU1 simdEnd = AMinU1(end, inWidth / 2);
+    AU1 i = x;
+    for (; i + 4 <= simdEnd; i += 4)
+    {
+        __m256 e0, o0, e1, o1;
+        SpdCpuSplitRG32F_AVX2(r0 + i * 4, e0, o0);
+        SpdCpuSplitRG32F_AVX2(r1 + i * 4, e1, o1);
+        __m256 lo = _mm256_min_ps(_mm256_min_ps(e0, e1), _mm256_min_ps(o0, o1));
+        __m256 hi = _mm256_max_ps(_mm256_max_ps(e0, e1), _mm256_max_ps(o0, o1));
+        _mm256_storeu_ps(d + i * 2, SpdCpuOrderRG32F_AVX2(_mm256_blend_ps(lo, hi, 0xAA)));
+    }
+    if (i < end)
+        SpdCpuReduceRowRG32FMinMax(dst, row0, row1, i, end - i, inWidth);
+}
+
+SPD_CPU_TARGET("avx2")
+A_STATIC void SpdCpuReduceRowRG32FMaxLength_AVX2(AB1 *A_RESTRICT dst, const AB1 *A_RESTRICT row0,
+    const AB1 *A_RESTRICT row1, AU1 x, AU1 count, AU1 inWidth)
+{
+    const AF1 *r0 = (const AF1*)row0;
+    const AF1 *r1 = (const AF1*)row1;
+    AF1 *d = (AF1*)dst;
+    AU1 end = x + count;
+    AU1 simdEnd = AMinU1(end, inWidth / 2);
+    AU1 i = x;
+    for (; i + 4 <= simdEnd; i += 4)
+    {
+        __m256 v[4];
+        SpdCpuSplitRG32F_AVX2(r0 + i * 4, v[0], v[1]);
+        SpdCpuSplitRG32F_AVX2(r1 + i * 4, v[2], v[3]);
+        __m256 longest = v[0];
+        __m256 longestLength = SpdCpuLengthSquared_AVX2(v[0]);
+        for (AU1 j = 1; j < 4; j++)
+        {
+            __m256 length = SpdCpuLengthSquared_AVX2(v[j]);
+            __m256 longer = _mm256_cmp_ps(length, longestLength, _CMP_GT_OQ);
+            longest = _mm256_blendv_ps(longest, v[j], longer);
+            longestLength = _mm256_blendv_ps(longestLength, length, longer);
+        }
+        _mm256_storeu_ps(d + i * 2, SpdCpuOrderRG32F_AVX2(longest));
+    }
+    if (i < end)
+        SpdCpuReduceRowRG32FMaxLength(dst, row0, row1, i, end - i, inWidth);
+}
+
+SPD_CPU_TARGET("avx512f,avx512bw")
+A_STATIC void SpdCpuSplitRG32F_AVX512(const AF1 *row, __m512 &even, __m512 &odd)
+{
+    __m512 a = _mm512_loadu_ps(row);
+    __m512 b = _mm512_loadu_ps(row + 16);
+    even = _mm512_maskz_shuffle_ps(0xFFFF, a, b, 0x44);
+    odd = _mm512_maskz_shuffle_ps(0xFFFF, a, b, 0xEE);
+}
+
+// Outputs come out as 0 4 | 1 5 | 2 6 | 3 7
+SPD_CPU_TARGET("avx512f,avx512bw")
+A_STATIC __m512 SpdCpuOrderRG32F_AVX512(__m512 v)
+{
+    const __m512i order = _mm512_setr_epi64(0, 2, 4, 6, 1, 3, 5, 7);
+    return _mm512_castpd_ps(_mm512_maskz_permutexvar_pd(0xFF, order, _mm512_castps_pd(v)));
+}
+
+SPD_CPU_TARGET("avx512f,avx512bw")
+A_STATIC __m512 SpdCpuLengthSquared_AVX512(__m512 v)
+{
+    __m512 squared = _mm512_mul_ps(v, v);
+    return _mm512_add_ps(squared, _mm512_maskz_permute_ps(0xFFFF, squared, 0xB1));
+}
+
+// 8 output texels per iteration
+SPD_CPU_TARGET("avx512f,avx512bw")
+A_STATIC void SpdCpuReduceRowRG32FMinMax_AVX512(AB1 *A_RESTRICT dst, const AB1 *A_RESTRICT row0,
+    const AB1 *A_RESTRICT row1, AU1 x, AU1 count, AU1 inWidth)
+{
+    const AF1 *r0 = (const AF1*)row0;
+    const AF1 *r1 = (const AF1*)row1;
+    AF1 *d = (AF1*)dst;
+    AU1 end = x + count;
+    AU1 simdEnd = AMinU1(end, inWidth / 2);
+    AU1 i = x;
+    for (; i + 8 <= simdEnd; i += 8)
+    {
+        __m512 e0, o0, e1, o1;
+        SpdCpuSplitRG32F_AVX512(r0 + i * 4, e0, o0);
+        SpdCpuSplitRG32F_AVX512(r1 + i * 4, e1, o1);
+        __m512 lo = _mm512_min_ps(_mm512_min_ps(e0, e1), _mm512_min_ps(o0, o1));
+        __m512 hi = _mm512_max_ps(_mm512_max_ps(e0, e1), _mm512_max_ps(o0, o1));
+        _mm512_storeu_ps(d + i * 2, SpdCpuOrderRG32F_AVX512(_mm512_mask_blend_ps(0xAAAA, lo, hi)));
+    }
+    if (i < end)
+        SpdCpuReduceRowRG32FMinMax(dst, row0, row1, i, end - i, inWidth);
+}
+
+SPD_CPU_TARGET("avx512f,avx512bw")
+A_STATIC void SpdCpuReduceRowRG32FMaxLength_AVX512(AB1 *A_RESTRICT dst, const AB1 *A_RESTRICT row0,
+    const AB1 *A_RESTRICT row1, AU1 x, AU1 count, AU1 inWidth)
+{
+    const AF1 *r0 = (const AF1*)row0;
+    const AF1 *r1 = (const AF1*)row1;
+    AF1 *d = (AF1*)dst;
+    AU1 end = x + count;
+    AU1 simdEnd = AMinU1(end, inWidth / 2);
+    AU1 i = x;
+    for (; i + 8 <= simdEnd; i += 8)
+    {
+        __m512 v[4];
+        SpdCpuSplitRG32F_AVX512(r0 + i * 4, v[0], v[1]);
+        SpdCpuSplitRG32F_AVX512(r1 + i * 4, v[2], v[3]);
+        __m512 longest = v[0];
+        __m512 longestLength = SpdCpuLengthSquared_AVX512(v[0]);
+        for (AU1 j = 1; j < 4; j++)
+        {
+            __m512 length = SpdCpuLengthSquared_AVX512(v[j]);
+            __mmask16 longer = _mm512_cmp_ps_mask(length, longestLength, _CMP_GT_OQ);
+            longest = _mm512_mask_mov_ps(longest, longer, v[j]);
+            longestLength = _mm512_mask_mov_ps(longestLength, longer, length);
+        }
+        _mm512_storeu_ps(d + i * 2, SpdCpuOrderRG32F_AVX512(longest));
+    }
+    if (i < end)
+        SpdCpuReduceRowRG32FMaxLength(dst, row0, row1, i, end - i, inWidth);
+}
+
+#endif // #ifdef SPD_CPU_SIMD
+
+#if defined(__clang__)
+    #pragma STDC FP_CONTRACT DEFAULT
+#elif defined(A_GCC)
+    #pragma GCC pop_options
+#endif
+
+//==============================================================================================================================
+//                                                     CONFIGURATION
+//==============================================================================================================================
+enum class SpdCpuIsa : AU1
+{
+    Scalar,
+    SSE41,
+    AVX2,
+    AVX512, // AVX-512F and AVX-512BW
+};
+#define SPD_CPU_ISA_COUNT 4
+
+// Order in which the workers pick up the tiles of a plan rectangle
+enum class SpdCpuTraversal : AU1
+{
+    RowMajor,
+    Morton, // Z-order, neighbouring tiles stay close in time
+};
+#define SPD_CPU_TRAVERSAL_COUNT 2
+
+#define SPD_CPU_MAX_THREADS 64
+
+struct SpdCpuConfig
+{
+    SpdCpuIsa isa;
+    AU1 threadCount; // including the calling thread
+    AU1 tileSize; // not read by SpdDownsampleCpu, pass it to SpdCreatePlan
+    SpdCpuTraversal traversal;
+};
+
+A_STATIC bool SpdCpuIsaSupported(SpdCpuIsa isa)
+{
+    if (isa == SpdCpuIsa::Scalar)
+        return true;
+#if defined(SPD_CPU_SIMD) && defined(A_GCC)
+    __builtin_cpu_init();
+    switch (isa)
+    {
+    case SpdCpuIsa::SSE41:
+        return __builtin_cpu_supports("sse4.1");
+    case SpdCpuIsa::AVX2:
+        return __builtin_cpu_supports("avx2");
+    case SpdCpuIsa::AVX512:
+        return __builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512bw");
+    default:
+        return false;
+    }
+#elif defined(SPD_CPU_SIMD)
+    int info[4];
+    __cpuid(info, 1);
+    bool sse41 = (info[2] & (1 << 19)) != 0;
+    bool osxsave = (info[2] & (1 << 27)) != 0;
+    AL1 xcr0 = osxsave ? AL1(_xgetbv(0)) : 0;
+    __cpuidex(info, 7, 0);
+    switch (isa)
+    {
+    case SpdCpuIsa::SSE41:
+        return sse41;
+    case SpdCpuIsa::AVX2:
+        return (xcr0 & 0x06) == 0x06 && (info[1] & (1 << 5)) != 0;
+    case SpdCpuIsa::AVX512:
+        return (xcr0 & 0xE6) == 0xE6 && (info[1] & (1 << 16)) != 0 && (info[1] & (1 << 30)) != 0;
+    default:
+        return false;
+    }
+#else
+    return false;
+#endif
+}
+
+A_STATIC SpdCpuIsa SpdCpuBestIsa()
+{
+    for (AU1 i = SPD_CPU_ISA_COUNT - 1; i > 0; i--)
+        if (SpdCpuIsaSupported(SpdCpuIsa(i)))
+            return SpdCpuIsa(i);
+    return SpdCpuIsa::Scalar;
+}
+
+// Best ISA, single threaded, row-major, same tile size as the GPU version
+A_STATIC SpdCpuConfig SpdCpuDefaultConfig()
+{
+    return SpdCpuConfig{ SpdCpuBestIsa(), 1, SPD_TILE_SIZE, SpdCpuTraversal::RowMajor };
+}
+
+// Runs worker(i) on the calling thread (i = 0) and on threadCount - 1 started threads, returns once all are done.
+// If a thread can't be started, the calling thread and the ones already started do the work, so workers must not wait
+// for each other by count.
+template <typename Worker>
+A_STATIC void SpdCpuRunWorkers(Worker worker, AU1 threadCount)
+{
+    std::thread workers[SPD_CPU_MAX_THREADS - 1];
+    AU1 started = 0;
+#if defined(__cpp_exceptions) || defined(_CPPUNWIND)
+    try
+    {
+        for (; started + 1 < AMinU1(threadCount, SPD_CPU_MAX_THREADS); started++)
+            workers[started] = std::thread(worker, started + 1);
+    }
+    catch (...)
+    {
+        // Swallowed on purpose, the workers started so far and the calling thread share the work
+    }
+#else
+    for (; started + 1 < AMinU1(threadCount, SPD_CPU_MAX_THREADS); started++)
+        workers[started] = std::thread(worker, started + 1);
+#endif
+    worker(0);
+    for (AU1 i = 0; i < started; i++)
+        workers[i].join();
+}
+
+#ifdef SPD_CPU_SIMD
+    #define SPD_CPU_KERNELS(name) { name, name##_SSE41, name##_AVX2, name##_AVX512 }
+    // kernels that need gathers, SSE4.1 uses the scalar one
+    #define SPD_CPU_GATHER_KERNELS(name) { name, name, name##_AVX2, name##_AVX512 }
+#else
+    #define SPD_CPU_KERNELS(name) { name, name, name, name }
+    #define SPD_CPU_GATHER_KERNELS(name) { name, name, name, name }
+#endif
+
+// Row kernel for format, falls back to the scalar kernel if the ISA is not supported by this CPU
+A_STATIC SpdCpuReduceRowFn SpdCpuGetReduceRow(SpdCpuFormat format, SpdCpuIsa isa = SpdCpuIsa::Scalar)
+{
+    // indexed by SpdCpuFormat, then SpdCpuIsa
+    static const SpdCpuReduceRowFn kernels[][SPD_CPU_ISA_COUNT] =
+    {
+        SPD_CPU_KERNELS(SpdCpuReduceRowRGBA32F),
+        SPD_CPU_KERNELS(SpdCpuReduceRowRGBA8Unorm),
+        SPD_CPU_KERNELS(SpdCpuReduceRowRGBA8UnormFixed),
+        SPD_CPU_GATHER_KERNELS(SpdCpuReduceRowRGBA8UnormSrgb),
+        SPD_CPU_GATHER_KERNELS(SpdCpuReduceRowRGBA32FNormal),
+        SPD_CPU_GATHER_KERNELS(SpdCpuReduceRowRGBA8UnormNormal),
+        SPD_CPU_KERNELS(SpdCpuReduceRowRGBA32F),
+        SPD_CPU_KERNELS(SpdCpuReduceRowRGBA32F),
+        SPD_CPU_KERNELS(SpdCpuReduceRowR8Unorm),
+        SPD_CPU_KERNELS(SpdCpuReduceRowR16Unorm),
+        SPD_CPU_KERNELS(SpdCpuReduceRowR8UintMajority),
+        SPD_CPU_KERNELS(SpdCpuReduceRowR32UintMajority),
+        SPD_CPU_KERNELS(SpdCpuReduceRowR32UintOr),
+        SPD_CPU_KERNELS(SpdCpuReduceRowR32UintAnd),
+        SPD_CPU_KERNELS(SpdCpuReduceRowR32UintOr8x4),
+        SPD_CPU_KERNELS(SpdCpuReduceRowR32UintAnd8x4),
+        SPD_CPU_KERNELS(SpdCpuReduceRowR16UnormMaxHeight),
+        SPD_CPU_KERNELS(SpdCpuReduceRowRGBA32FDepthAware),
+        SPD_CPU_KERNELS(SpdCpuReduceRowRGBA32FDepthAwareMax),
+        SPD_CPU_KERNELS(SpdCpuReduceRowRG32FMinMax),
+        SPD_CPU_KERNELS(SpdCpuReduceRowRG32FMaxLength),
+    };
+    return kernels[AU1(format)][AU1(SpdCpuIsaSupported(isa) ? isa : SpdCpuIsa::Scalar)];
+}
+
+// Row kernel for level 1, which reads the source level. Same as SpdCpuGetReduceRow() except for the depth formats.
+A_STATIC SpdCpuReduceRowFn SpdCpuGetReduceSourceRow(SpdCpuFormat format, SpdCpuIsa isa = SpdCpuIsa::Scalar)
+{
+    if (format == SpdCpuFormat::RGBA32FVsm)
+        return SpdCpuReduceRowDepthVsm;
+    if (format == SpdCpuFormat::RGBA32FEvsm)
+        return SpdCpuReduceRowDepthEvsm;
+    return SpdCpuGetReduceRow(format, isa);
+}
+
+//==============================================================================================================================
+//                                                     ALPHA COVERAGE
+//==============================================================================================================================
+// Same scheme as SPD_ALPHA_COVERAGE in ffx_spd.h: the levels of a tile with at least SPD_CPU_COVERAGE_MIN_TILE_SIDE texels
+// per side are scaled to the coverage of the tile. The smaller tile levels (the last three, e.g. 4x4, 2x2 and 1x1 with
+// 64x64 tiles) have too few texels per tile to hit a target, a 1x1 region can only be fully covered or not at all, so they
+// are scaled together with the remaining levels to the coverage of all tiles of the slice. Coverage is counted on the
+// source, alpha is scaled after a level region is computed, levels are always computed from the unscaled previous level.
+// Like on the GPU the larger tile levels of neighbouring tiles get different scales, which shows as seams at the tile
+// borders where the coverage changes a lot.
+#define SPD_CPU_COVERAGE_MIN_TILE_SIDE 8
+
+// Number of tile levels that are scaled per tile
+A_STATIC AU1 SpdCpuCoverageTileLevels(AU1 tileSize)
+{
+    AU1 levels = 0;
+    while ((tileSize >> (levels + 1)) >= SPD_CPU_COVERAGE_MIN_TILE_SIDE)
+        levels++;
+    return levels;
+}
+
+A_STATIC AF1 SpdCpuLoadAlpha(SpdCpuFormat format, const AB1 *row, AU1 x)
+{
+    if (SpdCpuFormatTexelSize(format) != 16)
+        return SpdCpuUnpackUnorm8(row[x * 4 + 3]);
+    AF1 alpha;
+    memcpy(&alpha, row + x * 16 + 12, sizeof(alpha));
+    return alpha;
+}
+
+A_STATIC void SpdCpuStoreAlpha(SpdCpuFormat format, AB1 *row, AU1 x, AF1 alpha)
+{
+    alpha = ASatF1(alpha);
+    if (SpdCpuFormatTexelSize(format) != 16)
+        row[x * 4 + 3] = SpdCpuPackUnorm8(alpha);
+    else
+        memcpy(row + x * 16 + 12, &alpha, sizeof(alpha));
+}
+
+// Number of texels in [x0, x1) x [y0, y1) with alpha >= cutoff
+A_STATIC AU1 SpdCpuCountAlphaCoverage(const SpdMipChain &chain, AU1 level, AU1 slice, AU1 x0, AU1 y0, AU1 x1, AU1 y1,
+    AF1 cutoff)
+{
+    SpdCpuFormat format = chain.Layout().format;
+    AU1 covered = 0;
+    for (AU1 y = y0; y < y1; y++)
+    {
+        const AB1 *row = chain.Row(level, slice, y);
+        for (AU1 x = x0; x < x1; x++)
+            covered += SpdCpuLoadAlpha(format, row, x) >= cutoff ? 1 : 0;
+    }
+    return covered;
+}
+
+// Calls fn(row, x) for every texel of the regions {x0, y0, x1, y1} of a level
+template <typename Fn>
+A_STATIC void SpdCpuForEachRegionTexel(SpdMipChain &chain, AU1 level, AU1 slice, const AU1 (*regions)[4], AU1 regionCount,
+    Fn fn)
+{
+    for (AU1 r = 0; r < regionCount; r++)
+        for (AU1 y = regions[r][1]; y < regions[r][3]; y++)
+        {
+            AB1 *row = chain.Row(level, slice, y);
+            for (AU1 x = regions[r][0]; x < regions[r][2]; x++)
+                fn(row, x);
+        }
+}
+
+// Scales the alpha of the regions {x0, y0, x1, y1} of a level with one scale, so that about covered / texels of them pass
+// the cutoff. 8-bit alpha is counted per level. The threshold level is the one that lets the number of texels closest to
+// the target pass, the scale stores it as the first level at or above the cutoff and the level below it under the cutoff,
+// same as SPD_ALPHA_COVERAGE_UNORM8 in the shader. Texels stored with the same level pass or fail together, so levels
+// whose averages fall into a few 8-bit levels (the last levels of large noisy images) only get close to the target.
+// Float alpha uses a 256 bin histogram like the shader, the bin the threshold falls into is split again twice, averages
+// of large tiles are too close to each other otherwise.
+A_STATIC void SpdCpuScaleAlphaCoverage(SpdMipChain &chain, AU1 level, AU1 slice, const AU1 (*regions)[4],
+    AU1 regionCount, AF1 cutoff, AL1 covered, AL1 texels)
+{
+    SpdCpuFormat format = chain.Layout().format;
+    AL1 regionTexels = 0;
+    AU1 regionCovered = 0;
+    for (AU1 r = 0; r < regionCount; r++)
+        if (regions[r][0] < regions[r][2] && regions[r][1] < regions[r][3])
+        {
+            regionTexels += AL1(regions[r][2] - regions[r][0]) * (regions[r][3] - regions[r][1]);
+            regionCovered += SpdCpuCountAlphaCoverage(chain, level, slice, regions[r][0], regions[r][1], regions[r][2],
+                regions[r][3], cutoff);
+        }
+    if (texels == 0 || regionTexels == 0)
+        return;
+    AU1 target = AU1((covered * regionTexels + texels / 2) / texels);
+    if (regionCovered == target)
+        return;
+
+    AF1 scale = cutoff;
+    if (SpdCpuFormatTexelSize(format) != 16)
+    {
+        // first level at or above the cutoff
+        AU1 cutoffLevel = AU1(ceilf(ASatF1(cutoff) * 255.0f));
+        if (cutoffLevel > 1 && SpdCpuUnpackUnorm8(AB1(cutoffLevel - 1)) >= cutoff)
+            cutoffLevel--;
+        cutoffLevel = AMaxU1(cutoffLevel, 1);
+
+        AU1 histogram[256] = {};
+        SpdCpuForEachRegionTexel(chain, level, slice, regions, regionCount,
+            [&histogram](const AB1 *row, AU1 x) { histogram[row[x * 4 + 3]]++; });
+        // lowest level with at least target texels at or above it, or the next one if its count is closer to target
+        AU1 threshold = 256;
+        AU1 above = 0;
+        while (threshold > 0 && above < target)
+            above += histogram[--threshold];
+        if (threshold < 256 && above - target > target - (above - histogram[threshold]))
+            threshold++;
+        // threshold * scale lands half a scale step above the rounding edge of cutoffLevel, the level below half a step
+        // under it
+        scale = (AF1(cutoffLevel) - 0.5f) / (AF1(AMaxU1(threshold, 1)) - 0.5f);
+    }
+    else if (target > 0)
+    {
+        // threshold: lowest alpha of the target texels with the highest alpha, within [low, low + width)
+        AF1 low = 0.0f;
+        AF1 width = 1.0f;
+        AU1 above = 0;
+        for (AU1 pass = 0; pass < 3; pass++)
+        {
+            AU1 histogram[256] = {};
+            SpdCpuForEachRegionTexel(chain, level, slice, regions, regionCount,
+                [&histogram, format, low, width, pass](const AB1 *row, AU1 x)
+                {
+                    AF1 bin = (ASatF1(SpdCpuLoadAlpha(format, row, x)) - low) * (256.0f / width);
+                    if (bin >= 0.0f && (bin < 256.0f || pass == 0))
+                        histogram[AMinU1(AU1(bin), 255)]++;
+                });
+            AU1 bin = 256;
+            while (bin > 0 && above + histogram[bin - 1] < target)
+                above += histogram[--bin];
+            if (bin == 0)
+                break;
+            width *= 1.0f / 256.0f;
+            low += AF1(bin - 1) * width;
+        }
+        scale = cutoff / AMaxF1(low, 1.0f / 256.0f);
+    }
+
+    SpdCpuForEachRegionTexel(chain, level, slice, regions, regionCount,
+        [format, scale](AB1 *row, AU1 x) { SpdCpuStoreAlpha(format, row, x, SpdCpuLoadAlpha(format, row, x) * scale); });
+}
+
+A_STATIC void SpdCpuScaleAlphaCoverage(SpdMipChain &chain, AU1 level, AU1 slice, AU1 x0, AU1 y0, AU1 x1, AU1 y1,
+    AF1 cutoff, AL1 covered, AL1 texels)
+{
+    const AU1 region[1][4] = { { x0, y0, x1, y1 } };
+    SpdCpuScaleAlphaCoverage(chain, level, slice, region, 1, cutoff, covered, texels);
+}
+
+//==============================================================================================================================
+//                                                     TILE HASH
+//==============================================================================================================================
+// Same idea as SPD_TILE_HASH in ffx_spd.h: SpdDownsampleCpuTileHash() hashes every source tile before it is reduced and
+// skips the tiles whose hash didn't change since the last call, their levels still hold the texels computed back then.
+// The remaining levels are always recomputed from the tiles. The bytes of each tile row are hashed as 32 bit words, word
+// i of a row goes to lane i % 16, each lane is h = rotl((h ^ word) * 0x9e3779b1, 13), so SSE4.1, AVX2 and AVX-512 update
+// 4, 8 or 16 lanes per instruction and all ISAs give the same hash. The lanes are folded into 64 bits at the end.
+typedef void (*SpdCpuHashRowFn)(AU1 *lanes, const AB1 *row, AU1 bytes);
+
+#define SPD_CPU_HASH_LANES 16
+
+A_STATIC AU1 SpdCpuHashStep(AU1 h, AU1 word)
+{
+    h = (h ^ word) * 0x9e3779b1u;
+    return (h << 13) | (h >> 19);
+}
+
+// Hashes bytes bytes of a row into the lanes, the last word is padded with zeros
+A_STATIC void SpdCpuHashRow(AU1 *lanes, const AB1 *row, AU1 bytes)
+{
+    AU1 words = bytes / 4;
+    for (AU1 i = 0; i < words; i++)
+    {
+        AU1 word;
+        memcpy(&word, row + i * 4, 4);
+        lanes[i % SPD_CPU_HASH_LANES] = SpdCpuHashStep(lanes[i % SPD_CPU_HASH_LANES], word);
+    }
+    if (bytes % 4)
+    {
+        AU1 word = 0;
+        memcpy(&word, row + words * 4, bytes % 4);
+        lanes[words % SPD_CPU_HASH_LANES] = SpdCpuHashStep(lanes[words % SPD_CPU_HASH_LANES], word);
+    }
+}
+
+#ifdef SPD_CPU_SIMD
+SPD_CPU_TARGET("sse4.1")
+A_STATIC __m128i SpdCpuHashStep_SSE41(__m128i h, __m128i word)
+{
+    h = _mm_mullo_epi32(_mm_xor_si128(h, word), _mm_set1_epi32(int(0x9e3779b1u)));
+    return _mm_or_si128(_mm_slli_epi32(h, 13), _mm_srli_epi32(h, 19));
+}
+
+// 64 bytes per iteration in four independent registers
+SPD_CPU_TARGET("sse4.1")
+A_STATIC void SpdCpuHashRow_SSE41(AU1 *lanes, const AB1 *row, AU1 bytes)
+{
+    __m128i h[4];
+    for (AU1 k = 0; k < 4; k++)
+        h[k] = _mm_loadu_si128((const __m128i*)(lanes + k * 4));
+    AU1 i = 0;
+    for (; i + 64 <= bytes; i += 64)
+        for (AU1 k = 0; k < 4; k++)
+            h[k] = SpdCpuHashStep_SSE41(h[k], _mm_loadu_si128((const __m128i*)(row + i + k * 16)));
+    for (AU1 k = 0; k < 4; k++)
+        _mm_storeu_si128((__m128i*)(lanes + k * 4), h[k]);
+    if (i < bytes)
+        SpdCpuHashRow(lanes, row + i, bytes - i);
+}
+
+SPD_CPU_TARGET("avx2")
+A_STATIC __m256i SpdCpuHashStep_AVX2(__m256i h, __m256i word)
+{
+    h = _mm256_mullo_epi32(_mm256_xor_si256(h, word), _mm256_set1_epi32(int(0x9e3779b1u)));
+    return _mm256_or_si256(_mm256_slli_epi32(h, 13), _mm256_srli_epi32(h, 19));
+}
+
+// 64 bytes per iteration in two independent registers
+SPD_CPU_TARGET("avx2")
+A_STATIC void SpdCpuHashRow_AVX2(AU1 *lanes, const AB1 *row, AU1 bytes)
+{
+    __m256i h0 = _mm256_loadu_si256((const __m256i*)lanes);
+    __m256i h1 = _mm256_loadu_si256((const __m256i*)(lanes + 8));
+    AU1 i = 0;
+    for (; i + 64 <= bytes; i += 64)
+    {
+        h0 = SpdCpuHashStep_AVX2(h0, _mm256_loadu_si256((const __m256i*)(row + i)));
+        h1 = SpdCpuHashStep_AVX2(h1, _mm256_loadu_si256((const __m256i*)(row + i + 32)));
+    }
+    _mm256_storeu_si256((__m256i*)lanes, h0);
+    _mm256_storeu_si256((__m256i*)(lanes + 8), h1);
+    if (i < bytes)
+        SpdCpuHashRow(lanes, row + i, bytes - i);
+}
+
+// all 16 lanes in one register
+SPD_CPU_TARGET("avx512f")
+A_STATIC void SpdCpuHashRow_AVX512(AU1 *lanes, const AB1 *row, AU1 bytes)
+{
+    const __m512i factor = _mm512_set1_epi32(int(0x9e3779b1u));
+    __m512i h = _mm512_loadu_si512(lanes);
+    AU1 i = 0;
+    for (; i + 64 <= bytes; i += 64)
+        h = _mm512_rol_epi32(_mm512_mullo_epi32(_mm512_xor_si512(h, _mm512_loadu_si512(row + i)), factor), 13);
+    _mm512_storeu_si512(lanes, h);
+    if (i < bytes)
+        SpdCpuHashRow(lanes, row + i, bytes - i);
+}
+#endif // #ifdef SPD_CPU_SIMD
+
+A_STATIC SpdCpuHashRowFn SpdCpuGetHashRow(SpdCpuIsa isa = SpdCpuIsa::Scalar)
+{
+    static const SpdCpuHashRowFn kernels[SPD_CPU_ISA_COUNT] = SPD_CPU_KERNELS(SpdCpuHashRow);
+    return kernels[AU1(SpdCpuIsaSupported(isa) ? isa : SpdCpuIsa::Scalar)];
+}
+
+A_STATIC void SpdCpuHashBegin(AU1 *lanes)
+{
+    for (AU1 i = 0; i < SPD_CPU_HASH_LANES; i++)
+        lanes[i] = 0x811c9dc5u + i * 0x9e3779b9u;
+}
+
+// Folds the lanes into the 64 bit hash, never 0
+A_STATIC AL1 SpdCpuHashEnd(const AU1 *lanes)
+{
+    AL1 hash = 0;
+    for (AU1 i = 0; i < SPD_CPU_HASH_LANES; i++)
+    {
+        hash = (hash ^ lanes[i]) * AL1(0xff51afd7ed558ccdull);
+        hash ^= hash >> 32;
+    }
+    return hash != 0 ? hash : 1;
+}
+
+// Hash of the tileSize x tileSize tile of level 0
+A_STATIC AL1 SpdCpuHashTile(const SpdMipChain &chain, SpdCpuHashRowFn hashRow, AU1 tileSize, AU1 tileX, AU1 tileY,
+    AU1 slice)
+{
+    AU1 texelSize = SpdCpuFormatTexelSize(chain.Layout().format);
+    AU1 x0 = tileX * tileSize;
+    AU1 y0 = tileY * tileSize;
+    AU1 x1 = AMinU1(x0 + tileSize, chain.Width(0));
+    AU1 y1 = AMinU1(y0 + tileSize, chain.Height(0));
+    AU1 lanes[SPD_CPU_HASH_LANES];
+    SpdCpuHashBegin(lanes);
+    for (AU1 y = y0; y < y1; y++)
+        hashRow(lanes, chain.Row(0, slice, y) + x0 * texelSize, (x1 - x0) * texelSize);
+    return SpdCpuHashEnd(lanes);
+}
+
+// Hashes of the source tiles of a mip chain, kept from one SpdDownsampleCpuTileHash() call to the next
+class SpdCpuTileHashes
+{
+public:
+    SpdCpuTileHashes() {}
+    ~SpdCpuTileHashes() { delete[] m_pHashes; }
+
+    SpdCpuTileHashes(const SpdCpuTileHashes&) = delete;
+    SpdCpuTileHashes& operator=(const SpdCpuTileHashes&) = delete;
+
+    // One hash per tileSize x tileSize tile of level 0 of every slice, all invalid. Returns false if the allocation failed.
+    bool Init(AU1 width, AU1 height, AU1 slices, AU1 tileSize)
+    {
+        delete[] m_pHashes;
+        m_width = width;
+        m_height = height;
+        m_slices = slices;
+        m_tileSize = AMaxU1(tileSize, 1);
+        m_tilesX = (width + m_tileSize - 1) / m_tileSize;
+        m_tilesY = (height + m_tileSize - 1) / m_tileSize;
+        m_pHashes = new (std::nothrow) AL1[size_t(m_tilesX) * m_tilesY * slices];
+        Invalidate();
+        return m_pHashes != nullptr;
+    }
+
+    // The next call recomputes every tile, needed whenever the levels of the chain were changed by anything else
+    void Invalidate()
+    {
+        if (m_pHashes)
+            memset(m_pHashes, 0, size_t(m_tilesX) * m_tilesY * m_slices * sizeof(AL1));
+    }
+
+    bool Matches(const SpdMipChain &chain, AU1 tileSize) const
+    {
+        return m_pHashes != nullptr && chain.Width(0) == m_width && chain.Height(0) == m_height &&
+            chain.SliceCount() == m_slices && tileSize == m_tileSize;
+    }
+
+    AL1 &Hash(AU1 slice, AU1 tileX, AU1 tileY)
+    {
+        return m_pHashes[(size_t(slice) * m_tilesY + tileY) * m_tilesX + tileX];
+    }
+
+    AU1 TilesX() const { return m_tilesX; }
+    AU1 TilesY() const { return m_tilesY; }
+
+private:
+    AL1 *m_pHashes = nullptr; // 0 is invalid
+    AU1 m_width = 0;
+    AU1 m_height = 0;
+    AU1 m_slices = 0;
+    AU1 m_tileSize = 0;
+    AU1 m_tilesX = 0;
+    AU1 m_tilesY = 0;
+};
+
+//==============================================================================================================================
+//                                                     DOWNSAMPLER
+//==============================================================================================================================
+// Computes the region [x0, x1) x [y0, y1) of a level from the previous level
+A_STATIC void SpdCpuDownsampleRegion(SpdMipChain &chain, SpdCpuReduceRowFn reduceRow, AU1 level, AU1 slice,
+    AU1 x0, AU1 y0, AU1 x1, AU1 y1)
+{
+    const SpdMipLevelLayout &in = chain.Layout().levels[level - 1];
+    for (AU1 y = y0; y < y1; y++)
+    {
+        const AB1 *row0 = chain.Row(level - 1, slice, AMinU1(y * 2 + 0, in.height - 1));
+        const AB1 *row1 = chain.Row(level - 1, slice, AMinU1(y * 2 + 1, in.height - 1));
+        reduceRow(chain.Row(level, slice, y), row0, row1, x0, x1 - x0, in.width);
+    }
+}
+
+// Conservative borders of SPD_MAX_HEIGHT: where a level has an odd size the next level drops its last column or row.
+// From the first level that does, the last column (row) of every following level is recomputed in order, from everything
+// of the level above up to its edge. The other texels never see those texels, so only the borders have to wait until the
+// whole slice is done.
+A_STATIC void SpdCpuFoldMaxHeightBorders(SpdMipChain &chain, AU1 slice, AU1 mips)
+{
+    bool foldX = false;
+    bool foldY = false;
+    for (AU1 level = 1; level <= mips; level++)
+    {
+        const SpdMipLevelLayout &in = chain.Layout().levels[level - 1];
+        const SpdMipLevelLayout &out = chain.Layout().levels[level];
+        foldX = foldX || in.width > out.width * 2;
+        foldY = foldY || in.height > out.height * 2;
+        if (!foldX && !foldY)
+            continue;
+        // the last column if it folds, then the rest of the last row if that folds
+        AU1 columnTexels = foldX ? out.height : 0;
+        AU1 rowTexels = foldY ? out.width - (foldX ? 1 : 0) : 0;
+        for (AU1 i = 0; i < columnTexels + rowTexels; i++)
+        {
+            AU1 x = i < columnTexels ? out.width - 1 : i - columnTexels;
+            AU1 y = i < columnTexels ? i : out.height - 1;
+            AU1 x1 = x == out.width - 1 ? in.width : AMinU1(x * 2 + 2, in.width);
+            AU1 y1 = y == out.height - 1 ? in.height : AMinU1(y * 2 + 2, in.height);
+            AU1 v = 0;
+            for (AU1 sy = AMinU1(y * 2, in.height - 1); sy < y1; sy++)
+            {
+                const AW1 *row = (const AW1*)chain.Row(level - 1, slice, sy);
+                for (AU1 sx = AMinU1(x * 2, in.width - 1); sx < x1; sx++)
+                    v = AMaxU1(v, row[sx]);
+            }
+            ((AW1*)chain.Row(level, slice, y))[x] = AW1(v);
+        }
+    }
+}
+
+// Number of levels a tile is reduced by until it is a single texel, e.g. 6 for 64x64 tiles (mips 0-5)
+A_STATIC constexpr AU1 SpdCpuTileLevels(AU1 tileSize)
+{
+    return tileSize > 1 ? 1 + SpdCpuTileLevels(tileSize >> 1) : 0;
+}
+
+// Computes levels 1 to log2(tileSize) of one tileSize x tileSize source tile
+// reduceSourceRow computes level 1 from the source, reduceRow the other levels
+A_STATIC void SpdCpuDownsampleTile(SpdMipChain &chain, SpdCpuReduceRowFn reduceSourceRow, SpdCpuReduceRowFn reduceRow,
+    AU1 tileSize, AU1 tileX, AU1 tileY, AU1 mips, AU1 slice)
+{
+    AU1 tileLevels = AMinU1(mips, SpdCpuTileLevels(tileSize));
+    for (AU1 level = 1; level <= tileLevels; level++)
+    {
+        AU1 size = tileSize >> level;
+        AU1 x0 = tileX * size;
+        AU1 y0 = tileY * size;
+        AU1 x1 = AMinU1(x0 + size, chain.Width(level));
+        AU1 y1 = AMinU1(y0 + size, chain.Height(level));
+        if (x0 >= x1 || y0 >= y1)
+            break;
+        SpdCpuDownsampleRegion(chain, level == 1 ? reduceSourceRow : reduceRow, level, slice, x0, y0, x1, y1);
+    }
+}
+
+// SpdCpuDownsampleTile, then scales the alpha of the tile levels with at least SPD_CPU_COVERAGE_MIN_TILE_SIDE texels per
+// side to the coverage of the source tile.
+// Adds the covered and total source texels of the tile to covered and texels.
+A_STATIC void SpdCpuDownsampleTileAlphaCoverage(SpdMipChain &chain, SpdCpuReduceRowFn reduceSourceRow,
+    SpdCpuReduceRowFn reduceRow, AU1 tileSize, AU1 tileX, AU1 tileY, AU1 mips, AU1 slice, AF1 cutoff,
+    std::atomic<AL1> &covered, std::atomic<AL1> &texels)
+{
+    AU1 x0 = tileX * tileSize;
+    AU1 y0 = tileY * tileSize;
+    AU1 x1 = AMinU1(x0 + tileSize, chain.Width(0));
+    AU1 y1 = AMinU1(y0 + tileSize, chain.Height(0));
+    if (x0 >= x1 || y0 >= y1)
+        return;
+    AL1 tileCovered = SpdCpuCountAlphaCoverage(chain, 0, slice, x0, y0, x1, y1, cutoff);
+    AL1 tileTexels = AL1(x1 - x0) * (y1 - y0);
+    covered.fetch_add(tileCovered, std::memory_order_relaxed);
+    texels.fetch_add(tileTexels, std::memory_order_relaxed);
+
+    SpdCpuDownsampleTile(chain, reduceSourceRow, reduceRow, tileSize, tileX, tileY, mips, slice);
+    AU1 tileLevels = AMinU1(mips, SpdCpuCoverageTileLevels(tileSize));
+    for (AU1 level = 1; level <= tileLevels; level++)
+    {
+        AU1 size = tileSize >> level;
+        SpdCpuScaleAlphaCoverage(chain, level, slice, tileX * size, tileY * size,
+            AMinU1((tileX + 1) * size, chain.Width(level)), AMinU1((tileY + 1) * size, chain.Height(level)),
+            cutoff, tileCovered, tileTexels);
+    }
+}
+
+// Source texels sampled per side for one preview texel of SpdDownsampleCpuProgressive, 64:1 for 64x64 tiles
+#define SPD_CPU_PREVIEW_GRID 8
+
+// Preview of the levels of one tile: every texel of level is reduced from a grid of point samples of its source footprint,
+// SPD_CPU_PREVIEW_GRID per side at most and spread evenly, with the same kernels instead of from the full level above.
+A_STATIC void SpdCpuPreviewTile(SpdMipChain &chain, SpdCpuReduceRowFn reduceSourceRow, SpdCpuReduceRowFn reduceRow,
+    AU1 tileSize, AU1 tileX, AU1 tileY, AU1 level, AU1 slice)
+{
+    AU1 size = tileSize >> level;
+    AU1 x0 = tileX * size;
+    AU1 y0 = tileY * size;
+    AU1 x1 = AMinU1(x0 + size, chain.Width(level));
+    AU1 y1 = AMinU1(y0 + size, chain.Height(level));
+    AU1 texelSize = chain.Layout().texelSize;
+    AU1 footprint = 1u << level;
+    AU1 grid = AMinU1(footprint, SPD_CPU_PREVIEW_GRID);
+    AU1 stride = footprint / grid;
+    AB1 samples[2][SPD_CPU_PREVIEW_GRID][SPD_CPU_PREVIEW_GRID * 16];
+    for (AU1 y = y0; y < y1; y++)
+        for (AU1 x = x0; x < x1; x++)
+        {
+            for (AU1 j = 0; j < grid; j++)
+            {
+                const AB1 *row = chain.Row(0, slice, AMinU1(y * footprint + j * stride + stride / 2, chain.Height(0) - 1));
+                for (AU1 i = 0; i < grid; i++)
+                    memcpy(samples[0][j] + i * texelSize,
+                        row + AMinU1(x * footprint + i * stride + stride / 2, chain.Width(0) - 1) * texelSize, texelSize);
+            }
+            AU1 buffer = 0;
+            for (AU1 n = grid; n > 1; n >>= 1, buffer ^= 1)
+                for (AU1 j = 0; j < n / 2; j++)
+                    (n == grid ? reduceSourceRow : reduceRow)(samples[buffer ^ 1][j], samples[buffer][j * 2],
+                        samples[buffer][j * 2 + 1], 0, n / 2, n);
+            memcpy(chain.Row(level, slice, y) + x * texelSize, samples[buffer][0], texelSize);
+        }
+}
+
+A_STATIC AU1 SpdCpuMortonCompact(AU1 v)
+{
+    v &= 0x55555555u;
+    v = (v | (v >> 1)) & 0x33333333u;
+    v = (v | (v >> 2)) & 0x0F0F0F0Fu;
+    v = (v | (v >> 4)) & 0x00FF00FFu;
+    v = (v | (v >> 8)) & 0x0000FFFFu;
+    return v;
+}
+
+// Number of work indices for the tiles of one plan rectangle. Morton covers the enclosing power of two square,
+// indices outside of the rectangle are skipped.
+A_STATIC AU1 SpdCpuTileIndexCount(const SpdPlanDispatch &dispatch, SpdCpuTraversal traversal)
+{
+    AU1 width = dispatch.dispatchThreadGroupCountXY[0];
+    AU1 height = dispatch.dispatchThreadGroupCountXY[1];
+    if (traversal == SpdCpuTraversal::RowMajor)
+        return width * height;
+    AU1 side = 1;
+    while (side < AMaxU1(width, height))
+        side <<= 1;
+    return side * side;
+}
+
+// Most mip chains SpdDownsampleCpuMultiTarget() downsamples in one job
+#define SPD_CPU_MAX_TARGETS 4
+
+// State shared by all workers of one SpdDownsampleCpu call
+struct SpdCpuJob
+{
+    SpdMipChain *chains[SPD_CPU_MAX_TARGETS]; // the single chain calls only use the first
+    SpdCpuReduceRowFn reduceSourceRow[SPD_CPU_MAX_TARGETS];
+    SpdCpuReduceRowFn reduceRow[SPD_CPU_MAX_TARGETS];
+    AU1 targetCount;
+    const SpdPlan *plan;
+    SpdCpuTraversal traversal;
+    AU1 mips;
+    AU1 slices;
+    AU1 tileLevels; // the preview level for progressive jobs
+    AU1 threadCount;
+    AU1 indexCount[SPD_PLAN_MAX_RECTS];
+    AU1 indicesPerSlice;
+    bool preview;
+    bool alphaCoverage;
+    AF1 alphaCutoff;
+    std::atomic<AL1> *coveredTexels; // alpha coverage only, per slice: source texels >= alphaCutoff
+    std::atomic<AL1> *sourceTexels;  // alpha coverage only, per slice: source texels of the processed tiles
+    SpdCpuTileHashes *tileHashes;    // tile hash only
+    SpdCpuHashRowFn hashRow;
+    std::atomic<AU1> skippedTiles;
+    std::atomic<AU1> nextIndex;
+    std::atomic<AU1> finishedIndices;
+    std::atomic<AU1> nextSlice;
+};
+
+// Hashes the source tile, returns true if the hash is the one of the last call, otherwise stores the new one
+A_STATIC bool SpdCpuTileUnchanged(SpdCpuJob &job, AU1 tileX, AU1 tileY, AU1 slice)
+{
+    if (tileX >= job.tileHashes->TilesX() || tileY >= job.tileHashes->TilesY())
+        return false;
+    AL1 hash = SpdCpuHashTile(*job.chains[0], job.hashRow, job.plan->tileSize, tileX, tileY, slice);
+    AL1 &previous = job.tileHashes->Hash(slice, tileX, tileY);
+    if (previous == hash)
+    {
+        job.skippedTiles.fetch_add(1, std::memory_order_relaxed);
+        return true;
+    }
+    previous = hash;
+    return false;
+}
+
+// Downsamples the tile of one work index
+A_STATIC void SpdCpuWorkerTile(SpdCpuJob &job, AU1 index)
+{
+    AU1 slice = index / job.indicesPerSlice;
+    AU1 local = index % job.indicesPerSlice;
+    AU1 rect = 0;
+    while (local >= job.indexCount[rect])
+        local -= job.indexCount[rect++];
+
+    const SpdPlanDispatch &dispatch = job.plan->dispatches[rect];
+    AU1 tileX = local % dispatch.dispatchThreadGroupCountXY[0];
+    AU1 tileY = local / dispatch.dispatchThreadGroupCountXY[0];
+    if (job.traversal == SpdCpuTraversal::Morton)
+    {
+        tileX = SpdCpuMortonCompact(local);
+        tileY = SpdCpuMortonCompact(local >> 1);
+        if (tileX >= dispatch.dispatchThreadGroupCountXY[0] || tileY >= dispatch.dispatchThreadGroupCountXY[1])
+            return;
+    }
+    tileX += dispatch.workGroupOffset[0];
+    tileY += dispatch.workGroupOffset[1];
+    if (job.tileHashes && SpdCpuTileUnchanged(job, tileX, tileY, slice))
+        return;
+    if (job.preview)
+        SpdCpuPreviewTile(*job.chains[0], job.reduceSourceRow[0], job.reduceRow[0], job.plan->tileSize, tileX, tileY,
+            job.tileLevels, slice);
+    else if (job.alphaCoverage)
+        SpdCpuDownsampleTileAlphaCoverage(*job.chains[0], job.reduceSourceRow[0], job.reduceRow[0],
+            job.plan->tileSize, tileX, tileY, job.mips, slice, job.alphaCutoff, job.coveredTexels[slice],
+            job.sourceTexels[slice]);
+    else
+        for (AU1 t = 0; t < job.targetCount; t++)
+            SpdCpuDownsampleTile(*job.chains[t], job.reduceSourceRow[t], job.reduceRow[t], job.plan->tileSize,
+                tileX, tileY, job.mips, slice);
+}
+
+A_STATIC void SpdCpuWorker(SpdCpuJob &job)
+{
+    const AU1 indexCount = job.indicesPerSlice * job.slices;
+    for (;;)
+    {
+        AU1 index = job.nextIndex.fetch_add(1, std::memory_order_relaxed);
+        if (index >= indexCount)
+            break;
+        SpdCpuWorkerTile(job, index);
+        job.finishedIndices.fetch_add(1, std::memory_order_acq_rel);
+    }
+
+    // All tiles have to be done before the remaining levels, same as SpdExitWorkgroup on the GPU. The finished indices are
+    // counted rather than the workers, so it doesn't matter how many workers run.
+    while (job.finishedIndices.load(std::memory_order_acquire) < indexCount)
+        std::this_thread::yield();
+
+    // Once a tile is a single texel one worker per slice downsamples the remaining levels
+    for (;;)
+    {
+        AU1 slice = job.nextSlice.fetch_add(1, std::memory_order_relaxed);
+        if (slice >= job.slices)
+            break;
+        for (AU1 t = 0; t < job.targetCount; t++)
+        {
+            SpdMipChain &chain = *job.chains[t];
+            for (AU1 level = job.tileLevels + 1; level <= job.mips; level++)
+                SpdCpuDownsampleRegion(chain, job.reduceRow[t], level, slice, 0, 0, chain.Width(level), chain.Height(level));
+            if (chain.Layout().format == SpdCpuFormat::R16UnormMaxHeight && !job.preview)
+                SpdCpuFoldMaxHeightBorders(chain, slice, job.mips);
+        }
+        if (!job.alphaCoverage)
+            continue;
+        SpdMipChain &chain = *job.chains[0];
+        AL1 covered = job.coveredTexels[slice].load(std::memory_order_relaxed);
+        AL1 texels = job.sourceTexels[slice].load(std::memory_order_relaxed);
+        // the small tile levels of the tiles in the plan rectangles, after the remaining levels were computed from them
+        AU1 lastTileLevel = AMinU1(job.tileLevels, job.mips);
+        for (AU1 level = SpdCpuCoverageTileLevels(job.plan->tileSize) + 1; level <= lastTileLevel; level++)
+        {
+            AU1 size = job.plan->tileSize >> level;
+            AU1 regions[SPD_PLAN_MAX_RECTS][4];
+            for (AU1 i = 0; i < job.plan->rectCount; i++)
+            {
+                const SpdPlanDispatch &dispatch = job.plan->dispatches[i];
+                regions[i][0] = dispatch.workGroupOffset[0] * size;
+                regions[i][1] = dispatch.workGroupOffset[1] * size;
+                regions[i][2] = AMinU1((dispatch.workGroupOffset[0] + dispatch.dispatchThreadGroupCountXY[0]) * size,
+                    chain.Width(level));
+                regions[i][3] = AMinU1((dispatch.workGroupOffset[1] + dispatch.dispatchThreadGroupCountXY[1]) * size,
+                    chain.Height(level));
+            }
+            SpdCpuScaleAlphaCoverage(chain, level, slice, regions, job.plan->rectCount, job.alphaCutoff, covered, texels);
+        }
+        for (AU1 level = job.tileLevels + 1; level <= job.mips; level++)
+            SpdCpuScaleAlphaCoverage(chain, level, slice, 0, 0, chain.Width(level), chain.Height(level),
+                job.alphaCutoff, covered, texels);
+    }
+}
+
+// Sets up the job of a SpdDownsampleCpu call, returns false if there is nothing to compute
+A_STATIC bool SpdCpuInitJob(SpdCpuJob &job, SpdMipChain &chain, const SpdPlan &plan, const SpdCpuConfig &config)
+{
+    AU1 mips = AMinU1(plan.mips, chain.LevelCount() - 1);
+    AU1 slices = AMinU1(plan.slices, chain.SliceCount());
+    if (mips == 0)
+        return false;
+
+    job.chains[0] = &chain;
+    job.reduceSourceRow[0] = SpdCpuGetReduceSourceRow(chain.Layout().format, config.isa);
+    job.reduceRow[0] = SpdCpuGetReduceRow(chain.Layout().format, config.isa);
+    job.targetCount = 1;
+    job.plan = &plan;
+    job.traversal = config.traversal;
+    job.mips = mips;
+    job.slices = slices;
+    job.tileLevels = SpdCpuTileLevels(plan.tileSize);
+    job.threadCount = AMinU1(AMaxU1(config.threadCount, 1), SPD_CPU_MAX_THREADS);
+    job.indicesPerSlice = 0;
+    for (AU1 i = 0; i < plan.rectCount; i++)
+    {
+        job.indexCount[i] = SpdCpuTileIndexCount(plan.dispatches[i], config.traversal);
+        job.indicesPerSlice += job.indexCount[i];
+    }
+    job.preview = false;
+    job.alphaCoverage = false;
+    job.alphaCutoff = 0.0f;
+    job.coveredTexels = nullptr;
+    job.sourceTexels = nullptr;
+    job.tileHashes = nullptr;
+    job.hashRow = nullptr;
+    job.skippedTiles.store(0, std::memory_order_relaxed);
+    job.nextIndex.store(0, std::memory_order_relaxed);
+    job.finishedIndices.store(0, std::memory_order_relaxed);
+    job.nextSlice.store(0, std::memory_order_relaxed);
+    return true;
+}
+
+// Runs the job on the calling thread and job.threadCount - 1 started ones
+A_STATIC void SpdCpuRunJob(SpdCpuJob &job)
+{
+    SpdCpuRunWorkers([&job](AU1) { SpdCpuWorker(job); }, job.threadCount);
+}
+
+// Computes the mips described by the plan, reading level 0 of the chain. Only the tiles covered by the plan rectangles are
+// processed, the remaining mips (6+ for 64x64 tiles) are always recomputed for the whole slice, same as the GPU version.
+// The plan mips and slices are clamped to what the chain holds. plan.tileSize must be a power of two.
+// config.threadCount - 1 threads are started per call, the calling thread works as well.
+A_STATIC void SpdDownsampleCpu(SpdMipChain &chain, const SpdPlan &plan, const SpdCpuConfig &config)
+{
+    SpdCpuJob job;
+    if (SpdCpuInitJob(job, chain, plan, config))
+        SpdCpuRunJob(job);
+}
+
+A_STATIC void SpdDownsampleCpu(SpdMipChain &chain, const SpdPlan &plan)
+{
+    SpdDownsampleCpu(chain, plan, SpdCpuDefaultConfig());
+}
+
+// Computes mips [0, mips) of every slice for the whole image
+A_STATIC void SpdDownsampleCpu(SpdMipChain &chain, AU1 mips, AU1 tileSize = SPD_TILE_SIZE)
+{
+    SpdDownsampleCpu(chain, SpdCreatePlan(chain.Width(0), chain.Height(0), chain.SliceCount(), ASU1(mips),
+        AU1(chain.Layout().format), tileSize));
+}
+
+// SpdDownsampleCpu that keeps the alpha test coverage of every mip at the coverage of the source: the fraction of texels
+// with alpha >= alphaCutoff, see ALPHA COVERAGE. Tile levels with at least 8x8 texels per tile are matched to the tile, the
+// smaller tile levels and the remaining mips to all tiles of the plan in the slice. Allocates two counters per slice,
+// returns false if that fails or if the format has no alpha.
+A_STATIC bool SpdDownsampleCpuAlphaCoverage(SpdMipChain &chain, const SpdPlan &plan, const SpdCpuConfig &config,
+    AF1 alphaCutoff)
+{
+    if (SpdCpuFormatChannels(chain.Layout().format) != 4)
+        return false;
+    SpdCpuJob job;
+    if (!SpdCpuInitJob(job, chain, plan, config))
+        return true;
+    std::atomic<AL1> *counters = new (std::nothrow) std::atomic<AL1>[job.slices * 2];
+    if (!counters)
+        return false;
+    for (AU1 i = 0; i < job.slices * 2; i++)
+        counters[i].store(0, std::memory_order_relaxed);
+    job.alphaCoverage = true;
+    job.alphaCutoff = alphaCutoff;
+    job.coveredTexels = counters;
+    job.sourceTexels = counters + job.slices;
+    SpdCpuRunJob(job);
+    delete[] counters;
+    return true;
+}
+
+A_STATIC bool SpdDownsampleCpuAlphaCoverage(SpdMipChain &chain, AU1 mips, AF1 alphaCutoff, AU1 tileSize = SPD_TILE_SIZE)
+{
+    return SpdDownsampleCpuAlphaCoverage(chain, SpdCreatePlan(chain.Width(0), chain.Height(0), chain.SliceCount(),
+        ASU1(mips), AU1(chain.Layout().format), tileSize), SpdCpuDefaultConfig(), alphaCutoff);
+}
+
+// Writes the fraction of texels with alpha >= alphaCutoff of every level of a slice to coverage[0, chain.LevelCount()),
+// to check the result of SpdDownsampleCpuAlphaCoverage() against the source in coverage[0]
+A_STATIC void SpdCpuAlphaCoveragePerLevel(const SpdMipChain &chain, AU1 slice, AF1 alphaCutoff, AF1 *coverage)
+{
+    for (AU1 level = 0; level < chain.LevelCount(); level++)
+        coverage[level] = AF1(SpdCpuCountAlphaCoverage(chain, level, slice, 0, 0, chain.Width(level), chain.Height(level),
+            alphaCutoff)) / (AF1(chain.Width(level)) * AF1(chain.Height(level)));
+}
+
+// SpdDownsampleCpu for up to SPD_CPU_MAX_TARGETS chains of the same size at once, see MULTI TARGET: e.g. RGBA32F color,
+// RG32FMinMax depth and RG32FMaxLength motion vectors of a frame. Each chain is reduced with the kernel of its format, the
+// tiles are scheduled once and each worker computes a tile of every chain before it takes the next one.
+// Mips and slices are clamped to what all chains hold. Returns false if the chains don't match.
+A_STATIC bool SpdDownsampleCpuMultiTarget(SpdMipChain *const *chains, AU1 count, const SpdPlan &plan,
+    const SpdCpuConfig &config)
+{
+    if (count == 0 || count > SPD_CPU_MAX_TARGETS)
+        return false;
+    for (AU1 t = 1; t < count; t++)
+        if (chains[t]->Width(0) != chains[0]->Width(0) || chains[t]->Height(0) != chains[0]->Height(0))
+            return false;
+    SpdCpuJob job;
+    if (!SpdCpuInitJob(job, *chains[0], plan, config))
+        return true;
+    for (AU1 t = 1; t < count; t++)
+    {
+        SpdMipChain &chain = *chains[t];
+        job.chains[t] = &chain;
+        job.reduceSourceRow[t] = SpdCpuGetReduceSourceRow(chain.Layout().format, config.isa);
+        job.reduceRow[t] = SpdCpuGetReduceRow(chain.Layout().format, config.isa);
+        job.mips = AMinU1(job.mips, chain.LevelCount() - 1);
+        job.slices = AMinU1(job.slices, chain.SliceCount());
+    }
+    job.targetCount = count;
+    if (job.mips > 0)
+        SpdCpuRunJob(job);
+    return true;
+}
+
+A_STATIC bool SpdDownsampleCpuMultiTarget(SpdMipChain *const *chains, AU1 count, AU1 mips,
+    AU1 tileSize = SPD_TILE_SIZE)
+{
+    if (count == 0)
+        return false;
+    return SpdDownsampleCpuMultiTarget(chains, count, SpdCreatePlan(chains[0]->Width(0), chains[0]->Height(0),
+        chains[0]->SliceCount(), ASU1(mips), AU1(chains[0]->Layout().format), tileSize), SpdCpuDefaultConfig());
+}
+
+// SpdDownsampleCpu for mostly static sources, see TILE HASH: tiles whose hash is the one stored in hashes by the last call
+// keep their levels, so the chain must not be changed by anything else in between, call hashes.Invalidate() if it was.
+// hashes must be set up for the chain and plan.tileSize, the plan mips should stay the same from call to call.
+// skippedTiles receives the number of unchanged tiles. Returns false if hashes don't match.
+A_STATIC bool SpdDownsampleCpuTileHash(SpdMipChain &chain, SpdCpuTileHashes &hashes, const SpdPlan &plan,
+    const SpdCpuConfig &config, AU1 *skippedTiles = nullptr)
+{
+    if (!hashes.Matches(chain, plan.tileSize))
+        return false;
+    if (skippedTiles)
+        *skippedTiles = 0;
+    SpdCpuJob job;
+    if (!SpdCpuInitJob(job, chain, plan, config))
+        return true;
+    job.tileHashes = &hashes;
+    job.hashRow = SpdCpuGetHashRow(config.isa);
+    SpdCpuRunJob(job);
+    if (skippedTiles)
+        *skippedTiles = job.skippedTiles.load(std::memory_order_relaxed);
+    return true;
+}
+
+// Called by SpdDownsampleCpuProgressive once the preview is done: levels previewLevel to mips of every slice hold the
+// preview, the finer levels are not computed yet. The chain may be read until the call returns.
+typedef void (*SpdCpuPreviewFn)(void *user, const SpdMipChain &chain, AU1 previewLevel);
+
+struct SpdCpuProgressiveTimes
+{
+    double previewMilliseconds; // from the call until the preview is done
+    double totalMilliseconds;   // from the call until all mips are done, including the preview callback
+    AU1 previewLevel;           // mip 5 (level 6) for 64x64 tiles, lower if the plan has fewer mips
+};
+
+// SpdDownsampleCpu for low latency previews, e.g. of a remote texture viewer. First every tile of the plan is reduced straight
+// to its texel of the last tile level from a strided SPD_CPU_PREVIEW_GRID^2 sample (64:1 for 64x64 tiles) and the remaining
+// mips are computed from those, so a blurry preview of the whole image is done after one touch of every source tile.
+// preview is called, then all mips are computed again as SpdDownsampleCpu does, the result is the same.
+A_STATIC void SpdDownsampleCpuProgressive(SpdMipChain &chain, const SpdPlan &plan, const SpdCpuConfig &config,
+    SpdCpuPreviewFn preview = nullptr, void *user = nullptr, SpdCpuProgressiveTimes *times = nullptr)
+{
+    auto start = std::chrono::high_resolution_clock::now();
+    SpdCpuJob job;
+    if (!SpdCpuInitJob(job, chain, plan, config))
+    {
+        if (times)
+            *times = SpdCpuProgressiveTimes{ 0.0, 0.0, 0 };
+        return;
+    }
+    job.preview = true;
+    job.tileLevels = AMinU1(job.tileLevels, job.mips);
+    SpdCpuRunJob(job);
+    auto previewEnd = std::chrono::high_resolution_clock::now();
+    if (preview)
+        preview(user, chain, job.tileLevels);
+
+    SpdCpuJob fullJob;
+    SpdCpuInitJob(fullJob, chain, plan, config);
+    SpdCpuRunJob(fullJob);
+    auto end = std::chrono::high_resolution_clock::now();
+    if (times)
+        *times = SpdCpuProgressiveTimes{ std::chrono::duration<double, std::milli>(previewEnd - start).count(),
+            std::chrono::duration<double, std::milli>(end - start).count(), job.tileLevels };
+}
+
+//==============================================================================================================================
+//                                                     LAZY MIP CHAIN
+//==============================================================================================================================
+// Levels on demand, e.g. a thumbnail or LOD preview of a huge texture: SpdLazyMipChain computes nothing up front. Every
+// level is split into blocks of SPD_CPU_LAZY_BLOCK_SIZE^2 texels with one valid bit each. Request() computes the blocks of
+// a region that are not valid yet with the row kernels, after making sure the four blocks below each of them are valid,
+// down to the nearest level that already holds them or the source. So only the source texels under the region are read,
+// and levels that are never requested are never computed. A block of level l covers 2^l blocks of the source per side.
+// Not thread safe. R16UnormMaxHeight is not supported, its borders need whole levels.
+#define SPD_CPU_LAZY_BLOCK_SIZE 32
+
+class SpdLazyMipChain
+{
+public:
+    SpdLazyMipChain() {}
+    ~SpdLazyMipChain() { delete[] m_pValid; }
+
+    SpdLazyMipChain(const SpdLazyMipChain&) = delete;
+    SpdLazyMipChain& operator=(const SpdLazyMipChain&) = delete;
+
+    // Level 0 of chain holds the source, all other levels are invalid. The chain has to outlive this object.
+    // Returns false if the bit masks can't be allocated or the format is not supported.
+    bool Init(SpdMipChain &chain, SpdCpuIsa isa = SpdCpuBestIsa())
+    {
+        delete[] m_pValid;
+        m_pValid = nullptr;
+        m_pChain = &chain;
+        m_computedTexels = 0;
+        SpdCpuFormat format = chain.Layout().format;
+        if (format == SpdCpuFormat::R16UnormMaxHeight)
+            return false;
+        m_reduceSourceRow = SpdCpuGetReduceSourceRow(format, isa);
+        m_reduceRow = SpdCpuGetReduceRow(format, isa);
+
+        AU1 words = 0;
+        for (AU1 level = 0; level < chain.LevelCount(); level++)
+        {
+            m_blocksX[level] = (chain.Width(level) + SPD_CPU_LAZY_BLOCK_SIZE - 1) / SPD_CPU_LAZY_BLOCK_SIZE;
+            m_blocksY[level] = (chain.Height(level) + SPD_CPU_LAZY_BLOCK_SIZE - 1) / SPD_CPU_LAZY_BLOCK_SIZE;
+            m_offsets[level] = words;
+            words += (m_blocksX[level] * m_blocksY[level] + 31) / 32;
+        }
+        m_wordsPerSlice = words;
+        m_pValid = new (std::nothrow) AU1[size_t(words) * chain.SliceCount()];
+        if (!m_pValid)
+            return false;
+        memset(m_pValid, 0, size_t(words) * chain.SliceCount() * sizeof(AU1));
+        return true;
+    }
+
+    // Makes [x0, x1) x [y0, y1) of level valid, returns false if the region is not inside the level
+    bool Request(AU1 level, AU1 slice, AU1 x0, AU1 y0, AU1 x1, AU1 y1)
+    {
+        if (!m_pValid || level >= m_pChain->LevelCount() || slice >= m_pChain->SliceCount() || x0 >= x1 || y0 >= y1 ||
+            x1 > m_pChain->Width(level) || y1 > m_pChain->Height(level))
+            return false;
+        if (level == 0)
+            return true;
+        for (AU1 by = y0 / SPD_CPU_LAZY_BLOCK_SIZE; by <= (y1 - 1) / SPD_CPU_LAZY_BLOCK_SIZE; by++)
+            for (AU1 bx = x0 / SPD_CPU_LAZY_BLOCK_SIZE; bx <= (x1 - 1) / SPD_CPU_LAZY_BLOCK_SIZE; bx++)
+                MaterializeBlock(level, slice, bx, by);
+        return true;
+    }
+
+    bool Request(AU1 level, AU1 slice)
+    {
+        return level < m_pChain->LevelCount() &&
+            Request(level, slice, 0, 0, m_pChain->Width(level), m_pChain->Height(level));
+    }
+
+    bool IsValid(AU1 level, AU1 slice, AU1 x0, AU1 y0, AU1 x1, AU1 y1) const
+    {
+        if (level == 0)
+            return true;
+        for (AU1 by = y0 / SPD_CPU_LAZY_BLOCK_SIZE; by <= (y1 - 1) / SPD_CPU_LAZY_BLOCK_SIZE; by++)
+            for (AU1 bx = x0 / SPD_CPU_LAZY_BLOCK_SIZE; bx <= (x1 - 1) / SPD_CPU_LAZY_BLOCK_SIZE; bx++)
+                if (!BlockValid(level, slice, bx, by))
+                    return false;
+        return true;
+    }
+
+    // The source region [x0, x1) x [y0, y1) of slice changed, every block computed from it becomes invalid
+    void Invalidate(AU1 slice, AU1 x0, AU1 y0, AU1 x1, AU1 y1)
+    {
+        if (!m_pValid || x0 >= x1 || y0 >= y1)
+            return;
+        for (AU1 level = 1; level < m_pChain->LevelCount(); level++)
+        {
+            AU1 size = SPD_CPU_LAZY_BLOCK_SIZE << level; // source texels per block side
+            AU1 bx1 = AMinU1((x1 - 1) / size + 1, m_blocksX[level]);
+            AU1 by1 = AMinU1((y1 - 1) / size + 1, m_blocksY[level]);
+            for (AU1 by = y0 / size; by < by1; by++)
+                for (AU1 bx = x0 / size; bx < bx1; bx++)
+                {
+                    AU1 bit = by * m_blocksX[level] + bx;
+                    Word(level, slice, bit) &= ~(1u << (bit % 32));
+                }
+        }
+    }
+
+    SpdMipChain &Chain() { return *m_pChain; }
+    AL1 ComputedTexels() const { return m_computedTexels; } // texels computed so far over all levels
+
+private:
+    AU1 &Word(AU1 level, AU1 slice, AU1 bit) const
+    {
+        return m_pValid[size_t(slice) * m_wordsPerSlice + m_offsets[level] + bit / 32];
+    }
+
+    bool BlockValid(AU1 level, AU1 slice, AU1 bx, AU1 by) const
+    {
+        AU1 bit = by * m_blocksX[level] + bx;
+        return level == 0 || (Word(level, slice, bit) & (1u << (bit % 32))) != 0;
+    }
+
+    // The block reads at most blocks 2bx, 2bx + 1 and 2by, 2by + 1 of the level above, the clamped edge stays inside them
+    void MaterializeBlock(AU1 level, AU1 slice, AU1 bx, AU1 by)
+    {
+        if (BlockValid(level, slice, bx, by))
+            return;
+        for (AU1 cy = by * 2; cy < AMinU1(by * 2 + 2, m_blocksY[level - 1]); cy++)
+            for (AU1 cx = bx * 2; cx < AMinU1(bx * 2 + 2, m_blocksX[level - 1]); cx++)
+                MaterializeBlock(level - 1, slice, cx, cy);
+
+        AU1 x0 = bx * SPD_CPU_LAZY_BLOCK_SIZE;
+        AU1 y0 = by * SPD_CPU_LAZY_BLOCK_SIZE;
+        AU1 x1 = AMinU1(x0 + SPD_CPU_LAZY_BLOCK_SIZE, m_pChain->Width(level));
+        AU1 y1 = AMinU1(y0 + SPD_CPU_LAZY_BLOCK_SIZE, m_pChain->Height(level));
+        SpdCpuDownsampleRegion(*m_pChain, level == 1 ? m_reduceSourceRow : m_reduceRow, level, slice, x0, y0, x1, y1);
+        m_computedTexels += AL1(x1 - x0) * (y1 - y0);
+        AU1 bit = by * m_blocksX[level] + bx;
+        Word(level, slice, bit) |= 1u << (bit % 32);
+    }
+
+    SpdMipChain *m_pChain = nullptr;
+    SpdCpuReduceRowFn m_reduceSourceRow = nullptr;
+    SpdCpuReduceRowFn m_reduceRow = nullptr;
+    AU1 *m_pValid = nullptr; // one bit per block, per slice, then level
+    AU1 m_wordsPerSlice = 0;
+    AU1 m_offsets[SPD_CPU_MAX_LEVELS] = {};
+    AU1 m_blocksX[SPD_CPU_MAX_LEVELS] = {};
+    AU1 m_blocksY[SPD_CPU_MAX_LEVELS] = {};
+    AL1 m_computedTexels = 0;
+};
+
+//==============================================================================================================================
+//                                                     BLOOM
+//==============================================================================================================================
+// 13-tap bloom downsample chain, same filter and tile scheme as SPD_BLOOM in ffx_spd.h: a tile level is computed by the worker
+// that finishes the last of the 9 tiles around it on the level before, so there is no barrier between the levels.
+// Results are identical to SpdDownsampleCpuBloomReference(), which computes one level after the other.
+// RGBA32F only.
+
+// box of the 2x2 texels at (x, y) of the 6x6 footprint
+A_STATIC void SpdCpuBloomBox(outAF4 d, const AF1 *const *rows, const AU1 *columns, AU1 x, AU1 y)
+{
+    for (AU1 c = 0; c < 4; c++)
+        d[c] = (rows[y][columns[x] + c] + rows[y][columns[x + 1] + c] +
+            rows[y + 1][columns[x] + c] + rows[y + 1][columns[x + 1] + c]) * 0.25f;
+}
+
+// Computes the region [x0, x1) x [y0, y1) of a level from the previous level with the 13-tap filter.
+// karis weights the five boxes by 1/(1+luma) like SPD_KARIS_AVERAGE, the shader version does that for level 1 only.
+A_STATIC void SpdCpuBloomRegion(SpdMipChain &chain, AU1 level, AU1 slice, AU1 x0, AU1 y0, AU1 x1, AU1 y1, bool karis)
+{
+    // the 13 taps as 2x2 boxes of the footprint, and the four taps of each of the five boxes
+    static const AU1 taps[13][2] = { {0, 0}, {2, 0}, {4, 0}, {1, 1}, {3, 1}, {0, 2}, {2, 2}, {4, 2}, {1, 3}, {3, 3},
+        {0, 4}, {2, 4}, {4, 4} };
+    static const AU1 boxes[5][4] = { {3, 4, 8, 9}, {0, 1, 5, 6}, {1, 2, 6, 7}, {5, 6, 10, 11}, {6, 7, 11, 12} };
+
+    AU1 inWidth = chain.Width(level - 1);
+    AU1 inHeight = chain.Height(level - 1);
+    for (AU1 y = y0; y < y1; y++)
+    {
+        const AF1 *rows[6];
+        for (AU1 i = 0; i < 6; i++)
+            rows[i] = (const AF1*)chain.Row(level - 1, slice, AMinU1(AMaxU1(y * 2 + i, 2) - 2, inHeight - 1));
+        AF1 *dst = (AF1*)chain.Row(level, slice, y);
+        for (AU1 x = x0; x < x1; x++)
+        {
+            AU1 columns[6];
+            for (AU1 i = 0; i < 6; i++)
+                columns[i] = AMinU1(AMaxU1(x * 2 + i, 2) - 2, inWidth - 1) * 4;
+            AF1 tap[13][4];
+            for (AU1 i = 0; i < 13; i++)
+                SpdCpuBloomBox(tap[i], rows, columns, taps[i][0], taps[i][1]);
+            AF1 box[5][4];
+            for (AU1 i = 0; i < 5; i++)
+                for (AU1 c = 0; c < 4; c++)
+                    box[i][c] = (tap[boxes[i][0]][c] + tap[boxes[i][1]][c] + tap[boxes[i][2]][c] + tap[boxes[i][3]][c]) *
+                        0.25f;
+            AF1 *d = dst + x * 4;
+            if (karis)
+            {
+                AF1 w[5];
+                for (AU1 i = 0; i < 5; i++)
+                    w[i] = (i == 0 ? 0.5f : 0.125f) /
+                        (1.0f + AMaxF1(box[i][0] * 0.2126f + box[i][1] * 0.7152f + box[i][2] * 0.0722f, 0.0f));
+                AF1 rcp = 1.0f / (w[0] + w[1] + w[2] + w[3] + w[4]);
+                for (AU1 c = 0; c < 4; c++)
+                    d[c] = (box[0][c] * w[0] + box[1][c] * w[1] + box[2][c] * w[2] + box[3][c] * w[3] + box[4][c] * w[4]) *
+                        rcp;
+            }
+            else
+            {
+                for (AU1 c = 0; c < 4; c++)
+                    d[c] = box[0][c] * 0.5f + (box[1][c] + box[2][c] + box[3][c] + box[4][c]) * 0.125f;
+            }
+        }
+    }
+}
+
+//==============================================================================================================================
+//                                                     GAUSSIAN PYRAMID
+//==============================================================================================================================
+// Same as SPD_GAUSSIAN and SPD_LAPLACIAN in ffx_spd.h: the separable 5-tap binomial [1 4 6 4 1] / 16 before decimation, and
+// optionally the Laplacian levels in a second chain with the same layout. Level n of it is level n minus level n + 1
+// expanded with the same kernel, the last computed level is the residual and has no Laplacian level.
+A_STATIC void SpdCpuGaussianRegion(SpdMipChain &chain, AU1 level, AU1 slice, AU1 x0, AU1 y0, AU1 x1, AU1 y1)
+{
+    AU1 inWidth = chain.Width(level - 1);
+    AU1 inHeight = chain.Height(level - 1);
+    for (AU1 y = y0; y < y1; y++)
+    {
+        const AF1 *rows[5];
+        for (AU1 i = 0; i < 5; i++)
+            rows[i] = (const AF1*)chain.Row(level - 1, slice, AMinU1(AMaxU1(y * 2 + i, 2) - 2, inHeight - 1));
+        AF1 *dst = (AF1*)chain.Row(level, slice, y);
+        for (AU1 x = x0; x < x1; x++)
+        {
+            AU1 columns[5];
+            for (AU1 i = 0; i < 5; i++)
+                columns[i] = AMinU1(AMaxU1(x * 2 + i, 2) - 2, inWidth - 1) * 4;
+            AF1 row[5][4];
+            for (AU1 i = 0; i < 5; i++)
+                for (AU1 c = 0; c < 4; c++)
+                    row[i][c] = (rows[i][columns[0] + c] + rows[i][columns[4] + c] +
+                        (rows[i][columns[1] + c] + rows[i][columns[3] + c]) * 4.0f + rows[i][columns[2] + c] * 6.0f) *
+                        (1.0f / 16.0f);
+            for (AU1 c = 0; c < 4; c++)
+                dst[x * 4 + c] = (row[0][c] + row[4][c] + (row[1][c] + row[3][c]) * 4.0f + row[2][c] * 6.0f) *
+                    (1.0f / 16.0f);
+        }
+    }
+}
+
+// Texels and weights of the next level, with n texels, that texel i is expanded from: 1 6 1 / 8 for even texels, which sit on
+// a texel of the next level, and 1 1 / 2 for odd ones
+A_STATIC void SpdCpuExpandTaps(AU1 i, AU1 n, AU1 *taps, AF1 *weights)
+{
+    AU1 j = i >> 1;
+    taps[0] = AMinU1(AMaxU1(j, 1) - 1, n - 1);
+    taps[1] = AMinU1(j, n - 1);
+    taps[2] = AMinU1(j + 1, n - 1);
+    weights[0] = (i & 1) == 0 ? 0.125f : 0.0f;
+    weights[1] = (i & 1) == 0 ? 0.75f : 0.5f;
+    weights[2] = (i & 1) == 0 ? 0.125f : 0.5f;
+}
+
+// Writes the region [x0, x1) x [y0, y1) of a Laplacian level: level of chain minus level + 1 expanded
+A_STATIC void SpdCpuLaplacianRegion(const SpdMipChain &chain, SpdMipChain &laplacian, AU1 level, AU1 slice,
+    AU1 x0, AU1 y0, AU1 x1, AU1 y1)
+{
+    for (AU1 y = y0; y < y1; y++)
+    {
+        AU1 ty[3];
+        AF1 wy[3];
+        SpdCpuExpandTaps(y, chain.Height(level + 1), ty, wy);
+        const AF1 *rows[3];
+        for (AU1 j = 0; j < 3; j++)
+            rows[j] = (const AF1*)chain.Row(level + 1, slice, ty[j]);
+        const AF1 *src = (const AF1*)chain.Row(level, slice, y);
+        AF1 *dst = (AF1*)laplacian.Row(level, slice, y);
+        for (AU1 x = x0; x < x1; x++)
+        {
+            AU1 tx[3];
+            AF1 wx[3];
+            SpdCpuExpandTaps(x, chain.Width(level + 1), tx, wx);
+            for (AU1 c = 0; c < 4; c++)
+            {
+                AF1 v = 0.0f;
+                for (AU1 j = 0; j < 3; j++)
+                    for (AU1 i = 0; i < 3; i++)
+                        v += rows[j][tx[i] * 4 + c] * (wx[i] * wy[j]);
+                dst[x * 4 + c] = src[x * 4 + c] - v;
+            }
+        }
+    }
+}
+
+//==============================================================================================================================
+//                                                     WIDE FILTER DOWNSAMPLER
+//==============================================================================================================================
+// State shared by all workers of one SpdDownsampleCpuBloom or SpdDownsampleCpuGaussian call
+struct SpdCpuBloomJob
+{
+    SpdMipChain *chain;
+    SpdMipChain *laplacian; // Gaussian only, nullptr if not wanted
+    AU1 mips;
+    AU1 slices;
+    AU1 tileSize;
+    AU1 tileLevels;
+    AU1 tilesX;
+    AU1 tilesY;
+    bool gaussian;
+    bool karis;
+    std::atomic<AU1> *counters; // per slice, level and tile: tiles around it that are done with the level
+    std::atomic<AU1> *finishedTiles; // per slice: tiles that are done with their last level
+    std::atomic<AU1> nextIndex;
+};
+
+A_STATIC void SpdCpuBloomJobRegion(SpdCpuBloomJob &job, AU1 level, AU1 slice, AU1 x0, AU1 y0, AU1 x1, AU1 y1)
+{
+    if (job.gaussian)
+        SpdCpuGaussianRegion(*job.chain, level, slice, x0, y0, x1, y1);
+    else
+        SpdCpuBloomRegion(*job.chain, level, slice, x0, y0, x1, y1, job.karis && level == 1);
+}
+
+// Tiles within one tile of (tileX, tileY), including itself
+A_STATIC AU1 SpdCpuBloomNeighbours(const SpdCpuBloomJob &job, AU1 tileX, AU1 tileY)
+{
+    AU1 x = 1 + (tileX > 0 ? 1 : 0) + (tileX + 1 < job.tilesX ? 1 : 0);
+    AU1 y = 1 + (tileY > 0 ? 1 : 0) + (tileY + 1 < job.tilesY ? 1 : 0);
+    return x * y;
+}
+
+// Computes level 1 of one tile and then every tile level that becomes complete through it.
+// A task of level n also writes the Laplacian level n - 2 of the tile, which needs level n - 1 of the tiles around it.
+A_STATIC void SpdCpuBloomTile(SpdCpuBloomJob &job, AU1 tileX, AU1 tileY, AU1 slice)
+{
+    SpdMipChain &chain = *job.chain;
+    const AU1 tiles = job.tilesX * job.tilesY;
+    const AU1 lastLevel = AMinU1(job.mips, job.tileLevels);
+    // the Laplacian needs one more task for the last band
+    const AU1 lastTask = lastLevel + (job.laplacian ? 1 : 0);
+    AU1 stack[9 * SPD_CPU_MAX_MIP_LEVELS][3];
+    AU1 count = 0;
+    stack[count][0] = tileX;
+    stack[count][1] = tileY;
+    stack[count++][2] = 1;
+    while (count > 0)
+    {
+        count--;
+        AU1 x = stack[count][0];
+        AU1 y = stack[count][1];
+        AU1 level = stack[count][2];
+        if (level <= lastLevel)
+        {
+            AU1 size = job.tileSize >> level;
+            AU1 x0 = x * size;
+            AU1 y0 = y * size;
+            AU1 x1 = AMinU1(x0 + size, chain.Width(level));
+            AU1 y1 = AMinU1(y0 + size, chain.Height(level));
+            if (x0 < x1 && y0 < y1)
+                SpdCpuBloomJobRegion(job, level, slice, x0, y0, x1, y1);
+        }
+        if (job.laplacian && level >= 2)
+        {
+            AU1 band = level - 2;
+            AU1 size = job.tileSize >> band;
+            AU1 x0 = x * size;
+            AU1 y0 = y * size;
+            AU1 x1 = AMinU1(x0 + size, chain.Width(band));
+            AU1 y1 = AMinU1(y0 + size, chain.Height(band));
+            if (x0 < x1 && y0 < y1)
+                SpdCpuLaplacianRegion(chain, *job.laplacian, band, slice, x0, y0, x1, y1);
+        }
+
+        if (level < lastTask)
+        {
+            for (AU1 n = 0; n < 9; n++)
+            {
+                ASU1 nx = ASU1(x) + ASU1(n % 3) - 1;
+                ASU1 ny = ASU1(y) + ASU1(n / 3) - 1;
+                if (nx < 0 || ny < 0 || nx >= ASU1(job.tilesX) || ny >= ASU1(job.tilesY))
+                    continue;
+                std::atomic<AU1> &counter = job.counters[
+                    (AL1(slice) * job.tileLevels + level - 1) * tiles + AU1(ny) * job.tilesX + AU1(nx)];
+                if (counter.fetch_add(1, std::memory_order_acq_rel) + 1 != SpdCpuBloomNeighbours(job, AU1(nx), AU1(ny)))
+                    continue;
+                stack[count][0] = AU1(nx);
+                stack[count][1] = AU1(ny);
+                stack[count++][2] = level + 1;
+            }
+        }
+        else if (job.mips > job.tileLevels &&
+            job.finishedTiles[slice].fetch_add(1, std::memory_order_acq_rel) + 1 == tiles)
+        {
+            // last tile of the slice, the remaining levels
+            for (AU1 l = job.tileLevels + 1; l <= job.mips; l++)
+                SpdCpuBloomJobRegion(job, l, slice, 0, 0, chain.Width(l), chain.Height(l));
+            if (job.laplacian)
+                for (AU1 l = job.tileLevels; l < job.mips; l++)
+                    SpdCpuLaplacianRegion(chain, *job.laplacian, l, slice, 0, 0, chain.Width(l), chain.Height(l));
+        }
+    }
+}
+
+A_STATIC void SpdCpuBloomWorker(SpdCpuBloomJob &job)
+{
+    const AU1 tiles = job.tilesX * job.tilesY;
+    for (;;)
+    {
+        AU1 index = job.nextIndex.fetch_add(1, std::memory_order_relaxed);
+        if (index >= tiles * job.slices)
+            break;
+        AU1 local = index % tiles;
+        SpdCpuBloomTile(job, local % job.tilesX, local / job.tilesX, index / tiles);
+    }
+}
+
+// Runs a job with chain, laplacian, gaussian and karis set. Allocates the counters, returns false if that fails.
+A_STATIC bool SpdCpuRunBloomJob(SpdCpuBloomJob &job, const SpdPlan &plan, const SpdCpuConfig &config)
+{
+    SpdMipChain &chain = *job.chain;
+    job.mips = AMinU1(plan.mips, chain.LevelCount() - 1);
+    job.slices = AMinU1(plan.slices, chain.SliceCount());
+    if (job.mips == 0 || job.slices == 0)
+        return true;
+    job.tileSize = plan.tileSize;
+    job.tileLevels = SpdCpuTileLevels(plan.tileSize);
+    job.tilesX = (chain.Width(0) + plan.tileSize - 1) / plan.tileSize;
+    job.tilesY = (chain.Height(0) + plan.tileSize - 1) / plan.tileSize;
+    AL1 counterCount = AL1(job.slices) * job.tileLevels * job.tilesX * job.tilesY + job.slices;
+    std::atomic<AU1> *counters = new (std::nothrow) std::atomic<AU1>[size_t(counterCount)];
+    if (!counters)
+        return false;
+    for (AL1 i = 0; i < counterCount; i++)
+        counters[i].store(0, std::memory_order_relaxed);
+    job.counters = counters;
+    job.finishedTiles = counters + (counterCount - job.slices);
+    job.nextIndex.store(0, std::memory_order_relaxed);
+
+    SpdCpuRunWorkers([&job](AU1) { SpdCpuBloomWorker(job); }, config.threadCount);
+    delete[] counters;
+    return true;
+}
+
+// 13-tap bloom downsample of mips [0, plan.mips), see BLOOM. Always processes whole slices: every texel depends on the
+// neighbouring tiles, so the plan rectangles are ignored, only mips, slices and tileSize are read.
+// config.tileSize and config.traversal are not read. Allocates one counter per tile and level, returns false if that fails
+// or if the chain is not RGBA32F.
+A_STATIC bool SpdDownsampleCpuBloom(SpdMipChain &chain, const SpdPlan &plan, const SpdCpuConfig &config,
+    bool karisAverage = false)
+{
+    if (chain.Layout().format != SpdCpuFormat::RGBA32F)
+        return false;
+    SpdCpuBloomJob job;
+    job.chain = &chain;
+    job.laplacian = nullptr;
+    job.gaussian = false;
+    job.karis = karisAverage;
+    return SpdCpuRunBloomJob(job, plan, config);
+}
+
+A_STATIC bool SpdDownsampleCpuBloom(SpdMipChain &chain, AU1 mips, bool karisAverage = false,
+    AU1 tileSize = SPD_TILE_SIZE)
+{
+    return SpdDownsampleCpuBloom(chain, SpdCreatePlan(chain.Width(0), chain.Height(0), chain.SliceCount(), ASU1(mips),
+        AU1(chain.Layout().format), tileSize), SpdCpuDefaultConfig(), karisAverage);
+}
+
+// The multipass version: computes mips [0, mips) one after the other for the whole slice, single threaded.
+// Meant as the reference for SpdDownsampleCpuBloom() and the shader version, returns false if the chain is not RGBA32F.
+A_STATIC bool SpdDownsampleCpuBloomReference(SpdMipChain &chain, AU1 mips, bool karisAverage = false)
+{
+    if (chain.Layout().format != SpdCpuFormat::RGBA32F)
+        return false;
+    mips = AMinU1(mips, chain.LevelCount() - 1);
+    for (AU1 slice = 0; slice < chain.SliceCount(); slice++)
+        for (AU1 level = 1; level <= mips; level++)
+            SpdCpuBloomRegion(chain, level, slice, 0, 0, chain.Width(level), chain.Height(level), karisAverage && level == 1);
+    return true;
+}
+
+// A Laplacian chain has to be RGBA32F and match the layout of chain
+A_STATIC bool SpdCpuLaplacianMatches(const SpdMipChain &chain, const SpdMipChain *laplacian)
+{
+    return laplacian == nullptr || (laplacian->Layout().format == SpdCpuFormat::RGBA32F &&
+        laplacian->Layout().size == chain.Layout().size && laplacian->LevelCount() == chain.LevelCount() &&
+        laplacian->SliceCount() == chain.SliceCount() && laplacian->Width(0) == chain.Width(0) &&
+        laplacian->Height(0) == chain.Height(0));
+}
+
+// Gaussian pyramid of mips [0, plan.mips), see GAUSSIAN PYRAMID. If laplacian is set, its levels [0, mips) receive the
+// Laplacian levels in the same pass. Otherwise as SpdDownsampleCpuBloom(), also returns false if laplacian doesn't match.
+A_STATIC bool SpdDownsampleCpuGaussian(SpdMipChain &chain, const SpdPlan &plan, const SpdCpuConfig &config,
+    SpdMipChain *laplacian = nullptr)
+{
+    if (chain.Layout().format != SpdCpuFormat::RGBA32F || !SpdCpuLaplacianMatches(chain, laplacian))
+        return false;
+    SpdCpuBloomJob job;
+    job.chain = &chain;
+    job.laplacian = laplacian;
+    job.gaussian = true;
+    job.karis = false;
+    return SpdCpuRunBloomJob(job, plan, config);
+}
+
+A_STATIC bool SpdDownsampleCpuGaussian(SpdMipChain &chain, AU1 mips, SpdMipChain *laplacian = nullptr,
+    AU1 tileSize = SPD_TILE_SIZE)
+{
+    return SpdDownsampleCpuGaussian(chain, SpdCreatePlan(chain.Width(0), chain.Height(0), chain.SliceCount(), ASU1(mips),
+        AU1(chain.Layout().format), tileSize), SpdCpuDefaultConfig(), laplacian);
+}
+
+// The multipass version of SpdDownsampleCpuGaussian(): all mips one after the other, then all Laplacian levels
+A_STATIC bool SpdDownsampleCpuGaussianReference(SpdMipChain &chain, AU1 mips, SpdMipChain *laplacian = nullptr)
+{
+    if (chain.Layout().format != SpdCpuFormat::RGBA32F || !SpdCpuLaplacianMatches(chain, laplacian))
+        return false;
+    mips = AMinU1(mips, chain.LevelCount() - 1);
+    for (AU1 slice = 0; slice < chain.SliceCount(); slice++)
+    {
+        for (AU1 level = 1; level <= mips; level++)
+            SpdCpuGaussianRegion(chain, level, slice, 0, 0, chain.Width(level), chain.Height(level));
+        for (AU1 level = 0; laplacian && level < mips; level++)
+            SpdCpuLaplacianRegion(chain, *laplacian, level, slice, 0, 0, chain.Width(level), chain.Height(level));
+    }
+    return true;
+}
+
+//==============================================================================================================================
+//                                                   LUMINANCE HISTOGRAM
+//==============================================================================================================================
+// Same as SPD_HISTOGRAM in ffx_spd.h, for offline tone mapping: the workers bin the tiles of level 0 into one histogram per
+// tile, the worker that finishes the last tile merges them and computes the average luminance and the exposure.
+#define SPD_CPU_MAX_HISTOGRAM_BINS 256
+
+struct SpdCpuHistogramSettings
+{
+    AU1 bins; // 64 or 256
+    AF1 minLog2Luminance; // metering range, texels below it go to bin 0 and are not metered, above it to the last bin
+    AF1 maxLog2Luminance;
+    AF1 lowPercentile; // the average is taken over the metered texels between the two percentiles
+    AF1 highPercentile;
+    AF1 key; // exposure = key / averageLuminance
+};
+
+struct SpdCpuHistogram
+{
+    AU1 bins;
+    AU1 counts[SPD_CPU_MAX_HISTOGRAM_BINS];
+    AF1 averageLuminance;
+    AF1 exposure;
+};
+
+A_STATIC SpdCpuHistogramSettings SpdCpuDefaultHistogramSettings()
+{
+    return SpdCpuHistogramSettings{ 256, -10.0f, 6.0f, 0.5f, 0.95f, 0.18f };
+}
+
+// Rec. 709 luminance of texel x, or the value itself for the one channel formats
+A_STATIC AF1 SpdCpuLoadLuminance(SpdCpuFormat format, const SpdCpuSrgbTables &tables, const AB1 *row, AU1 x)
+{
+    switch (format)
+    {
+    case SpdCpuFormat::RGBA32F:
+    {
+        AF1 v[3];
+        memcpy(v, row + x * 16, sizeof(v));
+        return v[0] * 0.2126f + v[1] * 0.7152f + v[2] * 0.0722f;
+    }
+    case SpdCpuFormat::R8Unorm:
+        return SpdCpuUnpackUnorm8(row[x]);
+    case SpdCpuFormat::R16Unorm:
+    {
+        AW1 v;
+        memcpy(&v, row + x * 2, sizeof(v));
+        return AF1(v) * (1.0f / 65535.0f);
+    }
+    default:
+    {
+        // RGBA8Unorm and RGBA8UnormFixed read the linear half of the decode table
+        const AF1 *decode = tables.decode + (format == SpdCpuFormat::RGBA8UnormSrgb ? 0 : 256);
+        const AB1 *t = row + x * 4;
+        return decode[t[0]] * 0.2126f + decode[t[1]] * 0.7152f + decode[t[2]] * 0.0722f;
+    }
+    }
+}
+
+A_STATIC bool SpdCpuHistogramSupported(SpdCpuFormat format)
+{
+    return format == SpdCpuFormat::RGBA32F || format == SpdCpuFormat::RGBA8Unorm ||
+        format == SpdCpuFormat::RGBA8UnormFixed || format == SpdCpuFormat::RGBA8UnormSrgb ||
+        format == SpdCpuFormat::R8Unorm || format == SpdCpuFormat::R16Unorm;
+}
+
+A_STATIC AU1 SpdCpuHistogramBin(AF1 luminance, const SpdCpuHistogramSettings &settings)
+{
+    if (!(luminance >= exp2f(settings.minLog2Luminance)))
+        return 0;
+    AF1 t = AMinF1((log2f(luminance) - settings.minLog2Luminance) /
+        (settings.maxLog2Luminance - settings.minLog2Luminance), 1.0f);
+    return 1 + AMinU1(AU1(t * AF1(settings.bins - 1)), settings.bins - 2);
+}
+
+// Average luminance between the percentiles of the metered texels, same as SpdHistogramAverage() in the shader
+A_STATIC AF1 SpdCpuHistogramAverage(const AU1 *counts, const SpdCpuHistogramSettings &settings)
+{
+    double metered = 0.0;
+    for (AU1 bin = 1; bin < settings.bins; bin++)
+        metered += counts[bin];
+    double low = metered * settings.lowPercentile;
+    double high = metered * settings.highPercentile;
+    double range = double(settings.maxLog2Luminance) - settings.minLog2Luminance;
+    double below = 0.0;
+    double sum = 0.0;
+    double weight = 0.0;
+    for (AU1 bin = 1; bin < settings.bins; bin++)
+    {
+        double inside = AMinD1(below + counts[bin], high) - AMaxD1(below, low);
+        if (inside > 0.0)
+        {
+            double center = (bin - 0.5) / (settings.bins - 1);
+            sum += inside * (settings.minLog2Luminance + center * range);
+            weight += inside;
+        }
+        below += counts[bin];
+    }
+    return AF1(exp2(weight > 0.0 ? sum / weight : settings.minLog2Luminance));
+}
+
+struct SpdCpuHistogramJob
+{
+    const SpdMipChain *chain;
+    SpdCpuHistogramSettings settings;
+    SpdCpuHistogram *histogram;
+    AU1 slice;
+    AU1 tileSize;
+    AU1 tilesX;
+    AU1 tilesY;
+    AU1 *tileCounts; // settings.bins per tile
+    std::atomic<AU1> nextIndex;
+    std::atomic<AU1> finishedTiles;
+};
+
+A_STATIC void SpdCpuHistogramTile(SpdCpuHistogramJob &job, AU1 tile)
+{
+    const SpdMipChain &chain = *job.chain;
+    SpdCpuFormat format = chain.Layout().format;
+    const SpdCpuSrgbTables &tables = SpdCpuGetSrgbTables();
+    AU1 *counts = job.tileCounts + size_t(tile) * job.settings.bins;
+    memset(counts, 0, job.settings.bins * sizeof(AU1));
+    AU1 x0 = (tile % job.tilesX) * job.tileSize;
+    AU1 y0 = (tile / job.tilesX) * job.tileSize;
+    AU1 x1 = AMinU1(x0 + job.tileSize, chain.Width(0));
+    AU1 y1 = AMinU1(y0 + job.tileSize, chain.Height(0));
+    for (AU1 y = y0; y < y1; y++)
+    {
+        const AB1 *row = chain.Row(0, job.slice, y);
+        for (AU1 x = x0; x < x1; x++)
+            counts[SpdCpuHistogramBin(SpdCpuLoadLuminance(format, tables, row, x), job.settings)]++;
+    }
+}
+
+// Called by the worker that finished the last tile
+A_STATIC void SpdCpuHistogramMerge(SpdCpuHistogramJob &job)
+{
+    SpdCpuHistogram &histogram = *job.histogram;
+    const AU1 tiles = job.tilesX * job.tilesY;
+    histogram.bins = job.settings.bins;
+    memset(histogram.counts, 0, sizeof(histogram.counts));
+    for (AU1 tile = 0; tile < tiles; tile++)
+    {
+        const AU1 *counts = job.tileCounts + size_t(tile) * job.settings.bins;
+        for (AU1 bin = 0; bin < job.settings.bins; bin++)
+            histogram.counts[bin] += counts[bin];
+    }
+    histogram.averageLuminance = SpdCpuHistogramAverage(histogram.counts, job.settings);
+    histogram.exposure = job.settings.key / histogram.averageLuminance;
+}
+
+A_STATIC void SpdCpuHistogramWorker(SpdCpuHistogramJob &job)
+{
+    const AU1 tiles = job.tilesX * job.tilesY;
+    for (;;)
+    {
+        AU1 index = job.nextIndex.fetch_add(1, std::memory_order_relaxed);
+        if (index >= tiles)
+            break;
+        SpdCpuHistogramTile(job, index);
+        if (job.finishedTiles.fetch_add(1, std::memory_order_acq_rel) == tiles - 1)
+            SpdCpuHistogramMerge(job);
+    }
+}
+
+// Luminance histogram, average luminance and exposure of level 0 of slice, see LUMINANCE HISTOGRAM. The tiles are
+// config.tileSize wide and spread over config.threadCount threads, config.isa and config.traversal are not read.
+// Allocates one histogram per tile, returns false if that fails, if the format has no luminance (only RGBA32F, the
+// RGBA8 formats except the normal map one, R8Unorm and R16Unorm) or if the settings are invalid.
+A_STATIC bool SpdCpuLuminanceHistogram(const SpdMipChain &chain, AU1 slice, const SpdCpuHistogramSettings &settings,
+    SpdCpuHistogram &histogram, const SpdCpuConfig &config)
+{
+    if (!SpdCpuHistogramSupported(chain.Layout().format) || slice >= chain.SliceCount() ||
+        (settings.bins != 64 && settings.bins != 256) || !(settings.minLog2Luminance < settings.maxLog2Luminance))
+        return false;
+    SpdCpuHistogramJob job;
+    job.chain = &chain;
+    job.settings = settings;
+    job.histogram = &histogram;
+    job.slice = slice;
+    job.tileSize = AMaxU1(config.tileSize, 1);
+    job.tilesX = (chain.Width(0) + job.tileSize - 1) / job.tileSize;
+    job.tilesY = (chain.Height(0) + job.tileSize - 1) / job.tileSize;
+    job.tileCounts = new (std::nothrow) AU1[size_t(job.tilesX) * job.tilesY * settings.bins];
+    if (!job.tileCounts)
+        return false;
+    job.nextIndex.store(0, std::memory_order_relaxed);
+    job.finishedTiles.store(0, std::memory_order_relaxed);
+
+    SpdCpuRunWorkers([&job](AU1) { SpdCpuHistogramWorker(job); }, config.threadCount);
+    delete[] job.tileCounts;
+    return true;
+}
+
+A_STATIC bool SpdCpuLuminanceHistogram(const SpdMipChain &chain, AU1 slice, const SpdCpuHistogramSettings &settings,
+    SpdCpuHistogram &histogram)
+{
+    return SpdCpuLuminanceHistogram(chain, slice, settings, histogram, SpdCpuDefaultConfig());
+}
+
+//==============================================================================================================================
+//                                                   SUMMED AREA TABLE
+//==============================================================================================================================
+// Same scheme as SPD_SUMMED_AREA_TABLE in ffx_spd.h, with the SPD tiles: the workers compute the prefix sums local to each
+// tile in any order, then add the carries of the tiles to the left and above, S = L + (top + (left - corner)), where top is
+// the last row of the tile above, left the last column of the tile to the left and corner the texel they share. A tile
+// gets its carries as soon as its local sums and both neighbours are done, by the worker that finished the last of them,
+// same as the bloom tiles, nobody waits. The local sums are the expensive part and run fully parallel.
+// SpdCpuSummedAreaTableTwoPass() is the usual baseline, a horizontal pass over all rows, then a vertical one.
+// RGBA32F only, sums are in float: subtract the average first for large images that need small differences.
+typedef void (*SpdCpuSatRowFn)(AF1 *dst, const AF1 *src, const AF1 *above, AU1 count);
+
+#define SPD_CPU_MAX_TILE_SIZE (SPD_CPU_MIN_TILE_SIZE << (SPD_CPU_TILE_SIZE_COUNT - 1))
+
+// dst[x] = src[0] + ... + src[x] + above[x] for count RGBA32F texels, dst may be src
+A_STATIC void SpdCpuSatRow(AF1 *dst, const AF1 *src, const AF1 *above, AU1 count)
+{
+    AF1 s[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+    for (AU1 i = 0; i < count * 4; i += 4)
+        for (AU1 c = 0; c < 4; c++)
+        {
+            s[c] += src[i + c];
+            dst[i + c] = s[c] + above[i + c];
+        }
+}
+
+#ifdef SPD_CPU_SIMD
+// one texel per instruction, the running sum is the only dependency
+SPD_CPU_TARGET("sse4.1")
+A_STATIC void SpdCpuSatRow_SSE41(AF1 *dst, const AF1 *src, const AF1 *above, AU1 count)
+{
+    __m128 s = _mm_setzero_ps();
+    for (AU1 i = 0; i < count * 4; i += 4)
+    {
+        s = _mm_add_ps(s, _mm_loadu_ps(src + i));
+        _mm_storeu_ps(dst + i, _mm_add_ps(s, _mm_loadu_ps(above + i)));
+    }
+}
+
+// two texels: t0 + t1 in the upper half, then the running sum is added and broadcast from the upper half
+SPD_CPU_TARGET("avx2")
+A_STATIC void SpdCpuSatRow_AVX2(AF1 *dst, const AF1 *src, const AF1 *above, AU1 count)
+{
+    __m256 s = _mm256_setzero_ps();
+    AU1 i = 0;
+    for (; i + 8 <= count * 4; i += 8)
+    {
+        __m256 v = _mm256_loadu_ps(src + i);
+        v = _mm256_add_ps(v, _mm256_permute2f128_ps(v, v, 0x08));
+        v = _mm256_add_ps(v, s);
+        _mm256_storeu_ps(dst + i, _mm256_add_ps(v, _mm256_loadu_ps(above + i)));
+        s = _mm256_permute2f128_ps(v, v, 0x11);
+    }
+    if (i < count * 4)
+    {
+        __m128 r = _mm_add_ps(_mm256_castps256_ps128(s), _mm_loadu_ps(src + i));
+        _mm_storeu_ps(dst + i, _mm_add_ps(r, _mm_loadu_ps(above + i)));
+    }
+}
+
+// four texels, a log step scan over the 128-bit lanes
+SPD_CPU_TARGET("avx512f")
+A_STATIC void SpdCpuSatRow_AVX512(AF1 *dst, const AF1 *src, const AF1 *above, AU1 count)
+{
+    const __m512i shift1 = _mm512_set_epi32(11, 10, 9, 8, 7, 6, 5, 4, 3, 2, 1, 0, 0, 0, 0, 0);
+    const __m512i shift2 = _mm512_set_epi32(7, 6, 5, 4, 3, 2, 1, 0, 0, 0, 0, 0, 0, 0, 0, 0);
+    __m512 s = _mm512_setzero_ps();
+    AU1 i = 0;
+    for (; i + 16 <= count * 4; i += 16)
+    {
+        __m512 v = _mm512_loadu_ps(src + i);
+        v = _mm512_add_ps(v, _mm512_maskz_permutexvar_ps(0xFFF0, shift1, v));
+        v = _mm512_add_ps(v, _mm512_maskz_permutexvar_ps(0xFF00, shift2, v));
+        v = _mm512_add_ps(v, s);
+        _mm512_storeu_ps(dst + i, _mm512_add_ps(v, _mm512_loadu_ps(above + i)));
+        // zero masked forms, the unmasked ones read an undefined register that GCC warns about
+        s = _mm512_maskz_shuffle_f32x4(0xFFFF, v, v, 0xFF);
+    }
+    AF1 sum[16];
+    _mm512_storeu_ps(sum, s);
+    __m128 r = _mm_loadu_ps(sum);
+    for (; i < count * 4; i += 4)
+    {
+        r = _mm_add_ps(r, _mm_loadu_ps(src + i));
+        _mm_storeu_ps(dst + i, _mm_add_ps(r, _mm_loadu_ps(above + i)));
+    }
+}
+#endif // #ifdef SPD_CPU_SIMD
+
+A_STATIC SpdCpuSatRowFn SpdCpuGetSatRow(SpdCpuIsa isa = SpdCpuIsa::Scalar)
+{
+    static const SpdCpuSatRowFn kernels[SPD_CPU_ISA_COUNT] = SPD_CPU_KERNELS(SpdCpuSatRow);
+    return kernels[AU1(SpdCpuIsaSupported(isa) ? isa : SpdCpuIsa::Scalar)];
+}
+
+// The table has to be RGBA32F with the size and slices of the source, which can be the same chain
+A_STATIC bool SpdCpuSatMatches(const SpdMipChain &source, const SpdMipChain &table)
+{
+    return source.Layout().format == SpdCpuFormat::RGBA32F && table.Layout().format == SpdCpuFormat::RGBA32F &&
+        table.Width(0) == source.Width(0) && table.Height(0) == source.Height(0) &&
+        table.SliceCount() == source.SliceCount();
+}
+
+struct SpdCpuSatJob
+{
+    const SpdMipChain *source;
+    SpdMipChain *table;
+    SpdCpuSatRowFn satRow;
+    AU1 slices;
+    AU1 tileSize;
+    AU1 tilesX;
+    AU1 tilesY;
+    AU1 stackSize; // tiles that can be ready at once: min(tilesX, tilesY)
+    AU1 *stacks; // stackSize per thread
+    std::atomic<AU1> *counters; // per slice and tile: local sums, left and top neighbour that are done
+    std::atomic<AU1> nextIndex;
+};
+
+A_STATIC AF1 *SpdCpuSatTexel(SpdMipChain &table, AU1 slice, AU1 x, AU1 y)
+{
+    return (AF1*)table.Row(0, slice, y) + x * 4;
+}
+
+A_STATIC void SpdCpuSatTileLocal(SpdCpuSatJob &job, AU1 tileX, AU1 tileY, AU1 slice)
+{
+    static const AF1 zeros[SPD_CPU_MAX_TILE_SIZE * 4] = {};
+    SpdMipChain &table = *job.table;
+    AU1 x0 = tileX * job.tileSize;
+    AU1 y0 = tileY * job.tileSize;
+    AU1 x1 = AMinU1(x0 + job.tileSize, table.Width(0));
+    AU1 y1 = AMinU1(y0 + job.tileSize, table.Height(0));
+    for (AU1 y = y0; y < y1; y++)
+    {
+        const AF1 *src = (const AF1*)job.source->Row(0, slice, y) + x0 * 4;
+        const AF1 *above = y > y0 ? SpdCpuSatTexel(table, slice, x0, y - 1) : zeros;
+        job.satRow(SpdCpuSatTexel(table, slice, x0, y), src, above, x1 - x0);
+    }
+}
+
+A_STATIC void SpdCpuSatTileCarry(SpdCpuSatJob &job, AU1 tileX, AU1 tileY, AU1 slice)
+{
+    if (tileX == 0 && tileY == 0)
+        return;
+    SpdMipChain &table = *job.table;
+    AU1 x0 = tileX * job.tileSize;
+    AU1 y0 = tileY * job.tileSize;
+    AU1 x1 = AMinU1(x0 + job.tileSize, table.Width(0));
+    AU1 y1 = AMinU1(y0 + job.tileSize, table.Height(0));
+    AF1 corner[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+    if (tileX > 0 && tileY > 0)
+        memcpy(corner, SpdCpuSatTexel(table, slice, x0 - 1, y0 - 1), sizeof(corner));
+    const AF1 *top = tileY > 0 ? SpdCpuSatTexel(table, slice, x0, y0 - 1) : nullptr;
+    for (AU1 y = y0; y < y1; y++)
+    {
+        AF1 *row = SpdCpuSatTexel(table, slice, x0, y);
+        AF1 left[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+        if (tileX > 0)
+            memcpy(left, SpdCpuSatTexel(table, slice, x0 - 1, y), sizeof(left));
+        for (AU1 c = 0; c < 4; c++)
+            left[c] -= corner[c];
+        if (top)
+        {
+            for (AU1 i = 0; i < (x1 - x0) * 4; i++)
+                row[i] += top[i] + left[i & 3];
+        }
+        else
+        {
+            for (AU1 i = 0; i < (x1 - x0) * 4; i++)
+                row[i] += left[i & 3];
+        }
+    }
+}
+
+// Counts one more dependency of the tile done, returns true if it was the last one
+A_STATIC bool SpdCpuSatSignal(SpdCpuSatJob &job, AU1 tileX, AU1 tileY, AU1 slice)
+{
+    AU1 dependencies = 1 + (tileX > 0 ? 1 : 0) + (tileY > 0 ? 1 : 0);
+    std::atomic<AU1> &counter = job.counters[(AL1(slice) * job.tilesY + tileY) * job.tilesX + tileX];
+    return counter.fetch_add(1, std::memory_order_acq_rel) + 1 == dependencies;
+}
+
+A_STATIC void SpdCpuSatWorker(SpdCpuSatJob &job, AU1 thread)
+{
+    const AU1 tiles = job.tilesX * job.tilesY;
+    AU1 *stack = job.stacks + thread * job.stackSize;
+    for (;;)
+    {
+        AU1 index = job.nextIndex.fetch_add(1, std::memory_order_relaxed);
+        if (index >= tiles * job.slices)
+            break;
+        AU1 slice = index / tiles;
+        AU1 local = index % tiles;
+        SpdCpuSatTileLocal(job, local % job.tilesX, local / job.tilesX, slice);
+        if (!SpdCpuSatSignal(job, local % job.tilesX, local / job.tilesX, slice))
+            continue;
+        // the ready tiles of a slice never depend on each other, so there are at most min(tilesX, tilesY)
+        AU1 count = 0;
+        stack[count++] = local;
+        while (count > 0)
+        {
+            AU1 tile = stack[--count];
+            AU1 x = tile % job.tilesX;
+            AU1 y = tile / job.tilesX;
+            SpdCpuSatTileCarry(job, x, y, slice);
+            if (x + 1 < job.tilesX && SpdCpuSatSignal(job, x + 1, y, slice))
+                stack[count++] = tile + 1;
+            if (y + 1 < job.tilesY && SpdCpuSatSignal(job, x, y + 1, slice))
+                stack[count++] = tile + job.tilesX;
+        }
+    }
+}
+
+// Summed area table of level 0 of every slice of source into level 0 of table, see SUMMED AREA TABLE. Both have to be
+// RGBA32F with the same size and slices, table can be source. The tiles are config.tileSize wide (clamped to 32-128) and
+// spread over config.threadCount threads, config.isa picks the kernel, config.traversal is not read.
+// Allocates one counter per tile, returns false if that fails or if the chains don't match.
+A_STATIC bool SpdCpuSummedAreaTable(const SpdMipChain &source, SpdMipChain &table, const SpdCpuConfig &config)
+{
+    if (!SpdCpuSatMatches(source, table))
+        return false;
+    SpdCpuSatJob job;
+    job.source = &source;
+    job.table = &table;
+    job.satRow = SpdCpuGetSatRow(config.isa);
+    job.slices = table.SliceCount();
+    job.tileSize = AMinU1(AMaxU1(config.tileSize, SPD_CPU_MIN_TILE_SIZE), SPD_CPU_MAX_TILE_SIZE);
+    job.tilesX = (table.Width(0) + job.tileSize - 1) / job.tileSize;
+    job.tilesY = (table.Height(0) + job.tileSize - 1) / job.tileSize;
+    job.stackSize = AMinU1(job.tilesX, job.tilesY);
+    AU1 threadCount = AMinU1(AMaxU1(config.threadCount, 1), SPD_CPU_MAX_THREADS);
+    AL1 counterCount = AL1(job.slices) * job.tilesX * job.tilesY;
+    std::atomic<AU1> *counters = new (std::nothrow) std::atomic<AU1>[size_t(counterCount)];
+    AU1 *stacks = new (std::nothrow) AU1[size_t(threadCount) * job.stackSize];
+    if (!counters || !stacks)
+    {
+        delete[] counters;
+        delete[] stacks;
+        return false;
+    }
+    for (AL1 i = 0; i < counterCount; i++)
+        counters[i].store(0, std::memory_order_relaxed);
+    job.counters = counters;
+    job.stacks = stacks;
+    job.nextIndex.store(0, std::memory_order_relaxed);
+
+    SpdCpuRunWorkers([&job](AU1 worker) { SpdCpuSatWorker(job, worker); }, threadCount);
+    delete[] counters;
+    delete[] stacks;
+    return true;
+}
+
+A_STATIC bool SpdCpuSummedAreaTable(const SpdMipChain &source, SpdMipChain &table)
+{
+    return SpdCpuSummedAreaTable(source, table, SpdCpuDefaultConfig());
+}
+
+struct SpdCpuSatTwoPassJob
+{
+    const SpdMipChain *source;
+    SpdMipChain *table;
+    SpdCpuSatRowFn satRow;
+    const AF1 *zeros; // a row of the table
+    std::atomic<AU1> nextIndex;
+};
+
+// First pass: one row per index
+A_STATIC void SpdCpuSatRowsWorker(SpdCpuSatTwoPassJob &job)
+{
+    SpdMipChain &table = *job.table;
+    for (;;)
+    {
+        AU1 index = job.nextIndex.fetch_add(1, std::memory_order_relaxed);
+        if (index >= table.Height(0) * table.SliceCount())
+            break;
+        AU1 slice = index / table.Height(0);
+        AU1 y = index % table.Height(0);
+        job.satRow(SpdCpuSatTexel(table, slice, 0, y), (const AF1*)job.source->Row(0, slice, y), job.zeros,
+            table.Width(0));
+    }
+}
+
+// Second pass: one strip of SPD_CPU_MAX_TILE_SIZE columns per index, each row adds the one above
+A_STATIC void SpdCpuSatColumnsWorker(SpdCpuSatTwoPassJob &job)
+{
+    SpdMipChain &table = *job.table;
+    const AU1 strips = (table.Width(0) + SPD_CPU_MAX_TILE_SIZE - 1) / SPD_CPU_MAX_TILE_SIZE;
+    for (;;)
+    {
+        AU1 index = job.nextIndex.fetch_add(1, std::memory_order_relaxed);
+        if (index >= strips * table.SliceCount())
+            break;
+        AU1 slice = index / strips;
+        AU1 x0 = (index % strips) * SPD_CPU_MAX_TILE_SIZE;
+        AU1 count = (AMinU1(x0 + SPD_CPU_MAX_TILE_SIZE, table.Width(0)) - x0) * 4;
+        for (AU1 y = 1; y < table.Height(0); y++)
+        {
+            AF1 *row = SpdCpuSatTexel(table, slice, x0, y);
+            const AF1 *above = SpdCpuSatTexel(table, slice, x0, y - 1);
+            for (AU1 i = 0; i < count; i++)
+                row[i] += above[i];
+        }
+    }
+}
+
+A_STATIC void SpdCpuSatRunPass(SpdCpuSatTwoPassJob &job, void (*worker)(SpdCpuSatTwoPassJob&), AU1 threadCount)
+{
+    job.nextIndex.store(0, std::memory_order_relaxed);
+    SpdCpuRunWorkers([&job, worker](AU1) { worker(job); }, threadCount);
+}
+
+// The two pass baseline of SpdCpuSummedAreaTable(): prefix sums of all rows, then of all columns, each pass spread over
+// config.threadCount threads. Same requirements, the results differ by float rounding only.
+A_STATIC bool SpdCpuSummedAreaTableTwoPass(const SpdMipChain &source, SpdMipChain &table, const SpdCpuConfig &config)
+{
+    if (!SpdCpuSatMatches(source, table))
+        return false;
+    AF1 *zeros = new (std::nothrow) AF1[size_t(table.Width(0)) * 4]();
+    if (!zeros)
+        return false;
+    SpdCpuSatTwoPassJob job;
+    job.source = &source;
+    job.table = &table;
+    job.satRow = SpdCpuGetSatRow(config.isa);
+    job.zeros = zeros;
+    AU1 threadCount = AMinU1(AMaxU1(config.threadCount, 1), SPD_CPU_MAX_THREADS);
+    SpdCpuSatRunPass(job, SpdCpuSatRowsWorker, threadCount);
+    SpdCpuSatRunPass(job, SpdCpuSatColumnsWorker, threadCount);
+    delete[] zeros;
+    return true;
+}
+
+//==============================================================================================================================
+//                                                        UPSAMPLE
+//==============================================================================================================================
+// Same as SPD_UPSAMPLE in ffx_spd.h: the coarser level is upsampled bilinearly (weights 9, 3, 3, 1, clamped to the edge)
+// and combined with the level, the result replaces the level, from the coarsest level to SPD mip 0 (level 1).
+// The default combine adds the two, for bloom.
+struct SpdCpuUpsampleAdd
+{
+    void operator()(AF1 *result, const AF1 *fine, const AF1 *coarse, AU1 /*mip*/) const
+    {
+        for (AU1 c = 0; c < 4; c++)
+            result[c] = fine[c] + coarse[c];
+    }
+};
+
+// Texel before the center of texel x in the coarser level, its weight, and the one after it
+A_STATIC void SpdCpuUpsampleTaps(AU1 x, AU1 coarseWidth, AU1 &a, AU1 &b, AF1 &weight)
+{
+    ASU1 before = ASU1((x + 1) / 2) - 1;
+    weight = (x & 1) ? 0.75f : 0.25f;
+    b = AMinU1(AU1(before + 1), coarseWidth - 1);
+    a = AMaxSU1(AU1(before), 0);
+}
+
+// The up chain of SPD mips [0, mips) in place, single threaded, level by level. Mip mips - 1 is the coarsest, it stays as
+// it is. combine(AF1 *result, const AF1 *fine, const AF1 *coarse, AU1 mip) gets the RGBA of the texel and of the
+// upsampled coarser level, result can be fine. Returns false if the chain is not RGBA32F.
+template <typename Combine = SpdCpuUpsampleAdd>
+A_STATIC bool SpdUpsampleCpuReference(SpdMipChain &chain, AU1 mips, Combine combine = Combine())
+{
+    if (chain.Layout().format != SpdCpuFormat::RGBA32F)
+        return false;
+    mips = AMinU1(mips, chain.LevelCount() - 1);
+    for (AU1 slice = 0; slice < chain.SliceCount(); slice++)
+    {
+        for (AU1 mip = mips > 1 ? mips - 1 : 0; mip-- > 0;)
+        {
+            AU1 level = mip + 1;
+            AU1 coarseWidth = chain.Width(level + 1);
+            AU1 coarseHeight = chain.Height(level + 1);
+            for (AU1 y = 0; y < chain.Height(level); y++)
+            {
+                AU1 ya, yb;
+                AF1 wy;
+                SpdCpuUpsampleTaps(y, coarseHeight, ya, yb, wy);
+                const AF1 *rowA = (const AF1*)chain.Row(level + 1, slice, ya);
+                const AF1 *rowB = (const AF1*)chain.Row(level + 1, slice, yb);
+                AF1 *row = (AF1*)chain.Row(level, slice, y);
+                for (AU1 x = 0; x < chain.Width(level); x++)
+                {
+                    AU1 xa, xb;
+                    AF1 wx;
+                    SpdCpuUpsampleTaps(x, coarseWidth, xa, xb, wx);
+                    AF1 coarse[4];
+                    for (AU1 c = 0; c < 4; c++)
+                    {
+                        AF1 top = rowA[xa * 4 + c] * wx + rowA[xb * 4 + c] * (1.0f - wx);
+                        AF1 bottom = rowB[xa * 4 + c] * wx + rowB[xb * 4 + c] * (1.0f - wx);
+                        coarse[c] = top * wy + bottom * (1.0f - wy);
+                    }
+                    combine(row + x * 4, row + x * 4, coarse, mip);
+                }
+            }
+        }
+    }
+    return true;
+}
+
+//==============================================================================================================================
+//                                                     AUTOTUNING
+//==============================================================================================================================
+// Downsamples the whole chain iterations times and returns the fastest run in milliseconds, after one warm up run.
+// Level 0 has to be filled already, all other levels get overwritten.
+A_STATIC double SpdCpuBenchmark(SpdMipChain &chain, const SpdCpuConfig &config, AU1 iterations)
+{
+    SpdPlan plan = SpdCreatePlan(chain.Width(0), chain.Height(0), chain.SliceCount(), ASU1(chain.LevelCount() - 1),
+        AU1(chain.Layout().format), config.tileSize);
+    SpdDownsampleCpu(chain, plan, config);
+
+    double time = 0.0;
+    for (AU1 iteration = 0; iteration < AMaxU1(iterations, 1); iteration++)
+    {
+        auto start = std::chrono::high_resolution_clock::now();
+        SpdDownsampleCpu(chain, plan, config);
+        auto end = std::chrono::high_resolution_clock::now();
+        double t = std::chrono::duration<double, std::milli>(end - start).count();
+        time = (iteration == 0 || t < time) ? t : time;
+    }
+    return time;
+}
+
+// Fills level 0 of every slice with noise, so no reduction can take a shortcut on uniform data
+A_STATIC void SpdCpuFillNoise(SpdMipChain &chain)
+{
+    AU1 texelSize = SpdCpuFormatTexelSize(chain.Layout().format);
+    AU1 seed = 0x12345678u;
+    for (AU1 slice = 0; slice < chain.SliceCount(); slice++)
+        for (AU1 y = 0; y < chain.Height(0); y++)
+        {
+            AB1 *row = chain.Row(0, slice, y);
+            for (AU1 x = 0; x < chain.Width(0) * (texelSize >= 8 ? texelSize / 4 : texelSize); x++)
+            {
+                seed = seed * 1664525u + 1013904223u;
+                if (texelSize >= 8)
+                    ((AF1*)row)[x] = AF1(seed >> 8) * (1.0f / 16777216.0f);
+                else
+                    row[x] = AB1(seed >> 24);
+            }
+        }
+}
+
+// Frame time of every ISA on a width x height noise image of format, 4K UHD by default, e.g. to check that a camera
+// pipeline keeps up with its frame rate. Each ISA computes all levels single threaded, milliseconds receives the best
+// time per SpdCpuIsa (0 if not supported by this CPU). Returns the fastest ISA, Scalar if the chain can't be allocated.
+A_STATIC SpdCpuIsa SpdCpuBenchmarkIsa(SpdCpuFormat format, AU1 iterations, double *milliseconds = nullptr,
+    AU1 width = 3840, AU1 height = 2160)
+{
+    SpdCpuConfig config = SpdCpuDefaultConfig();
+    SpdCpuIsa bestIsa = SpdCpuIsa::Scalar;
+    double bestTime = 0.0;
+    SpdMipChain chain;
+    bool allocated = chain.Init(SpdComputeMipChainLayout(width, height, 1, SPD_CPU_ALL_LEVELS, format));
+    if (allocated)
+        SpdCpuFillNoise(chain);
+    for (AU1 i = 0; i < SPD_CPU_ISA_COUNT; i++)
+    {
+        config.isa = SpdCpuIsa(i);
+        double time = (allocated && SpdCpuIsaSupported(config.isa)) ? SpdCpuBenchmark(chain, config, iterations) : 0.0;
+        if (milliseconds)
+            milliseconds[i] = time;
+        if (time > 0.0 && (bestTime == 0.0 || time < bestTime))
+        {
+            bestTime = time;
+            bestIsa = config.isa;
+        }
+    }
+    return bestIsa;
+}
+
+// Downsamples the whole chain with every supported tile size and returns the fastest one.
+// Taking the best of several runs keeps a noisy neighbour from skewing the result. Meant for setup time, not per frame.
+// milliseconds: optional, receives the best time per tile size (SPD_CPU_MIN_TILE_SIZE << i)
+A_STATIC AU1 SpdCpuBenchmarkTileSize(SpdMipChain &chain, AU1 iterations, double *milliseconds = nullptr)
+{
+    SpdCpuConfig config = SpdCpuDefaultConfig();
+    AU1 bestTileSize = SPD_TILE_SIZE;
+    double bestTime = 0.0;
+    for (AU1 i = 0; i < SPD_CPU_TILE_SIZE_COUNT; i++)
+    {
+        config.tileSize = SPD_CPU_MIN_TILE_SIZE << i;
+        double time = SpdCpuBenchmark(chain, config, iterations);
+        if (milliseconds)
+            milliseconds[i] = time;
+        if (i == 0 || time < bestTime)
+        {
+            bestTime = time;
+            bestTileSize = config.tileSize;
+        }
+    }
+    return bestTileSize;
+}
+
+// Summed area table of a width x height RGBA32F noise image with config, single pass (SpdCpuSummedAreaTable()) against
+// the two pass baseline (SpdCpuSummedAreaTableTwoPass()), 4K UHD by default. milliseconds receives the best time of
+// each, single pass first. Returns false if the images can't be allocated.
+A_STATIC bool SpdCpuBenchmarkSummedAreaTable(const SpdCpuConfig &config, AU1 iterations, double *milliseconds,
+    AU1 width = 3840, AU1 height = 2160)
+{
+    SpdMipChain source;
+    SpdMipChain table;
+    SpdMipChainLayout layout = SpdComputeMipChainLayout(width, height, 1, 1, SpdCpuFormat::RGBA32F);
+    if (!source.Init(layout) || !table.Init(layout))
+        return false;
+    SpdCpuFillNoise(source);
+    for (AU1 pass = 0; pass < 2; pass++)
+    {
+        bool (*run)(const SpdMipChain&, SpdMipChain&, const SpdCpuConfig&) = SpdCpuSummedAreaTable;
+        if (pass == 1)
+            run = SpdCpuSummedAreaTableTwoPass;
+        run(source, table, config);
+        for (AU1 iteration = 0; iteration < AMaxU1(iterations, 1); iteration++)
+        {
+            auto start = std::chrono::high_resolution_clock::now();
+            run(source, table, config);
+            auto end = std::chrono::high_resolution_clock::now();
+            double t = std::chrono::duration<double, std::milli>(end - start).count();
+            milliseconds[pass] = (iteration == 0 || t < milliseconds[pass]) ? t : milliseconds[pass];
+        }
+    }
+    return true;
+}
+
+// CPU brand string, e.g. "AMD Ryzen 9 5950X 16-Core Processor", "unknown" if not available
+A_STATIC void SpdCpuGetModelName(char *name, AU1 size)
+{
+    char brand[49] = {};
+#if defined(SPD_CPU_SIMD) && defined(A_GCC)
+    unsigned int info[4];
+    if (__get_cpuid_max(0x80000000u, nullptr) >= 0x80000004u)
+        for (AU1 i = 0; i < 3; i++)
+        {
+            __get_cpuid(0x80000002u + i, &info[0], &info[1], &info[2], &info[3]);
+            memcpy(brand + i * 16, info, 16);
+        }
+#elif defined(SPD_CPU_SIMD)
+    int info[4];
+    __cpuid(info, 0x80000000);
+    if (AU1(info[0]) >= 0x80000004u)
+        for (AU1 i = 0; i < 3; i++)
+        {
+            __cpuid(info, 0x80000002 + i);
+            memcpy(brand + i * 16, info, 16);
+        }
+#endif
+    const char *begin = brand;
+    while (*begin == ' ')
+        begin++;
+    snprintf(name, size, "%s", *begin ? begin : "unknown");
+}
+
+// Cache file: one line per CPU model and format, "format isa threadCount tileSize traversal model"
+A_STATIC bool SpdCpuLoadConfig(const char *path, SpdCpuFormat format, SpdCpuConfig &config)
+{
+    FILE *file = fopen(path, "r");
+    if (!file)
+        return false;
+
+    char model[64];
+    SpdCpuGetModelName(model, sizeof(model));
+    char line[256];
+    bool found = false;
+    while (!found && fgets(line, sizeof(line), file))
+    {
+        unsigned int entry[5];
+        int length = 0;
+        if (sscanf(line, "%u %u %u %u %u %n", &entry[0], &entry[1], &entry[2], &entry[3], &entry[4], &length) != 5)
+            continue;
+        line[strcspn(line, "\r\n")] = 0;
+        if (entry[0] != AU1(format) || strcmp(line + length, model) != 0)
+            continue;
+        if (entry[1] >= SPD_CPU_ISA_COUNT || entry[4] >= SPD_CPU_TRAVERSAL_COUNT || !SpdCpuIsaSupported(SpdCpuIsa(entry[1])))
+            continue;
+        // the file can be edited by hand, only take thread counts and tile sizes the engine supports
+        bool tileSize = false;
+        for (AU1 i = 0; i < SPD_CPU_TILE_SIZE_COUNT; i++)
+            tileSize = tileSize || entry[3] == (AU1(SPD_CPU_MIN_TILE_SIZE) << i);
+        if (!tileSize || entry[2] < 1 || entry[2] > SPD_CPU_MAX_THREADS)
+            continue;
+        config = SpdCpuConfig{ SpdCpuIsa(entry[1]), entry[2], entry[3], SpdCpuTraversal(entry[4]) };
+        found = true;
+    }
+    fclose(file);
+    return found;
+}
+
+// Replaces the entry of this CPU model and format, other entries are kept so the file can be shared between machines
+A_STATIC bool SpdCpuSaveConfig(const char *path, SpdCpuFormat format, const SpdCpuConfig &config)
+{
+    char model[64];
+    SpdCpuGetModelName(model, sizeof(model));
+    // unique per process and call, several machines may autotune against one shared cache file
+#ifdef _WIN32
+    unsigned long process = GetCurrentProcessId();
+#else
+    unsigned long process = (unsigned long)getpid();
+#endif
+    char tempPath[1024];
+    snprintf(tempPath, sizeof(tempPath), "%s.%lx.%llx.tmp", path, process,
+        (unsigned long long)std::chrono::system_clock::now().time_since_epoch().count());
+
+    FILE *out = fopen(tempPath, "w");
+    if (!out)
+        return false;
+    FILE *in = fopen(path, "r");
+    if (in)
+    {
+        char line[256];
+        while (fgets(line, sizeof(line), in))
+        {
+            unsigned int entry[5];
+            int length = 0;
+            if (sscanf(line, "%u %u %u %u %u %n", &entry[0], &entry[1], &entry[2], &entry[3], &entry[4], &length) != 5)
+                continue;
+            char entryModel[256];
+            snprintf(entryModel, sizeof(entryModel), "%s", line + length);
+            entryModel[strcspn(entryModel, "\r\n")] = 0;
+            if (entry[0] == AU1(format) && strcmp(entryModel, model) == 0)
+                continue;
+            fputs(line, out);
+        }
+        fclose(in);
+    }
+    fprintf(out, "%u %u %u %u %u %s\n", AU1(format), AU1(config.isa), config.threadCount, config.tileSize,
+        AU1(config.traversal), model);
+    bool written = fclose(out) == 0;
+
+    // readers see either the old or the new file
+#ifdef _WIN32
+    written = written && MoveFileExA(tempPath, path, MOVEFILE_REPLACE_EXISTING);
+#else
+    written = written && rename(tempPath, path) == 0;
+#endif
+    if (!written)
+        remove(tempPath);
+    return written;
+}
+
+// Returns the fastest configuration for format on this machine.
+// On a cache hit in cachePath the stored configuration is returned right away. Otherwise ISA, thread count, tile size and
+// traversal order are tuned one after the other (each keeps the winners of the previous ones) on a synthetic
+// width x height image, and the result is written back. cachePath may be nullptr to always benchmark.
+A_STATIC SpdCpuConfig SpdCpuAutotune(SpdCpuFormat format, const char *cachePath, AU1 width = 2048, AU1 height = 2048,
+    AU1 iterations = 4)
+{
+    SpdCpuConfig best = SpdCpuDefaultConfig();
+    if (cachePath && SpdCpuLoadConfig(cachePath, format, best))
+        return best;
+
+    SpdMipChain chain;
+    if (!chain.Init(SpdComputeMipChainLayout(width, height, 1, SPD_CPU_ALL_LEVELS, format)))
+        return best;
+    SpdCpuFillNoise(chain);
+
+    double bestTime = SpdCpuBenchmark(chain, best, iterations);
+    SpdCpuConfig candidate = best;
+    auto tryCandidate = [&]()
+    {
+        double time = SpdCpuBenchmark(chain, candidate, iterations);
+        if (time < bestTime)
+        {
+            bestTime = time;
+            best = candidate;
+        }
+        candidate = best;
+    };
+
+    for (AU1 isa = 0; isa < SPD_CPU_ISA_COUNT; isa++)
+    {
+        candidate.isa = SpdCpuIsa(isa);
+        if (SpdCpuIsaSupported(candidate.isa))
+            tryCandidate();
+    }
+    AU1 hardwareThreads = AMinU1(AMaxU1(std::thread::hardware_concurrency(), 1), SPD_CPU_MAX_THREADS);
+    for (AU1 threads = 2; threads < hardwareThreads * 2; threads *= 2)
+    {
+        candidate.threadCount = AMinU1(threads, hardwareThreads);
+        tryCandidate();
+    }
+    for (AU1 i = 0; i < SPD_CPU_TILE_SIZE_COUNT; i++)
+    {
+        candidate.tileSize = SPD_CPU_MIN_TILE_SIZE << i;
+        tryCandidate();
+    }
+    for (AU1 traversal = 0; traversal < SPD_CPU_TRAVERSAL_COUNT; traversal++)
+    {
+        candidate.traversal = SpdCpuTraversal(traversal);
+        tryCandidate();
+    }
+
+    if (cachePath)
+        SpdCpuSaveConfig(cachePath, format, best);
+    return best;
+}
+
+//==============================================================================================================================
+//                                                     MIP CHAIN CACHE
+//==============================================================================================================================
+// Content addressed cache of finished mip chains, e.g. for an asset cooker that runs over the same textures again and
+// again. SpdMipChainCache::Downsample() hashes level 0 of the chain with the TILE HASH kernels and looks for a blob with
+// the same source hash, size, format, mode, mips and tile size in the cache directory. On a hit the blob is memory mapped
+// and the returned SpdMipChainView points into it, nothing is computed or copied. On a miss the chain is downsampled, the
+// arena is written to the directory as it is laid out in memory and the view points into the chain.
+// The directory is kept below a size limit by deleting the least recently used blobs. The last use is the modification
+// time of the blob, so the order carries over to the next run. Only plans that cover the whole image are cached.
+// Blobs are written to a temporary file first and renamed, several cookers can share a directory. Temporary files a
+// crashed writer left behind are deleted by Open() once they are older than SPD_CPU_CACHE_STALE_SECONDS.
+// A blob is only used if its layout is the one of the chain, so a corrupted blob or one of another build is a miss.
+#define SPD_CPU_CACHE_MAGIC 0x43445053u // "SPDC"
+#define SPD_CPU_CACHE_VERSION 1u
+#define SPD_CPU_CACHE_MAX_PATH 1024
+#define SPD_CPU_CACHE_STALE_SECONDS 3600
+
+// Reduction of the cached levels, selects the SpdDownsampleCpu variant run on a miss
+enum class SpdCpuCacheMode : AU1
+{
+    Downsample,    // SpdDownsampleCpu()
+    AlphaCoverage, // SpdDownsampleCpuAlphaCoverage(), the parameter is the alpha cutoff
+    Bloom,         // SpdDownsampleCpuBloom()
+    BloomKaris,    // SpdDownsampleCpuBloom() with the Karis average
+    Gaussian,      // SpdDownsampleCpuGaussian() without Laplacian levels
+};
+
+struct SpdCpuCacheKey
+{
+    AL1 sourceHash; // of level 0 of every slice
+    AU1 width;
+    AU1 height;
+    AU1 slices;
+    AU1 format;
+    AU1 mode;
+    AU1 parameter; // bits of the AF1 parameter of the mode, 0 if it has none
+    AU1 mips;
+    AU1 tileSize;
+};
+
+struct SpdCpuCacheHeader
+{
+    AU1 magic;
+    AU1 version;
+    SpdCpuCacheKey key;
+    SpdMipChainLayout layout; // the arena follows at SpdCpuCacheDataOffset()
+};
+
+struct SpdCpuCacheStats
+{
+    AL1 hits;
+    AL1 misses;
+    AL1 stores;    // blobs written
+    AL1 evictions; // blobs deleted to stay below the size limit
+    AL1 bytes;     // size of all blobs in the directory
+    AU1 blobs;
+};
+
+A_STATIC double SpdCpuCacheHitRate(const SpdCpuCacheStats &stats)
+{
+    AL1 lookups = stats.hits + stats.misses;
+    return lookups ? double(stats.hits) / double(lookups) : 0.0;
+}
+
+A_STATIC bool SpdCpuSameLayout(const SpdMipChainLayout &a, const SpdMipChainLayout &b)
+{
+    if (a.levelCount != b.levelCount || a.slices != b.slices || a.texelSize != b.texelSize || a.format != b.format ||
+        a.slicePitch != b.slicePitch || a.size != b.size || a.levelCount > SPD_CPU_MAX_LEVELS)
+        return false;
+    for (AU1 i = 0; i < a.levelCount; i++)
+        if (a.levels[i].width != b.levels[i].width || a.levels[i].height != b.levels[i].height ||
+            a.levels[i].rowPitch != b.levels[i].rowPitch || a.levels[i].offset != b.levels[i].offset)
+            return false;
+    return true;
+}
+
+A_STATIC constexpr AL1 SpdCpuCacheDataOffset()
+{
+    return SpdCpuAlignUp(sizeof(SpdCpuCacheHeader), SPD_CPU_ALIGNMENT);
+}
+
+// Wall clock time in nanoseconds, the unit of the last use of a blob
+A_STATIC AL1 SpdCpuCacheNow()
+{
+    return AL1(std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::system_clock::now().time_since_epoch()).count());
+}
+
+// Maps the whole file read only, returns nullptr if that fails
+A_STATIC const AB1 *SpdCpuMapFile(const char *path, AL1 &size)
+{
+#ifdef _WIN32
+    HANDLE file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_DELETE, NULL, OPEN_EXISTING,
+        FILE_ATTRIBUTE_NORMAL, NULL);
+    if (file == INVALID_HANDLE_VALUE)
+        return nullptr;
+    LARGE_INTEGER fileSize;
+    HANDLE mapping = NULL;
+    if (GetFileSizeEx(file, &fileSize) && fileSize.QuadPart > 0)
+        mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+    CloseHandle(file);
+    if (mapping == NULL)
+        return nullptr;
+    void *pData = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+    CloseHandle(mapping);
+    size = AL1(fileSize.QuadPart);
+    return (const AB1*)pData;
+#else
+    int file = open(path, O_RDONLY);
+    if (file < 0)
+        return nullptr;
+    struct stat info;
+    void *pData = MAP_FAILED;
+    if (fstat(file, &info) == 0 && info.st_size > 0)
+        pData = mmap(NULL, size_t(info.st_size), PROT_READ, MAP_SHARED, file, 0);
+    close(file);
+    if (pData == MAP_FAILED)
+        return nullptr;
+    size = AL1(info.st_size);
+    return (const AB1*)pData;
+#endif
+}
+
+A_STATIC void SpdCpuUnmapFile(const AB1 *pData, AL1 size)
+{
+#ifdef _WIN32
+    (void)size;
+    UnmapViewOfFile(pData);
+#else
+    munmap((void*)pData, size_t(size));
+#endif
+}
+
+// Sets the modification time of the file to now
+A_STATIC void SpdCpuTouchFile(const char *path)
+{
+#ifdef _WIN32
+    HANDLE file = CreateFileA(path, FILE_WRITE_ATTRIBUTES, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE, NULL,
+        OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (file == INVALID_HANDLE_VALUE)
+        return;
+    FILETIME now;
+    GetSystemTimeAsFileTime(&now);
+    SetFileTime(file, NULL, NULL, &now);
+    CloseHandle(file);
+#else
+    utimensat(AT_FDCWD, path, NULL, 0);
+#endif
+}
+
+// Read only levels of a mip chain, either mapped from a cache blob or pointing into a SpdMipChain
+class SpdMipChainView
+{
+public:
+    SpdMipChainView() {}
+    ~SpdMipChainView() { Release(); }
+
+    SpdMipChainView(const SpdMipChainView&) = delete;
+    SpdMipChainView& operator=(const SpdMipChainView&) = delete;
+
+    void Release()
+    {
+        if (m_pMapping)
+            SpdCpuUnmapFile(m_pMapping, m_mappedSize);
+        m_pMapping = nullptr;
+        m_mappedSize = 0;
+        m_pData = nullptr;
+    }
+
+    const SpdMipChainLayout &Layout() const { return m_layout; }
+    AU1 LevelCount() const { return m_layout.levelCount; }
+    AU1 SliceCount() const { return m_layout.slices; }
+    AU1 Width(AU1 level) const { return m_layout.levels[level].width; }
+    AU1 Height(AU1 level) const { return m_layout.levels[level].height; }
+    AU1 RowPitch(AU1 level) const { return m_layout.levels[level].rowPitch; }
+    bool IsMapped() const { return m_pMapping != nullptr; }
+
+    const AB1 *Data() const { return m_pData; }
+    const AB1 *Level(AU1 level, AU1 slice) const
+    {
+        return m_pData + m_layout.slicePitch * slice + m_layout.levels[level].offset;
+    }
+    const AB1 *Row(AU1 level, AU1 slice, AU1 y) const
+    {
+        return Level(level, slice) + AL1(m_layout.levels[level].rowPitch) * y;
+    }
+
+    // Points the view into chain
+    void Reset(const SpdMipChain &chain)
+    {
+        Release();
+        m_layout = chain.Layout();
+        m_pData = chain.Data();
+    }
+
+    // Takes ownership of a mapped blob, the arena starts at offset
+    void Reset(const SpdMipChainLayout &layout, const AB1 *pMapping, AL1 mappedSize, AL1 offset)
+    {
+        Release();
+        m_layout = layout;
+        m_pMapping = pMapping;
+        m_mappedSize = mappedSize;
+        m_pData = pMapping + offset;
+    }
+
+private:
+    SpdMipChainLayout m_layout = {};
+    const AB1 *m_pData = nullptr;
+    const AB1 *m_pMapping = nullptr;
+    AL1 m_mappedSize = 0;
+};
+
+// Key of the levels plan computes for chain, hashes level 0 with the hash kernel of isa
+A_STATIC SpdCpuCacheKey SpdCpuMakeCacheKey(const SpdMipChain &chain, const SpdPlan &plan, SpdCpuCacheMode mode,
+    AF1 parameter, SpdCpuIsa isa = SpdCpuIsa::Scalar)
+{
+    SpdCpuHashRowFn hashRow = SpdCpuGetHashRow(isa);
+    AU1 bytes = chain.Width(0) * SpdCpuFormatTexelSize(chain.Layout().format);
+    AU1 lanes[SPD_CPU_HASH_LANES];
+    SpdCpuHashBegin(lanes);
+    for (AU1 slice = 0; slice < chain.SliceCount(); slice++)
+        for (AU1 y = 0; y < chain.Height(0); y++)
+            hashRow(lanes, chain.Row(0, slice, y), bytes);
+
+    SpdCpuCacheKey key = {};
+    key.sourceHash = SpdCpuHashEnd(lanes);
+    key.width = chain.Width(0);
+    key.height = chain.Height(0);
+    key.slices = AMinU1(plan.slices, chain.SliceCount());
+    key.format = AU1(chain.Layout().format);
+    key.mode = AU1(mode);
+    if (mode == SpdCpuCacheMode::AlphaCoverage)
+        memcpy(&key.parameter, &parameter, sizeof(AU1));
+    key.mips = AMinU1(plan.mips, chain.LevelCount() - 1);
+    key.tileSize = plan.tileSize;
+    return key;
+}
+
+class SpdMipChainCache
+{
+public:
+    SpdMipChainCache() {}
+    ~SpdMipChainCache() { delete[] m_pEntries; }
+
+    SpdMipChainCache(const SpdMipChainCache&) = delete;
+    SpdMipChainCache& operator=(const SpdMipChainCache&) = delete;
+
+    // Uses directory for the blobs, creates it if needed, and indexes the blobs already in it. maxBytes limits the size
+    // of all blobs. Returns false if the directory can't be read.
+    bool Open(const char *directory, AL1 maxBytes)
+    {
+        snprintf(m_directory, sizeof(m_directory), "%s", directory);
+        m_maxBytes = maxBytes;
+        m_entryCount = 0;
+        m_stats = SpdCpuCacheStats{};
+#ifdef _WIN32
+        CreateDirectoryA(directory, NULL);
+        char pattern[SPD_CPU_CACHE_MAX_PATH];
+        snprintf(pattern, sizeof(pattern), "%s/*", directory);
+        WIN32_FIND_DATAA data;
+        HANDLE find = FindFirstFileA(pattern, &data);
+        if (find == INVALID_HANDLE_VALUE)
+            return GetLastError() == ERROR_FILE_NOT_FOUND;
+        do
+        {
+            if (data.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY)
+                continue;
+            AL1 lastWrite = (AL1(data.ftLastWriteTime.dwHighDateTime) << 32) | data.ftLastWriteTime.dwLowDateTime;
+            AL1 size = (AL1(data.nFileSizeHigh) << 32) | data.nFileSizeLow;
+            // 100 ns ticks since 1601
+            AddFile(data.cFileName, size, (lastWrite - AL1(116444736000000000ull)) * 100);
+        } while (FindNextFileA(find, &data));
+        FindClose(find);
+#else
+        mkdir(directory, 0755);
+        DIR *dir = opendir(directory);
+        if (!dir)
+            return false;
+        while (struct dirent *entry = readdir(dir))
+        {
+            char path[SPD_CPU_CACHE_MAX_PATH];
+            snprintf(path, sizeof(path), "%s/%s", directory, entry->d_name);
+            struct stat info;
+            if (stat(path, &info) != 0 || !S_ISREG(info.st_mode))
+                continue;
+    #ifdef __APPLE__
+            const struct timespec &lastWrite = info.st_mtimespec;
+    #else
+            const struct timespec &lastWrite = info.st_mtim;
+    #endif
+            AddFile(entry->d_name, AL1(info.st_size), AL1(lastWrite.tv_sec) * 1000000000ull + AL1(lastWrite.tv_nsec));
+        }
+        closedir(dir);
+#endif
+        Evict(0);
+        return true;
+    }
+
+    // Maps the blob of key into view if it has the expected layout, returns false on a miss
+    bool Find(const SpdCpuCacheKey &key, const SpdMipChainLayout &layout, SpdMipChainView &view)
+    {
+        AL1 name = BlobName(key);
+        char path[SPD_CPU_CACHE_MAX_PATH];
+        BlobPath(name, path);
+        AL1 size = 0;
+        const AB1 *pMapping = SpdCpuMapFile(path, size);
+        SpdCpuCacheHeader header;
+        bool valid = pMapping && size >= SpdCpuCacheDataOffset();
+        if (valid)
+        {
+            memcpy(&header, pMapping, sizeof(header));
+            valid = header.magic == SPD_CPU_CACHE_MAGIC && header.version == SPD_CPU_CACHE_VERSION &&
+                memcmp(&header.key, &key, sizeof(key)) == 0 && SpdCpuSameLayout(header.layout, layout) &&
+                size == SpdCpuCacheDataOffset() + layout.size;
+        }
+        if (!valid)
+        {
+            if (pMapping)
+                SpdCpuUnmapFile(pMapping, size);
+            m_stats.misses++;
+            return false;
+        }
+        view.Reset(header.layout, pMapping, size, SpdCpuCacheDataOffset());
+        SpdCpuTouchFile(path);
+        // the blob may have been written by another process since Open()
+        SpdCpuCacheEntry *entry = FindEntry(name);
+        if (entry)
+            entry->lastUse = SpdCpuCacheNow();
+        else
+            AddEntry(name, size, SpdCpuCacheNow());
+        m_stats.hits++;
+        return true;
+    }
+
+    // Writes the arena of chain as the blob of key, then evicts blobs until the size limit is met
+    bool Store(const SpdCpuCacheKey &key, const SpdMipChain &chain)
+    {
+        SpdCpuCacheHeader header = {};
+        header.magic = SPD_CPU_CACHE_MAGIC;
+        header.version = SPD_CPU_CACHE_VERSION;
+        header.key = key;
+        header.layout = chain.Layout();
+        AL1 size = SpdCpuCacheDataOffset() + header.layout.size;
+        if (size > m_maxBytes)
+            return false;
+
+        AL1 name = BlobName(key);
+        char path[SPD_CPU_CACHE_MAX_PATH];
+        char tempPath[SPD_CPU_CACHE_MAX_PATH + 32];
+        BlobPath(name, path);
+        snprintf(tempPath, sizeof(tempPath), "%s.%llx.tmp", path, (unsigned long long)SpdCpuCacheNow());
+        FILE *file = fopen(tempPath, "wb");
+        if (!file)
+            return false;
+        AB1 padding[SpdCpuCacheDataOffset()] = {};
+        memcpy(padding, &header, sizeof(header));
+        bool written = fwrite(padding, 1, sizeof(padding), file) == sizeof(padding) &&
+            fwrite(chain.Data(), 1, size_t(header.layout.size), file) == size_t(header.layout.size);
+        written = fclose(file) == 0 && written;
+#ifdef _WIN32
+        written = written && MoveFileExA(tempPath, path, MOVEFILE_REPLACE_EXISTING);
+#else
+        written = written && rename(tempPath, path) == 0;
+#endif
+        if (!written)
+        {
+            remove(tempPath);
+            return false;
+        }
+
+        RemoveEntry(name);
+        AddEntry(name, size, SpdCpuCacheNow());
+        m_stats.stores++;
+        Evict(name);
+        return true;
+    }
+
+    // Levels of chain computed as plan and mode say, from the cache if possible, see MIP CHAIN CACHE. On a miss the chain
+    // is downsampled and stored. parameter is the alpha cutoff for SpdCpuCacheMode::AlphaCoverage.
+    // Returns false if the downsample fails, e.g. if the format doesn't fit the mode.
+    bool Downsample(SpdMipChain &chain, const SpdPlan &plan, const SpdCpuConfig &config, SpdCpuCacheMode mode,
+        AF1 parameter, SpdMipChainView &view)
+    {
+        const SpdPlanRect &rect = plan.dispatches[0].rect;
+        bool wholeImage = plan.rectCount == 1 && rect.left == 0 && rect.top == 0 && rect.width == chain.Width(0) &&
+            rect.height == chain.Height(0);
+        SpdCpuCacheKey key = {};
+        if (wholeImage)
+        {
+            key = SpdCpuMakeCacheKey(chain, plan, mode, parameter, config.isa);
+            if (Find(key, chain.Layout(), view))
+                return true;
+        }
+
+        bool computed = true;
+        switch (mode)
+        {
+        case SpdCpuCacheMode::Downsample:
+            SpdDownsampleCpu(chain, plan, config);
+            break;
+        case SpdCpuCacheMode::AlphaCoverage:
+            computed = SpdDownsampleCpuAlphaCoverage(chain, plan, config, parameter);
+            break;
+        case SpdCpuCacheMode::Bloom:
+        case SpdCpuCacheMode::BloomKaris:
+            computed = SpdDownsampleCpuBloom(chain, plan, config, mode == SpdCpuCacheMode::BloomKaris);
+            break;
+        case SpdCpuCacheMode::Gaussian:
+            computed = SpdDownsampleCpuGaussian(chain, plan, config);
+            break;
+        }
+        if (!computed)
+            return false;
+        if (wholeImage)
+            Store(key, chain);
+        view.Reset(chain);
+        return true;
+    }
+
+    bool Downsample(SpdMipChain &chain, AU1 mips, SpdMipChainView &view)
+    {
+        SpdPlan plan = SpdCreatePlan(chain.Width(0), chain.Height(0), chain.SliceCount(), ASU1(mips),
+            AU1(chain.Layout().format), SPD_TILE_SIZE);
+        return Downsample(chain, plan, SpdCpuDefaultConfig(), SpdCpuCacheMode::Downsample, 0.0f, view);
+    }
+
+    const SpdCpuCacheStats &Stats() const { return m_stats; }
+
+private:
+    struct SpdCpuCacheEntry
+    {
+        AL1 name;
+        AL1 size;
+        AL1 lastUse; // nanoseconds since the epoch
+    };
+
+    // Blobs are named after the hash of their key, the header holds the whole key
+    static AL1 BlobName(const SpdCpuCacheKey &key)
+    {
+        AU1 lanes[SPD_CPU_HASH_LANES];
+        SpdCpuHashBegin(lanes);
+        SpdCpuHashRow(lanes, (const AB1*)&key, sizeof(key));
+        return SpdCpuHashEnd(lanes);
+    }
+
+    void BlobPath(AL1 name, char *path) const
+    {
+        snprintf(path, SPD_CPU_CACHE_MAX_PATH, "%s/%016llx.spdmip", m_directory, (unsigned long long)name);
+    }
+
+    // Indexes a file found in the directory if it is a blob, deletes it if it is a stale temporary file
+    void AddFile(const char *fileName, AL1 size, AL1 lastUse)
+    {
+        char *end = nullptr;
+        AL1 name = AL1(strtoull(fileName, &end, 16));
+        if (end == fileName + 16 && strcmp(end, ".spdmip") == 0)
+        {
+            AddEntry(name, size, lastUse);
+            return;
+        }
+        size_t length = strlen(fileName);
+        AL1 now = SpdCpuCacheNow();
+        if (end == fileName + 16 && length > 4 && strcmp(fileName + length - 4, ".tmp") == 0 &&
+            now > lastUse && now - lastUse > AL1(SPD_CPU_CACHE_STALE_SECONDS) * 1000000000ull)
+        {
+            char path[SPD_CPU_CACHE_MAX_PATH];
+            snprintf(path, sizeof(path), "%s/%s", m_directory, fileName);
+            remove(path);
+        }
+    }
+
+    SpdCpuCacheEntry *FindEntry(AL1 name)
+    {
+        for (AU1 i = 0; i < m_entryCount; i++)
+            if (m_pEntries[i].name == name)
+                return &m_pEntries[i];
+        return nullptr;
+    }
+
+    void AddEntry(AL1 name, AL1 size, AL1 lastUse)
+    {
+        if (m_entryCount == m_entryCapacity)
+        {
+            AU1 capacity = AMaxU1(m_entryCapacity * 2, 64);
+            SpdCpuCacheEntry *pEntries = new (std::nothrow) SpdCpuCacheEntry[capacity];
+            if (!pEntries)
+                return;
+            if (m_entryCount)
+                memcpy(pEntries, m_pEntries, m_entryCount * sizeof(SpdCpuCacheEntry));
+            delete[] m_pEntries;
+            m_pEntries = pEntries;
+            m_entryCapacity = capacity;
+        }
+        m_pEntries[m_entryCount++] = SpdCpuCacheEntry{ name, size, lastUse };
+        m_stats.bytes += size;
+        m_stats.blobs = m_entryCount;
+    }
+
+    void RemoveEntry(AL1 name)
+    {
+        SpdCpuCacheEntry *entry = FindEntry(name);
+        if (!entry)
+            return;
+        m_stats.bytes -= entry->size;
+        *entry = m_pEntries[--m_entryCount];
+        m_stats.blobs = m_entryCount;
+    }
+
+    // Deletes the least recently used blobs until they fit in the size limit, keep is never deleted.
+    // Blobs that can't be deleted, e.g. because another process maps them on Windows, are dropped from the index.
+    void Evict(AL1 keep)
+    {
+        while (m_stats.bytes > m_maxBytes)
+        {
+            SpdCpuCacheEntry *oldest = nullptr;
+            for (AU1 i = 0; i < m_entryCount; i++)
+                if (m_pEntries[i].name != keep && (!oldest || m_pEntries[i].lastUse < oldest->lastUse))
+                    oldest = &m_pEntries[i];
+            if (!oldest)
+                break;
+            char path[SPD_CPU_CACHE_MAX_PATH];
+            BlobPath(oldest->name, path);
+            if (remove(path) == 0)
+                m_stats.evictions++;
+            RemoveEntry(oldest->name);
+        }
+    }
+
+    char m_directory[SPD_CPU_CACHE_MAX_PATH - 32] = {}; // room for the blob names
+    AL1 m_maxBytes = 0;
+    SpdCpuCacheEntry *m_pEntries = nullptr;
+    AU1 m_entryCount = 0;
+    AU1 m_entryCapacity = 0;
+    SpdCpuCacheStats m_stats = {};
+};
+
+#endif // #ifdef A_CPU
+#endif // #ifndef FFX_SPD_CPU_H
@@ -42,7 +42,8 @@ namespace CAULDRON_DX12
         DynamicBufferRing *pConstantBufferRing,
         SPDLoad spdLoad,
         SPDWaveOps spdWaveOps,
-        SPDPacked spdPacked
+        SPDPacked spdPacked,
+        SPDReduction spdReduction
     )
     {
         m_pDevice = pDevice;
@@ -52,6 +53,7 @@ namespace CAULDRON_DX12
         m_spdLoad = spdLoad;
         m_spdWaveOps = spdWaveOps;
         m_spdPacked = spdPacked;
+        m_spdReduction = spdReduction;
 
         D3D12_SHADER_BYTECODE shaderByteCode = {};
         DefineList defines;
@@ -63,6 +65,9 @@ namespace CAULDRON_DX12
             defines["A_HALF"] = 1;
             defines["SPD_PACKED_ONLY"] = 1;
         }
+        if (m_spdReduction == SPDReduction::SPDKarisAverage) {
+            defines["SPD_KARIS_AVERAGE"] = 1;
+        }
 
         if (m_spdLoad == SPDLoad::SPDLinearSampler)
         {
@@ -221,6 +226,9 @@ namespace CAULDRON_DX12
         m_cubeTexture.InitFromFile(pDevice, pUploadHeap, "..\\media\\envmaps\\papermill\\specular.dds", true, 1.0f, D3D12_RESOURCE_FLAG_ALLOW_UNORDERED_ACCESS);
         pUploadHeap->FlushAndFinish();
 
+        // dispatch size and constants only depend on the texture, compute them once instead of on every Draw
+        m_pPlan = new SpdPlan(SpdCreatePlan(m_cubeTexture.GetWidth(), m_cubeTexture.GetHeight(), m_cubeTexture.GetArraySize()));
+
         // Allocate descriptors for the mip chain
         //
         m_pResourceViewHeaps->AllocCBV_SRV_UAVDescriptor(1, &m_constBuffer);
@@ -275,7 +283,7 @@ namespace CAULDRON_DX12
 
         m_pResourceViewHeaps->AllocCBV_SRV_UAVDescriptor(1, &m_globalCounter);
         m_globalCounterBuffer.InitBuffer(m_pDevice, "SPD_CS::m_globalCounterBuffer",
-            &CD3DX12_RESOURCE_DESC::Buffer(sizeof(uint32_t) * m_cubeTexture.GetArraySize(), // 6 slices
+            &CD3DX12_RESOURCE_DESC::Buffer(m_pPlan->counterBufferSize, // one counter per slice
                 D3D12_RESOURCE_FLAG_ALLOW_UNORDERED_ACCESS),
             sizeof(uint32_t), D3D12_RESOURCE_STATE_UNORDERED_ACCESS);
         m_globalCounterBuffer.CreateBufferUAV(0, NULL, &m_globalCounter);
@@ -297,47 +305,15 @@ namespace CAULDRON_DX12
             m_pRootSignature->Release();
             m_pRootSignature = NULL;
         }
+
+        delete m_pPlan;
+        m_pPlan = nullptr;
     }
 
     void SPDCS::Draw(ID3D12GraphicsCommandList2 *pCommandList)
     {
         UserMarker marker(pCommandList, "SPDCS");
 
-        varAU2(dispatchThreadGroupCountXY);
-        varAU2(workGroupOffset); // needed if Left and Top are not 0,0
-        varAU2(numWorkGroupsAndMips);
-        varAU4(rectInfo) = initAU4(0, 0, m_cubeTexture.GetWidth(), m_cubeTexture.GetHeight()); // left, top, width, height
-        SpdSetup(dispatchThreadGroupCountXY, workGroupOffset, numWorkGroupsAndMips, rectInfo);
-
-        // downsample
-        uint32_t dispatchX = dispatchThreadGroupCountXY[0];
-        uint32_t dispatchY = dispatchThreadGroupCountXY[1];
-        uint32_t dispatchZ = m_cubeTexture.GetArraySize();
-
-        D3D12_GPU_VIRTUAL_ADDRESS cbHandle;
-        uint32_t* pConstMem;
-        if (m_spdLoad == SPDLoad::SPDLinearSampler)
-        {
-            m_pConstantBufferRing->AllocConstantBuffer(sizeof(SpdLinearSamplerConstants), (void**)&pConstMem, &cbHandle);
-            SpdLinearSamplerConstants constants;
-            constants.numWorkGroupsPerSlice = numWorkGroupsAndMips[0];
-            constants.mips = numWorkGroupsAndMips[1];
-            constants.workGroupOffset[0] = workGroupOffset[0];
-            constants.workGroupOffset[1] = workGroupOffset[1];
-            constants.invInputSize[0] = 1.0f / m_cubeTexture.GetWidth();
-            constants.invInputSize[1] = 1.0f / m_cubeTexture.GetHeight();
-            memcpy(pConstMem, &constants, sizeof(SpdLinearSamplerConstants));
-        }
-        else {
-            m_pConstantBufferRing->AllocConstantBuffer(sizeof(SpdConstants), (void**)&pConstMem, &cbHandle);
-            SpdConstants constants;
-            constants.numWorkGroupsPerSlice = numWorkGroupsAndMips[0];
-            constants.mips = numWorkGroupsAndMips[1];
-            constants.workGroupOffset[0] = workGroupOffset[0];
-            constants.workGroupOffset[1] = workGroupOffset[1];
-            memcpy(pConstMem, &constants, sizeof(SpdConstants));
-        }
-
         // Bind Descriptor heaps and the root signature
         //                
         ID3D12DescriptorHeap *pDescriptorHeaps[] = { m_pResourceViewHeaps->GetCBV_SRV_UAVHeap(), m_pResourceViewHeaps->GetSamplerHeap() };
@@ -346,8 +322,7 @@ namespace CAULDRON_DX12
 
         // Bind Descriptor the descriptor sets
         //                
-        int params = 0;
-        pCommandList->SetComputeRootConstantBufferView(params++, cbHandle);
+        int params = 1; // root constant buffer is bound per dispatch
         pCommandList->SetComputeRootDescriptorTable(params++, m_globalCounter.GetGPU());
         if (m_spdLoad == SPDLoad::SPDLinearSampler)
         {
@@ -383,9 +358,44 @@ namespace CAULDRON_DX12
         };
         pCommandList->ResourceBarrier(2, resourceBarriers);
 
-        // Dispatch
+        // Dispatch, one per rectangle of the plan
         //
-        pCommandList->Dispatch(dispatchX, dispatchY, dispatchZ);
+        for (AU1 i = 0; i < m_pPlan->rectCount; i++)
+        {
+            const SpdPlanDispatch &dispatch = m_pPlan->dispatches[i];
+
+            D3D12_GPU_VIRTUAL_ADDRESS cbHandle;
+            uint32_t* pConstMem;
+            if (m_spdLoad == SPDLoad::SPDLinearSampler)
+            {
+                m_pConstantBufferRing->AllocConstantBuffer(sizeof(SpdLinearSamplerConstants), (void**)&pConstMem, &cbHandle);
+                SpdLinearSamplerConstants constants;
+                constants.numWorkGroupsPerSlice = dispatch.numWorkGroups;
+                constants.mips = m_pPlan->mips;
+                constants.workGroupOffset[0] = dispatch.workGroupOffset[0];
+                constants.workGroupOffset[1] = dispatch.workGroupOffset[1];
+                constants.invInputSize[0] = 1.0f / m_pPlan->width;
+                constants.invInputSize[1] = 1.0f / m_pPlan->height;
+                memcpy(pConstMem, &constants, sizeof(SpdLinearSamplerConstants));
+            }
+            else {
+                m_pConstantBufferRing->AllocConstantBuffer(sizeof(SpdConstants), (void**)&pConstMem, &cbHandle);
+                SpdConstants constants;
+                constants.numWorkGroupsPerSlice = dispatch.numWorkGroups;
+                constants.mips = m_pPlan->mips;
+                constants.workGroupOffset[0] = dispatch.workGroupOffset[0];
+                constants.workGroupOffset[1] = dispatch.workGroupOffset[1];
+                memcpy(pConstMem, &constants, sizeof(SpdConstants));
+            }
+            pCommandList->SetComputeRootConstantBufferView(0, cbHandle);
+
+            // previous rectangle writes the same tail mips and counters
+            if (i > 0)
+            {
+                pCommandList->ResourceBarrier(1, &CD3DX12_RESOURCE_BARRIER::UAV(nullptr));
+            }
+            pCommandList->Dispatch(dispatch.dispatchThreadGroupCountXY[0], dispatch.dispatchThreadGroupCountXY[1], m_pPlan->slices);
+        }
         pCommandList->ResourceBarrier(1, &CD3DX12_RESOURCE_BARRIER::Transition(m_cubeTexture.GetResource(), D3D12_RESOURCE_STATE_UNORDERED_ACCESS, D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE | D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE));
     }
 
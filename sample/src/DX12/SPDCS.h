@@ -21,6 +21,8 @@
 #include "Base/DynamicBufferRing.h"
 #include "Base/Texture.h"
 
+struct SpdPlan;
+
 namespace CAULDRON_DX12
 {
 #define SPD_MAX_MIP_LEVELS 12
@@ -43,11 +45,17 @@ namespace CAULDRON_DX12
         SPDLinearSampler,
     };
 
+    enum class SPDReduction
+    {
+        SPDAverage,
+        SPDKarisAverage,    // luminance weighted, keeps HDR fireflies from bleeding into the mips
+    };
+
     class SPDCS
     {
     public:
         void OnCreate(Device *pDevice, UploadHeap *pUploadHeap, ResourceViewHeaps *pResourceViewHeaps, DynamicBufferRing *pConstantBufferRing, 
-            SPDLoad spdLoad, SPDWaveOps spdWaveOps, SPDPacked spdPacked);
+            SPDLoad spdLoad, SPDWaveOps spdWaveOps, SPDPacked spdPacked, SPDReduction spdReduction);
         void OnDestroy();
 
         void Draw(ID3D12GraphicsCommandList2 *pCommandList);
@@ -91,5 +99,8 @@ namespace CAULDRON_DX12
         SPDLoad                       m_spdLoad;
         SPDWaveOps                    m_spdWaveOps;
         SPDPacked                     m_spdPacked;
+        SPDReduction                  m_spdReduction;
+
+        SpdPlan                      *m_pPlan = nullptr; // built once in OnCreate, reused by every Draw
     };
 }
\ No newline at end of file
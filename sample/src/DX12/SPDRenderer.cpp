@@ -540,8 +540,8 @@ void SPDRenderer::OnRender(State *pState, SwapChain *pSwapChain)
             m_CSDownsampler.GUI(&pState->downsamplerImGUISlice);
             break;
         case Downsampler::SPDCS:
-            m_SPDVersions.Dispatch(pCmdLst1, pState->spdLoad, pState->spdWaveOps, pState->spdPacked);
-            m_SPDVersions.GUI(pState->spdLoad, pState->spdWaveOps, pState->spdPacked, &pState->downsamplerImGUISlice);
+            m_SPDVersions.Dispatch(pCmdLst1, pState->spdLoad, pState->spdWaveOps, pState->spdPacked, pState->spdReduction);
+            m_SPDVersions.GUI(pState->spdLoad, pState->spdWaveOps, pState->spdPacked, pState->spdReduction, &pState->downsamplerImGUISlice);
             break;
         }
 
@@ -75,6 +75,7 @@ public:
         SPDLoad         spdLoad;
         SPDWaveOps      spdWaveOps;
         SPDPacked       spdPacked;
+        SPDReduction    spdReduction;
 
         int             downsamplerImGUISlice;
     };
@@ -42,6 +42,7 @@ void SPDSample::OnParseCommandLine(LPSTR lpCmdLine, uint32_t *pWidth, uint32_t *
     *pHeight = 1080;
     *pbFullScreen = false;
     m_state.isBenchmarking = true;
+    m_state.spdReduction = SPDReduction::SPDAverage;
     m_isCpuValidationLayerEnabled = false;
     m_isGpuValidationLayerEnabled = false;
     m_stablePowerState = false;
@@ -59,6 +60,7 @@ void SPDSample::OnParseCommandLine(LPSTR lpCmdLine, uint32_t *pWidth, uint32_t *
         m_state.spdLoad = jData.value("spdLoad", m_state.spdLoad);
         m_state.spdWaveOps = jData.value("spdWaveOps", m_state.spdWaveOps);
         m_state.spdPacked = jData.value("spdPacked", m_state.spdPacked);
+        m_state.spdReduction = jData.value("spdReduction", m_state.spdReduction);
     };
 
     //read json globals from commandline
@@ -308,6 +310,14 @@ void SPDSample::BuildUI()
             "Packed",
         };
         ImGui::Combo("SPD Non-Packed / Packed Version", (int*)&m_state.spdPacked, spdPackedItemNames, _countof(spdPackedItemNames));
+
+        // Box filter or luminance weighted (Karis) average
+        const char* spdReductionItemNames[] =
+        {
+            "Average",
+            "Karis Average",
+        };
+        ImGui::Combo("SPD Average / Karis Average", (int*)&m_state.spdReduction, spdReductionItemNames, _countof(spdReductionItemNames));
     }
 
     if (ImGui::CollapsingHeader("Lighting", ImGuiTreeNodeFlags_DefaultOpen))
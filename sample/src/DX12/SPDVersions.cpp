@@ -36,15 +36,20 @@ namespace CAULDRON_DX12
     {
         m_pDevice = pDevice;
 
-        m_spd_WaveOps_NonPacked.OnCreate(pDevice, pUploadHeap, pResourceViewHeaps, pConstantBufferRing, SPDLoad::SPDLoad, SPDWaveOps::SPDWaveOps, SPDPacked::SPDNonPacked);
-        m_spd_WaveOps_Packed.OnCreate(pDevice, pUploadHeap, pResourceViewHeaps, pConstantBufferRing, SPDLoad::SPDLoad, SPDWaveOps::SPDWaveOps, SPDPacked::SPDPacked);
-        m_spd_No_WaveOps_NonPacked.OnCreate(pDevice, pUploadHeap, pResourceViewHeaps, pConstantBufferRing, SPDLoad::SPDLoad, SPDWaveOps::SPDNoWaveOps, SPDPacked::SPDNonPacked);
-        m_spd_No_WaveOps_Packed.OnCreate(pDevice, pUploadHeap, pResourceViewHeaps, pConstantBufferRing, SPDLoad::SPDLoad, SPDWaveOps::SPDNoWaveOps, SPDPacked::SPDPacked);
-
-        m_spd_WaveOps_NonPacked_Linear_Sampler.OnCreate(pDevice, pUploadHeap, pResourceViewHeaps, pConstantBufferRing, SPDLoad::SPDLinearSampler, SPDWaveOps::SPDWaveOps, SPDPacked::SPDNonPacked);
-        m_spd_WaveOps_Packed_Linear_Sampler.OnCreate(pDevice, pUploadHeap, pResourceViewHeaps, pConstantBufferRing, SPDLoad::SPDLinearSampler, SPDWaveOps::SPDWaveOps, SPDPacked::SPDPacked);
-        m_spd_No_WaveOps_NonPacked_Linear_Sampler.OnCreate(pDevice, pUploadHeap, pResourceViewHeaps, pConstantBufferRing, SPDLoad::SPDLinearSampler, SPDWaveOps::SPDNoWaveOps, SPDPacked::SPDNonPacked);
-        m_spd_No_WaveOps_Packed_Linear_Sampler.OnCreate(pDevice, pUploadHeap, pResourceViewHeaps, pConstantBufferRing, SPDLoad::SPDLinearSampler, SPDWaveOps::SPDNoWaveOps, SPDPacked::SPDPacked);
+        for (int load = 0; load < 2; load++)
+        {
+            for (int waveOps = 0; waveOps < 2; waveOps++)
+            {
+                for (int packed = 0; packed < 2; packed++)
+                {
+                    for (int reduction = 0; reduction < 2; reduction++)
+                    {
+                        m_spd[load][waveOps][packed][reduction].OnCreate(pDevice, pUploadHeap, pResourceViewHeaps, pConstantBufferRing,
+                            (SPDLoad)load, (SPDWaveOps)waveOps, (SPDPacked)packed, (SPDReduction)reduction);
+                    }
+                }
+            }
+        }
     }
 
     uint32_t SPDVersions::GetMaxMIPLevelCount(uint32_t Width, uint32_t Height)
@@ -55,140 +60,28 @@ namespace CAULDRON_DX12
 
     void SPDVersions::OnDestroy()
     {
-        m_spd_WaveOps_NonPacked.OnDestroy();
-        m_spd_WaveOps_Packed.OnDestroy();
-        m_spd_No_WaveOps_NonPacked.OnDestroy();
-        m_spd_No_WaveOps_Packed.OnDestroy();
-
-        m_spd_WaveOps_NonPacked_Linear_Sampler.OnDestroy();
-        m_spd_WaveOps_Packed_Linear_Sampler.OnDestroy();
-        m_spd_No_WaveOps_NonPacked_Linear_Sampler.OnDestroy();
-        m_spd_No_WaveOps_Packed_Linear_Sampler.OnDestroy();
-    }
-
-    void SPDVersions::Dispatch(ID3D12GraphicsCommandList2 *pCommandList, SPDLoad spdLoad, SPDWaveOps spdWaveOps, SPDPacked spdPacked)
-    {
-        switch (spdLoad)
+        for (int load = 0; load < 2; load++)
         {
-        case SPDLoad::SPDLoad:
-        {
-            switch (spdWaveOps)
+            for (int waveOps = 0; waveOps < 2; waveOps++)
             {
-            case SPDWaveOps::SPDWaveOps:
-                switch (spdPacked)
-                {
-                case SPDPacked::SPDNonPacked:
-                    m_spd_WaveOps_NonPacked.Draw(pCommandList);
-                    break;
-                case SPDPacked::SPDPacked:
-                    m_spd_WaveOps_Packed.Draw(pCommandList);
-                    break;
-                }
-                break;
-            case SPDWaveOps::SPDNoWaveOps:
-                switch (spdPacked)
-                {
-                case SPDPacked::SPDNonPacked:
-                    m_spd_No_WaveOps_NonPacked.Draw(pCommandList);
-                    break;
-                case SPDPacked::SPDPacked:
-                    m_spd_No_WaveOps_Packed.Draw(pCommandList);
-                    break;
-                }
-            }
-            break;
-        }
-        case SPDLoad::SPDLinearSampler:
-        {
-            switch (spdWaveOps)
-            {
-            case SPDWaveOps::SPDWaveOps:
-                switch (spdPacked)
-                {
-                case SPDPacked::SPDNonPacked:
-                    m_spd_WaveOps_NonPacked_Linear_Sampler.Draw(pCommandList);
-                    break;
-                case SPDPacked::SPDPacked:
-                    m_spd_WaveOps_Packed_Linear_Sampler.Draw(pCommandList);
-                    break;
-                }
-                break;
-            case SPDWaveOps::SPDNoWaveOps:
-                switch (spdPacked)
+                for (int packed = 0; packed < 2; packed++)
                 {
-                case SPDPacked::SPDNonPacked:
-                    m_spd_No_WaveOps_NonPacked_Linear_Sampler.Draw(pCommandList);
-                    break;
-                case SPDPacked::SPDPacked:
-                    m_spd_No_WaveOps_Packed_Linear_Sampler.Draw(pCommandList);
-                    break;
+                    for (int reduction = 0; reduction < 2; reduction++)
+                    {
+                        m_spd[load][waveOps][packed][reduction].OnDestroy();
+                    }
                 }
             }
-            break;
-        }
         }
     }
 
-    void SPDVersions::GUI(SPDLoad spdLoad, SPDWaveOps spdWaveOps, SPDPacked spdPacked, int *pSlice)
+    void SPDVersions::Dispatch(ID3D12GraphicsCommandList2 *pCommandList, SPDLoad spdLoad, SPDWaveOps spdWaveOps, SPDPacked spdPacked, SPDReduction spdReduction)
     {
-        switch (spdLoad)
-        {
-        case SPDLoad::SPDLoad:
-        {
-            switch (spdWaveOps)
-            {
-            case SPDWaveOps::SPDWaveOps:
-                switch (spdPacked)
-                {
-                case SPDPacked::SPDNonPacked:
-                    m_spd_WaveOps_NonPacked.GUI(pSlice);
-                    break;
-                case SPDPacked::SPDPacked:
-                    m_spd_WaveOps_Packed.GUI(pSlice);
-                    break;
-                }
-                break;
-            case SPDWaveOps::SPDNoWaveOps:
-                switch (spdPacked)
-                {
-                case SPDPacked::SPDNonPacked:
-                    m_spd_No_WaveOps_NonPacked.GUI(pSlice);
-                    break;
-                case SPDPacked::SPDPacked:
-                    m_spd_No_WaveOps_Packed.GUI(pSlice);
-                    break;
-                }
-            }
-            break;
-        }
-        case SPDLoad::SPDLinearSampler:
-        {
-            switch (spdWaveOps)
-            {
-            case SPDWaveOps::SPDWaveOps:
-                switch (spdPacked)
-                {
-                case SPDPacked::SPDNonPacked:
-                    m_spd_WaveOps_NonPacked_Linear_Sampler.GUI(pSlice);
-                    break;
-                case SPDPacked::SPDPacked:
-                    m_spd_WaveOps_Packed_Linear_Sampler.GUI(pSlice);
-                    break;
-                }
-                break;
-            case SPDWaveOps::SPDNoWaveOps:
-                switch (spdPacked)
-                {
-                case SPDPacked::SPDNonPacked:
-                    m_spd_No_WaveOps_NonPacked_Linear_Sampler.GUI(pSlice);
-                    break;
-                case SPDPacked::SPDPacked:
-                    m_spd_No_WaveOps_Packed_Linear_Sampler.GUI(pSlice);
-                    break;
-                }
-            }
-            break;
-        }
-        }
+        GetVersion(spdLoad, spdWaveOps, spdPacked, spdReduction).Draw(pCommandList);
+    }
+
+    void SPDVersions::GUI(SPDLoad spdLoad, SPDWaveOps spdWaveOps, SPDPacked spdPacked, SPDReduction spdReduction, int *pSlice)
+    {
+        GetVersion(spdLoad, spdWaveOps, spdPacked, spdReduction).GUI(pSlice);
     }
 }
\ No newline at end of file
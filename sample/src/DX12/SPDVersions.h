@@ -33,23 +33,23 @@ namespace CAULDRON_DX12
         );
         void OnDestroy();
 
-        void Dispatch(ID3D12GraphicsCommandList2 *pCommandList, SPDLoad spdLoad, SPDWaveOps spdWaveOps, SPDPacked spdPacked);
-        void GUI(SPDLoad spdLoad, SPDWaveOps spdWaveOps, SPDPacked spdPacked, int *pSlice);
+        void Dispatch(ID3D12GraphicsCommandList2 *pCommandList, SPDLoad spdLoad, SPDWaveOps spdWaveOps, SPDPacked spdPacked, SPDReduction spdReduction);
+        void GUI(SPDLoad spdLoad, SPDWaveOps spdWaveOps, SPDPacked spdPacked, SPDReduction spdReduction, int *pSlice);
 
     private:
         Device                  *m_pDevice = nullptr;
 
-        SPDCS                    m_spd_WaveOps_NonPacked;
-        SPDCS                    m_spd_No_WaveOps_NonPacked;
+        // one permutation per load / wave ops / packed / reduction combination
+        SPDCS                    m_spd[2][2][2][2];
 
-        SPDCS                    m_spd_WaveOps_Packed;
-        SPDCS                    m_spd_No_WaveOps_Packed;
+        SPDCS &GetVersion(SPDLoad spdLoad, SPDWaveOps spdWaveOps, SPDPacked spdPacked, SPDReduction spdReduction)
+        {
+            return m_spd[PermutationIndex(spdLoad)][PermutationIndex(spdWaveOps)][PermutationIndex(spdPacked)][PermutationIndex(spdReduction)];
+        }
 
-        SPDCS                    m_spd_WaveOps_NonPacked_Linear_Sampler;
-        SPDCS                    m_spd_No_WaveOps_NonPacked_Linear_Sampler;
-
-        SPDCS                    m_spd_WaveOps_Packed_Linear_Sampler;
-        SPDCS                    m_spd_No_WaveOps_Packed_Linear_Sampler;
+        // out of range values, e.g. from the config file, select the first permutation
+        template <typename T>
+        static int PermutationIndex(T value) { return (unsigned)value < 2 ? (int)value : 0; }
 
         uint32_t GetMaxMIPLevelCount(uint32_t Width, uint32_t Height);
     };
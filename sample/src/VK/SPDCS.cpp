@@ -37,7 +37,8 @@ namespace CAULDRON_VK
         ResourceViewHeaps *pResourceViewHeaps,
         SPDLoad spdLoad,
         SPDWaveOps spdWaveOps,
-        SPDPacked spdPacked
+        SPDPacked spdPacked,
+        SPDReduction spdReduction
     )
     {
         m_pDevice = pDevice;
@@ -46,6 +47,7 @@ namespace CAULDRON_VK
         m_spdLoad = spdLoad;
         m_spdWaveOps = spdWaveOps;
         m_spdPacked = spdPacked;
+        m_spdReduction = spdReduction;
 
         uint32_t bindingCount = 3;
 
@@ -135,6 +137,9 @@ namespace CAULDRON_VK
         m_cubeTexture.InitFromFile(pDevice, pUploadHeap, "..\\media\\envmaps\\papermill\\specular.dds", true, VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_STORAGE_BIT);
         pUploadHeap->FlushAndFinish();
 
+        // dispatch size and constants only depend on the texture, compute them once instead of on every Draw
+        m_pPlan = new SpdPlan(SpdCreatePlan(m_cubeTexture.GetWidth(), m_cubeTexture.GetHeight(), m_cubeTexture.GetArraySize()));
+
         // Create global atomic counter
         {
             VkBufferCreateInfo bufferInfo = {};
@@ -143,7 +148,7 @@ namespace CAULDRON_VK
             bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
             bufferInfo.queueFamilyIndexCount = 0;
             bufferInfo.pQueueFamilyIndices = NULL;
-            bufferInfo.size = sizeof(int) * m_cubeTexture.GetArraySize(); // number of slices
+            bufferInfo.size = m_pPlan->counterBufferSize; // one counter per slice
             bufferInfo.usage = VK_BUFFER_USAGE_STORAGE_BUFFER_BIT;
 
             VmaAllocationCreateInfo bufferAllocCreateInfo = {};
@@ -174,6 +179,9 @@ namespace CAULDRON_VK
             defines["A_HALF"] = 1;
             defines["SPD_PACKED_ONLY"] = 1;
         }
+        if (m_spdReduction == SPDReduction::SPDKarisAverage) {
+            defines["SPD_KARIS_AVERAGE"] = 1;
+        }
 
         if (m_spdLoad == SPDLoad::SPDLinearSampler)
         {
@@ -445,18 +453,15 @@ namespace CAULDRON_VK
         vkDestroyPipeline(m_pDevice->GetDevice(), m_pipeline, nullptr);
         vkDestroyPipelineLayout(m_pDevice->GetDevice(), m_pipelineLayout, nullptr);
         vkDestroyDescriptorSetLayout(m_pDevice->GetDevice(), m_descriptorSetLayout, NULL);
+
+        delete m_pPlan;
+        m_pPlan = nullptr;
     }
 
     void SPDCS::Draw(VkCommandBuffer cmd_buf)
     {
         // downsample
         //
-        varAU2(dispatchThreadGroupCountXY);
-        varAU2(workGroupOffset);  // needed if Left and Top are not 0,0
-        varAU2(numWorkGroupsAndMips);
-        varAU4(rectInfo) = initAU4(0, 0, m_cubeTexture.GetWidth(), m_cubeTexture.GetHeight()); // left, top, width, height
-        SpdSetup(dispatchThreadGroupCountXY, workGroupOffset, numWorkGroupsAndMips, rectInfo);
-
         VkImageMemoryBarrier imageMemoryBarrier[2];
             
         uint32_t numBarriers = 1;
@@ -510,42 +515,54 @@ namespace CAULDRON_VK
         //
         vkCmdBindPipeline(cmd_buf, VK_PIPELINE_BIND_POINT_COMPUTE, m_pipeline);
 
-        // should be / 64
-        uint32_t dispatchX = dispatchThreadGroupCountXY[0];
-        uint32_t dispatchY = dispatchThreadGroupCountXY[1];
-        uint32_t dispatchZ = m_cubeTexture.GetArraySize(); // slices
-
         // single pass for storage buffer?
         //uint32_t uniformOffsets[1] = { (uint32_t)constantBuffer.offset };
         vkCmdBindDescriptorSets(cmd_buf, VK_PIPELINE_BIND_POINT_COMPUTE, m_pipelineLayout, 0, 1, &m_descriptorSet, 0, nullptr);
 
-        // Bind push constants
-        //
-        if (m_spdLoad == SPDLoad::SPDLinearSampler)
+        // one dispatch per rectangle of the plan
+        for (AU1 i = 0; i < m_pPlan->rectCount; i++)
         {
-            SpdLinearSamplerConstants data;
-            data.numWorkGroupsPerSlice = numWorkGroupsAndMips[0];
-            data.mips = numWorkGroupsAndMips[1];
-            data.workGroupOffset[0] = workGroupOffset[0];
-            data.workGroupOffset[1] = workGroupOffset[1];
-            data.invInputSize[0] = 1.0f / m_cubeTexture.GetWidth();
-            data.invInputSize[1] = 1.0f / m_cubeTexture.GetHeight();
-            vkCmdPushConstants(cmd_buf, m_pipelineLayout,
-                VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(SpdLinearSamplerConstants), (void*)&data);
-        }
-        else {
-            SpdConstants data;
-            data.numWorkGroupsPerSlice = numWorkGroupsAndMips[0];
-            data.mips = numWorkGroupsAndMips[1];
-            data.workGroupOffset[0] = workGroupOffset[0];
-            data.workGroupOffset[1] = workGroupOffset[1];
-            vkCmdPushConstants(cmd_buf, m_pipelineLayout,
-                VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(SpdConstants), (void*)&data);
-        }
+            const SpdPlanDispatch &dispatch = m_pPlan->dispatches[i];
 
-        // Draw
-        //
-        vkCmdDispatch(cmd_buf, dispatchX, dispatchY, dispatchZ);
+            // Bind push constants
+            //
+            if (m_spdLoad == SPDLoad::SPDLinearSampler)
+            {
+                SpdLinearSamplerConstants data;
+                data.numWorkGroupsPerSlice = dispatch.numWorkGroups;
+                data.mips = m_pPlan->mips;
+                data.workGroupOffset[0] = dispatch.workGroupOffset[0];
+                data.workGroupOffset[1] = dispatch.workGroupOffset[1];
+                data.invInputSize[0] = 1.0f / m_pPlan->width;
+                data.invInputSize[1] = 1.0f / m_pPlan->height;
+                vkCmdPushConstants(cmd_buf, m_pipelineLayout,
+                    VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(SpdLinearSamplerConstants), (void*)&data);
+            }
+            else {
+                SpdConstants data;
+                data.numWorkGroupsPerSlice = dispatch.numWorkGroups;
+                data.mips = m_pPlan->mips;
+                data.workGroupOffset[0] = dispatch.workGroupOffset[0];
+                data.workGroupOffset[1] = dispatch.workGroupOffset[1];
+                vkCmdPushConstants(cmd_buf, m_pipelineLayout,
+                    VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(SpdConstants), (void*)&data);
+            }
+
+            // previous rectangle writes the same tail mips and counters
+            if (i > 0)
+            {
+                VkMemoryBarrier memoryBarrier = {};
+                memoryBarrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+                memoryBarrier.srcAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+                memoryBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+                vkCmdPipelineBarrier(cmd_buf, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                    0, 1, &memoryBarrier, 0, nullptr, 0, nullptr);
+            }
+
+            // Draw
+            //
+            vkCmdDispatch(cmd_buf, dispatch.dispatchThreadGroupCountXY[0], dispatch.dispatchThreadGroupCountXY[1], m_pPlan->slices);
+        }
 
         imageMemoryBarrier[0] = {};
         imageMemoryBarrier[0].sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
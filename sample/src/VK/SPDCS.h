@@ -22,6 +22,8 @@
 #include "Base/Texture.h"
 #include "Base/DynamicBufferRing.h"
 
+struct SpdPlan;
+
 namespace CAULDRON_VK
 {
 #define SPD_MAX_MIP_LEVELS 12
@@ -44,11 +46,17 @@ namespace CAULDRON_VK
         SPDLinearSampler,
     };
 
+    enum class SPDReduction
+    {
+        SPDAverage,
+        SPDKarisAverage,    // luminance weighted, keeps HDR fireflies from bleeding into the mips
+    };
+
     class SPDCS
     {
     public:
         void OnCreate(Device *pDevice, UploadHeap *pUploadHeap, ResourceViewHeaps *pResourceViewHeaps,
-            SPDLoad spdLoad, SPDWaveOps spdWaveOps, SPDPacked spdPacked);
+            SPDLoad spdLoad, SPDWaveOps spdWaveOps, SPDPacked spdPacked, SPDReduction spdReduction);
         void OnDestroy();
 
         void Draw(VkCommandBuffer cmd_buf);
@@ -96,5 +104,8 @@ namespace CAULDRON_VK
         SPDLoad                        m_spdLoad;
         SPDWaveOps                     m_spdWaveOps;
         SPDPacked                      m_spdPacked;
+        SPDReduction                   m_spdReduction;
+
+        SpdPlan                       *m_pPlan = nullptr; // built once in OnCreate, reused by every Draw
     };
 }
\ No newline at end of file
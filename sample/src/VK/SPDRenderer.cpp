@@ -774,8 +774,8 @@ void SPDRenderer::OnRender(State *pState, SwapChain *pSwapChain)
             break;
         case Downsampler::SPDCS:
             if (m_usingDescriptorIndexing) {
-                m_SPDVersions.Dispatch(cmdBuf1, pState->spdLoad, pState->spdWaveOps, pState->spdPacked);
-                m_SPDVersions.GUI(pState->spdLoad, pState->spdWaveOps, pState->spdPacked, &pState->downsamplerImGUISlice);
+                m_SPDVersions.Dispatch(cmdBuf1, pState->spdLoad, pState->spdWaveOps, pState->spdPacked, pState->spdReduction);
+                m_SPDVersions.GUI(pState->spdLoad, pState->spdWaveOps, pState->spdPacked, pState->spdReduction, &pState->downsamplerImGUISlice);
             }
         
             if (pState->spdLoad == SPDLoad::SPDLoad)
@@ -74,6 +74,7 @@ public:
         SPDLoad         spdLoad;
         SPDWaveOps      spdWaveOps;
         SPDPacked       spdPacked;
+        SPDReduction    spdReduction;
 
         int             downsamplerImGUISlice;
     };
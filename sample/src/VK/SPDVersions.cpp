@@ -33,40 +33,48 @@ namespace CAULDRON_VK
         m_pDevice = pDevice;
 
         // check if subgroup operations are supported, otherwise we need to fallback to the LDS only version
-        if (pDevice->GetPhysicalDeviceSubgroupProperties().supportedOperations 
-            & VK_SUBGROUP_FEATURE_QUAD_BIT)
+        bool waveOpsSupported = (pDevice->GetPhysicalDeviceSubgroupProperties().supportedOperations
+            & VK_SUBGROUP_FEATURE_QUAD_BIT) != 0;
+
+        for (int load = 0; load < 2; load++)
         {
-            m_spd_WaveOps_NonPacked.OnCreate(pDevice, pUploadHeap, pResourceViewHeaps, SPDLoad::SPDLoad, SPDWaveOps::SPDWaveOps, SPDPacked::SPDNonPacked);
-            m_spd_WaveOps_Packed.OnCreate(pDevice, pUploadHeap, pResourceViewHeaps, SPDLoad::SPDLoad, SPDWaveOps::SPDWaveOps, SPDPacked::SPDPacked);
+            for (int waveOps = 0; waveOps < 2; waveOps++)
+            {
+                if ((SPDWaveOps)waveOps == SPDWaveOps::SPDWaveOps && !waveOpsSupported)
+                    continue;
 
-            m_spd_WaveOps_NonPacked_Linear_Sampler.OnCreate(pDevice, pUploadHeap, pResourceViewHeaps, SPDLoad::SPDLinearSampler, SPDWaveOps::SPDWaveOps, SPDPacked::SPDNonPacked);
-            m_spd_WaveOps_Packed_Linear_Sampler.OnCreate(pDevice, pUploadHeap, pResourceViewHeaps, SPDLoad::SPDLinearSampler, SPDWaveOps::SPDWaveOps, SPDPacked::SPDPacked);
+                for (int packed = 0; packed < 2; packed++)
+                {
+                    for (int reduction = 0; reduction < 2; reduction++)
+                    {
+                        m_spd[load][waveOps][packed][reduction].OnCreate(pDevice, pUploadHeap, pResourceViewHeaps,
+                            (SPDLoad)load, (SPDWaveOps)waveOps, (SPDPacked)packed, (SPDReduction)reduction);
+                    }
+                }
+            }
         }
-
-        // fallback path
-        m_spd_No_WaveOps_NonPacked.OnCreate(pDevice, pUploadHeap, pResourceViewHeaps, SPDLoad::SPDLoad, SPDWaveOps::SPDNoWaveOps, SPDPacked::SPDNonPacked);
-        m_spd_No_WaveOps_Packed.OnCreate(pDevice, pUploadHeap, pResourceViewHeaps, SPDLoad::SPDLoad, SPDWaveOps::SPDNoWaveOps, SPDPacked::SPDPacked);
-
-        m_spd_No_WaveOps_NonPacked_Linear_Sampler.OnCreate(pDevice, pUploadHeap, pResourceViewHeaps, SPDLoad::SPDLinearSampler, SPDWaveOps::SPDNoWaveOps, SPDPacked::SPDNonPacked);
-        m_spd_No_WaveOps_Packed_Linear_Sampler.OnCreate(pDevice, pUploadHeap, pResourceViewHeaps, SPDLoad::SPDLinearSampler, SPDWaveOps::SPDNoWaveOps, SPDPacked::SPDPacked);
     }
 
     void SPDVersions::OnDestroy()
     {
-        m_spd_No_WaveOps_NonPacked.OnDestroy();
-        m_spd_No_WaveOps_Packed.OnDestroy();
-
-        m_spd_No_WaveOps_NonPacked_Linear_Sampler.OnDestroy();
-        m_spd_No_WaveOps_Packed_Linear_Sampler.OnDestroy();
+        bool waveOpsSupported = (m_pDevice->GetPhysicalDeviceSubgroupProperties().supportedOperations
+            & VK_SUBGROUP_FEATURE_QUAD_BIT) != 0;
 
-        if (m_pDevice->GetPhysicalDeviceSubgroupProperties().supportedOperations 
-            & VK_SUBGROUP_FEATURE_QUAD_BIT)
+        for (int load = 0; load < 2; load++)
         {
-            m_spd_WaveOps_NonPacked.OnDestroy();
-            m_spd_WaveOps_Packed.OnDestroy();
+            for (int waveOps = 0; waveOps < 2; waveOps++)
+            {
+                if ((SPDWaveOps)waveOps == SPDWaveOps::SPDWaveOps && !waveOpsSupported)
+                    continue;
 
-            m_spd_WaveOps_NonPacked_Linear_Sampler.OnDestroy();
-            m_spd_WaveOps_Packed_Linear_Sampler.OnDestroy();
+                for (int packed = 0; packed < 2; packed++)
+                {
+                    for (int reduction = 0; reduction < 2; reduction++)
+                    {
+                        m_spd[load][waveOps][packed][reduction].OnDestroy();
+                    }
+                }
+            }
         }
     }
 
@@ -76,129 +84,13 @@ namespace CAULDRON_VK
         return (static_cast<int>(min(floor(log2(resolution)), 12)));
     }
 
-    void SPDVersions::Dispatch(VkCommandBuffer cmd_buf, SPDLoad spdLoad, SPDWaveOps spdWaveOps, SPDPacked spdPacked)
+    void SPDVersions::Dispatch(VkCommandBuffer cmd_buf, SPDLoad spdLoad, SPDWaveOps spdWaveOps, SPDPacked spdPacked, SPDReduction spdReduction)
     {
-        switch (spdLoad)
-        {
-        case SPDLoad::SPDLoad:
-        {
-            switch (spdWaveOps)
-            {
-            case SPDWaveOps::SPDWaveOps:
-                switch (spdPacked)
-                {
-                case SPDPacked::SPDNonPacked:
-                    m_spd_WaveOps_NonPacked.Draw(cmd_buf);
-                    break;
-                case SPDPacked::SPDPacked:
-                    m_spd_WaveOps_Packed.Draw(cmd_buf);
-                    break;
-                }
-                break;
-            case SPDWaveOps::SPDNoWaveOps:
-                switch (spdPacked)
-                {
-                case SPDPacked::SPDNonPacked:
-                    m_spd_No_WaveOps_NonPacked.Draw(cmd_buf);
-                    break;
-                case SPDPacked::SPDPacked:
-                    m_spd_No_WaveOps_Packed.Draw(cmd_buf);
-                    break;
-                }
-            }
-            break;
-        }
-        case SPDLoad::SPDLinearSampler:
-        {
-            switch (spdWaveOps)
-            {
-            case SPDWaveOps::SPDWaveOps:
-                switch (spdPacked)
-                {
-                case SPDPacked::SPDNonPacked:
-                    m_spd_WaveOps_NonPacked_Linear_Sampler.Draw(cmd_buf);
-                    break;
-                case SPDPacked::SPDPacked:
-                    m_spd_WaveOps_Packed_Linear_Sampler.Draw(cmd_buf);
-                    break;
-                }
-                break;
-            case SPDWaveOps::SPDNoWaveOps:
-                switch (spdPacked)
-                {
-                case SPDPacked::SPDNonPacked:
-                    m_spd_No_WaveOps_NonPacked_Linear_Sampler.Draw(cmd_buf);
-                    break;
-                case SPDPacked::SPDPacked:
-                    m_spd_No_WaveOps_Packed_Linear_Sampler.Draw(cmd_buf);
-                    break;
-                }
-            }
-            break;
-        }
-        }
+        GetVersion(spdLoad, spdWaveOps, spdPacked, spdReduction).Draw(cmd_buf);
     }
 
-    void SPDVersions::GUI(SPDLoad spdLoad, SPDWaveOps spdWaveOps, SPDPacked spdPacked, int* pSlice)
+    void SPDVersions::GUI(SPDLoad spdLoad, SPDWaveOps spdWaveOps, SPDPacked spdPacked, SPDReduction spdReduction, int *pSlice)
     {
-        switch (spdLoad)
-        {
-        case SPDLoad::SPDLoad:
-        {
-            switch (spdWaveOps)
-            {
-            case SPDWaveOps::SPDWaveOps:
-                switch (spdPacked)
-                {
-                case SPDPacked::SPDNonPacked:
-                    m_spd_WaveOps_NonPacked.GUI(pSlice);
-                    break;
-                case SPDPacked::SPDPacked:
-                    m_spd_WaveOps_Packed.GUI(pSlice);
-                    break;
-                }
-                break;
-            case SPDWaveOps::SPDNoWaveOps:
-                switch (spdPacked)
-                {
-                case SPDPacked::SPDNonPacked:
-                    m_spd_No_WaveOps_NonPacked.GUI(pSlice);
-                    break;
-                case SPDPacked::SPDPacked:
-                    m_spd_No_WaveOps_Packed.GUI(pSlice);
-                    break;
-                }
-            }
-            break;
-        }
-        case SPDLoad::SPDLinearSampler:
-        {
-            switch (spdWaveOps)
-            {
-            case SPDWaveOps::SPDWaveOps:
-                switch (spdPacked)
-                {
-                case SPDPacked::SPDNonPacked:
-                    m_spd_WaveOps_NonPacked_Linear_Sampler.GUI(pSlice);
-                    break;
-                case SPDPacked::SPDPacked:
-                    m_spd_WaveOps_Packed_Linear_Sampler.GUI(pSlice);
-                    break;
-                }
-                break;
-            case SPDWaveOps::SPDNoWaveOps:
-                switch (spdPacked)
-                {
-                case SPDPacked::SPDNonPacked:
-                    m_spd_No_WaveOps_NonPacked_Linear_Sampler.GUI(pSlice);
-                    break;
-                case SPDPacked::SPDPacked:
-                    m_spd_No_WaveOps_Packed_Linear_Sampler.GUI(pSlice);
-                    break;
-                }
-            }
-            break;
-        }
-        }
+        GetVersion(spdLoad, spdWaveOps, spdPacked, spdReduction).GUI(pSlice);
     }
 }
\ No newline at end of file